@@ -0,0 +1,74 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#ifndef SCEFRAMEBUDGET_H
+#define SCEFRAMEBUDGET_H
+
+#include <SCE/utils/SCEUtils.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sce_sframebudget SCE_SFrameBudget;
+/**
+ * \brief Time allowed each frame to background work such as terrain meshing,
+ * decimation and uploads, shared between the modules doing that work
+ */
+struct sce_sframebudget {
+    float budget;               /**< Milliseconds per frame, 0 for unlimited */
+    float max_carry;            /**< Maximum unused time carried over */
+    float carry;                /**< Unused time of the previous frame */
+    float available;            /**< Time available for the current frame */
+    float spent;                /**< Time spent in slices this frame */
+    double start;               /**< Start of the running slice, in ms */
+    int depth;                  /**< Nesting level of the running slice */
+    SCEuint n_overruns;         /**< Number of frames exceeding the budget */
+};
+
+void SCE_FrameBudget_Init (SCE_SFrameBudget*);
+void SCE_FrameBudget_Clear (SCE_SFrameBudget*);
+SCE_SFrameBudget* SCE_FrameBudget_Create (void);
+void SCE_FrameBudget_Delete (SCE_SFrameBudget*);
+
+double SCE_FrameBudget_GetTime (void);
+
+void SCE_FrameBudget_SetBudget (SCE_SFrameBudget*, float);
+float SCE_FrameBudget_GetBudget (const SCE_SFrameBudget*);
+void SCE_FrameBudget_SetMaxCarry (SCE_SFrameBudget*, float);
+
+void SCE_FrameBudget_Begin (SCE_SFrameBudget*);
+void SCE_FrameBudget_End (SCE_SFrameBudget*);
+
+void SCE_FrameBudget_StartSlice (SCE_SFrameBudget*);
+void SCE_FrameBudget_StopSlice (SCE_SFrameBudget*);
+int SCE_FrameBudget_HasTime (const SCE_SFrameBudget*);
+
+float SCE_FrameBudget_GetSpent (const SCE_SFrameBudget*);
+float SCE_FrameBudget_GetRemaining (const SCE_SFrameBudget*);
+float SCE_FrameBudget_GetCarry (const SCE_SFrameBudget*);
+SCEuint SCE_FrameBudget_GetNumOverruns (const SCE_SFrameBudget*);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* guard */
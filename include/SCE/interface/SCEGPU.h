@@ -0,0 +1,67 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#ifndef SCEGPU_H
+#define SCEGPU_H
+
+#include <SCE/utils/SCEUtils.h>
+#include <SCE/renderer/SCERenderer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Fence signaled once the GPU commands issued before it are done */
+typedef GLsync SCE_GPUFence;
+
+SCEuint SCE_GPU_CreateVertexArray (void);
+void SCE_GPU_DeleteVertexArray (SCEuint);
+void SCE_GPU_UseVertexArray (SCEuint);
+
+int SCE_GPU_HasCopyBuffer (void);
+void SCE_GPU_CopyBuffer (SCE_RBuffer*, size_t, SCE_RBuffer*, size_t, size_t);
+
+int SCE_GPU_HasFences (void);
+SCE_GPUFence SCE_GPU_CreateFence (void);
+void SCE_GPU_DeleteFence (SCE_GPUFence);
+int SCE_GPU_IsFenceReached (SCE_GPUFence);
+
+SCEuint SCE_GPU_CreateBuffer (void);
+void SCE_GPU_DeleteBuffer (SCEuint);
+void* SCE_GPU_MapPixelBuffer (SCEuint, size_t, size_t, int);
+void SCE_GPU_UnmapPixelBuffer (void);
+void SCE_GPU_UsePixelBuffer (SCEuint);
+void SCE_GPU_SetBufferData (SCEuint, size_t, const void*);
+
+void SCE_GPU_EnableDrawAttribs (SCEuint, const int*, int, size_t);
+void SCE_GPU_DisableDrawAttribs (const int*, int);
+void SCE_GPU_MultiDrawIndirect (SCEenum, SCEenum, SCEuint, SCEuint);
+
+int SCE_GPU_SetUnpackAlignment (int);
+void SCE_GPU_SetUnpackLayout (int, int, const int*);
+void SCE_GPU_TexSubImage3D (const int*, const int*, SCEenum, SCEenum,
+                            const void*);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* guard */
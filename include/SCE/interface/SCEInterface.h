@@ -17,7 +17,7 @@
  -----------------------------------------------------------------------------*/
  
 /* created: 11/04/2010
-   updated: 16/04/2010 */
+   updated: 19/10/2026 */
 
 #ifndef SCEINTERFACE_H
 #define SCEINTERFACE_H
@@ -28,8 +28,12 @@
 #include <SCE/renderer/SCERenderer.h>
 
 /* internal dependencies (?) */
+#include "SCE/interface/SCEGPU.h"
 #include "SCE/interface/SCEQuad.h"
 #include "SCE/interface/SCEMesh.h"
+#include "SCE/interface/SCEMeshBatch.h"
+#include "SCE/interface/SCEMeshArena.h"
+#include "SCE/interface/SCEFrameBudget.h"
 #include "SCE/interface/SCELight.h"
 #include "SCE/interface/SCEGeometryInstance.h"
 #include "SCE/interface/SCESceneResource.h"
@@ -37,6 +41,9 @@
 #include "SCE/interface/SCEBatch.h"
 #include "SCE/interface/SCEModel.h"
 #include "SCE/interface/SCESkybox.h"
+#include "SCE/interface/SCEVoxelPyramid.h"
+#include "SCE/interface/SCEVoxelClassifier.h"
+#include "SCE/interface/SCEVoxelMeshCache.h"
 #include "SCE/interface/SCEVoxelTerrain.h"
 #include "SCE/interface/SCEVoxelOctreeTerrain.h"
 #include "SCE/interface/SCEScene.h"
@@ -17,13 +17,14 @@
  -----------------------------------------------------------------------------*/
 
 /* created: 31/07/2009
-   updated: 15/03/2013 */
+   updated: 19/10/2026 */
 
 #ifndef SCEMESH_H
 #define SCEMESH_H
 
 #include <SCE/core/SCECore.h>
 #include <SCE/renderer/SCERenderer.h>
+#include "SCE/interface/SCEMeshOptimizer.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -46,6 +47,23 @@ enum sce_emeshstream {
 };
 typedef enum sce_emeshstream SCE_EMeshStream;
 
+/* vertex data quantization flags, see SCE_Mesh_SetQuantization() */
+#define SCE_MESH_QUANTIZE_POSITION 1     /**< 4x16 bits normalized positions */
+#define SCE_MESH_QUANTIZE_NORMAL 2       /**< 2x16 bits octahedral normals */
+#define SCE_MESH_QUANTIZE_NORMAL_PACKED 4 /**< 10-10-10-2 normals */
+#define SCE_MESH_QUANTIZE_TEXCOORD 8     /**< Half float texture coordinates */
+
+/* number of vertex array objects of a mesh, one per set of activated
+   streams */
+#define SCE_MESH_MAX_VAOS 4
+
+#ifndef SCE_HALF_FLOAT
+#define SCE_HALF_FLOAT GL_HALF_FLOAT
+#endif
+#ifndef SCE_INT_2_10_10_10_REV
+#define SCE_INT_2_10_10_10_REV GL_INT_2_10_10_10_REV
+#endif
+
 typedef struct sce_smesharray SCE_SMeshArray;
 struct sce_smesharray {
     SCE_RVertexBufferData data;
@@ -74,10 +92,27 @@ struct sce_smesh {
     SCE_RFeedback feedback_id;  /**< Feedback object for indices */
     SCE_RBuffer *counting_buffer;
     SCE_RBuffer *counting_buffer_id;
+    int feedback_pending;       /**< Vertex count of the feedback not read */
+    int feedback_pending_id;    /**< Index count of the feedback not read */
     SCE_SGeometryArrayUser index_auser;
     SCE_RBufferRenderMode rmode;/**< Render mode */
     SCE_EMeshBuildMode bmode;   /**< Build mode */
     int built;                  /**< Is the mesh built? */
+    int use_vao;                /**< Are the bindings recorded in VAOs? */
+    SCEuint vaos[SCE_MESH_MAX_VAOS]; /**< Vertex array objects, 0 if unused */
+    int vao_streams[SCE_MESH_MAX_VAOS]; /**< Bindings recorded in each VAO */
+    SCEuint vao_versions[SCE_MESH_MAX_VAOS]; /**< \c vao_version at record
+                                              *   time */
+    SCEuint vao_version;        /**< Incremented when the buffers change */
+    SCEuint next_vao;           /**< VAO replaced when all of them are used */
+    SCEbitfield optimize;       /**< Optimization passes to run at build
+                                 *   time, see SCE_MeshOpt_Optimize() */
+    float acmr[2];              /**< ACMR before and after optimization */
+    SCEbitfield quantize;       /**< Vertex data quantization done at build
+                                 *   time, see SCE_Mesh_SetQuantization() */
+    float pos_scale[3];         /**< Decoding scale of quantized positions */
+    float pos_offset[3];        /**< Decoding offset of quantized positions */
+    int auto_index;             /**< Use 16 bits indices when possible */
 };
 
 int SCE_Init_Mesh (void);
@@ -113,6 +148,12 @@ int SCE_Mesh_SetGeometry (SCE_SMesh*, SCE_SGeometry*, int);
 void SCE_Mesh_Build (SCE_SMesh*, SCE_EMeshBuildMode,
                      SCE_RBufferUsage[SCE_MESH_NUM_STREAMS + 1]);
 void SCE_Mesh_AutoBuild (SCE_SMesh*);
+void SCE_Mesh_SetOptimization (SCE_SMesh*, SCEbitfield);
+void SCE_Mesh_GetACMR (const SCE_SMesh*, float*, float*);
+void SCE_Mesh_SetQuantization (SCE_SMesh*, SCEbitfield);
+SCEbitfield SCE_Mesh_GetQuantization (const SCE_SMesh*);
+float* SCE_Mesh_GetPositionScale (SCE_SMesh*);
+float* SCE_Mesh_GetPositionOffset (SCE_SMesh*);
 
 void SCE_Mesh_SetRenderMode (SCE_SMesh*, SCE_RBufferRenderMode);
 
@@ -130,6 +171,16 @@ int SCE_Mesh_ReallocIndexBuffer (SCE_SMesh*, SCE_RBufferPool*);
 void SCE_Mesh_UploadVertices (SCE_SMesh*, SCE_EMeshStream, const SCEvertices*,
                               size_t, size_t);
 void SCE_Mesh_UploadIndices (SCE_SMesh*, const SCEindices*, size_t);
+
+SCEenum SCE_Mesh_SelectIndexType (SCEuint);
+void SCE_Mesh_SetIndexType (SCE_SMesh*, SCEenum);
+SCEenum SCE_Mesh_GetIndexType (const SCE_SMesh*);
+void SCE_Mesh_AutoIndexType (SCE_SMesh*);
+void SCE_Mesh_SetAutoIndexType (SCE_SMesh*, int);
+size_t SCE_Mesh_GetIndexTypeSize (SCEenum);
+void SCE_Mesh_ConvertIndices (const void*, SCEenum, void*, SCEenum, SCEuint);
+int SCE_Mesh_UploadIndicesFrom (SCE_SMesh*, const void*, SCEenum, SCEuint);
+
 void SCE_Mesh_DownloadVertices (SCE_SMesh*, SCE_EMeshStream, SCEvertices*,
                                 size_t, size_t);
 void SCE_Mesh_DownloadIndices (SCE_SMesh*, SCEindices*, size_t);
@@ -140,11 +191,18 @@ void SCE_Mesh_Use (SCE_SMesh*);
 void SCE_Mesh_Render (void);
 void SCE_Mesh_RenderInstanced (SCEuint);
 void SCE_Mesh_Unuse (void);
+void SCE_Mesh_Unbind (void);
+
+SCEuint SCE_Mesh_GetNumAvoidedBinds (void);
+void SCE_Mesh_ResetNumAvoidedBinds (void);
 
 void SCE_Mesh_BeginRenderTo (SCE_SMesh*);
 void SCE_Mesh_EndRenderTo (SCE_SMesh*);
 void SCE_Mesh_BeginRenderToIndices (SCE_SMesh*);
 void SCE_Mesh_EndRenderToIndices (SCE_SMesh*);
+void SCE_Mesh_StopRenderTo (SCE_SMesh*);
+void SCE_Mesh_StopRenderToIndices (SCE_SMesh*);
+void SCE_Mesh_ResolveRenderTo (SCE_SMesh*);
 
 #ifdef __cplusplus
 } /* extern "C" */
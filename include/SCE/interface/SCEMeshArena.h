@@ -0,0 +1,133 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#ifndef SCEMESHARENA_H
+#define SCEMESHARENA_H
+
+#include <SCE/utils/SCEUtils.h>
+#include <SCE/core/SCECore.h>
+#include <SCE/renderer/SCERenderer.h>
+#include "SCE/interface/SCEMeshBatch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* two-level segregated fit parameters */
+#define SCE_MESHARENA_SL_LOG2 4
+#define SCE_MESHARENA_SL_COUNT (1 << SCE_MESHARENA_SL_LOG2)
+#define SCE_MESHARENA_FL_COUNT 32
+
+typedef struct sce_smesharenablock SCE_SMeshArenaBlock;
+/**
+ * \brief Range of a heap, either free or allocated
+ */
+struct sce_smesharenablock {
+    SCEuint offset;             /**< In elements (vertices or indices) */
+    SCEuint size;
+    int free;
+    void *owner;                /**< Allocation owning the block */
+    SCE_SMeshArenaBlock *prev, *next;           /**< Neighbours in memory */
+    SCE_SMeshArenaBlock *prev_free, *next_free; /**< Free list links */
+};
+
+typedef struct sce_smesharenaheap SCE_SMeshArenaHeap;
+/**
+ * \brief TLSF style allocator of ranges of elements
+ */
+struct sce_smesharenaheap {
+    SCEuint size;               /**< Capacity, in elements */
+    SCEuint used;               /**< Allocated elements */
+    SCEuint fl_bitmap;
+    SCEuint sl_bitmap[SCE_MESHARENA_FL_COUNT];
+    SCE_SMeshArenaBlock *free[SCE_MESHARENA_FL_COUNT][SCE_MESHARENA_SL_COUNT];
+    SCE_SMeshArenaBlock *first; /**< Lowest block in memory */
+    SCEuint n_blocks;
+    SCEuint n_free_blocks;
+};
+
+typedef struct sce_smesharenaalloc SCE_SMeshArenaAlloc;
+/**
+ * \brief Vertices and indices of one mesh living in an arena
+ */
+struct sce_smesharenaalloc {
+    SCE_SMeshArenaBlock *vblock;
+    SCE_SMeshArenaBlock *iblock;
+    SCE_SMeshBatchEntry entry;  /**< Vertices and indices actually used */
+};
+
+typedef struct sce_smesharena SCE_SMeshArena;
+/**
+ * \brief Large shared vertex and index buffers sub-allocated between many
+ * meshes of identical layout, with incremental defragmentation
+ * \sa SCE_SMeshBatch
+ */
+struct sce_smesharena {
+    SCE_SMeshBatch batch;       /**< Shared buffers and multi-draw */
+    SCE_SMeshArenaHeap vertices;
+    SCE_SMeshArenaHeap indices;
+    SCEuint n_allocs;           /**< Live allocations */
+    SCEuint n_moves;            /**< Allocations moved by defragmentation */
+    SCEuint n_failures;         /**< Allocations that did not fit */
+    void *scratch;              /**< Conversions and moves */
+    size_t scratch_size;
+};
+
+void SCE_MeshArena_InitAlloc (SCE_SMeshArenaAlloc*);
+
+void SCE_MeshArena_Init (SCE_SMeshArena*);
+void SCE_MeshArena_Clear (SCE_SMeshArena*);
+SCE_SMeshArena* SCE_MeshArena_Create (void);
+void SCE_MeshArena_Delete (SCE_SMeshArena*);
+
+int SCE_MeshArena_Setup (SCE_SMeshArena*, SCE_SGeometry*, SCEuint, SCEuint);
+SCE_SMeshBatch* SCE_MeshArena_GetBatch (SCE_SMeshArena*);
+
+int SCE_MeshArena_Alloc (SCE_SMeshArena*, SCE_SMeshArenaAlloc*, SCEuint,
+                         SCEuint);
+void SCE_MeshArena_Free (SCE_SMeshArena*, SCE_SMeshArenaAlloc*);
+int SCE_MeshArena_Realloc (SCE_SMeshArena*, SCE_SMeshArenaAlloc*, SCEuint,
+                           SCEuint);
+int SCE_MeshArena_IsAllocated (const SCE_SMeshArenaAlloc*);
+
+void SCE_MeshArena_UploadVertices (SCE_SMeshArena*, SCE_SMeshArenaAlloc*,
+                                   SCE_EMeshStream, const void*);
+int SCE_MeshArena_UploadIndices (SCE_SMeshArena*, SCE_SMeshArenaAlloc*,
+                                 const void*, SCEenum);
+int SCE_MeshArena_CopyMesh (SCE_SMeshArena*, SCE_SMeshArenaAlloc*, SCE_SMesh*);
+const SCE_SMeshBatchEntry*
+SCE_MeshArena_GetEntry (const SCE_SMeshArenaAlloc*);
+
+int SCE_MeshArena_Defragment (SCE_SMeshArena*, SCEuint);
+
+float SCE_MeshArena_GetVertexOccupancy (const SCE_SMeshArena*);
+float SCE_MeshArena_GetIndexOccupancy (const SCE_SMeshArena*);
+float SCE_MeshArena_GetVertexFragmentation (const SCE_SMeshArena*);
+float SCE_MeshArena_GetIndexFragmentation (const SCE_SMeshArena*);
+SCEuint SCE_MeshArena_GetNumAllocs (const SCE_SMeshArena*);
+SCEuint SCE_MeshArena_GetNumMoves (const SCE_SMeshArena*);
+SCEuint SCE_MeshArena_GetNumFailures (const SCE_SMeshArena*);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* guard */
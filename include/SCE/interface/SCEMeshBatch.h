@@ -0,0 +1,133 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#ifndef SCEMESHBATCH_H
+#define SCEMESHBATCH_H
+
+#include <SCE/utils/SCEUtils.h>
+#include <SCE/core/SCECore.h>
+#include <SCE/renderer/SCERenderer.h>
+#include "SCE/interface/SCEMesh.h"
+#include "SCE/interface/SCEGeometryInstance.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Number of floats of per-draw data: three rows of the object matrix
+ *  followed by a user vector, see SCE_MeshBatch_DrawData() */
+#define SCE_MESHBATCH_DRAW_DATA_SIZE 16
+
+/**
+ * \brief Location of a mesh packed into the buffers of a batch
+ * \sa SCE_MeshBatch_AddMesh()
+ */
+typedef struct sce_smeshbatchentry SCE_SMeshBatchEntry;
+struct sce_smeshbatchentry {
+    SCEuint first_vertex;       /**< Base vertex of the mesh */
+    SCEuint n_vertices;
+    SCEuint first_index;        /**< Offset of the first index, in indices */
+    SCEuint n_indices;
+};
+
+/**
+ * \brief One draw of a batch, matches the layout of the commands read by
+ * glMultiDrawElementsIndirect()
+ */
+typedef struct sce_smeshbatchcommand SCE_SMeshBatchCommand;
+struct sce_smeshbatchcommand {
+    SCEuint count;
+    SCEuint n_instances;
+    SCEuint first_index;
+    SCEint base_vertex;
+    SCEuint base_instance;      /**< Index of the per-draw data */
+};
+
+typedef struct sce_smeshbatch SCE_SMeshBatch;
+/**
+ * \brief Meshes sharing the same vertex layout packed into a single set
+ * of buffers, rendered with one multi-draw call per flush
+ * \sa SCE_SMesh
+ */
+struct sce_smeshbatch {
+    SCE_SMesh mesh;             /**< Shared buffers */
+    SCEuint max_vertices;       /**< Capacity of the vertex buffers */
+    SCEuint max_indices;        /**< Capacity of the index buffer */
+    SCEuint n_vertices;         /**< Vertices already packed */
+    SCEuint n_indices;          /**< Indices already packed */
+    size_t vertex_size[SCE_MESH_NUM_STREAMS]; /**< Bytes per vertex */
+    size_t index_size;          /**< Bytes per index */
+
+    SCE_SMeshBatchCommand *cmds; /**< Per-frame command buffer */
+    float *data;                 /**< Per-draw data, see
+                                  *   SCE_MESHBATCH_DRAW_DATA_SIZE */
+    SCEuint n_cmds;
+    SCEuint max_cmds;
+    int attrib1, attrib2, attrib3; /**< Attributes receiving the per-draw
+                                    *   data (one row each) */
+    int attrib4;                /**< Attribute receiving the user vector of
+                                 *   each draw, -1 if none */
+    SCEuint cmd_buffer;         /**< GL indirect buffer */
+    SCEuint data_buffer;        /**< GL per-draw data buffer */
+
+    SCEuint n_draw_calls;       /**< GL draw calls issued by the last flush */
+    SCEuint n_draws;            /**< Draws submitted by the last flush */
+};
+
+int SCE_Init_MeshBatch (void);
+void SCE_Quit_MeshBatch (void);
+
+int SCE_MeshBatch_HasBaseVertex (void);
+SCEuint SCE_MeshBatch_MaxIndex (SCEenum);
+void SCE_MeshBatch_RebaseIndices (void*, SCEenum, SCEuint, SCEuint);
+
+void SCE_MeshBatch_InitEntry (SCE_SMeshBatchEntry*);
+
+void SCE_MeshBatch_Init (SCE_SMeshBatch*);
+void SCE_MeshBatch_Clear (SCE_SMeshBatch*);
+SCE_SMeshBatch* SCE_MeshBatch_Create (void);
+void SCE_MeshBatch_Delete (SCE_SMeshBatch*);
+
+void SCE_MeshBatch_SetAttribIndices (SCE_SMeshBatch*, int, int, int);
+void SCE_MeshBatch_SetUserAttribIndex (SCE_SMeshBatch*, int);
+int SCE_MeshBatch_Setup (SCE_SMeshBatch*, SCE_SGeometry*, SCEuint, SCEuint);
+int SCE_MeshBatch_AddMesh (SCE_SMeshBatch*, SCE_SMesh*, SCE_SMeshBatchEntry*);
+int SCE_MeshBatch_Compatible (SCE_SMeshBatch*, SCE_SMesh*);
+
+SCE_SMesh* SCE_MeshBatch_GetMesh (SCE_SMeshBatch*);
+
+void SCE_MeshBatch_Begin (SCE_SMeshBatch*);
+int SCE_MeshBatch_Draw (SCE_SMeshBatch*, const SCE_SMeshBatchEntry*,
+                        const SCE_TMatrix4);
+int SCE_MeshBatch_DrawData (SCE_SMeshBatch*, const SCE_SMeshBatchEntry*,
+                            const SCE_TMatrix4, const float*);
+int SCE_MeshBatch_DrawGroup (SCE_SMeshBatch*, const SCE_SMeshBatchEntry*,
+                             SCE_SGeometryInstanceGroup*);
+void SCE_MeshBatch_Flush (SCE_SMeshBatch*);
+
+SCEuint SCE_MeshBatch_GetNumDrawCalls (const SCE_SMeshBatch*);
+SCEuint SCE_MeshBatch_GetNumDraws (const SCE_SMeshBatch*);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* guard */
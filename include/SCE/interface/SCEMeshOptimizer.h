@@ -0,0 +1,102 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#ifndef SCEMESHOPTIMIZER_H
+#define SCEMESHOPTIMIZER_H
+
+#include <SCE/utils/SCEUtils.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Reorder triangles for the post-transform vertex cache */
+#define SCE_MESHOPT_VERTEX_CACHE 1
+/** Reorder vertices in the order of their first use */
+#define SCE_MESHOPT_VERTEX_FETCH 2
+/** Sort clusters of triangles from the outside in, needs positions */
+#define SCE_MESHOPT_OVERDRAW 4
+
+/** Size of the simulated FIFO cache used to compute the ACMR */
+#define SCE_MESHOPT_FIFO_SIZE 16
+
+/**
+ * \brief Cluster of triangles for the overdraw pass
+ */
+typedef struct sce_smeshoptcluster SCE_SMeshOptCluster;
+struct sce_smeshoptcluster {
+    SCEuint first;              /**< First triangle */
+    SCEuint n_triangles;
+    float key;                  /**< Sort key, greater is drawn first */
+};
+
+typedef struct sce_smeshoptimizer SCE_SMeshOptimizer;
+/**
+ * \brief Scratch buffers and statistics of the mesh optimization pass
+ *
+ * The buffers grow on demand and are kept between calls so that optimizing
+ * many meshes of similar sizes does not allocate anything.
+ */
+struct sce_smeshoptimizer {
+    SCEuint *indices;           /**< Working copy of the indices */
+    SCEuint *sorted;            /**< Reordered indices */
+    SCEuint *remap;             /**< Old vertex index to new vertex index */
+    SCEuint *adjacency;         /**< Triangles of each vertex */
+    SCEuint *offsets;           /**< Offset of each vertex in \c adjacency */
+    SCEuint *valence;           /**< Number of remaining triangles */
+    int *cache_pos;             /**< Position in the simulated cache */
+    float *vscore;              /**< Score of each vertex */
+    float *tscore;              /**< Score of each triangle */
+    SCEubyte *emitted;          /**< Is the triangle already emitted? */
+    SCE_SMeshOptCluster *clusters; /**< Clusters of the overdraw pass */
+    void *tmp;                  /**< Copy of a vertex array while remapping */
+    SCEuint max_indices;
+    SCEuint max_vertices;
+    size_t tmp_size;
+
+    SCEuint n_vertices;         /**< Vertices of the last optimized mesh */
+    int remapped;               /**< Has the last mesh its vertices
+                                 *   reordered? see SCE_MeshOpt_Remap() */
+    float acmr_before;          /**< ACMR of the last mesh before the pass */
+    float acmr_after;           /**< ACMR of the last mesh after the pass */
+    double sum_before;
+    double sum_after;
+    SCEuint n_meshes;           /**< Number of optimized meshes */
+};
+
+void SCE_MeshOpt_Init (SCE_SMeshOptimizer*);
+void SCE_MeshOpt_Clear (SCE_SMeshOptimizer*);
+
+float SCE_MeshOpt_ComputeACMR (const SCEuint*, SCEuint);
+
+int SCE_MeshOpt_Optimize (SCE_SMeshOptimizer*, SCEbitfield, void*, SCEenum,
+                          SCEuint, const float*, size_t, SCEuint);
+int SCE_MeshOpt_Remap (SCE_SMeshOptimizer*, void*, size_t, size_t);
+
+void SCE_MeshOpt_GetACMR (const SCE_SMeshOptimizer*, float*, float*);
+void SCE_MeshOpt_GetAverageACMR (const SCE_SMeshOptimizer*, float*, float*);
+void SCE_MeshOpt_ResetStats (SCE_SMeshOptimizer*);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* guard */
@@ -30,6 +30,7 @@
 #include "SCE/interface/SCEShaders.h"
 #include "SCE/interface/SCETexture.h"
 #include "SCE/interface/SCEMaterial.h"
+#include "SCE/interface/SCEMeshBatch.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -94,6 +95,8 @@ struct sce_ssceneentity {
     SCE_SSceneResource *shader;   /**< Shader used by the entity */
     SCE_SSceneResource *material; /**< Material used by the entity */
     SCE_SSceneEntityProperties props;
+    SCE_SMeshBatch *batch;        /**< Batch where \c mesh is packed, if any */
+    SCE_SMeshBatchEntry batch_entry; /**< Location of \c mesh in \c batch */
 
     SCE_SSceneEntityGroup *group; /**< Group of the entity */
     /** Used to determine if the instance is in the given frustum */
@@ -179,6 +182,8 @@ void SCE_SceneEntity_SetInstanceData (SCE_SSceneEntityInstance*, void*);
 SCE_SSceneEntityProperties* SCE_SceneEntity_GetProperties (SCE_SSceneEntity*);
 void SCE_SceneEntity_SetMesh (SCE_SSceneEntity*, SCE_SMesh*);
 SCE_SMesh* SCE_SceneEntity_GetMesh (SCE_SSceneEntity*);
+int SCE_SceneEntity_SetBatch (SCE_SSceneEntity*, SCE_SMeshBatch*);
+SCE_SMeshBatch* SCE_SceneEntity_GetBatch (SCE_SSceneEntity*);
 
 int SCE_SceneEntity_AddTexture (SCE_SSceneEntity*, SCE_STexture*);
 void SCE_SceneEntity_RemoveTexture (SCE_SSceneEntity*, SCE_STexture*);
@@ -212,6 +217,7 @@ int SCE_SceneEntity_MatchState (SCE_SSceneEntity*, SCEuint);
 void SCE_SceneEntity_ApplyProperties (SCE_SSceneEntity*);
 
 void SCE_SceneEntity_UseResources (SCE_SSceneEntity*);
+int SCE_SceneEntity_HasSameResources (SCE_SSceneEntity*, SCE_SSceneEntity*);
 void SCE_SceneEntity_UnuseResources (SCE_SSceneEntity*);
 void SCE_SceneEntity_SetDefaultShader (SCE_SShader*);
 
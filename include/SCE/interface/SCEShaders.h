@@ -17,7 +17,7 @@
  -----------------------------------------------------------------------------*/
  
 /* created: 06/03/2007
-   updated: 10/04/2012 */
+   updated: 19/10/2026 */
 
 #ifndef SCESHADERS_H
 #define SCESHADERS_H
@@ -45,6 +45,10 @@ extern "C" {
 #define SCE_SHADER_UNIFORM_SAMPLER_6 "sce_tex6"
 #define SCE_SHADER_UNIFORM_SAMPLER_7 "sce_tex7"
 
+/* decoding of quantized vertex data, see SCE_Mesh_SetQuantization() */
+#define SCE_SHADER_UNIFORM_POSITION_SCALE "sce_position_scale"
+#define SCE_SHADER_UNIFORM_POSITION_OFFSET "sce_position_offset"
+
 /* :-' */
 typedef void (*SCE_FShaderSetParamfv)(int, size_t, float*);
 typedef void (*SCE_FShaderSetMatrix)(int, SCE_TMatrix4);
@@ -134,6 +138,7 @@ int SCE_Shader_Localf (SCE_SShader*, SCE_RShaderType, const char*, float);
 int SCE_Shader_Global (SCE_SShader*, const char*, const char*);
 int SCE_Shader_Globali (SCE_SShader*, const char*, int);
 int SCE_Shader_Globalf (SCE_SShader*, const char*, float);
+int SCE_Shader_AddQuantizationHelpers (SCE_SShader*, SCE_RShaderType);
 
 int SCE_Shader_InputPrimitive (SCE_SShader*, SCE_EPrimitiveType, int);
 int SCE_Shader_OutputPrimitive (SCE_SShader*, SCE_EPrimitiveType);
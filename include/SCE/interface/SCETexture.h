@@ -17,7 +17,7 @@
  -----------------------------------------------------------------------------*/
  
 /* created: 11/03/2007
-   updated: 04/02/2012 */
+   updated: 19/10/2026 */
 
 #ifndef SCETEXTURE_H
 #define SCETEXTURE_H
@@ -28,6 +28,7 @@
 #include <SCE/renderer/SCERenderer.h>
 
 #include "SCE/interface/SCESceneResource.h"
+#include "SCE/interface/SCEGPU.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -87,6 +88,23 @@ struct sce_stexture {
     SCE_SSceneResource s_resource; /**< Scene resource */
 };
 
+/* number of pixel buffers of a texture stream */
+#define SCE_TEXTURE_STREAM_BUFFERS 3
+
+/** \copydoc sce_stexturestream */
+typedef struct sce_stexturestream SCE_STextureStream;
+/**
+ * \brief Ring of pixel buffer objects used to stream partial texture updates
+ * \sa SCE_Texture_UpdateBox()
+ */
+struct sce_stexturestream {
+    SCEuint buffers[SCE_TEXTURE_STREAM_BUFFERS]; /**< GL buffer names */
+    size_t sizes[SCE_TEXTURE_STREAM_BUFFERS];    /**< Allocated bytes */
+    SCE_GPUFence fences[SCE_TEXTURE_STREAM_BUFFERS]; /**< Last transfers */
+    int current;             /**< Next buffer of the ring to use */
+    size_t n_bytes;          /**< Total number of uploaded bytes */
+};
+
 /** @} */
 
 int SCE_Init_Texture (void);
@@ -128,6 +146,12 @@ int SCE_Texture_GetDepth (SCE_STexture*);
 int SCE_Texture_Build (SCE_STexture*, int);
 void SCE_Texture_Update (SCE_STexture*);
 
+void SCE_Texture_InitStream (SCE_STextureStream*);
+void SCE_Texture_ClearStream (SCE_STextureStream*);
+size_t SCE_Texture_GetStreamedBytes (const SCE_STextureStream*);
+int SCE_Texture_UpdateBox (SCE_STexture*, SCE_STextureStream*,
+                           const SCE_SIntRect3*, const void*, size_t);
+
 void SCE_Texture_MakeRenderTexData (const SCE_STexture*, SCE_ETexRenderType,
                                     SCE_STexData*);
 int SCE_Texture_SetupFramebuffer (SCE_STexture*, SCE_ETexRenderType,
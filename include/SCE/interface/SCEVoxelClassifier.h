@@ -0,0 +1,73 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#ifndef SCEVOXELCLASSIFIER_H
+#define SCEVOXELCLASSIFIER_H
+
+#include <SCE/utils/SCEUtils.h>
+#include <SCE/core/SCECore.h>   /* SCE_SGrid */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sce_svoxelclassifier SCE_SVoxelClassifier;
+/**
+ * \brief Marching cubes cell classifier
+ *
+ * Computes the cube index of every cell of a box of a density grid and
+ * keeps a worklist of the cells crossing the surface, ie. those whose
+ * index is neither 0 nor 255.
+ */
+struct sce_svoxelclassifier {
+    SCEubyte iso;               /**< Iso value of the surface */
+    int dims[3];                /**< Maximum dimensions of a box, in cells */
+    SCEuint n_cells;            /**< Size of the worklist */
+    SCEuint *cells;             /**< Worklist: offsets of the cells in the
+                                 *   box, x varying first */
+    SCEubyte *cases;            /**< Cube index of each cell of \c cells */
+    SCEubyte *planes;           /**< Inside bits of two planes of voxels */
+    SCEubyte *row;              /**< Cube indices of a row of cells */
+};
+
+void SCE_VClassifier_Init (SCE_SVoxelClassifier*);
+void SCE_VClassifier_Clear (SCE_SVoxelClassifier*);
+SCE_SVoxelClassifier* SCE_VClassifier_Create (void);
+void SCE_VClassifier_Delete (SCE_SVoxelClassifier*);
+
+void SCE_VClassifier_SetDimensions (SCE_SVoxelClassifier*, int, int, int);
+void SCE_VClassifier_SetIsoValue (SCE_SVoxelClassifier*, SCEubyte);
+int SCE_VClassifier_Build (SCE_SVoxelClassifier*);
+
+SCEuint SCE_VClassifier_Classify (SCE_SVoxelClassifier*, const SCE_SGrid*,
+                                  const SCE_SIntRect3*);
+int SCE_VClassifier_HasSurface (SCE_SVoxelClassifier*, const SCE_SGrid*,
+                                const SCE_SIntRect3*);
+
+SCEuint SCE_VClassifier_GetNumCells (const SCE_SVoxelClassifier*);
+const SCEuint* SCE_VClassifier_GetCells (const SCE_SVoxelClassifier*);
+const SCEubyte* SCE_VClassifier_GetCases (const SCE_SVoxelClassifier*);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* guard */
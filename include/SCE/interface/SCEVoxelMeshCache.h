@@ -0,0 +1,136 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#ifndef SCEVOXELMESHCACHE_H
+#define SCEVOXELMESHCACHE_H
+
+#include <SCE/utils/SCEUtils.h>
+#include <SCE/core/SCECore.h>
+#include <SCE/renderer/SCERenderer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* number of hash buckets of a cache */
+#define SCE_VMESHCACHE_NUM_BUCKETS 256
+/* default size of the entries spilled on disk, in bytes */
+#define SCE_VMESHCACHE_MAX_SPILLED_BYTES (256 * 1024 * 1024)
+/* number of invalidations remembered to check the stored geometry */
+#define SCE_VMESHCACHE_HISTORY 64
+
+typedef struct sce_svmeshcacheentry SCE_SVMeshCacheEntry;
+/**
+ * \brief Final geometry of one octree node
+ */
+struct sce_svmeshcacheentry {
+    SCEuint level;              /**< Level of the node */
+    long x, y, z;               /**< Origin of the node */
+    SCEubyte *vertices;         /**< Interleaved vertices, NULL if spilled
+                                     or empty */
+    SCEuint *indices;           /**< Indices, stored after \c vertices */
+    SCEuint n_vertices;
+    SCEuint n_indices;
+    size_t size;                /**< Size of \c vertices and \c indices */
+    int spilled;                /**< Is the geometry stored on disk? */
+    int prefetched;             /**< Stored ahead of need and not read yet */
+    int discarded;              /**< Prefetch refused, no geometry */
+    SCE_SListIterator it;       /* cache->lru or cache->spilled */
+    SCE_SListIterator it2;      /* hash bucket */
+};
+
+typedef struct sce_svmeshcacheinvalidation SCE_SVMeshCacheInvalidation;
+/**
+ * \brief Modified area of the world
+ */
+struct sce_svmeshcacheinvalidation {
+    int flush;                  /**< Is the whole cache invalidated? */
+    SCEuint level;              /**< Modified level */
+    SCE_SLongRect3 rect;        /**< Modified area, in voxels of \c level */
+};
+
+typedef struct sce_svoxelmeshcache SCE_SVoxelMeshCache;
+/**
+ * \brief LRU cache of the geometry of octree nodes
+ *
+ * Entries are keyed by the level and origin of their node. The data version
+ * of the cache changes every time a part of the world is invalidated, the
+ * last invalidations are remembered so that geometry generated from an
+ * older version is refused only if its node reads a modified area.
+ */
+struct sce_svoxelmeshcache {
+    size_t max_bytes;           /**< Memory budget, 0 disables the cache */
+    size_t bytes;               /**< Memory used by the entries in memory */
+    size_t spilled_bytes;       /**< Size of the entries spilled on disk */
+    size_t max_spilled_bytes;   /**< Disk budget */
+    size_t stride;              /**< Size of a vertex */
+    long w, h, d;               /**< Dimensions of a node */
+    long border;                /**< Voxels read around a node */
+    SCEuint version;            /**< Data version */
+    /** Invalidation that bumped the version from v, at v modulo
+        SCE_VMESHCACHE_HISTORY */
+    SCE_SVMeshCacheInvalidation history[SCE_VMESHCACHE_HISTORY];
+    char *spill;                /**< Spill directory, NULL if none */
+    SCE_SList lru;              /**< Entries in memory, oldest first */
+    SCE_SList spilled;          /**< Entries on disk */
+    SCE_SList buckets[SCE_VMESHCACHE_NUM_BUCKETS];
+    SCEuint n_hits, n_misses;
+    SCEuint n_spill_hits;       /**< Hits read back from the disk */
+    SCEuint n_prefetch_hits;    /**< Hits on prefetched entries */
+};
+
+void SCE_VMeshCache_Init (SCE_SVoxelMeshCache*);
+void SCE_VMeshCache_Clear (SCE_SVoxelMeshCache*);
+SCE_SVoxelMeshCache* SCE_VMeshCache_Create (void);
+void SCE_VMeshCache_Delete (SCE_SVoxelMeshCache*);
+
+void SCE_VMeshCache_SetMaxBytes (SCE_SVoxelMeshCache*, size_t);
+size_t SCE_VMeshCache_GetMaxBytes (const SCE_SVoxelMeshCache*);
+void SCE_VMeshCache_SetStride (SCE_SVoxelMeshCache*, size_t);
+void SCE_VMeshCache_SetNodeSize (SCE_SVoxelMeshCache*, long, long, long, long);
+int SCE_VMeshCache_SetSpillDirectory (SCE_SVoxelMeshCache*, const char*);
+void SCE_VMeshCache_SetMaxSpilledBytes (SCE_SVoxelMeshCache*, size_t);
+
+SCEuint SCE_VMeshCache_GetVersion (const SCE_SVoxelMeshCache*);
+
+void SCE_VMeshCache_Flush (SCE_SVoxelMeshCache*);
+void SCE_VMeshCache_Invalidate (SCE_SVoxelMeshCache*, SCEuint,
+                                const SCE_SLongRect3*);
+int SCE_VMeshCache_Store (SCE_SVoxelMeshCache*, SCEuint, SCEuint, long, long,
+                          long, const void*, SCEuint, const SCEuint*, SCEuint);
+int SCE_VMeshCache_Prefetch (SCE_SVoxelMeshCache*, SCEuint, SCEuint, long, long,
+                             long, const void*, SCEuint, const SCEuint*,
+                             SCEuint);
+int SCE_VMeshCache_Contains (SCE_SVoxelMeshCache*, SCEuint, long, long, long);
+SCE_SVMeshCacheEntry* SCE_VMeshCache_Get (SCE_SVoxelMeshCache*, SCEuint, long,
+                                          long, long);
+
+void SCE_VMeshCache_GetStats (const SCE_SVoxelMeshCache*, SCEuint*, SCEuint*,
+                              size_t*, size_t*);
+float SCE_VMeshCache_GetHitRate (const SCE_SVoxelMeshCache*);
+SCEuint SCE_VMeshCache_GetNumPrefetchHits (const SCE_SVoxelMeshCache*);
+void SCE_VMeshCache_ResetStats (SCE_SVoxelMeshCache*);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* guard */
@@ -17,16 +17,20 @@
  -----------------------------------------------------------------------------*/
 
 /* created: 16/03/2013
-   updated: 20/03/2013 */
+   updated: 19/10/2026 */
 
 #ifndef SCEVOXELOCTREETERRAIN_H
 #define SCEVOXELOCTREETERRAIN_H
 
+#include <pthread.h>
 #include <SCE/core/SCECore.h>
 #include <SCE/renderer/SCERenderer.h>
 
 #include "SCE/interface/SCETexture.h"
 #include "SCE/interface/SCEVoxelRenderer.h"
+#include "SCE/interface/SCEMeshArena.h"
+#include "SCE/interface/SCEFrameBudget.h"
+#include "SCE/interface/SCEVoxelMeshCache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -55,17 +59,52 @@ typedef struct sce_svoterrainregion SCE_SVOTerrainRegion;
  */
 struct sce_svoterrainregion {
     SCE_EVOTerrainRegionStatus status;
-    SCE_SMesh mesh;             /**< Pointer to the mesh */
-    SCE_TMatrix4 matrix;        /**< World transform matrix */
+    SCE_SMesh *mesh;            /**< Own geometry, NULL when the terrain has
+                                 *   an arena */
+    SCE_SMeshArenaAlloc alloc;  /**< Geometry in the arena, if any */
     int draw;                   /**< Whether this region should be rendered */
     SCE_SVoxelOctreeNode *node; /**< Node associated with this region */
+    SCE_TVector3 pos;           /**< World position of the geometry */
+    float size;                 /**< World size of the geometry, the world
+                                 *   transform is computed from both */
+    SCEuint cull_frame;         /**< Culling that set \c cull */
+    int cull;                   /**< Visibility given by the node above */
     SCE_SVOTerrainLevel *level; /**< Owner of this region */
+    SCEuint version;            /**< Data version of the mesh cache when the
+                                 *   region was queued in the pipeline */
+    SCEuint stage;              /**< Pipeline stage of the region, if it is
+                                 *   in the pipeline */
+    int urgent;                 /**< Queued by an edit, see
+                                 *   SCE_VOTerrain_Edit() */
+    int refine;                 /**< Rendered without decimation, to be
+                                 *   decimated later */
+    double edit_time;           /**< Time of the edit, in milliseconds */
+    int prefetch;               /**< Meshed ahead of need, into the mesh
+                                 *   cache, see SCE_VOTerrain_SetVelocity() */
     SCE_SListIterator it;       /* pipeline */
     SCE_SListIterator it2;      /* level->to_render,ready,hidden */
-    SCE_SListIterator it3;      /* level->regions */
-    SCE_SListIterator it4;      /* terrain->to_render */
+    SCE_SListIterator it3;      /* level->regions,prefetched */
+    SCE_SListIterator it4;      /* terrain->to_render,prefetch_queue */
 };
 
+/* number of regions allocated at once */
+#define SCE_VOTERRAIN_SLAB_SIZE 64
+
+typedef struct sce_svoterrainslab SCE_SVOTerrainSlab;
+/* regions allocated in one go, along with their meshes when the terrain has
+   no arena */
+struct sce_svoterrainslab {
+    SCE_SVOTerrainRegion regions[SCE_VOTERRAIN_SLAB_SIZE];
+    SCE_SMesh *meshes;
+};
+
+
+typedef struct sce_svoterrainrects SCE_SVOTerrainRects;
+/* set of rectangles, overlapping ones are merged */
+struct sce_svoterrainrects {
+    SCE_SLongRect3 *rects;
+    SCEuint n, max;
+};
 
 struct sce_svoterrainlevel {
     SCEuint level;
@@ -77,10 +116,67 @@ struct sce_svoterrainlevel {
     SCE_SList ready;            /* regions ready to be rendered */
     SCE_SList to_render;        /* regions to render */
     SCE_SList hidden;
+    SCE_SList prefetched;       /* regions meshed ahead of need */
+
+    /* rectangles of the worlds updated since the last update */
+    SCE_SVOTerrainRects updates;
+    SCE_SVOTerrainRects edits;  /* those given to SCE_VOTerrain_Edit() */
+    double edit_time;           /* time of the oldest of them */
+
+    float decimation;           /* part of the vertices of a region removed
+                                   by the decimation */
+    SCEuint max_vertices;       /* vertices of a decimated region, 0 for no
+                                   limit */
 };
 
 #define SCE_VOTERRAIN_NUM_PIPELINE_STAGES 3
 
+/* number of regions whose voxels can be fetched ahead of Stage1 */
+#define SCE_VOTERRAIN_NUM_FETCHES 4
+
+typedef enum {
+    SCE_VOTERRAIN_FETCH_FREE = 0,
+    SCE_VOTERRAIN_FETCH_QUEUED, /* waiting for the worker thread */
+    SCE_VOTERRAIN_FETCH_BUSY,   /* being fetched by the worker thread */
+    SCE_VOTERRAIN_FETCH_READY   /* voxels ready for upload */
+} SCE_EVOTerrainFetchState;
+
+typedef struct sce_svoterrainfetch SCE_SVOTerrainFetch;
+/* voxels of a region fetched from the worlds by the worker thread */
+struct sce_svoterrainfetch {
+    SCE_EVOTerrainFetchState state;
+    int cancel;                 /* drop the voxels once fetched */
+    int error;                  /* the fetch failed */
+    SCE_SVOTerrainRegion *region;
+    SCEuint level;
+    long x, y, z;               /* origin of the region's node */
+    SCEubyte *density;
+    SCEubyte *material;
+};
+
+/* maximum number of regions polygonized at once by the pipeline */
+#define SCE_VOTERRAIN_MAX_BATCH 8
+
+typedef struct sce_svoterrainslot SCE_SVOTerrainSlot;
+/* textures and generated mesh of one region of a batch */
+struct sce_svoterrainslot {
+    SCE_STexData *tc, *tc_mat;
+    SCE_STexture *tex, *material;
+    SCE_SMesh mesh;
+    SCE_SVoxelMesh vmesh;
+    SCE_SVOTerrainRegion *region;  /* region uploaded into the textures */
+    SCE_SVOTerrainRegion *mregion; /* region generated into the mesh */
+};
+
+/** Decodes the vertices output by the GPU, see SCE_VOTerrain_Build() */
+typedef void (*SCE_FVOTerrainDecodeFunc)(const SCEvertices*, size_t,
+                                         SCEvertices*, SCEvertices*,
+                                         SCEubyte*);
+/** Encodes decimated vertices into the interleaved format of the terrain */
+typedef void (*SCE_FVOTerrainEncodeFunc)(const SCEvertices*,
+                                         const SCEvertices*, const SCEubyte*,
+                                         size_t, SCEubyte*);
+
 typedef struct sce_svoterrainpipeline SCE_SVOTerrainPipeline;
 struct sce_svoterrainpipeline {
     SCE_SVoxelTemplate temp;
@@ -106,16 +202,31 @@ struct sce_svoterrainpipeline {
     SCEvertices *normals;
     SCEubyte *materials;
     SCEubyte *anchors;
-    /* TODO: depending on the size of the cells, they might contain more than
-       256**2 vertices, which is the maximum supported by SCEindices */
-    SCEindices *indices;
+    SCEuint *indices;           /* 32 bits, narrowed for the decimation */
     SCEubyte *interleaved;
     SCEuint n_vertices;
     SCEuint n_indices;
+    SCEbitfield optimize;       /* optimization passes of decimated meshes */
+    SCE_SMeshOptimizer opt;
 
     size_t vstride, nstride, mstride;
     size_t stride;              /* final stride in \c interleaved =
                                    \c vstride + \c nstride + \c mstride */
+    SCE_FVOTerrainDecodeFunc decode; /* decoder matching use_materials */
+    SCE_FVOTerrainEncodeFunc encode; /* encoder matching the strides */
+
+    SCE_STextureStream stream;  /* pixel buffers of the texture uploads */
+    int async;                  /* fetch voxels on a worker thread */
+    int running;                /* is the worker thread running */
+    int quit;                   /* asks the worker thread to stop */
+    pthread_t thread;
+    pthread_mutex_t mutex;      /* protects the fetch slots */
+    pthread_cond_t cond;        /* signals queued fetches */
+    SCE_SVOTerrainFetch fetches[SCE_VOTERRAIN_NUM_FETCHES];
+    SCEuint n_async, n_sync;    /* regions fetched ahead or in Stage1 */
+
+    SCEuint batch;              /* regions polygonized per pipeline cycle */
+    SCE_SVOTerrainSlot slots[SCE_VOTERRAIN_MAX_BATCH];
 };
 
 
@@ -125,6 +236,8 @@ typedef struct sce_svoxeloctreeterrain SCE_SVoxelOctreeTerrain;
 struct sce_svoxeloctreeterrain {
     SCE_SVoxelWorld *vw;        /* density */
     SCE_SVoxelWorld *mw;        /* materials */
+    pthread_mutex_t world_mutex; /* guards the worlds against the worker */
+    SCEuint world_skips;        /* updates which could not lock the worlds */
     SCEuint n_levels;
     SCEuint w, h, d;            /* dimensions of a region */
     SCEuint n_regions;          /* width of a level */
@@ -136,14 +249,47 @@ struct sce_svoxeloctreeterrain {
     int comp_pos, comp_nor;     /* TODO: move to pipe */
     SCE_SGeometry region_geom;
     SCE_SVOTerrainPipeline pipe;
+    int built;                  /* SCE_VOTerrain_Build() has been called */
 
+    SCE_SVOTerrainSlab **slabs; /* storage of all the regions */
+    SCEuint n_slabs;
     SCE_SList pool;             /* global pool of available regions */
     SCE_SList to_render;
+    SCEuint cull_frame;         /* number of cullings so far */
     SCE_SVOTerrainLevel levels[SCE_VOTERRAIN_MAX_LEVELS];
     SCE_SShader *shader;
 
     SCE_STexture *diffuse; /* textures of materials (2D texture array) */
     SCE_STexture *normal;  /* normal maps */
+
+    SCE_SMeshArena *arena;      /* shared geometry of the regions */
+    SCEuint arena_vertices, arena_indices; /* size of the arena */
+
+    SCE_SFrameBudget *budget;   /* time allowed to the pipeline, if any */
+    SCEuint max_cycles;         /* max pipeline cycles per frame with a
+                                   budget */
+    SCEuint n_cycles;           /* pipeline cycles run by the last update */
+    SCEuint n_restarts;         /* in-flight regions whose voxels changed */
+    int fast_edits;             /* edited regions skip decimation at first */
+    SCEuint n_refines;          /* regions shown without decimation */
+    SCEuint n_edits;            /* edited regions displayed so far */
+    double edit_latency;        /* total time between edits and display */
+    double max_edit_latency;
+
+    float velocity[3];          /* of the viewer, voxels per second */
+    float prefetch_time;        /* how far ahead to prefetch, in seconds */
+    SCEuint max_prefetches;     /* max prefetched regions at a time */
+    SCEuint n_prefetching;      /* prefetched regions not done yet */
+    SCE_SList prefetch_queue;   /* prefetched regions waiting for the
+                                   pipeline to be idle */
+    SCEuint n_prefetches;       /* regions prefetched so far */
+    SCEuint n_prefetch_used;    /* prefetched regions adopted in flight */
+
+    float screen_error;         /* tolerated error of the decimation in
+                                   pixels, 0 to use the levels ratio */
+    float projection;           /* pixels per unit at a distance of 1 */
+
+    SCE_SVoxelMeshCache cache;  /* final geometry of the visited nodes */
 };
 
 void SCE_VOTerrain_Init (SCE_SVoxelOctreeTerrain*);
@@ -162,6 +308,26 @@ void SCE_VOTerrain_SetShader (SCE_SVoxelOctreeTerrain*, SCE_SShader*);
 void SCE_VOTerrain_SetDiffuseTexture (SCE_SVoxelOctreeTerrain*, SCE_STexture*);
 void SCE_VOTerrain_SetNormalTexture (SCE_SVoxelOctreeTerrain*, SCE_STexture*);
 void SCE_VOTerrain_UseMaterials (SCE_SVoxelOctreeTerrain*, int);
+void SCE_VOTerrain_SetMeshOptimization (SCE_SVoxelOctreeTerrain*, SCEbitfield);
+void SCE_VOTerrain_GetACMR (const SCE_SVoxelOctreeTerrain*, float*, float*);
+void SCE_VOTerrain_SetDecimation (SCE_SVoxelOctreeTerrain*, SCEuint, float);
+void SCE_VOTerrain_SetMaxRegionVertices (SCE_SVoxelOctreeTerrain*, SCEuint,
+                                         SCEuint);
+void SCE_VOTerrain_SetScreenError (SCE_SVoxelOctreeTerrain*, float, float);
+float SCE_VOTerrain_GetDecimation (const SCE_SVoxelOctreeTerrain*, SCEuint);
+void SCE_VOTerrain_SetArenaSize (SCE_SVoxelOctreeTerrain*, SCEuint, SCEuint);
+SCE_SMeshArena* SCE_VOTerrain_GetMeshArena (SCE_SVoxelOctreeTerrain*);
+void SCE_VOTerrain_SetFrameBudget (SCE_SVoxelOctreeTerrain*, SCE_SFrameBudget*);
+void SCE_VOTerrain_SetMaxCycles (SCE_SVoxelOctreeTerrain*, SCEuint);
+int SCE_VOTerrain_SetAsyncFetch (SCE_SVoxelOctreeTerrain*, int);
+void SCE_VOTerrain_LockWorld (SCE_SVoxelOctreeTerrain*);
+void SCE_VOTerrain_UnlockWorld (SCE_SVoxelOctreeTerrain*);
+void SCE_VOTerrain_GetFetchStats (const SCE_SVoxelOctreeTerrain*, SCEuint*,
+                                  SCEuint*);
+void SCE_VOTerrain_SetBatchSize (SCE_SVoxelOctreeTerrain*, SCEuint);
+void SCE_VOTerrain_SetMeshCacheSize (SCE_SVoxelOctreeTerrain*, size_t);
+int SCE_VOTerrain_SetMeshCacheSpill (SCE_SVoxelOctreeTerrain*, const char*);
+SCE_SVoxelMeshCache* SCE_VOTerrain_GetMeshCache (SCE_SVoxelOctreeTerrain*);
 
 SCEuint SCE_VOTerrain_GetWidth (const SCE_SVoxelOctreeTerrain*);
 SCEuint SCE_VOTerrain_GetHeight (const SCE_SVoxelOctreeTerrain*);
@@ -175,10 +341,27 @@ void SCE_VOTerrain_GetRectangle (const SCE_SVoxelOctreeTerrain*, long, long,
 void SCE_VOTerrain_GetCurrentRectangle (const SCE_SVoxelOctreeTerrain*, SCEuint,
                                         SCE_SLongRect3*);
 size_t SCE_VOTerrain_GetUsedVRAM (const SCE_SVoxelOctreeTerrain*);
+SCEuint SCE_VOTerrain_GetNumAllocatedRegions (const SCE_SVoxelOctreeTerrain*);
+size_t SCE_VOTerrain_GetRegionSize (const SCE_SVoxelOctreeTerrain*);
 
 void SCE_VOTerrain_CullRegions (SCE_SVoxelOctreeTerrain*, const SCE_SFrustum*);
 
 int SCE_VOTerrain_Update (SCE_SVoxelOctreeTerrain*);
+SCEuint SCE_VOTerrain_GetNumCycles (const SCE_SVoxelOctreeTerrain*);
+SCEuint SCE_VOTerrain_GetNumRestarts (const SCE_SVoxelOctreeTerrain*);
+
+int SCE_VOTerrain_Edit (SCE_SVoxelOctreeTerrain*, SCEuint,
+                        const SCE_SLongRect3*);
+void SCE_VOTerrain_SetFastEdits (SCE_SVoxelOctreeTerrain*, int);
+SCEuint SCE_VOTerrain_GetNumEdits (const SCE_SVoxelOctreeTerrain*);
+void SCE_VOTerrain_GetEditLatency (const SCE_SVoxelOctreeTerrain*, float*,
+                                   float*);
+
+void SCE_VOTerrain_SetVelocity (SCE_SVoxelOctreeTerrain*, float, float, float);
+void SCE_VOTerrain_SetPrefetchTime (SCE_SVoxelOctreeTerrain*, float);
+void SCE_VOTerrain_SetMaxPrefetches (SCE_SVoxelOctreeTerrain*, SCEuint);
+void SCE_VOTerrain_GetPrefetchStats (const SCE_SVoxelOctreeTerrain*, SCEuint*,
+                                     SCEuint*);
 void SCE_VOTerrain_Render (SCE_SVoxelOctreeTerrain*);
 
 #ifdef __cplusplus
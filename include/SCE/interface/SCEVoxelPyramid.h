@@ -0,0 +1,80 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#ifndef SCEVOXELPYRAMID_H
+#define SCEVOXELPYRAMID_H
+
+#include <SCE/utils/SCEUtils.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum number of levels of a pyramid */
+#define SCE_VPYRAMID_MAX_LEVELS 16
+
+/** Default width of the blocks of the finest level, in cells */
+#define SCE_VPYRAMID_DEFAULT_BLOCK 8
+
+typedef struct sce_svoxelpyramid SCE_SVoxelPyramid;
+/**
+ * \brief Min/max density pyramid over a toroidal voxel grid
+ *
+ * Each block of the finest level stores the density range of the voxels
+ * touched by its cells, each block of an upper level covers 2x2x2 blocks
+ * of the level below. A block whose range does not contain the iso value
+ * cannot produce any triangle.
+ */
+struct sce_svoxelpyramid {
+    int dims[3];                /**< Dimensions of the grid, in voxels */
+    int block;                  /**< Width of the finest blocks, in cells */
+    SCEubyte iso;               /**< Iso value of the surface */
+    SCEuint n_levels;           /**< Number of levels */
+    int size[SCE_VPYRAMID_MAX_LEVELS][3]; /**< Number of blocks of each
+                                           *   level along each axis */
+    SCEubyte *min[SCE_VPYRAMID_MAX_LEVELS]; /**< Minimum density of blocks */
+    SCEubyte *max[SCE_VPYRAMID_MAX_LEVELS]; /**< Maximum density of blocks */
+};
+
+void SCE_VPyramid_Init (SCE_SVoxelPyramid*);
+void SCE_VPyramid_Clear (SCE_SVoxelPyramid*);
+SCE_SVoxelPyramid* SCE_VPyramid_Create (void);
+void SCE_VPyramid_Delete (SCE_SVoxelPyramid*);
+
+void SCE_VPyramid_SetDimensions (SCE_SVoxelPyramid*, int, int, int);
+void SCE_VPyramid_SetBlockSize (SCE_SVoxelPyramid*, int);
+void SCE_VPyramid_SetIsoValue (SCE_SVoxelPyramid*, SCEubyte);
+SCEuint SCE_VPyramid_GetNumLevels (const SCE_SVoxelPyramid*);
+
+int SCE_VPyramid_Build (SCE_SVoxelPyramid*);
+
+void SCE_VPyramid_Update (SCE_SVoxelPyramid*, const SCEubyte*,
+                          const SCE_SIntRect3*);
+void SCE_VPyramid_UpdateAll (SCE_SVoxelPyramid*, const SCEubyte*);
+
+int SCE_VPyramid_HasCrossing (const SCE_SVoxelPyramid*, const SCE_SIntRect3*,
+                              const int*);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* guard */
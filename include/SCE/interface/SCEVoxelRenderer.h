@@ -17,7 +17,7 @@
  -----------------------------------------------------------------------------*/
 
 /* created: 14/02/2012
-   updated: 18/03/2013 */
+   updated: 19/10/2026 */
 
 #ifndef SCEVOXELRENDERER_H
 #define SCEVOXELRENDERER_H
@@ -27,6 +27,7 @@
 #include "SCE/interface/SCEMesh.h"
 #include "SCE/interface/SCETexture.h"
 #include "SCE/interface/SCEShaders.h"
+#include "SCE/interface/SCEVoxelClassifier.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,6 +43,16 @@ typedef enum {
     SCE_VRENDER_SOFTWARE
 } SCE_EVoxelRenderPipeline;
 
+typedef struct sce_svoxelbatchslot SCE_SVoxelBatchSlot;
+/**
+ * \brief Intermediate data of one volume of a hardware batch
+ * \sa SCE_VRender_HardwareBatch()
+ */
+struct sce_svoxelbatchslot {
+    SCE_SMesh non_empty;     /**< Generated list of non-empty cells */
+    SCE_SMesh list_verts;    /**< Generated list of vertices to generate */
+    SCE_STexture *splat;     /**< 3D map of indices */
+};
 typedef struct sce_svoxeltemplate SCE_SVoxelTemplate;
 struct sce_svoxeltemplate {
     SCE_EVoxelRenderPipeline pipeline;
@@ -60,9 +71,12 @@ struct sce_svoxeltemplate {
 
     /* software specific data */
     SCE_SMCGenerator mc_gen;
+    SCE_SVoxelClassifier classifier; /**< Skips volumes without surface */
     SCEvertices *vertices;
     SCEvertices *normals;
     SCEindices *indices;
+    SCEbitfield optimize;       /**< Optimization passes on generated meshes */
+    SCE_SMeshOptimizer opt;
 
     /* hardware specific data */
     SCE_SGeometry grid_geom; /**< Grid of points */
@@ -82,6 +96,9 @@ struct sce_svoxeltemplate {
     SCE_SShader *indices_shader;
     SCE_STexture *splat;     /**< 3D map of indices */
     SCE_STexture *mc_table;
+
+    SCEuint batch;           /**< Maximum number of volumes per batch */
+    SCE_SVoxelBatchSlot *slots; /**< Intermediate data of the batches */
 };
 
 typedef struct sce_svoxelmesh SCE_SVoxelMesh;
@@ -90,9 +107,9 @@ struct sce_svoxelmesh {
     SCE_SMesh *mesh;         /**< Final mesh */
     int render;              /**< Whether the mesh should be rendered */
 
-    /* TODO: those a fucking unused dude, DUDE. */
-    int vertex_range[2];     /**< Range of the vertex buffer to bind */
-    int index_range[2];      /**< Range of the index buffer to bind */
+    int vertex_range[2];     /**< Range of the vertex buffer to write into
+                              *   (first, count), -1 for the whole buffer */
+    int index_range[2];      /**< Range of the index buffer to write into */
     SCEuint n_vertices;      /**< Amount of produced vertices */
     SCEuint n_indices;       /**< Amount of produced indices */
 };
@@ -129,6 +146,10 @@ void SCE_VRender_UseMaterials (SCE_SVoxelTemplate*, int);
 void SCE_VRender_SetAlgorithm (SCE_SVoxelTemplate*, SCE_EVoxelRenderAlgorithm);
 void SCE_VRender_SetVertexBufferPool (SCE_SVoxelTemplate*, SCE_RBufferPool*);
 void SCE_VRender_SetIndexBufferPool (SCE_SVoxelTemplate*, SCE_RBufferPool*);
+void SCE_VRender_SetOptimization (SCE_SVoxelTemplate*, SCEbitfield);
+SCE_SMeshOptimizer* SCE_VRender_GetOptimizer (SCE_SVoxelTemplate*);
+void SCE_VRender_SetBatchSize (SCE_SVoxelTemplate*, SCEuint);
+SCEuint SCE_VRender_GetBatchSize (const SCE_SVoxelTemplate*);
 
 int SCE_VRender_Build (SCE_SVoxelTemplate*);
 
@@ -139,11 +160,17 @@ void SCE_VRender_SetMesh (SCE_SVoxelMesh*, SCE_SMesh*);
 
 void SCE_VRender_SetVBRange (SCE_SVoxelMesh*, const int*);
 void SCE_VRender_SetIBRange (SCE_SVoxelMesh*, const int*);
+int SCE_VRender_FitsRanges (const SCE_SVoxelMesh*);
+int SCE_VRender_UploadRanges (SCE_SVoxelTemplate*, SCE_SVoxelMesh*);
 
+int SCE_VRender_Empty (SCE_SVoxelTemplate*, SCE_SVoxelMesh*);
 int SCE_VRender_Software (SCE_SVoxelTemplate*, const SCE_SGrid*,
                           SCE_SVoxelMesh*, int, int, int);
 int SCE_VRender_Hardware (SCE_SVoxelTemplate*, SCE_STexture*, SCE_STexture*,
                           SCE_SVoxelMesh*, int, int, int);
+int SCE_VRender_HardwareBatch (SCE_SVoxelTemplate*, SCE_STexture**,
+                               SCE_STexture**, SCE_SVoxelMesh**, SCEuint,
+                               int, int, int);
 
 unsigned int SCE_VRender_GetMaxV (void);
 unsigned int SCE_VRender_GetMaxI (void);
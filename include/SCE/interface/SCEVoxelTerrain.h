@@ -17,7 +17,7 @@
  -----------------------------------------------------------------------------*/
 
 /* created: 30/01/2012
-   updated: 18/03/2013 */
+   updated: 19/10/2026 */
 
 #ifndef SCEVOXELTERRAIN_H
 #define SCEVOXELTERRAIN_H
@@ -25,7 +25,11 @@
 #include <SCE/utils/SCEUtils.h>
 #include <SCE/core/SCECore.h>   /* SCE_SGrid, SCE_SCamera */
 #include "SCE/interface/SCEShaders.h"
+#include "SCE/interface/SCETexture.h"
 #include "SCE/interface/SCEVoxelRenderer.h"
+#include "SCE/interface/SCEVoxelPyramid.h"
+#include "SCE/interface/SCEMeshArena.h"
+#include "SCE/interface/SCEFrameBudget.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -44,14 +48,26 @@ struct sce_svoxelterrainregion {
     int wx, wy, wz;             /**< Wrapped coordinates (dynamic) */
     SCE_SVoxelMesh vm;          /**< Abstract voxel mesh */
     SCE_SMesh *mesh;            /**< Pointer to the mesh */
+    SCE_SMeshArenaAlloc alloc;  /**< Copy of the mesh in the terrain arena */
     SCE_TMatrix4 matrix;        /**< World transform matrix */
     int draw;                   /**< Whether this region should be rendered */
+    int visible;                /**< In the view frustum at the last culling */
+    int hidden;                 /**< Covered by the finer level */
+    float priority;             /**< Squared distance to the viewer, orders
+                                 *   the updates */
     SCE_SListIterator it, it2, it3;
     int need_update;               /**< Hehe. */
+    int urgent;                    /**< Edited, mesh it first */
+    double edit_time;              /**< Time of the edit, see
+                                    *   SCE_FrameBudget_GetTime() */
     SCE_SList *level_list;         /**< Update list the region is in */
     SCE_SVoxelTerrainLevel *level; /**< Owner of this region */
 };
 
+/* maximum number of areas of a level texture waiting for upload, beyond
+   that they are merged */
+#define SCE_VTERRAIN_MAX_DIRTY_BOXES 16
+
 /**
  * \brief Single level (in terms of LOD) of a voxel terrain
  */
@@ -59,6 +75,7 @@ struct sce_svoxelterrainlevel {
     int level;               /**< Level. */
     SCE_SGrid grid;          /**< Density data */
     SCE_SGrid grid2;         /**< Material data */
+    SCE_SVoxelPyramid pyramid; /**< Density ranges of \c grid */
     int wrap[3];             /**< Texture wrapping */
     SCE_STexture *tex;       /**< Density texture */
     SCE_STexture *mat;       /**< Material texture */
@@ -70,13 +87,23 @@ struct sce_svoxelterrainlevel {
     int x, y, z;             /**< Position of the origin of the regions */
 
     long map_x, map_y, map_z;/**< Origin of the grid in the map */
+    float decimation;        /**< Part of the vertices of a region removed
+                              *   by the hybrid pipeline */
+    SCEuint max_vertices;    /**< Vertices of a region after decimation,
+                              *   0 for no limit */
 
     int need_update;         /**< Does the texture need to be updated? */
-    SCE_SIntRect3 update_zone;
+    /** Areas of the textures to upload, in texels (grid wrapping applied) */
+    SCE_SIntRect3 dirty[SCE_VTERRAIN_MAX_DIRTY_BOXES];
+    SCEuint n_dirty;
     SCE_SList list1, list2;
     SCE_SList *updating, *queue;
 
     SCE_SList to_render;     /**< Regions to render */
+    /** Origin and wrapping of the regions, and origin of the finer level,
+     * when the region matrices were last computed */
+    long placed[9];
+    int placed_ready;        /**< Are the region matrices computed? */
 
     SCE_SListIterator it;
 };
@@ -96,6 +123,7 @@ struct sce_svoxelterrainshader {
     int sidediffuse_loc;
     int noise_loc;
     int material_loc;
+    int draw_attribs[4];        /**< Per-draw data attributes (multi-draw) */
 };
 
 /* shader flags */
@@ -108,6 +136,8 @@ struct sce_svoxelterrainshader {
 #define SCE_VTERRAIN_USE_LOD_NAME "SCE_VTERRAIN_USE_LOD"
 #define SCE_VTERRAIN_USE_SHADOWS_NAME "SCE_VTERRAIN_USE_SHADOWS"
 #define SCE_VTERRAIN_USE_POINT_SHADOWS_NAME "SCE_VTERRAIN_USE_POINT_SHADOWS"
+/* defined to 1 in the shaders when the regions are drawn from an arena */
+#define SCE_VTERRAIN_MULTIDRAW_NAME "SCE_VTERRAIN_MULTIDRAW"
 
 typedef struct sce_svoxelterrainhybridgenerator
 SCE_SVoxelTerrainHybridGenerator;
@@ -115,6 +145,8 @@ struct sce_svoxelterrainhybridgenerator {
     SCE_SList queue;
     int dim;
     SCE_SGrid grid;
+    SCE_SVoxelClassifier classifier;
+    int active;               /* whether grid crosses the surface */
     SCE_SMCGenerator mc_gen;
     SCEuint mc_step;
     int query;                /* whether we are waiting for data */
@@ -130,8 +162,19 @@ struct sce_svoxelterrainhybridgenerator {
     int x, y, z;
     SCEuint level;
     SCE_SQEMMesh qmesh;
+    SCEbitfield optimize;     /* optimization passes of decimated meshes */
+    SCE_SMeshOptimizer opt;
+    int gradient;             /* normals from the density gradient */
 };
 
+/**
+ * \brief Encodes positions and normals into the interleaved vertex format
+ * of the terrain
+ */
+typedef void (*SCE_FVTerrainEncodeFunc)(float, const SCEvertices*,
+                                        const SCEvertices*, size_t,
+                                        SCEubyte*);
+
 /* maximum number of terrain levels */
 #define SCE_MAX_VTERRAIN_LEVELS 16
 
@@ -152,15 +195,29 @@ struct sce_svoxelterrain {
     int comp_pos, comp_nor;     /**< Compress positions? normals? */
     SCE_EVoxelRenderPipeline rpipeline;
     SCEuint cut;                /**< cut for the hybrid generation method */
+    SCE_FVTerrainEncodeFunc encode; /**< Encoder of the hybrid generator,
+                                     *   matching \c comp_pos and
+                                     *   \c comp_nor */
     SCE_SVoxelTerrainHybridGenerator hybrid;
     SCE_RBufferPool *vertex_pool;
     SCE_RBufferPool *index_pool;
+    SCE_SMeshArena *arena;      /**< Shared buffers of the regions, if any */
+    SCEuint arena_vertices;     /**< Capacity of the arena */
+    SCEuint arena_indices;
+    SCEuint n_draw_calls;       /**< Draw calls issued by the last render */
+    SCE_STextureStream stream;  /**< Pixel buffers of texture updates */
 
     SCEuint subregion_dim;      /**< Dimensions of one subregion */
     SCEuint n_subregions;       /**< Number of subregions per side */
     SCE_SVoxelTerrainLevel levels[SCE_MAX_VTERRAIN_LEVELS];
     size_t n_levels;
     long x, y, z;               /**< Position of the theoretical viewer */
+    float velocity[3];          /**< Velocity of the viewer, voxels per
+                                 *   second */
+    float prefetch_time;        /**< How far ahead to look, in seconds */
+    float screen_error;         /**< Tolerated error of the decimation, in
+                                 *   pixels, 0 to use the levels ratio */
+    float projection;           /**< Pixels per unit at a distance of 1 */
     int width, height, depth;   /**< Dimensions of one level */
     float unit;                 /**< Distance between two consecutive voxels */
     float scale;                /**< Scale to apply to the terrain */
@@ -170,6 +227,15 @@ struct sce_svoxelterrain {
     SCE_SVoxelTerrainLevel *update_level; /**< Level being updated */
     SCEuint max_updates;        /**< Maximum number of updated regions
                                      per frame */
+    SCEuint n_dropped_updates;  /**< Updates skipped because the region was
+                                 *   invalidated again before being meshed */
+    SCEuint n_empty_skips;      /**< Meshings skipped because the voxels
+                                 *   don't cross the surface */
+    SCEuint n_urgent;           /**< Edited regions waiting for meshing */
+    SCEuint n_edits;            /**< Edited regions meshed so far */
+    double edit_latency;        /**< Sum of the edit latencies (ms) */
+    double max_edit_latency;
+    SCE_SFrameBudget *budget;   /**< Time allowed to updates, if any */
 
     int trans_enabled;
     int shadow_mode;                 /**< Whether we are filling shadow maps */
@@ -213,8 +279,18 @@ void SCE_VTerrain_SetPipeline (SCE_SVoxelTerrain*, SCE_EVoxelRenderPipeline);
 void SCE_VTerrain_SetAlgorithm (SCE_SVoxelTerrain*, SCE_EVoxelRenderAlgorithm);
 void SCE_VTerrain_SetHybrid (SCE_SVoxelTerrain*, SCEuint);
 void SCE_VTerrain_SetHybridMCStep (SCE_SVoxelTerrain*, SCEuint);
+void SCE_VTerrain_UseGradientNormals (SCE_SVoxelTerrain*, int);
 void SCE_VTerrain_SetVertexBufferPool (SCE_SVoxelTerrain*, SCE_RBufferPool*);
 void SCE_VTerrain_SetIndexBufferPool (SCE_SVoxelTerrain*, SCE_RBufferPool*);
+void SCE_VTerrain_SetArenaSize (SCE_SVoxelTerrain*, SCEuint, SCEuint);
+SCE_SMeshArena* SCE_VTerrain_GetMeshArena (SCE_SVoxelTerrain*);
+void SCE_VTerrain_SetMeshOptimization (SCE_SVoxelTerrain*, SCEbitfield);
+void SCE_VTerrain_GetACMR (SCE_SVoxelTerrain*, float*, float*);
+void SCE_VTerrain_GetHybridACMR (SCE_SVoxelTerrain*, float*, float*);
+void SCE_VTerrain_SetDecimation (SCE_SVoxelTerrain*, SCEuint, float);
+void SCE_VTerrain_SetMaxRegionVertices (SCE_SVoxelTerrain*, SCEuint, SCEuint);
+void SCE_VTerrain_SetScreenError (SCE_SVoxelTerrain*, float, float);
+float SCE_VTerrain_GetDecimation (const SCE_SVoxelTerrain*, SCEuint);
 void SCE_VTerrain_EnableMaterials (SCE_SVoxelTerrain*);
 void SCE_VTerrain_DisableMaterials (SCE_SVoxelTerrain*);
 
@@ -231,6 +307,10 @@ int SCE_VTerrain_BuildShader (SCE_SVoxelTerrain*, SCE_SShader*);
 int SCE_VTerrain_Build (SCE_SVoxelTerrain*);
 
 void SCE_VTerrain_SetPosition (SCE_SVoxelTerrain*, long, long, long);
+void SCE_VTerrain_SetVelocity (SCE_SVoxelTerrain*, float, float, float);
+void SCE_VTerrain_SetPrefetchTime (SCE_SVoxelTerrain*, float);
+void SCE_VTerrain_GetPrefetchSlices (const SCE_SVoxelTerrain*, SCEuint, long*,
+                                     long*, long*);
 void SCE_VTerrain_GetMissingSlices (const SCE_SVoxelTerrain*, SCEuint, long*,
                                     long*, long*);
 int SCE_VTerrain_GetMissingRegion (SCE_SVoxelTerrain*, SCE_SLongRect3*);
@@ -251,14 +331,23 @@ void SCE_VTerrain_SetRegion (SCE_SVoxelTerrain*, const unsigned char*);
 
 void SCE_VTerrain_CullRegions (SCE_SVoxelTerrain*, const SCE_SFrustum*);
 
+void SCE_VTerrain_SetMaxUpdates (SCE_SVoxelTerrain*, SCEuint);
+void SCE_VTerrain_SetFrameBudget (SCE_SVoxelTerrain*, SCE_SFrameBudget*);
 int SCE_VTerrain_Update (SCE_SVoxelTerrain*);
+SCEuint SCE_VTerrain_GetNumEmptySkips (const SCE_SVoxelTerrain*);
+SCEuint SCE_VTerrain_GetNumDroppedUpdates (const SCE_SVoxelTerrain*);
+size_t SCE_VTerrain_GetUploadedBytes (const SCE_SVoxelTerrain*);
+SCEuint SCE_VTerrain_GetNumEdits (const SCE_SVoxelTerrain*);
+void SCE_VTerrain_GetEditLatency (const SCE_SVoxelTerrain*, float*, float*);
 void SCE_VTerrain_UpdateGrid (SCE_SVoxelTerrain*, SCEuint, int, int);
 void SCE_VTerrain_UpdateSubGrid (SCE_SVoxelTerrain*, SCEuint,
                                  SCE_SIntRect3*, int, int);
+void SCE_VTerrain_EditSubGrid (SCE_SVoxelTerrain*, SCEuint, SCE_SIntRect3*);
 
 void SCE_VTerrain_ActivateShadowMode (SCE_SVoxelTerrain*, int);
 void SCE_VTerrain_ActivatePointShadowMode (SCE_SVoxelTerrain*, int);
 void SCE_VTerrain_Render (SCE_SVoxelTerrain*);
+SCEuint SCE_VTerrain_GetNumDrawCalls (const SCE_SVoxelTerrain*);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -0,0 +1,221 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+/* clock_gettime() is POSIX, not C89 */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 199309L
+#endif
+#include <time.h>
+#include <SCE/utils/SCEUtils.h>
+#include "SCE/interface/SCEFrameBudget.h"
+
+/**
+ * \file SCEFrameBudget.c
+ * \brief Per-frame time budget of background work
+ *
+ * The application calls SCE_FrameBudget_Begin() and SCE_FrameBudget_End()
+ * once per frame and hands the same budget to every module doing deferred
+ * work (see SCE_VTerrain_SetFrameBudget() and
+ * SCE_VOTerrain_SetFrameBudget()). Those modules measure their work with
+ * SCE_FrameBudget_StartSlice() and SCE_FrameBudget_StopSlice() and stop
+ * slicing it as soon as SCE_FrameBudget_HasTime() returns false. Time left
+ * unused at the end of a frame is carried over to the next one, up to a
+ * configurable maximum.
+ */
+
+void SCE_FrameBudget_Init (SCE_SFrameBudget *fb)
+{
+    fb->budget = 0.0;
+    fb->max_carry = 0.0;
+    fb->carry = 0.0;
+    fb->available = 0.0;
+    fb->spent = 0.0;
+    fb->start = 0.0;
+    fb->depth = 0;
+    fb->n_overruns = 0;
+}
+void SCE_FrameBudget_Clear (SCE_SFrameBudget *fb)
+{
+    (void)fb;
+}
+SCE_SFrameBudget* SCE_FrameBudget_Create (void)
+{
+    SCE_SFrameBudget *fb = NULL;
+    if (!(fb = SCE_malloc (sizeof *fb)))
+        SCEE_LogSrc ();
+    else
+        SCE_FrameBudget_Init (fb);
+    return fb;
+}
+void SCE_FrameBudget_Delete (SCE_SFrameBudget *fb)
+{
+    if (fb) {
+        SCE_FrameBudget_Clear (fb);
+        SCE_free (fb);
+    }
+}
+
+/**
+ * \brief Gets the current time of a monotonic clock
+ * \returns a time in milliseconds, only meaningful relative to another
+ * value returned by this function
+ *
+ * Unlike the wall clock, this time never jumps when the system time is set.
+ */
+double SCE_FrameBudget_GetTime (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/**
+ * \brief Sets the time allowed to background work each frame
+ * \param fb a frame budget
+ * \param ms budget in milliseconds, 0 disables the limit (default)
+ */
+void SCE_FrameBudget_SetBudget (SCE_SFrameBudget *fb, float ms)
+{
+    fb->budget = ms;
+}
+float SCE_FrameBudget_GetBudget (const SCE_SFrameBudget *fb)
+{
+    return fb->budget;
+}
+/**
+ * \brief Sets how much unused time can be carried over to the next frame
+ * \param fb a frame budget
+ * \param ms maximum carried time in milliseconds, 0 by default
+ */
+void SCE_FrameBudget_SetMaxCarry (SCE_SFrameBudget *fb, float ms)
+{
+    fb->max_carry = ms;
+}
+
+/**
+ * \brief Starts a new frame
+ * \param fb a frame budget
+ * \sa SCE_FrameBudget_End()
+ */
+void SCE_FrameBudget_Begin (SCE_SFrameBudget *fb)
+{
+    fb->available = fb->budget + fb->carry;
+    fb->spent = 0.0;
+    fb->depth = 0;
+}
+/**
+ * \brief Ends a frame, carries its unused time over to the next one
+ * \param fb a frame budget
+ *
+ * The time spent and remaining stay readable until the next call to
+ * SCE_FrameBudget_Begin().
+ */
+void SCE_FrameBudget_End (SCE_SFrameBudget *fb)
+{
+    float remaining;
+
+    if (fb->depth > 0) {
+        fb->depth = 1;
+        SCE_FrameBudget_StopSlice (fb);
+    }
+    if (fb->budget <= 0.0) {
+        fb->carry = 0.0;
+        return;
+    }
+    remaining = fb->available - fb->spent;
+    if (remaining < 0.0) {
+        fb->n_overruns++;
+        remaining = 0.0;
+    }
+    fb->carry = MIN (remaining, fb->max_carry);
+}
+
+/**
+ * \brief Starts measuring a slice of work
+ * \param fb a frame budget
+ *
+ * Slices may be nested, only the outermost one is accounted for.
+ * \sa SCE_FrameBudget_StopSlice()
+ */
+void SCE_FrameBudget_StartSlice (SCE_SFrameBudget *fb)
+{
+    if (!fb->depth)
+        fb->start = SCE_FrameBudget_GetTime ();
+    fb->depth++;
+}
+/**
+ * \brief Stops measuring a slice of work, charges its duration to the
+ * current frame
+ * \param fb a frame budget
+ */
+void SCE_FrameBudget_StopSlice (SCE_SFrameBudget *fb)
+{
+    if (fb->depth > 0 && !--fb->depth)
+        fb->spent += SCE_FrameBudget_GetTime () - fb->start;
+}
+/**
+ * \brief Tells whether more work can be done during the current frame
+ * \param fb a frame budget
+ * \returns SCE_TRUE if the time spent so far, running slice included, is
+ * below the time available for this frame or if the budget is unlimited
+ */
+int SCE_FrameBudget_HasTime (const SCE_SFrameBudget *fb)
+{
+    return fb->budget <= 0.0 || SCE_FrameBudget_GetRemaining (fb) > 0.0;
+}
+
+/**
+ * \brief Gets the time spent in slices during the current frame
+ * \param fb a frame budget
+ * \returns time in milliseconds, running slice included
+ */
+float SCE_FrameBudget_GetSpent (const SCE_SFrameBudget *fb)
+{
+    float spent = fb->spent;
+    if (fb->depth > 0)
+        spent += SCE_FrameBudget_GetTime () - fb->start;
+    return spent;
+}
+/**
+ * \brief Gets the time left to the current frame
+ * \param fb a frame budget
+ * \returns time in milliseconds, negative when the frame went over budget
+ */
+float SCE_FrameBudget_GetRemaining (const SCE_SFrameBudget *fb)
+{
+    return fb->available - SCE_FrameBudget_GetSpent (fb);
+}
+/**
+ * \brief Gets the unused time carried over from the previous frame
+ * \param fb a frame budget
+ */
+float SCE_FrameBudget_GetCarry (const SCE_SFrameBudget *fb)
+{
+    return fb->carry;
+}
+/**
+ * \brief Gets the number of frames which exceeded their budget
+ * \param fb a frame budget
+ */
+SCEuint SCE_FrameBudget_GetNumOverruns (const SCE_SFrameBudget *fb)
+{
+    return fb->n_overruns;
+}
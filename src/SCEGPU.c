@@ -0,0 +1,321 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#include <SCE/utils/SCEUtils.h>
+#include <SCE/renderer/SCERenderer.h>
+
+#include "SCE/interface/SCEGPU.h"
+
+/**
+ * \file SCEGPU.c
+ * \brief Wrappers of the GL objects not covered by the renderer
+ *
+ * The interface modules never call GL themselves: vertex array objects,
+ * buffer copies, pixel buffers, fences and per-draw attribute buffers are
+ * handled here, with the same conventions as the buffers of the renderer.
+ * Every function binds what it needs and restores the default binding
+ * before returning, unless its purpose is to leave something bound.
+ */
+
+/**
+ * \brief Creates a vertex array object
+ * \returns the name of the new object, 0 if vertex array objects are not
+ * supported
+ * \sa SCE_GPU_DeleteVertexArray(), SCE_GPU_UseVertexArray()
+ */
+SCEuint SCE_GPU_CreateVertexArray (void)
+{
+    GLuint vao = 0;
+    if (SCE_RHasCap (SCE_VAO))
+        glGenVertexArrays (1, &vao);
+    return vao;
+}
+/**
+ * \brief Deletes a vertex array object, does nothing if \p vao is 0
+ */
+void SCE_GPU_DeleteVertexArray (SCEuint vao)
+{
+    GLuint name = vao;
+    if (name)
+        glDeleteVertexArrays (1, &name);
+}
+/**
+ * \brief Binds a vertex array object, 0 binds the default one
+ *
+ * The vertex and index buffers bound while a vertex array object is bound
+ * are recorded into it.
+ */
+void SCE_GPU_UseVertexArray (SCEuint vao)
+{
+    glBindVertexArray (vao);
+}
+
+/**
+ * \brief Can buffers be copied on the GPU (GL 3.1 or ARB_copy_buffer)
+ * \sa SCE_GPU_CopyBuffer()
+ */
+int SCE_GPU_HasCopyBuffer (void)
+{
+    return (GLEW_VERSION_3_1 || GLEW_ARB_copy_buffer) ? SCE_TRUE : SCE_FALSE;
+}
+/**
+ * \brief Copies a range of a buffer into another one without going through
+ * client memory
+ * \param dst destination buffer
+ * \param dst_offset offset in \p dst, in bytes
+ * \param src source buffer, can be \p dst if the ranges don't overlap
+ * \param src_offset offset in \p src, in bytes
+ * \param size number of bytes to copy
+ *
+ * The copy targets are used, so the bindings of the vertex array objects
+ * are left untouched.
+ * \sa SCE_GPU_HasCopyBuffer()
+ */
+void SCE_GPU_CopyBuffer (SCE_RBuffer *dst, size_t dst_offset,
+                         SCE_RBuffer *src, size_t src_offset, size_t size)
+{
+    glBindBuffer (GL_COPY_READ_BUFFER, src->id);
+    glBindBuffer (GL_COPY_WRITE_BUFFER, dst->id);
+    glCopyBufferSubData (GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                         src_offset, dst_offset, size);
+    glBindBuffer (GL_COPY_READ_BUFFER, 0);
+    glBindBuffer (GL_COPY_WRITE_BUFFER, 0);
+}
+
+
+/**
+ * \brief Are fences supported (GL 3.2 or ARB_sync)
+ */
+int SCE_GPU_HasFences (void)
+{
+    return (GLEW_VERSION_3_2 || GLEW_ARB_sync) ? SCE_TRUE : SCE_FALSE;
+}
+/**
+ * \brief Inserts a fence after the commands issued so far
+ * \returns the new fence, NULL if fences are not supported
+ * \sa SCE_GPU_IsFenceReached(), SCE_GPU_DeleteFence()
+ */
+SCE_GPUFence SCE_GPU_CreateFence (void)
+{
+    if (!SCE_GPU_HasFences ())
+        return NULL;
+    return glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+/**
+ * \brief Deletes a fence, does nothing if \p fence is NULL
+ */
+void SCE_GPU_DeleteFence (SCE_GPUFence fence)
+{
+    if (fence)
+        glDeleteSync (fence);
+}
+/**
+ * \brief Checks whether the GPU went past a fence, without waiting
+ */
+int SCE_GPU_IsFenceReached (SCE_GPUFence fence)
+{
+    GLenum r = glClientWaitSync (fence, 0, 0);
+    return (r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED);
+}
+
+
+/**
+ * \brief Creates a buffer object, its storage is allocated when mapped
+ * \sa SCE_GPU_MapPixelBuffer(), SCE_GPU_DeleteBuffer()
+ */
+SCEuint SCE_GPU_CreateBuffer (void)
+{
+    GLuint buffer = 0;
+    glGenBuffers (1, &buffer);
+    return buffer;
+}
+/**
+ * \brief Deletes a buffer object, does nothing if \p buffer is 0
+ */
+void SCE_GPU_DeleteBuffer (SCEuint buffer)
+{
+    GLuint name = buffer;
+    if (name)
+        glDeleteBuffers (1, &name);
+}
+/**
+ * \brief Maps a buffer as the pixel unpack buffer, for writing
+ * \param buffer a buffer object
+ * \param capacity size of the storage of \p buffer, in bytes
+ * \param size number of bytes to map from the beginning of the buffer
+ * \param orphan if true, new storage of \p capacity bytes is allocated,
+ * otherwise the current storage is mapped without synchronization: the
+ * caller must know that the GPU no longer reads it
+ * \returns the mapped memory, NULL on failure
+ *
+ * The buffer stays bound so that the texture uploads following
+ * SCE_GPU_UnmapPixelBuffer() read from it, unbind it with
+ * SCE_GPU_UsePixelBuffer(0). It is unbound on failure.
+ */
+void* SCE_GPU_MapPixelBuffer (SCEuint buffer, size_t capacity, size_t size,
+                              int orphan)
+{
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    void *p = NULL;
+
+    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, buffer);
+    if (orphan)
+        glBufferData (GL_PIXEL_UNPACK_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+    else
+        access |= GL_MAP_UNSYNCHRONIZED_BIT;
+    if (!(p = glMapBufferRange (GL_PIXEL_UNPACK_BUFFER, 0, size, access)))
+        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+    return p;
+}
+/**
+ * \brief Unmaps the pixel unpack buffer, leaving it bound
+ */
+void SCE_GPU_UnmapPixelBuffer (void)
+{
+    glUnmapBuffer (GL_PIXEL_UNPACK_BUFFER);
+}
+/**
+ * \brief Binds a buffer as the pixel unpack buffer, 0 unbinds it
+ */
+void SCE_GPU_UsePixelBuffer (SCEuint buffer)
+{
+    glBindBuffer (GL_PIXEL_UNPACK_BUFFER, buffer);
+}
+/**
+ * \brief Replaces the whole storage of a buffer, for data sent every frame
+ * \param buffer a buffer object
+ * \param size size of \p data, in bytes
+ * \param data new content of \p buffer
+ *
+ * The copy write target is used, so the bindings of the vertex array
+ * objects are left untouched.
+ */
+void SCE_GPU_SetBufferData (SCEuint buffer, size_t size, const void *data)
+{
+    glBindBuffer (GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData (GL_COPY_WRITE_BUFFER, size, data, GL_STREAM_DRAW);
+    glBindBuffer (GL_COPY_WRITE_BUFFER, 0);
+}
+
+
+/**
+ * \brief Sources vertex attributes from a per-draw data buffer
+ * \param buffer buffer of per-draw data, one record of \p stride bytes
+ * for each draw
+ * \param attribs attribute indices, the attribute \p attribs[i] reads the
+ * i-th vector of four floats of each record
+ * \param n number of attributes
+ * \param stride size of a record, in bytes
+ *
+ * The attributes advance once per instance, so a draw reads the record
+ * given by its base instance. They are recorded into the bound vertex array
+ * object: call SCE_GPU_DisableDrawAttribs() once the draws are issued to
+ * give it back its own layout.
+ * \sa SCE_GPU_MultiDrawIndirect()
+ */
+void SCE_GPU_EnableDrawAttribs (SCEuint buffer, const int *attribs, int n,
+                                size_t stride)
+{
+    int i;
+    glBindBuffer (GL_ARRAY_BUFFER, buffer);
+    for (i = 0; i < n; i++) {
+        glEnableVertexAttribArray (attribs[i]);
+        glVertexAttribPointer (attribs[i], 4, GL_FLOAT, GL_FALSE, stride,
+                               (const GLvoid*)(i * 4 * sizeof (float)));
+        glVertexAttribDivisor (attribs[i], 1);
+    }
+    glBindBuffer (GL_ARRAY_BUFFER, 0);
+}
+/**
+ * \brief Stops sourcing attributes from a per-draw data buffer
+ * \sa SCE_GPU_EnableDrawAttribs()
+ */
+void SCE_GPU_DisableDrawAttribs (const int *attribs, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        glVertexAttribDivisor (attribs[i], 0);
+        glDisableVertexAttribArray (attribs[i]);
+    }
+}
+/**
+ * \brief Issues the draw commands stored in a buffer
+ * \param prim primitive type
+ * \param itype type of the indices of the bound index buffer
+ * \param buffer buffer of \p n tightly packed commands, as expected by
+ * glMultiDrawElementsIndirect()
+ * \param n number of commands
+ */
+void SCE_GPU_MultiDrawIndirect (SCEenum prim, SCEenum itype, SCEuint buffer,
+                                SCEuint n)
+{
+#ifdef GL_ARB_multi_draw_indirect
+    glBindBuffer (GL_DRAW_INDIRECT_BUFFER, buffer);
+    glMultiDrawElementsIndirect (prim, itype, NULL, n, 0);
+    glBindBuffer (GL_DRAW_INDIRECT_BUFFER, 0);
+#else
+    (void)prim; (void)itype; (void)buffer; (void)n;
+#endif
+}
+
+
+/**
+ * \brief Sets the row alignment of the pixels sent to the GPU
+ * \returns the previous alignment, to be restored afterwards
+ */
+int SCE_GPU_SetUnpackAlignment (int align)
+{
+    GLint old = 4;
+    glGetIntegerv (GL_UNPACK_ALIGNMENT, &old);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, align);
+    return old;
+}
+/**
+ * \brief Sets the layout of the pixels sent to the GPU, to upload a box
+ * out of a larger volume
+ * \param row_length,image_height dimensions of the volume, in pixels
+ * \param skip origin of the box in the volume, NULL for none
+ *
+ * Call SCE_GPU_SetUnpackLayout(0, 0, NULL) to get back to tightly packed
+ * pixels.
+ */
+void SCE_GPU_SetUnpackLayout (int row_length, int image_height,
+                              const int *skip)
+{
+    glPixelStorei (GL_UNPACK_ROW_LENGTH, row_length);
+    glPixelStorei (GL_UNPACK_IMAGE_HEIGHT, image_height);
+    glPixelStorei (GL_UNPACK_SKIP_PIXELS, skip ? skip[0] : 0);
+    glPixelStorei (GL_UNPACK_SKIP_ROWS, skip ? skip[1] : 0);
+    glPixelStorei (GL_UNPACK_SKIP_IMAGES, skip ? skip[2] : 0);
+}
+/**
+ * \brief Updates a box of the 3D texture bound to the active unit
+ * \param p1,p2 corners of the box, \p p2 excluded
+ * \param fmt,type format and type of \p data
+ * \param data pixels, or offset in the bound pixel unpack buffer
+ * \sa SCE_GPU_SetUnpackLayout(), SCE_GPU_MapPixelBuffer()
+ */
+void SCE_GPU_TexSubImage3D (const int *p1, const int *p2, SCEenum fmt,
+                            SCEenum type, const void *data)
+{
+    glTexSubImage3D (GL_TEXTURE_3D, 0, p1[0], p1[1], p1[2], p2[0] - p1[0],
+                     p2[1] - p1[1], p2[2] - p1[2], fmt, type, data);
+}
@@ -67,6 +67,7 @@ int SCE_Init_Interface (FILE *outlog, SCEbitfield flags)
             SCE_Init_Texture () < 0 ||
             SCE_Init_Shader () < 0 ||
             SCE_Init_Mesh () < 0 ||
+            SCE_Init_MeshBatch () < 0 ||
             SCE_Init_Quad () < 0 ||
             SCE_Init_VRender () < 0 ||
             SCE_Init_Scene () < 0) {
@@ -104,6 +105,7 @@ void SCE_Quit_Interface (void)
             SCE_Quit_Anim ();
             SCE_Quit_AnimGeom ();
             SCE_Quit_OBJ ();
+            SCE_Quit_MeshBatch ();
             SCE_Quit_Mesh ();
             SCE_Quit_BoxGeom ();
             SCE_Quit_Geometry ();
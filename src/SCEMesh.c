@@ -17,10 +17,12 @@
  -----------------------------------------------------------------------------*/
 
 /* created: 31/07/2009
-   updated: 15/03/2013 */
+   updated: 19/10/2026 */
 
+#include <string.h>
 #include <SCE/utils/SCEUtils.h>
 #include <SCE/core/SCECore.h>
+#include "SCE/interface/SCEGPU.h"
 #include "SCE/interface/SCEMesh.h"
 
 typedef void (*SCE_SMeshRenderFunc)(SCEenum);
@@ -32,6 +34,15 @@ static int resource_type = 0;
 
 static SCE_SMesh *mesh_bound = NULL;
 static int activated_streams[SCE_MESH_NUM_STREAMS];
+/* mesh whose VAO is bound, between SCE_Mesh_Use() and SCE_Mesh_Unuse() */
+static SCE_SMesh *vao_bound = NULL;
+static SCEuint n_avoided_binds = 0;
+
+/* scratch buffers of the build-time optimization */
+static SCE_SMeshOptimizer optimizer;
+/* scratch buffer for index conversions at upload time */
+static void *index_scratch = NULL;
+static size_t index_scratch_size = 0;
 static SCE_SMeshRenderFunc render_func = NULL;
 static SCE_SMeshRenderInstancedFunc render_func_instanced = NULL;
 
@@ -53,6 +64,11 @@ int SCE_Init_Mesh (void)
         goto fail;
     for (i = 0; i < SCE_MESH_NUM_STREAMS; i++)
         activated_streams[i] = SCE_TRUE;
+    vao_bound = NULL;
+    n_avoided_binds = 0;
+    SCE_MeshOpt_Init (&optimizer);
+    index_scratch = NULL;
+    index_scratch_size = 0;
     is_init = SCE_TRUE;
     return SCE_OK;
 fail:
@@ -62,6 +78,10 @@ fail:
 }
 void SCE_Quit_Mesh (void)
 {
+    SCE_MeshOpt_Clear (&optimizer);
+    SCE_free (index_scratch);
+    index_scratch = NULL;
+    index_scratch_size = 0;
     is_init = SCE_FALSE;
 }
 
@@ -122,10 +142,25 @@ void SCE_Mesh_Init (SCE_SMesh *mesh)
     SCE_RInitFeedback (&mesh->feedback);
     SCE_RInitFeedback (&mesh->feedback_id);
     mesh->counting_buffer = NULL;
+    mesh->feedback_pending = mesh->feedback_pending_id = SCE_FALSE;
     SCE_Geometry_InitArrayUser (&mesh->index_auser);
     mesh->rmode = SCE_VA_RENDER_MODE;
     mesh->bmode = SCE_INDEPENDANT_VERTEX_BUFFER;
     mesh->built = SCE_FALSE;
+    mesh->use_vao = SCE_FALSE;
+    for (i = 0; i < SCE_MESH_MAX_VAOS; i++) {
+        mesh->vaos[i] = 0;
+        mesh->vao_streams[i] = 0;
+        mesh->vao_versions[i] = 0;
+    }
+    mesh->vao_version = 1;
+    mesh->next_vao = 0;
+    mesh->optimize = 0;
+    mesh->acmr[0] = mesh->acmr[1] = 0.0;
+    mesh->quantize = 0;
+    mesh->auto_index = SCE_TRUE;
+    mesh->pos_scale[0] = mesh->pos_scale[1] = mesh->pos_scale[2] = 1.0;
+    mesh->pos_offset[0] = mesh->pos_offset[1] = mesh->pos_offset[2] = 0.0;
 }
 SCE_SMesh* SCE_Mesh_Create (void)
 {
@@ -150,6 +185,10 @@ SCE_SMesh* SCE_Mesh_CreateFrom (SCE_SGeometry *geom, int canfree)
 void SCE_Mesh_Clear (SCE_SMesh *mesh)
 {
     size_t i;
+    if (vao_bound == mesh)
+        SCE_Mesh_Unbind ();
+    for (i = 0; i < SCE_MESH_MAX_VAOS; i++)
+        SCE_GPU_DeleteVertexArray (mesh->vaos[i]);
     SCE_RClearIndexBuffer (&mesh->ib);
     SCE_List_Clear (&mesh->arrays);
     for (i = 0; i < SCE_MESH_NUM_STREAMS; i++)
@@ -178,7 +217,7 @@ void SCE_Mesh_ActivateStream (SCE_EMeshStream s, int a)
  */
 void SCE_Mesh_EnableStream (SCE_EMeshStream s)
 {
-    activated_streams[s] = SCE_TRUE;
+    SCE_Mesh_ActivateStream (s, SCE_TRUE);
 }
 /**
  * \brief Disables a stream
@@ -186,7 +225,7 @@ void SCE_Mesh_EnableStream (SCE_EMeshStream s)
  */
 void SCE_Mesh_DisableStream (SCE_EMeshStream s)
 {
-    activated_streams[s] = SCE_FALSE;
+    SCE_Mesh_ActivateStream (s, SCE_FALSE);
 }
 
 void SCE_Mesh_ActivateIndices (SCE_SMesh *mesh, int activate)
@@ -251,20 +290,13 @@ static void SCE_Mesh_UpdateArrayCallback (void *data, size_t *range)
 }
 /**
  * \internal
- * \brief Adds a root geometry array to a mesh array (ie vertex buffer data)
- * 
- * The root geometry array is the first geometry array of a set of interleaved
- * geometry arrays.
- * \sa SCE_Mesh_AddArray(), SCE_Mesh_AddArrayFrom()
+ * \brief Creates the vertex arrays of a mesh array from the geometry arrays
+ * \p array and its children
  */
-static int SCE_Mesh_AddArrayArrays (SCE_SMeshArray *marray,
-                                    SCE_SGeometryArray *array,
-                                    size_t n_vertices)
+static int SCE_Mesh_AddVertexArrays (SCE_SMeshArray *marray,
+                                     SCE_SGeometryArray *array,
+                                     size_t n_vertices)
 {
-    /* set user at root */
-    SCE_Geometry_AddUser (array, &marray->auser, SCE_Mesh_UpdateArrayCallback,
-                          &marray->data);
-    /* add children */
     while (array) {
         /* create vertex arrays using vertex array data of the geometry */
         SCE_RVertexArray *va = NULL;
@@ -280,6 +312,27 @@ fail:
     SCEE_LogSrc ();
     return SCE_ERROR;
 }
+/**
+ * \internal
+ * \brief Adds a root geometry array to a mesh array (ie vertex buffer data)
+ * 
+ * The root geometry array is the first geometry array of a set of interleaved
+ * geometry arrays.
+ * \sa SCE_Mesh_AddArray(), SCE_Mesh_AddArrayFrom()
+ */
+static int SCE_Mesh_AddArrayArrays (SCE_SMeshArray *marray,
+                                    SCE_SGeometryArray *array,
+                                    size_t n_vertices)
+{
+    /* set user at root */
+    SCE_Geometry_AddUser (array, &marray->auser, SCE_Mesh_UpdateArrayCallback,
+                          &marray->data);
+    if (SCE_Mesh_AddVertexArrays (marray, array, n_vertices) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    return SCE_OK;
+}
 
 
 /**
@@ -480,6 +533,8 @@ static void SCE_Mesh_BuildBuffers (SCE_SMesh *mesh, SCE_RBufferUsage
         rmode = SCE_VA_RENDER_MODE;
     mesh->rmode = rmode;
 
+    /* the index buffer binding goes into the bound VAO, if any */
+    SCE_Mesh_Unbind ();
     SCE_Mesh_UpdateNumVertices (mesh);
     if (mesh->use_ib)
         SCE_RBuildIndexBuffer (&mesh->ib, usage[SCE_MESH_NUM_STREAMS]);
@@ -487,6 +542,10 @@ static void SCE_Mesh_BuildBuffers (SCE_SMesh *mesh, SCE_RBufferUsage
         if (mesh->used_streams[i])
             SCE_RBuildVertexBuffer (&mesh->streams[i], usage[i], rmode);
     }
+
+    /* the bindings are recorded by SCE_Mesh_Use() */
+    mesh->use_vao = SCE_RHasCap (SCE_VAO) && rmode == SCE_VBO_RENDER_MODE;
+    mesh->vao_version++;
 }
 /**
  * \internal
@@ -518,6 +577,328 @@ static void SCE_Mesh_BuildFeedback (SCE_SMesh *mesh)
     SCE_RAddFeedbackStream (&mesh->feedback_id, mesh->counting_buffer_id, NULL);
     SCE_REnableFeedbackCounting (&mesh->feedback_id, mesh->counting_buffer_id);
 }
+/**
+ * \internal
+ * \brief Size in bytes of one vertex in a root geometry array
+ */
+static size_t SCE_Mesh_GetArrayStride (SCE_SGeometryArray *array)
+{
+    SCE_SGeometryArrayData *data = SCE_Geometry_GetArrayData (array);
+    size_t size;
+    if (data->stride)
+        return data->stride;
+    switch (data->type) {
+    case SCE_UNSIGNED_BYTE:
+    case SCE_BYTE: size = 1; break;
+    case SCE_UNSIGNED_SHORT:
+    case SCE_HALF_FLOAT:
+    case SCE_SHORT: size = 2; break;
+    case SCE_INT_2_10_10_10_REV: return 4;
+    case SCE_DOUBLE: size = 8; break;
+    default: size = 4;
+    }
+    return size * data->size;
+}
+/**
+ * \internal
+ * \brief Runs the optimization passes on the geometry of a mesh, in place
+ */
+static int SCE_Mesh_Optimize (SCE_SMesh *mesh)
+{
+    SCE_SGeometry *geom = mesh->geom;
+    SCE_SGeometryArray *index_array = NULL, *array = NULL;
+    SCE_SGeometryArrayData *idata = NULL;
+    SCE_SListIterator *it = NULL;
+    SCE_SList *arrays = NULL;
+    const float *pos = NULL;
+    size_t pos_stride = 0;
+    SCEuint n_vertices;
+
+    if (!geom || !mesh->optimize || mesh->prim != SCE_TRIANGLES ||
+        !(index_array = SCE_Geometry_GetIndexArray (geom)))
+        return SCE_OK;
+
+    /* look for float positions (for the overdraw pass) */
+    arrays = SCE_Geometry_GetArrays (geom);
+    SCE_List_ForEach (it, arrays) {
+        for (array = SCE_List_GetData (it); array;
+             array = SCE_Geometry_GetChild (array)) {
+            SCE_SGeometryArrayData *data = SCE_Geometry_GetArrayData (array);
+            if (SCE_Geometry_GetArrayVertexAttribute (array) == SCE_POSITION &&
+                data->type == SCE_FLOAT && data->size >= 3) {
+                pos = data->data;
+                pos_stride = data->stride ? data->stride :
+                    data->size * sizeof (float);
+            }
+        }
+    }
+
+    n_vertices = SCE_Geometry_GetNumVertices (geom);
+    idata = SCE_Geometry_GetArrayData (index_array);
+    if (SCE_MeshOpt_Optimize (&optimizer, mesh->optimize, idata->data,
+                              idata->type, SCE_Geometry_GetNumIndices (geom),
+                              pos, pos_stride, n_vertices) < 0)
+        goto fail;
+    SCE_MeshOpt_GetACMR (&optimizer, &mesh->acmr[0], &mesh->acmr[1]);
+
+    /* reorder every root array, interleaved children follow their root */
+    SCE_List_ForEach (it, arrays) {
+        array = SCE_List_GetData (it);
+        if (!SCE_Geometry_GetRoot (array)) {
+            size_t stride = SCE_Mesh_GetArrayStride (array);
+            if (SCE_MeshOpt_Remap (&optimizer,
+                                   SCE_Geometry_GetArrayData (array)->data,
+                                   stride, stride) < 0)
+                goto fail;
+        }
+    }
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+/**
+ * \internal
+ * \brief Converts a float into an IEEE half float
+ */
+static SCEushort SCE_Mesh_FloatToHalf (float f)
+{
+    union { float f; SCEuint i; } u;
+    SCEuint sign, mant, h;
+    int e;
+
+    u.f = f;
+    sign = (u.i >> 16) & 0x8000;
+    mant = u.i & 0x7fffff;
+    e = (int)((u.i >> 23) & 0xff) - 127 + 15;
+    if (e >= 31) {
+        /* overflow, infinity or NaN */
+        if (((u.i >> 23) & 0xff) == 0xff && mant)
+            return sign | 0x7e00;
+        return sign | 0x7c00;
+    } else if (e <= 0) {
+        /* denormalized or too small */
+        if (e < -10)
+            return sign;
+        mant |= 0x800000;
+        h = (mant >> (14 - e)) + ((mant >> (13 - e)) & 1);
+        return sign | h;
+    }
+    /* rounding may carry into the exponent, which is what we want */
+    h = sign | (e << 10) | (mant >> 13);
+    h += (mant >> 12) & 1;
+    return h;
+}
+/**
+ * \internal
+ * \brief Quantizes a float in [-1, 1] on \p bits bits (sign included)
+ */
+static int SCE_Mesh_Snorm (float f, int bits)
+{
+    float m = (float)((1 << (bits - 1)) - 1);
+    f = MAX (-1.0f, MIN (1.0f, f));
+    return (int)(f * m + (f < 0.0f ? -0.5f : 0.5f));
+}
+/**
+ * \internal
+ * \brief Octahedral encoding of a unit vector
+ */
+static void SCE_Mesh_EncodeOctahedral (const float *n, short *out)
+{
+    float l, x, y;
+    l = fabs (n[0]) + fabs (n[1]) + fabs (n[2]);
+    if (l == 0.0f)
+        l = 1.0f;
+    x = n[0] / l;
+    y = n[1] / l;
+    if (n[2] < 0.0f) {
+        float t = x;
+        x = (1.0f - fabs (y)) * (t >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - fabs (t)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+    out[0] = SCE_Mesh_Snorm (x, 16);
+    out[1] = SCE_Mesh_Snorm (y, 16);
+}
+/**
+ * \internal
+ * \brief Quantizes one non-interleaved float geometry array
+ *
+ * Quantized positions and normals get the SCE_IPOSITION and SCE_INORMAL
+ * semantics, so that the integers are normalized when fetched, as done for
+ * the compressed voxel geometry.
+ */
+static int SCE_Mesh_QuantizeArray (SCE_SMesh *mesh, SCE_SGeometryArray *array,
+                                   SCEuint n_vertices)
+{
+    SCE_SGeometryArrayData *data = SCE_Geometry_GetArrayData (array);
+    SCE_EVertexAttribute attrib = SCE_Geometry_GetArrayVertexAttribute (array);
+    const float *src = data->data;
+    SCEuint i, j;
+    int size = data->size;
+
+    if (data->type != SCE_FLOAT || data->stride ||
+        SCE_Geometry_GetChild (array) || !src)
+        return SCE_OK;
+
+    if (attrib == SCE_POSITION && (mesh->quantize & SCE_MESH_QUANTIZE_POSITION)
+        && size >= 3) {
+        float min[3], max[3];
+        short *q = NULL;
+
+        if (!(q = SCE_malloc (n_vertices * 4 * sizeof *q)))
+            goto fail;
+        for (j = 0; j < 3; j++)
+            min[j] = max[j] = n_vertices ? src[j] : 0.0f;
+        for (i = 0; i < n_vertices; i++) {
+            for (j = 0; j < 3; j++) {
+                min[j] = MIN (min[j], src[i * size + j]);
+                max[j] = MAX (max[j], src[i * size + j]);
+            }
+        }
+        for (j = 0; j < 3; j++) {
+            mesh->pos_offset[j] = (min[j] + max[j]) * 0.5f;
+            mesh->pos_scale[j] = (max[j] - min[j]) * 0.5f;
+            if (mesh->pos_scale[j] <= 0.0f)
+                mesh->pos_scale[j] = 1.0f;
+        }
+        /* 4 components to keep 8-byte aligned vertices */
+        for (i = 0; i < n_vertices; i++) {
+            for (j = 0; j < 3; j++) {
+                float f = (src[i * size + j] - mesh->pos_offset[j]) /
+                    mesh->pos_scale[j];
+                q[i * 4 + j] = SCE_Mesh_Snorm (f, 16);
+            }
+            q[i * 4 + 3] = SCE_Mesh_Snorm (1.0f, 16);
+        }
+        SCE_Geometry_SetArrayData (array, SCE_IPOSITION, SCE_SHORT, 0, 4, q,
+                                   SCE_TRUE);
+    } else if (attrib == SCE_NORMAL && size >= 3 &&
+               (mesh->quantize & (SCE_MESH_QUANTIZE_NORMAL |
+                                  SCE_MESH_QUANTIZE_NORMAL_PACKED))) {
+        if ((mesh->quantize & SCE_MESH_QUANTIZE_NORMAL) && size == 3) {
+            short *q = NULL;
+            if (!(q = SCE_malloc (n_vertices * 2 * sizeof *q)))
+                goto fail;
+            for (i = 0; i < n_vertices; i++)
+                SCE_Mesh_EncodeOctahedral (&src[i * size], &q[i * 2]);
+            SCE_Geometry_SetArrayData (array, SCE_INORMAL, SCE_SHORT, 0, 2, q,
+                                       SCE_TRUE);
+        } else {
+            /* 10-10-10-2, the w component is kept */
+            SCEuint *q = NULL;
+            if (!(q = SCE_malloc (n_vertices * sizeof *q)))
+                goto fail;
+            for (i = 0; i < n_vertices; i++) {
+                const float *v = &src[i * size];
+                float w = size > 3 ? v[3] : 1.0f;
+                q[i] = ((SCEuint)SCE_Mesh_Snorm (v[0], 10) & 0x3ff) |
+                    (((SCEuint)SCE_Mesh_Snorm (v[1], 10) & 0x3ff) << 10) |
+                    (((SCEuint)SCE_Mesh_Snorm (v[2], 10) & 0x3ff) << 20) |
+                    (((SCEuint)SCE_Mesh_Snorm (w, 2) & 0x3) << 30);
+            }
+            SCE_Geometry_SetArrayData (array, SCE_INORMAL,
+                                       SCE_INT_2_10_10_10_REV, 0, 4, q,
+                                       SCE_TRUE);
+        }
+    } else if (attrib >= SCE_TEXCOORD0 && attrib < SCE_ATTRIB0 &&
+               (mesh->quantize & SCE_MESH_QUANTIZE_TEXCOORD)) {
+        SCEushort *q = NULL;
+        if (!(q = SCE_malloc (n_vertices * size * sizeof *q)))
+            goto fail;
+        for (i = 0; i < n_vertices * size; i++)
+            q[i] = SCE_Mesh_FloatToHalf (src[i]);
+        SCE_Geometry_SetArrayData (array, attrib, SCE_HALF_FLOAT, 0, size, q,
+                                   SCE_TRUE);
+    }
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+/**
+ * \internal
+ * \brief Quantizes the vertex data of the geometry of a mesh
+ *
+ * Only non-interleaved float arrays are converted, the vertex arrays of the
+ * mesh are then recreated to match the new data types.
+ */
+static int SCE_Mesh_Quantize (SCE_SMesh *mesh)
+{
+    SCE_SListIterator *it = NULL;
+    SCE_SList *arrays = NULL;
+    SCEuint n_vertices;
+
+    if (!mesh->geom || !mesh->quantize)
+        return SCE_OK;
+
+    n_vertices = SCE_Geometry_GetNumVertices (mesh->geom);
+    arrays = SCE_Geometry_GetArrays (mesh->geom);
+    SCE_List_ForEach (it, arrays) {
+        SCE_SGeometryArray *array = SCE_List_GetData (it);
+        if (!SCE_Geometry_GetRoot (array) &&
+            SCE_Mesh_QuantizeArray (mesh, array, n_vertices) < 0)
+            goto fail;
+    }
+    arrays = SCE_Geometry_GetModifiedArrays (mesh->geom);
+    SCE_List_ForEach (it, arrays) {
+        SCE_SGeometryArray *array = SCE_List_GetData (it);
+        if (!SCE_Geometry_GetRoot (array) &&
+            SCE_Mesh_QuantizeArray (mesh, array, n_vertices) < 0)
+            goto fail;
+    }
+
+    SCE_List_ForEach (it, &mesh->arrays) {
+        SCE_SMeshArray *marray = SCE_List_GetData (it);
+        SCE_RDeleteVertexBufferDataArrays (&marray->data);
+        SCE_RClearVertexBufferData (&marray->data);
+        SCE_RInitVertexBufferData (&marray->data);
+        if (SCE_Mesh_AddVertexArrays (marray,
+                                      SCE_Geometry_GetUserArray (&marray->auser),
+                                      n_vertices) < 0)
+            goto fail;
+    }
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+/**
+ * \internal
+ * \brief Converts the 32 bits indices of the geometry of a mesh into 16 bits
+ * indices when its vertices can be addressed with them
+ */
+static int SCE_Mesh_ShrinkIndices (SCE_SMesh *mesh)
+{
+    SCE_SGeometryArray *index_array = NULL;
+    SCE_SGeometryArrayData *data = NULL;
+    SCE_RIndexArray ia;
+    SCEuint n_indices;
+    void *indices = NULL;
+
+    if (!mesh->geom || !mesh->auto_index ||
+        !(index_array = SCE_Geometry_GetIndexArray (mesh->geom)))
+        return SCE_OK;
+    data = SCE_Geometry_GetArrayData (index_array);
+    if (!data->data || data->type != SCE_UNSIGNED_INT ||
+        SCE_Mesh_SelectIndexType (mesh->n_vertices) != SCE_UNSIGNED_SHORT)
+        return SCE_OK;
+
+    n_indices = SCE_Geometry_GetNumIndices (mesh->geom);
+    if (!(indices = SCE_malloc (n_indices * sizeof (SCEushort))))
+        goto fail;
+    SCE_Mesh_ConvertIndices (data->data, SCE_UNSIGNED_INT, indices,
+                             SCE_UNSIGNED_SHORT, n_indices);
+    SCE_Geometry_SetArrayIndices (index_array, SCE_UNSIGNED_SHORT, indices,
+                                  SCE_TRUE);
+
+    ia.type = SCE_UNSIGNED_SHORT;
+    ia.data = indices;
+    SCE_RSetIndexBufferIndexArray (&mesh->ib, &ia);
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
 /**
  * \brief Builds a mesh by creating vertex buffers with requested usages
  * \sa SCE_Mesh_AutoBuild()
@@ -531,6 +912,14 @@ void SCE_Mesh_Build (SCE_SMesh *mesh, SCE_EMeshBuildMode bmode,
                                    consider an unbuilt mesh as built */
     /* SCE_Mesh_Unbuild (mesh); */
 
+    if (SCE_Mesh_Optimize (mesh) < 0)
+        SCEE_LogSrc ();         /* not fatal, just build it as is */
+    /* after the optimization passes, they need float positions */
+    if (SCE_Mesh_Quantize (mesh) < 0)
+        SCEE_LogSrc ();
+    if (SCE_Mesh_ShrinkIndices (mesh) < 0)
+        SCEE_LogSrc ();
+
     switch (bmode) {
     case SCE_INDEPENDANT_VERTEX_BUFFER:
         SCE_Mesh_MakeIndependantVB (mesh);
@@ -557,6 +946,76 @@ void SCE_Mesh_AutoBuild (SCE_SMesh *mesh)
     SCE_Mesh_Build (mesh, SCE_INDEPENDANT_VERTEX_BUFFER, NULL);
 }
 
+/**
+ * \brief Sets the optimization passes run by SCE_Mesh_Build()
+ * \param mesh a mesh
+ * \param flags passes, see SCE_MeshOpt_Optimize(), 0 disables them (default)
+ *
+ * The passes modify the geometry of the mesh in place, both its indices and
+ * the order of its vertices. Only indexed triangle lists are optimized.
+ * \sa SCE_Mesh_GetACMR()
+ */
+void SCE_Mesh_SetOptimization (SCE_SMesh *mesh, SCEbitfield flags)
+{
+    mesh->optimize = flags;
+}
+/**
+ * \brief Gets the ACMR of a mesh measured before and after the optimization
+ * passes of SCE_Mesh_Build()
+ * \sa SCE_Mesh_SetOptimization(), SCE_MeshOpt_ComputeACMR()
+ */
+void SCE_Mesh_GetACMR (const SCE_SMesh *mesh, float *before, float *after)
+{
+    if (before) *before = mesh->acmr[0];
+    if (after) *after = mesh->acmr[1];
+}
+
+/**
+ * \brief Sets the vertex data quantization done by SCE_Mesh_Build()
+ * \param mesh a mesh
+ * \param flags any combination of SCE_MESH_QUANTIZE_POSITION,
+ * SCE_MESH_QUANTIZE_NORMAL, SCE_MESH_QUANTIZE_NORMAL_PACKED and
+ * SCE_MESH_QUANTIZE_TEXCOORD, 0 disables it (default)
+ *
+ * Float positions are stored as normalized 16 bits integers, decoded with the
+ * scale and offset given by SCE_Mesh_GetPositionScale() and
+ * SCE_Mesh_GetPositionOffset(). Normals are octahedral encoded on 2x16 bits,
+ * or packed in 10-10-10-2 if SCE_MESH_QUANTIZE_NORMAL_PACKED is given or if
+ * they have 4 components. Quantized positions and normals are bound as
+ * SCE_IPOSITION and SCE_INORMAL (normalized integers). Tangents and
+ * binormals have no normalized semantic and stay in floats.
+ * Texture coordinates are stored as half floats. Shaders decode them with the
+ * functions added by SCE_Shader_AddQuantizationHelpers().
+ *
+ * The geometry of the mesh is modified in place, interleaved arrays are left
+ * untouched. Bounding volumes must be generated before the build.
+ * \sa SCE_Mesh_GetQuantization()
+ */
+void SCE_Mesh_SetQuantization (SCE_SMesh *mesh, SCEbitfield flags)
+{
+    mesh->quantize = flags;
+}
+SCEbitfield SCE_Mesh_GetQuantization (const SCE_SMesh *mesh)
+{
+    return mesh->quantize;
+}
+/**
+ * \brief Gets the scale to apply to quantized positions (3 floats)
+ * \sa SCE_Mesh_GetPositionOffset(), SCE_Mesh_SetQuantization()
+ */
+float* SCE_Mesh_GetPositionScale (SCE_SMesh *mesh)
+{
+    return mesh->pos_scale;
+}
+/**
+ * \brief Gets the offset to add to scaled quantized positions (3 floats)
+ * \sa SCE_Mesh_GetPositionScale(), SCE_Mesh_SetQuantization()
+ */
+float* SCE_Mesh_GetPositionOffset (SCE_SMesh *mesh)
+{
+    return mesh->pos_offset;
+}
+
 /**
  * \brief Sets the render mode of a mesh
  * \sa SCE_RSetVertexBufferRenderMode()
@@ -641,6 +1100,9 @@ size_t SCE_Mesh_GetUsedVRAM (const SCE_SMesh *mesh)
 int SCE_Mesh_ReallocStream (SCE_SMesh *mesh, SCE_EMeshStream s,
                             SCE_RBufferPool *pool)
 {
+    /* the buffer may change, the recorded bindings become invalid */
+    SCE_Mesh_Unbind ();
+    mesh->vao_version++;
     if (SCE_RReallocVertexBuffer (&mesh->streams[s], pool) < 0) {
         SCEE_LogSrc ();
         return SCE_ERROR;
@@ -649,6 +1111,8 @@ int SCE_Mesh_ReallocStream (SCE_SMesh *mesh, SCE_EMeshStream s,
 }
 int SCE_Mesh_ReallocIndexBuffer (SCE_SMesh *mesh, SCE_RBufferPool *pool)
 {
+    SCE_Mesh_Unbind ();
+    mesh->vao_version++;
     if (SCE_RReallocIndexBuffer (&mesh->ib, pool) < 0) {
         SCEE_LogSrc ();
         return SCE_ERROR;
@@ -663,8 +1127,150 @@ void SCE_Mesh_UploadVertices (SCE_SMesh *mesh, SCE_EMeshStream str,
 }
 void SCE_Mesh_UploadIndices (SCE_SMesh *mesh, const SCEindices *i, size_t s)
 {
+    /* binding an element array buffer would alter the bound VAO */
+    SCE_Mesh_Unbind ();
     SCE_RInstantIndexBufferUpdate (&mesh->ib, i, 0, s);
 }
+/**
+ * \brief Gets the smallest index type able to address \p n_vertices vertices
+ * \returns SCE_UNSIGNED_SHORT or SCE_UNSIGNED_INT
+ * \sa SCE_Mesh_AutoIndexType()
+ */
+SCEenum SCE_Mesh_SelectIndexType (SCEuint n_vertices)
+{
+    return n_vertices <= 65536 ? SCE_UNSIGNED_SHORT : SCE_UNSIGNED_INT;
+}
+/**
+ * \brief Sets the data type of the indices of a mesh
+ *
+ * It must be called before reallocating the index buffer of the mesh, since
+ * the size of the buffer depends on it.
+ * \sa SCE_Mesh_GetIndexType(), SCE_Mesh_AutoIndexType()
+ */
+void SCE_Mesh_SetIndexType (SCE_SMesh *mesh, SCEenum type)
+{
+    mesh->ib.ia.type = type;
+}
+SCEenum SCE_Mesh_GetIndexType (const SCE_SMesh *mesh)
+{
+    return mesh->ib.ia.type;
+}
+/**
+ * \brief Sets the index type of a mesh according to its number of vertices
+ * \sa SCE_Mesh_SelectIndexType(), SCE_Mesh_UploadIndicesFrom()
+ */
+void SCE_Mesh_AutoIndexType (SCE_SMesh *mesh)
+{
+    SCE_Mesh_SetIndexType (mesh, SCE_Mesh_SelectIndexType (mesh->n_vertices));
+}
+/**
+ * \brief Defines whether SCE_Mesh_Build() converts 32 bits indices of the
+ * geometry into 16 bits ones when possible (default is SCE_TRUE)
+ */
+void SCE_Mesh_SetAutoIndexType (SCE_SMesh *mesh, int enable)
+{
+    mesh->auto_index = enable;
+}
+
+/**
+ * \brief Gets the size in bytes of one index of the given type
+ */
+size_t SCE_Mesh_GetIndexTypeSize (SCEenum type)
+{
+    switch (type) {
+    case SCE_UNSIGNED_INT: return sizeof (SCEuint);
+    case SCE_UNSIGNED_SHORT: return sizeof (SCEushort);
+    default: return sizeof (SCEubyte);
+    }
+}
+/**
+ * \brief Converts indices from a data type to another
+ * \param src source indices
+ * \param stype type of \p src (SCE_UNSIGNED_BYTE, SHORT or INT)
+ * \param dst destination, can be \p src if the types have the same size
+ * \param dtype type of \p dst
+ * \param n number of indices to convert
+ *
+ * Narrowing conversions truncate the values.
+ */
+void SCE_Mesh_ConvertIndices (const void *src, SCEenum stype, void *dst,
+                              SCEenum dtype, SCEuint n)
+{
+    SCEuint i;
+
+/* unrolled so that the compiler can vectorize the loop */
+#define SCE_MESH_CONVERT(st, dt) do {                       \
+        const st *s = src;                                  \
+        dt *d = dst;                                        \
+        for (i = 0; i + 4 <= n; i += 4) {                   \
+            d[i] = (dt)s[i];                                \
+            d[i + 1] = (dt)s[i + 1];                        \
+            d[i + 2] = (dt)s[i + 2];                        \
+            d[i + 3] = (dt)s[i + 3];                        \
+        }                                                   \
+        for (; i < n; i++)                                  \
+            d[i] = (dt)s[i];                                \
+    } while (0)
+
+    if (stype == dtype) {
+        if (src != dst)
+            memmove (dst, src, n * SCE_Mesh_GetIndexTypeSize (stype));
+        return;
+    }
+
+    switch (stype) {
+    case SCE_UNSIGNED_INT:
+        if (dtype == SCE_UNSIGNED_SHORT)
+            SCE_MESH_CONVERT (SCEuint, SCEushort);
+        else
+            SCE_MESH_CONVERT (SCEuint, SCEubyte);
+        break;
+    case SCE_UNSIGNED_SHORT:
+        if (dtype == SCE_UNSIGNED_INT)
+            SCE_MESH_CONVERT (SCEushort, SCEuint);
+        else
+            SCE_MESH_CONVERT (SCEushort, SCEubyte);
+        break;
+    default:
+        if (dtype == SCE_UNSIGNED_INT)
+            SCE_MESH_CONVERT (SCEubyte, SCEuint);
+        else
+            SCE_MESH_CONVERT (SCEubyte, SCEushort);
+    }
+#undef SCE_MESH_CONVERT
+}
+/**
+ * \brief Uploads indices of any type into the index buffer of a mesh,
+ * converting them to the index type of the mesh
+ * \param mesh a mesh
+ * \param indices indices to upload
+ * \param type data type of \p indices
+ * \param n number of indices
+ * \sa SCE_Mesh_UploadIndices(), SCE_Mesh_AutoIndexType()
+ */
+int SCE_Mesh_UploadIndicesFrom (SCE_SMesh *mesh, const void *indices,
+                                SCEenum type, SCEuint n)
+{
+    SCEenum itype = SCE_Mesh_GetIndexType (mesh);
+    size_t size = n * SCE_Mesh_GetIndexTypeSize (itype);
+
+    if (itype == type) {
+        SCE_Mesh_UploadIndices (mesh, indices, size);
+        return SCE_OK;
+    }
+    if (size > index_scratch_size) {
+        void *p = NULL;
+        if (!(p = SCE_realloc (index_scratch, size))) {
+            SCEE_LogSrc ();
+            return SCE_ERROR;
+        }
+        index_scratch = p;
+        index_scratch_size = size;
+    }
+    SCE_Mesh_ConvertIndices (indices, type, index_scratch, itype, n);
+    SCE_Mesh_UploadIndices (mesh, index_scratch, size);
+    return SCE_OK;
+}
 void SCE_Mesh_DownloadVertices (SCE_SMesh *mesh, SCE_EMeshStream str,
                                 SCEvertices *v, size_t first, size_t s)
 {
@@ -672,6 +1278,7 @@ void SCE_Mesh_DownloadVertices (SCE_SMesh *mesh, SCE_EMeshStream str,
 }
 void SCE_Mesh_DownloadIndices (SCE_SMesh *mesh, SCEindices *i, size_t s)
 {
+    SCE_Mesh_Unbind ();
     SCE_RInstantIndexBufferFetch (&mesh->ib, i, 0, s);
 }
 void SCE_Mesh_DownloadAllVertices (SCE_SMesh *mesh, SCE_EMeshStream str,
@@ -683,30 +1290,94 @@ void SCE_Mesh_DownloadAllVertices (SCE_SMesh *mesh, SCE_EMeshStream str,
 void SCE_Mesh_DownloadAllIndices (SCE_SMesh *mesh, SCEindices *i)
 {
     size_t size = SCE_RGetIndexBufferSize (&mesh->ib);
+    SCE_Mesh_Unbind ();
     SCE_RInstantIndexBufferFetch (&mesh->ib, i, 0, size);
 }
 
 
-/**
- * \brief Declares a mesh as activated for rendering
- * \sa SCE_Mesh_Render(), SCE_Mesh_RenderInstanced(), SCE_Mesh_Unuse()
- * \todo Geometry cannot updates its number of vertices nor indices.
- */
-void SCE_Mesh_Use (SCE_SMesh *mesh)
+static void SCE_Mesh_SetRenderFuncs (SCE_SMesh *mesh)
 {
-    size_t i;
-    for (i = 0; i < SCE_MESH_NUM_STREAMS; i++) {
-        if (activated_streams[i] && mesh->used_streams[i])
-            SCE_RUseVertexBuffer (&mesh->streams[i]);
-    }
     if (mesh->use_ib) {
-        SCE_RUseIndexBuffer (&mesh->ib);
         render_func = SCE_RRenderVertexBufferIndexed;
         render_func_instanced = SCE_RRenderVertexBufferIndexedInstanced;
     } else {
         render_func = SCE_RRenderVertexBuffer;
         render_func_instanced = SCE_RRenderVertexBufferInstanced;
     }
+}
+static void SCE_Mesh_BindStreams (SCE_SMesh *mesh)
+{
+    size_t i;
+    for (i = 0; i < SCE_MESH_NUM_STREAMS; i++) {
+        if (activated_streams[i] && mesh->used_streams[i])
+            SCE_RUseVertexBuffer (&mesh->streams[i]);
+    }
+    if (mesh->use_ib)
+        SCE_RUseIndexBuffer (&mesh->ib);
+}
+/* bindings a mesh needs with the current activated streams */
+static int SCE_Mesh_GetBoundStreams (const SCE_SMesh *mesh)
+{
+    size_t i;
+    int streams = mesh->use_ib ? 1 << SCE_MESH_NUM_STREAMS : 0;
+    for (i = 0; i < SCE_MESH_NUM_STREAMS; i++) {
+        if (activated_streams[i] && mesh->used_streams[i])
+            streams |= 1 << i;
+    }
+    return streams;
+}
+/* gets the VAO of a mesh recording the bindings \p streams, a new one
+   is created when none does. a VAO recording other bindings is never
+   reused as is: the arrays it enabled would remain enabled */
+static int SCE_Mesh_GetVAO (SCE_SMesh *mesh, int streams)
+{
+    int i;
+
+    for (i = 0; i < SCE_MESH_MAX_VAOS; i++) {
+        if (mesh->vaos[i] && mesh->vao_streams[i] == streams)
+            return i;
+    }
+    for (i = 0; i < SCE_MESH_MAX_VAOS && mesh->vaos[i]; i++)
+        ;
+    if (i == SCE_MESH_MAX_VAOS) {
+        /* all of them are used, replace one */
+        i = mesh->next_vao;
+        mesh->next_vao = (mesh->next_vao + 1) % SCE_MESH_MAX_VAOS;
+        SCE_GPU_DeleteVertexArray (mesh->vaos[i]);
+    }
+    mesh->vaos[i] = SCE_GPU_CreateVertexArray ();
+    mesh->vao_streams[i] = streams;
+    mesh->vao_versions[i] = 0;
+    return i;
+}
+/**
+ * \brief Declares a mesh as activated for rendering
+ *
+ * If the mesh can use vertex array objects, it keeps one per set of
+ * activated streams: the bindings are recorded the first time and only
+ * the VAO is bound afterwards. It is unbound by SCE_Mesh_Unuse().
+ * \sa SCE_Mesh_Render(), SCE_Mesh_RenderInstanced(), SCE_Mesh_Unuse(),
+ * SCE_Mesh_GetNumAvoidedBinds()
+ * \todo Geometry cannot updates its number of vertices nor indices.
+ */
+void SCE_Mesh_Use (SCE_SMesh *mesh)
+{
+    int i;
+
+    SCE_Mesh_Unbind ();
+    if (!mesh->use_vao)
+        SCE_Mesh_BindStreams (mesh);
+    else {
+        i = SCE_Mesh_GetVAO (mesh, SCE_Mesh_GetBoundStreams (mesh));
+        SCE_GPU_UseVertexArray (mesh->vaos[i]);
+        vao_bound = mesh;
+        if (mesh->vao_versions[i] != mesh->vao_version) {
+            SCE_Mesh_BindStreams (mesh);
+            mesh->vao_versions[i] = mesh->vao_version;
+        } else
+            n_avoided_binds++;
+    }
+    SCE_Mesh_SetRenderFuncs (mesh);
     mesh_bound = mesh;
 }
 /**
@@ -742,10 +1413,42 @@ void SCE_Mesh_RenderInstanced (SCEuint n_instances)
  */
 void SCE_Mesh_Unuse (void)
 {
-    if (SCE_TRUE/*non_full_gl3*/)
+    /* a VAO keeps its arrays enabled, unbinding it is enough */
+    if (vao_bound)
+        SCE_Mesh_Unbind ();
+    else
         SCE_RFinishVertexBufferRender ();
     mesh_bound = NULL;
 }
+/**
+ * \brief Unbinds the vertex array object of the mesh being used, if any
+ *
+ * Call it before binding vertex or index buffers yourself between
+ * SCE_Mesh_Use() and SCE_Mesh_Unuse(), otherwise you would modify the
+ * bindings recorded in the VAO of the mesh.
+ * \sa SCE_Mesh_Use()
+ */
+void SCE_Mesh_Unbind (void)
+{
+    if (vao_bound) {
+        SCE_GPU_UseVertexArray (0);
+        vao_bound = NULL;
+    }
+}
+
+/**
+ * \brief Gets the number of calls to SCE_Mesh_Use() which did not bind
+ * the buffers of the mesh because its VAO had them recorded already
+ * \sa SCE_Mesh_ResetNumAvoidedBinds()
+ */
+SCEuint SCE_Mesh_GetNumAvoidedBinds (void)
+{
+    return n_avoided_binds;
+}
+void SCE_Mesh_ResetNumAvoidedBinds (void)
+{
+    n_avoided_binds = 0;
+}
 
 
 void SCE_Mesh_BeginRenderTo (SCE_SMesh *mesh)
@@ -783,3 +1486,59 @@ void SCE_Mesh_EndRenderToIndices (SCE_SMesh *mesh)
     }
     feedback_target_id = NULL;
 }
+
+/**
+ * \brief Ends a rendering started with SCE_Mesh_BeginRenderTo() without
+ * reading the amount of generated vertices back
+ *
+ * Reading the amount of primitives written by a feedback waits for the GPU
+ * to complete the rendering, several feedbacks can be ended with this
+ * function and resolved later with SCE_Mesh_ResolveRenderTo() in order to
+ * wait only once.
+ * \sa SCE_Mesh_EndRenderTo(), SCE_Mesh_ResolveRenderTo()
+ */
+void SCE_Mesh_StopRenderTo (SCE_SMesh *mesh)
+{
+    if (feedback_enabled) {
+        SCE_REndFeedback (&mesh->feedback);
+        mesh->feedback_pending = SCE_TRUE;
+        feedback_enabled = SCE_FALSE;
+    }
+    feedback_target = NULL;
+}
+/**
+ * \brief Same as SCE_Mesh_StopRenderTo() for SCE_Mesh_BeginRenderToIndices()
+ */
+void SCE_Mesh_StopRenderToIndices (SCE_SMesh *mesh)
+{
+    if (feedback_enabled_id) {
+        SCE_REndFeedback (&mesh->feedback_id);
+        mesh->feedback_pending_id = SCE_TRUE;
+        feedback_enabled_id = SCE_FALSE;
+    }
+    feedback_target_id = NULL;
+}
+/**
+ * \brief Reads back the amounts of vertices and indices generated by the
+ * feedbacks ended with SCE_Mesh_StopRenderTo() and
+ * SCE_Mesh_StopRenderToIndices()
+ */
+void SCE_Mesh_ResolveRenderTo (SCE_SMesh *mesh)
+{
+    SCEuint n_prim;
+
+    if (mesh->feedback_pending) {
+        n_prim = SCE_RGetFeedbackNumPrimitives (&mesh->feedback,
+                                                mesh->counting_buffer);
+        SCE_Mesh_SetNumVertices (
+            mesh, n_prim * SCE_Geometry_GetPrimitiveVertices (mesh->prim));
+        mesh->feedback_pending = SCE_FALSE;
+    }
+    if (mesh->feedback_pending_id) {
+        n_prim = SCE_RGetFeedbackNumPrimitives (&mesh->feedback_id,
+                                                mesh->counting_buffer_id);
+        SCE_Mesh_SetNumIndices (
+            mesh, n_prim * SCE_Geometry_GetPrimitiveVertices (mesh->prim));
+        mesh->feedback_pending_id = SCE_FALSE;
+    }
+}
@@ -0,0 +1,829 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#include <string.h>
+#include <SCE/utils/SCEUtils.h>
+#include <SCE/core/SCECore.h>
+#include <SCE/renderer/SCERenderer.h>
+#include "SCE/interface/SCEGPU.h"
+#include "SCE/interface/SCEMeshArena.h"
+
+/**
+ * \file SCEMeshArena.c
+ * \brief Sub-allocation of the shared buffers of a mesh batch
+ *
+ * The vertex and index buffers are allocated once by SCE_MeshArena_Setup(),
+ * then ranges of vertices and indices are handed out by two TLSF style
+ * allocators (two-level segregated fit: free blocks are sorted into lists by
+ * size class, found in constant time with two levels of bitmaps and merged
+ * with their free neighbours when released). Meshes can thus be regenerated
+ * with a different number of vertices without reallocating any GL buffer.
+ * SCE_MeshArena_Defragment() moves a few allocations towards the beginning
+ * of the buffers at each call. Copies and moves stay on the GPU when
+ * buffers can be copied there, see SCE_GPU_CopyBuffer().
+ *
+ * When the draw calls can't take a base vertex, the indices are stored
+ * rebased on the first vertex of their allocation and rebased again when
+ * its vertices are moved, the vertices of an allocation must then lie in
+ * the range of the index type of the arena.
+ */
+
+/* index of the most significant bit, n > 0 */
+static int SCE_MeshArena_MSB (SCEuint n)
+{
+    int b = 0;
+    while (n >>= 1)
+        b++;
+    return b;
+}
+/* index of the least significant bit, n > 0 */
+static int SCE_MeshArena_LSB (SCEuint n)
+{
+    int b = 0;
+    while (!(n & 1)) {
+        n >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void SCE_MeshArena_Mapping (SCEuint size, int *fl, int *sl)
+{
+    if (size < SCE_MESHARENA_SL_COUNT) {
+        *fl = 0;
+        *sl = size;
+    } else {
+        int f = SCE_MeshArena_MSB (size);
+        *sl = (size >> (f - SCE_MESHARENA_SL_LOG2)) ^ SCE_MESHARENA_SL_COUNT;
+        *fl = f - SCE_MESHARENA_SL_LOG2 + 1;
+    }
+}
+
+
+static void SCE_MeshArena_InitHeap (SCE_SMeshArenaHeap *heap)
+{
+    size_t i, j;
+    heap->size = heap->used = 0;
+    heap->fl_bitmap = 0;
+    for (i = 0; i < SCE_MESHARENA_FL_COUNT; i++) {
+        heap->sl_bitmap[i] = 0;
+        for (j = 0; j < SCE_MESHARENA_SL_COUNT; j++)
+            heap->free[i][j] = NULL;
+    }
+    heap->first = NULL;
+    heap->n_blocks = heap->n_free_blocks = 0;
+}
+static void SCE_MeshArena_ClearHeap (SCE_SMeshArenaHeap *heap)
+{
+    SCE_SMeshArenaBlock *b = heap->first, *next = NULL;
+    while (b) {
+        next = b->next;
+        SCE_free (b);
+        b = next;
+    }
+    SCE_MeshArena_InitHeap (heap);
+}
+
+static void SCE_MeshArena_InsertFree (SCE_SMeshArenaHeap *heap,
+                                      SCE_SMeshArenaBlock *b)
+{
+    int fl, sl;
+    SCE_MeshArena_Mapping (b->size, &fl, &sl);
+    b->free = SCE_TRUE;
+    b->owner = NULL;
+    b->prev_free = NULL;
+    b->next_free = heap->free[fl][sl];
+    if (b->next_free)
+        b->next_free->prev_free = b;
+    heap->free[fl][sl] = b;
+    heap->fl_bitmap |= 1u << fl;
+    heap->sl_bitmap[fl] |= 1u << sl;
+    heap->n_free_blocks++;
+}
+static void SCE_MeshArena_RemoveFree (SCE_SMeshArenaHeap *heap,
+                                      SCE_SMeshArenaBlock *b)
+{
+    int fl, sl;
+    SCE_MeshArena_Mapping (b->size, &fl, &sl);
+    if (b->next_free)
+        b->next_free->prev_free = b->prev_free;
+    if (b->prev_free)
+        b->prev_free->next_free = b->next_free;
+    else {
+        heap->free[fl][sl] = b->next_free;
+        if (!heap->free[fl][sl]) {
+            heap->sl_bitmap[fl] &= ~(1u << sl);
+            if (!heap->sl_bitmap[fl])
+                heap->fl_bitmap &= ~(1u << fl);
+        }
+    }
+    b->free = SCE_FALSE;
+    b->prev_free = b->next_free = NULL;
+    heap->n_free_blocks--;
+}
+
+static SCE_SMeshArenaBlock* SCE_MeshArena_NewBlock (SCEuint offset,
+                                                    SCEuint size)
+{
+    SCE_SMeshArenaBlock *b = NULL;
+    if (!(b = SCE_malloc (sizeof *b)))
+        SCEE_LogSrc ();
+    else {
+        b->offset = offset;
+        b->size = size;
+        b->free = SCE_FALSE;
+        b->owner = NULL;
+        b->prev = b->next = NULL;
+        b->prev_free = b->next_free = NULL;
+    }
+    return b;
+}
+
+static int SCE_MeshArena_SetupHeap (SCE_SMeshArenaHeap *heap, SCEuint size)
+{
+    SCE_MeshArena_ClearHeap (heap);
+    heap->size = size;
+    if (!size)
+        return SCE_OK;
+    if (!(heap->first = SCE_MeshArena_NewBlock (0, size))) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    heap->n_blocks = 1;
+    SCE_MeshArena_InsertFree (heap, heap->first);
+    return SCE_OK;
+}
+
+/* finds a free block of at least size elements, in constant time */
+static SCE_SMeshArenaBlock*
+SCE_MeshArena_FindFree (SCE_SMeshArenaHeap *heap, SCEuint size)
+{
+    int fl, sl;
+    SCEuint map;
+
+    /* round up to the next size class, so that any block of the class
+       found is large enough */
+    if (size >= SCE_MESHARENA_SL_COUNT)
+        size += (1u << (SCE_MeshArena_MSB (size) - SCE_MESHARENA_SL_LOG2)) - 1;
+    SCE_MeshArena_Mapping (size, &fl, &sl);
+    if (fl >= SCE_MESHARENA_FL_COUNT)
+        return NULL;
+
+    map = heap->sl_bitmap[fl] & (~0u << sl);
+    if (!map) {
+        if (fl + 1 >= SCE_MESHARENA_FL_COUNT)
+            return NULL;
+        map = heap->fl_bitmap & (~0u << (fl + 1));
+        if (!map)
+            return NULL;
+        fl = SCE_MeshArena_LSB (map);
+        map = heap->sl_bitmap[fl];
+    }
+    sl = SCE_MeshArena_LSB (map);
+    return heap->free[fl][sl];
+}
+
+static SCE_SMeshArenaBlock*
+SCE_MeshArena_HeapAlloc (SCE_SMeshArenaHeap *heap, SCEuint size, void *owner)
+{
+    SCE_SMeshArenaBlock *b = NULL, *rest = NULL;
+
+    if (!size || !(b = SCE_MeshArena_FindFree (heap, size)))
+        return NULL;
+    SCE_MeshArena_RemoveFree (heap, b);
+
+    /* split, the remainder stays free */
+    if (b->size > size) {
+        if (!(rest = SCE_MeshArena_NewBlock (b->offset + size,
+                                             b->size - size))) {
+            SCE_MeshArena_InsertFree (heap, b);
+            SCEE_LogSrc ();
+            return NULL;
+        }
+        rest->prev = b;
+        rest->next = b->next;
+        if (b->next)
+            b->next->prev = rest;
+        b->next = rest;
+        b->size = size;
+        heap->n_blocks++;
+        SCE_MeshArena_InsertFree (heap, rest);
+    }
+    b->owner = owner;
+    heap->used += b->size;
+    return b;
+}
+
+/* merges b into its lower neighbour a, b is freed */
+static void SCE_MeshArena_Merge (SCE_SMeshArenaHeap *heap,
+                                 SCE_SMeshArenaBlock *a,
+                                 SCE_SMeshArenaBlock *b)
+{
+    a->size += b->size;
+    a->next = b->next;
+    if (b->next)
+        b->next->prev = a;
+    SCE_free (b);
+    heap->n_blocks--;
+}
+
+static void SCE_MeshArena_HeapFree (SCE_SMeshArenaHeap *heap,
+                                    SCE_SMeshArenaBlock *b)
+{
+    heap->used -= b->size;
+    if (b->next && b->next->free) {
+        SCE_MeshArena_RemoveFree (heap, b->next);
+        SCE_MeshArena_Merge (heap, b, b->next);
+    }
+    if (b->prev && b->prev->free) {
+        SCE_SMeshArenaBlock *a = b->prev;
+        SCE_MeshArena_RemoveFree (heap, a);
+        SCE_MeshArena_Merge (heap, a, b);
+        b = a;
+    }
+    SCE_MeshArena_InsertFree (heap, b);
+}
+
+static float SCE_MeshArena_HeapOccupancy (const SCE_SMeshArenaHeap *heap)
+{
+    return heap->size ? (float)heap->used / heap->size : 0.0f;
+}
+/* 0 when all the free space is contiguous, close to 1 when it is
+   scattered into many small blocks */
+static float SCE_MeshArena_HeapFragmentation (const SCE_SMeshArenaHeap *heap)
+{
+    SCE_SMeshArenaBlock *b = NULL;
+    SCEuint largest = 0, total = 0;
+
+    for (b = heap->first; b; b = b->next) {
+        if (b->free) {
+            total += b->size;
+            largest = MAX (largest, b->size);
+        }
+    }
+    return total ? 1.0f - (float)largest / total : 0.0f;
+}
+
+
+void SCE_MeshArena_InitAlloc (SCE_SMeshArenaAlloc *alloc)
+{
+    alloc->vblock = alloc->iblock = NULL;
+    SCE_MeshBatch_InitEntry (&alloc->entry);
+}
+
+void SCE_MeshArena_Init (SCE_SMeshArena *arena)
+{
+    SCE_MeshBatch_Init (&arena->batch);
+    SCE_MeshArena_InitHeap (&arena->vertices);
+    SCE_MeshArena_InitHeap (&arena->indices);
+    arena->n_allocs = 0;
+    arena->n_moves = 0;
+    arena->n_failures = 0;
+    arena->scratch = NULL;
+    arena->scratch_size = 0;
+}
+void SCE_MeshArena_Clear (SCE_SMeshArena *arena)
+{
+    SCE_MeshArena_ClearHeap (&arena->vertices);
+    SCE_MeshArena_ClearHeap (&arena->indices);
+    SCE_MeshBatch_Clear (&arena->batch);
+    SCE_free (arena->scratch);
+}
+SCE_SMeshArena* SCE_MeshArena_Create (void)
+{
+    SCE_SMeshArena *arena = NULL;
+    if (!(arena = SCE_malloc (sizeof *arena)))
+        SCEE_LogSrc ();
+    else
+        SCE_MeshArena_Init (arena);
+    return arena;
+}
+void SCE_MeshArena_Delete (SCE_SMeshArena *arena)
+{
+    if (arena) {
+        SCE_MeshArena_Clear (arena);
+        SCE_free (arena);
+    }
+}
+
+/**
+ * \brief Allocates the shared buffers of an arena
+ * \param arena an arena
+ * \param layout geometry describing the vertex layout and the index type of
+ * the meshes, its data are not read
+ * \param max_vertices,max_indices capacity of the buffers
+ * \returns SCE_ERROR on error, SCE_OK otherwise
+ * \sa SCE_MeshBatch_Setup(), SCE_MeshArena_Alloc()
+ */
+int SCE_MeshArena_Setup (SCE_SMeshArena *arena, SCE_SGeometry *layout,
+                         SCEuint max_vertices, SCEuint max_indices)
+{
+    if (SCE_MeshBatch_Setup (&arena->batch, layout, max_vertices,
+                             max_indices) < 0)
+        goto fail;
+    if (SCE_MeshArena_SetupHeap (&arena->vertices, max_vertices) < 0)
+        goto fail;
+    if (SCE_MeshArena_SetupHeap (&arena->indices, max_indices) < 0)
+        goto fail;
+    arena->n_allocs = 0;
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+/**
+ * \brief Gets the batch holding the buffers of an arena, use it to render
+ * the allocations
+ * \sa SCE_MeshArena_GetEntry(), SCE_MeshBatch_Draw()
+ */
+SCE_SMeshBatch* SCE_MeshArena_GetBatch (SCE_SMeshArena *arena)
+{
+    return &arena->batch;
+}
+
+/**
+ * \brief Allocates room for a mesh in an arena
+ * \param arena an arena
+ * \param alloc an initialized allocation, must not be already allocated
+ * \param n_vertices,n_indices size of the mesh
+ * \returns SCE_ERROR if the arena is full, SCE_OK otherwise
+ * \sa SCE_MeshArena_Free(), SCE_MeshArena_Realloc()
+ */
+int SCE_MeshArena_Alloc (SCE_SMeshArena *arena, SCE_SMeshArenaAlloc *alloc,
+                         SCEuint n_vertices, SCEuint n_indices)
+{
+    int out_of_range = SCE_FALSE;
+
+    alloc->vblock = SCE_MeshArena_HeapAlloc (&arena->vertices, n_vertices,
+                                             alloc);
+    alloc->iblock = SCE_MeshArena_HeapAlloc (&arena->indices, n_indices,
+                                             alloc);
+    /* the rebased indices must fit in the index type */
+    if (alloc->vblock && !SCE_MeshBatch_HasBaseVertex ()) {
+        SCEenum type = SCE_Mesh_GetIndexType (&arena->batch.mesh);
+        out_of_range = (alloc->vblock->offset + n_vertices - 1 >
+                        SCE_MeshBatch_MaxIndex (type));
+    }
+    if ((n_vertices && !alloc->vblock) || (n_indices && !alloc->iblock) ||
+        out_of_range) {
+        if (alloc->vblock)
+            SCE_MeshArena_HeapFree (&arena->vertices, alloc->vblock);
+        if (alloc->iblock)
+            SCE_MeshArena_HeapFree (&arena->indices, alloc->iblock);
+        SCE_MeshArena_InitAlloc (alloc);
+        arena->n_failures++;
+        SCEE_Log (SCE_INVALID_OPERATION);
+        SCEE_LogMsg ("mesh arena is full (%u vertices, %u indices requested)",
+                     n_vertices, n_indices);
+        return SCE_ERROR;
+    }
+    alloc->entry.first_vertex = alloc->vblock ? alloc->vblock->offset : 0;
+    alloc->entry.n_vertices = n_vertices;
+    alloc->entry.first_index = alloc->iblock ? alloc->iblock->offset : 0;
+    alloc->entry.n_indices = n_indices;
+    if (SCE_MeshArena_IsAllocated (alloc))
+        arena->n_allocs++;
+    return SCE_OK;
+}
+/**
+ * \brief Releases the vertices and indices of an allocation
+ */
+void SCE_MeshArena_Free (SCE_SMeshArena *arena, SCE_SMeshArenaAlloc *alloc)
+{
+    if (alloc->vblock || alloc->iblock) {
+        if (alloc->vblock)
+            SCE_MeshArena_HeapFree (&arena->vertices, alloc->vblock);
+        if (alloc->iblock)
+            SCE_MeshArena_HeapFree (&arena->indices, alloc->iblock);
+        arena->n_allocs--;
+    }
+    SCE_MeshArena_InitAlloc (alloc);
+}
+/**
+ * \brief Resizes an allocation
+ *
+ * The allocation is kept in place when its blocks are large enough, so
+ * shrinking a mesh is free. Data are not preserved, upload the new mesh
+ * afterwards. The new blocks are taken before the old ones are released,
+ * so that a failed reallocation leaves \p alloc and its data untouched.
+ * \returns SCE_ERROR if the arena is full, SCE_OK otherwise
+ * \sa SCE_MeshArena_Defragment()
+ */
+int SCE_MeshArena_Realloc (SCE_SMeshArena *arena, SCE_SMeshArenaAlloc *alloc,
+                           SCEuint n_vertices, SCEuint n_indices)
+{
+    SCEuint vcap = alloc->vblock ? alloc->vblock->size : 0;
+    SCEuint icap = alloc->iblock ? alloc->iblock->size : 0;
+    SCE_SMeshArenaAlloc tmp;
+
+    /* keep the blocks unless they are way too large */
+    if (SCE_MeshArena_IsAllocated (alloc) &&
+        n_vertices <= vcap && n_vertices >= vcap / 4 &&
+        n_indices <= icap && n_indices >= icap / 4) {
+        alloc->entry.n_vertices = n_vertices;
+        alloc->entry.n_indices = n_indices;
+        return SCE_OK;
+    }
+    SCE_MeshArena_InitAlloc (&tmp);
+    if (SCE_MeshArena_Alloc (arena, &tmp, n_vertices, n_indices) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    SCE_MeshArena_Free (arena, alloc);
+    *alloc = tmp;
+    if (alloc->vblock)
+        alloc->vblock->owner = alloc;
+    if (alloc->iblock)
+        alloc->iblock->owner = alloc;
+    return SCE_OK;
+}
+int SCE_MeshArena_IsAllocated (const SCE_SMeshArenaAlloc *alloc)
+{
+    return (alloc->vblock || alloc->iblock);
+}
+
+/* copies vertices of a stream between two meshes (or within one), offsets
+   and size in bytes */
+static void SCE_MeshArena_CopyVertices (SCE_SMesh *dst, size_t dst_offset,
+                                        SCE_SMesh *src, size_t src_offset,
+                                        SCE_EMeshStream s, size_t size)
+{
+    SCE_RBuffer *d = SCE_RGetVertexBufferBuffer (SCE_Mesh_GetStream (dst, s));
+    SCE_RBuffer *r = SCE_RGetVertexBufferBuffer (SCE_Mesh_GetStream (src, s));
+    SCE_GPU_CopyBuffer (d, dst_offset, r, src_offset, size);
+}
+/* same as SCE_MeshArena_CopyVertices() for the indices */
+static void SCE_MeshArena_CopyIndices (SCE_SMesh *dst, size_t dst_offset,
+                                       SCE_SMesh *src, size_t src_offset,
+                                       size_t size)
+{
+    SCE_RBuffer *d = SCE_RGetIndexBufferBuffer (SCE_Mesh_GetIndexBuffer (dst));
+    SCE_RBuffer *r = SCE_RGetIndexBufferBuffer (SCE_Mesh_GetIndexBuffer (src));
+    SCE_GPU_CopyBuffer (d, dst_offset, r, src_offset, size);
+}
+
+static void* SCE_MeshArena_GetScratch (SCE_SMeshArena *arena, size_t size)
+{
+    if (size > arena->scratch_size) {
+        void *p = NULL;
+        if (!(p = SCE_realloc (arena->scratch, size))) {
+            SCEE_LogSrc ();
+            return NULL;
+        }
+        arena->scratch = p;
+        arena->scratch_size = size;
+    }
+    return arena->scratch;
+}
+
+/**
+ * \brief Uploads the vertices of a stream of an allocation
+ * \param data as many vertices as given to SCE_MeshArena_Alloc()
+ */
+void SCE_MeshArena_UploadVertices (SCE_SMeshArena *arena,
+                                   SCE_SMeshArenaAlloc *alloc,
+                                   SCE_EMeshStream s, const void *data)
+{
+    size_t size = arena->batch.vertex_size[s];
+    if (!alloc->vblock || !alloc->entry.n_vertices)
+        return;
+    SCE_Mesh_UploadVertices (&arena->batch.mesh, s, data,
+                             size * alloc->vblock->offset,
+                             size * alloc->entry.n_vertices);
+}
+/**
+ * \brief Uploads the indices of an allocation
+ * \param indices as many indices as given to SCE_MeshArena_Alloc(), relative
+ * to the first vertex of the allocation
+ * \param type data type of \p indices, they are converted to the index type
+ * of the arena if needed
+ * \returns SCE_ERROR on memory allocation failure, SCE_OK otherwise
+ *
+ * Without base vertex support the indices are rebased on the first vertex
+ * of the allocation, upload them again after reallocating the vertices.
+ */
+int SCE_MeshArena_UploadIndices (SCE_SMeshArena *arena,
+                                 SCE_SMeshArenaAlloc *alloc,
+                                 const void *indices, SCEenum type)
+{
+    SCE_SMesh *mesh = &arena->batch.mesh;
+    SCEenum itype = SCE_Mesh_GetIndexType (mesh);
+    size_t size = arena->batch.index_size * alloc->entry.n_indices;
+    int rebase = (!SCE_MeshBatch_HasBaseVertex () && alloc->vblock &&
+                  alloc->vblock->offset);
+
+    if (!alloc->iblock || !alloc->entry.n_indices)
+        return SCE_OK;
+    if (type != itype || rebase) {
+        void *p = NULL;
+        if (!(p = SCE_MeshArena_GetScratch (arena, size))) {
+            SCEE_LogSrc ();
+            return SCE_ERROR;
+        }
+        if (type != itype)
+            SCE_Mesh_ConvertIndices (indices, type, p, itype,
+                                     alloc->entry.n_indices);
+        else
+            memcpy (p, indices, size);
+        if (rebase)
+            SCE_MeshBatch_RebaseIndices (p, itype, alloc->entry.n_indices,
+                                         alloc->vblock->offset);
+        indices = p;
+    }
+    SCE_Mesh_Unbind ();
+    SCE_RInstantIndexBufferUpdate (&mesh->ib, indices,
+                                   arena->batch.index_size *
+                                   alloc->iblock->offset, size);
+    return SCE_OK;
+}
+/**
+ * \brief Copies the vertices and indices of a mesh into an allocation,
+ * resizing it as needed
+ * \param arena an arena
+ * \param alloc an initialized allocation
+ * \param mesh a mesh with the vertex layout of the arena, its indices can
+ * be of any type
+ * \returns SCE_ERROR on error (arena full), SCE_OK otherwise
+ *
+ * The data are copied on the GPU when possible, the indices go through
+ * client memory only when they have to be converted or rebased.
+ * \sa SCE_MeshArena_Realloc(), SCE_MeshBatch_AddMesh()
+ */
+int SCE_MeshArena_CopyMesh (SCE_SMeshArena *arena, SCE_SMeshArenaAlloc *alloc,
+                            SCE_SMesh *mesh)
+{
+    size_t i, size, isize;
+    void *data = NULL;
+    SCE_SMesh *amesh = &arena->batch.mesh;
+    SCEuint n_vertices = SCE_Mesh_GetNumVertices (mesh);
+    SCEuint n_indices = SCE_Mesh_GetNumIndices (mesh);
+    SCEenum type = SCE_Mesh_GetIndexType (mesh);
+    int gpu = SCE_GPU_HasCopyBuffer ();
+
+    if (SCE_MeshArena_Realloc (arena, alloc, n_vertices, n_indices) < 0)
+        goto fail;
+
+    if (gpu && alloc->vblock) {
+        for (i = 0; i < SCE_MESH_NUM_STREAMS; i++) {
+            size_t s = arena->batch.vertex_size[i];
+            if (amesh->used_streams[i])
+                SCE_MeshArena_CopyVertices (amesh, s * alloc->vblock->offset,
+                                            mesh, 0, i, s * n_vertices);
+        }
+    }
+    /* indices of the arena type that need no rebasing */
+    if (gpu && (!alloc->iblock || (type == SCE_Mesh_GetIndexType (amesh) &&
+                                   (SCE_MeshBatch_HasBaseVertex () ||
+                                    !alloc->vblock ||
+                                    !alloc->vblock->offset)))) {
+        if (alloc->iblock)
+            SCE_MeshArena_CopyIndices (amesh, arena->batch.index_size *
+                                       alloc->iblock->offset, mesh, 0,
+                                       arena->batch.index_size * n_indices);
+        return SCE_OK;
+    }
+
+    isize = SCE_Mesh_GetIndexTypeSize (type) * n_indices;
+    size = MAX (isize, arena->batch.index_size * n_indices);
+    for (i = 0; !gpu && i < SCE_MESH_NUM_STREAMS; i++)
+        size = MAX (size, arena->batch.vertex_size[i] * n_vertices);
+    /* the scratch is also used by UploadIndices() for the conversion,
+       keep the downloaded indices after its first bytes */
+    if (!(data = SCE_MeshArena_GetScratch (arena, size + isize)))
+        goto fail;
+
+    for (i = 0; !gpu && i < SCE_MESH_NUM_STREAMS; i++) {
+        if (!amesh->used_streams[i])
+            continue;
+        SCE_Mesh_DownloadVertices (mesh, i, data, 0,
+                                   arena->batch.vertex_size[i] * n_vertices);
+        SCE_MeshArena_UploadVertices (arena, alloc, i, data);
+    }
+    data = &((unsigned char*)arena->scratch)[size];
+    SCE_Mesh_DownloadIndices (mesh, data, isize);
+    if (SCE_MeshArena_UploadIndices (arena, alloc, data, type) < 0)
+        goto fail;
+
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+/**
+ * \brief Gets the location of an allocation in the buffers, to be given to
+ * SCE_MeshBatch_Draw()
+ * \note The location changes when the arena is defragmented.
+ */
+const SCE_SMeshBatchEntry*
+SCE_MeshArena_GetEntry (const SCE_SMeshArenaAlloc *alloc)
+{
+    return &alloc->entry;
+}
+
+
+static int SCE_MeshArena_MoveVertices (SCE_SMeshArena *arena,
+                                       SCE_SMeshArenaBlock *from,
+                                       SCE_SMeshArenaBlock *to)
+{
+    size_t i;
+    SCE_SMeshArenaAlloc *alloc = from->owner;
+    SCE_SMesh *mesh = &arena->batch.mesh;
+
+    for (i = 0; i < SCE_MESH_NUM_STREAMS; i++) {
+        size_t s = arena->batch.vertex_size[i];
+        size_t size = s * alloc->entry.n_vertices;
+        void *p = NULL;
+        if (!mesh->used_streams[i] || !size)
+            continue;
+        if (SCE_GPU_HasCopyBuffer ()) {
+            /* the blocks don't overlap */
+            SCE_MeshArena_CopyVertices (mesh, s * to->offset, mesh,
+                                        s * from->offset, i, size);
+            continue;
+        }
+        if (!(p = SCE_MeshArena_GetScratch (arena, size)))
+            goto fail;
+        SCE_Mesh_DownloadVertices (mesh, i, p, s * from->offset, size);
+        SCE_Mesh_UploadVertices (mesh, i, p, s * to->offset, size);
+    }
+    /* the indices point to the old location, move them as well */
+    if (!SCE_MeshBatch_HasBaseVertex () && alloc->iblock &&
+        alloc->entry.n_indices) {
+        size_t s = arena->batch.index_size;
+        size_t size = s * alloc->entry.n_indices;
+        size_t offset = s * alloc->iblock->offset;
+        void *p = NULL;
+        if (!(p = SCE_MeshArena_GetScratch (arena, size)))
+            goto fail;
+        SCE_Mesh_Unbind ();
+        SCE_RInstantIndexBufferFetch (&mesh->ib, p, offset, size);
+        SCE_MeshBatch_RebaseIndices (p, SCE_Mesh_GetIndexType (mesh),
+                                     alloc->entry.n_indices,
+                                     to->offset - from->offset);
+        SCE_RInstantIndexBufferUpdate (&mesh->ib, p, offset, size);
+    }
+    alloc->vblock = to;
+    alloc->entry.first_vertex = to->offset;
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+static int SCE_MeshArena_MoveIndices (SCE_SMeshArena *arena,
+                                      SCE_SMeshArenaBlock *from,
+                                      SCE_SMeshArenaBlock *to)
+{
+    SCE_SMeshArenaAlloc *alloc = from->owner;
+    SCE_SMesh *mesh = &arena->batch.mesh;
+    size_t s = arena->batch.index_size;
+    size_t size = s * alloc->entry.n_indices;
+    void *p = NULL;
+
+    if (size && SCE_GPU_HasCopyBuffer ()) {
+        SCE_MeshArena_CopyIndices (mesh, s * to->offset, mesh,
+                                   s * from->offset, size);
+    } else if (size) {
+        if (!(p = SCE_MeshArena_GetScratch (arena, size))) {
+            SCEE_LogSrc ();
+            return SCE_ERROR;
+        }
+        SCE_Mesh_Unbind ();
+        SCE_RInstantIndexBufferFetch (&mesh->ib, p, s * from->offset, size);
+        SCE_RInstantIndexBufferUpdate (&mesh->ib, p, s * to->offset, size);
+    }
+    alloc->iblock = to;
+    alloc->entry.first_index = to->offset;
+    return SCE_OK;
+}
+
+/* moves up to max_moves blocks of a heap towards its beginning */
+static int SCE_MeshArena_DefragmentHeap (SCE_SMeshArena *arena,
+                                         SCE_SMeshArenaHeap *heap,
+                                         SCEuint max_moves)
+{
+    SCE_SMeshArenaBlock *b = NULL, *nb = NULL, *prev = NULL;
+    SCEuint n = 0;
+    int r;
+
+    /* start from the end of the buffer */
+    for (b = heap->first; b && b->next; b = b->next)
+        ;
+    for (; b && n < max_moves; b = prev) {
+        prev = b->prev;
+        if (b->free || !heap->n_free_blocks)
+            continue;
+        if (!(nb = SCE_MeshArena_HeapAlloc (heap, b->size, b->owner)))
+            continue;
+        if (nb->offset > b->offset) {
+            /* no room below this block */
+            SCE_MeshArena_HeapFree (heap, nb);
+            continue;
+        }
+        if (heap == &arena->vertices)
+            r = SCE_MeshArena_MoveVertices (arena, b, nb);
+        else
+            r = SCE_MeshArena_MoveIndices (arena, b, nb);
+        if (r < 0) {
+            SCE_MeshArena_HeapFree (heap, nb);
+            SCEE_LogSrc ();
+            return SCE_ERROR;
+        }
+        /* nb was taken below b, prev is still a valid block */
+        prev = b->prev;
+        SCE_MeshArena_HeapFree (heap, b);
+        arena->n_moves++;
+        n++;
+    }
+    return n;
+}
+/**
+ * \brief Incrementally compacts an arena
+ * \param arena an arena
+ * \param max_moves maximum number of blocks to move during this call, in
+ * both the vertex and the index buffers
+ * \returns the number of moved blocks or SCE_ERROR on error
+ *
+ * Blocks are moved from the end of the buffers into free space below them,
+ * so that free space gathers at the end. Moving a block copies its data,
+ * through client memory if buffers can't be copied on the GPU, call this
+ * function with a small \p max_moves at each frame rather than compacting
+ * everything at once.
+ * \sa SCE_MeshArena_GetVertexFragmentation()
+ */
+int SCE_MeshArena_Defragment (SCE_SMeshArena *arena, SCEuint max_moves)
+{
+    int n1, n2;
+    if ((n1 = SCE_MeshArena_DefragmentHeap (arena, &arena->vertices,
+                                            max_moves)) < 0)
+        goto fail;
+    if ((n2 = SCE_MeshArena_DefragmentHeap (arena, &arena->indices,
+                                            max_moves)) < 0)
+        goto fail;
+    return n1 + n2;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+
+/**
+ * \brief Gets the ratio of allocated vertices, in [0, 1]
+ */
+float SCE_MeshArena_GetVertexOccupancy (const SCE_SMeshArena *arena)
+{
+    return SCE_MeshArena_HeapOccupancy (&arena->vertices);
+}
+/**
+ * \brief Gets the ratio of allocated indices, in [0, 1]
+ */
+float SCE_MeshArena_GetIndexOccupancy (const SCE_SMeshArena *arena)
+{
+    return SCE_MeshArena_HeapOccupancy (&arena->indices);
+}
+/**
+ * \brief Gets the fragmentation of the vertex buffer: 0 when the free
+ * vertices are contiguous, close to 1 when scattered in small blocks
+ */
+float SCE_MeshArena_GetVertexFragmentation (const SCE_SMeshArena *arena)
+{
+    return SCE_MeshArena_HeapFragmentation (&arena->vertices);
+}
+/**
+ * \brief Gets the fragmentation of the index buffer
+ * \sa SCE_MeshArena_GetVertexFragmentation()
+ */
+float SCE_MeshArena_GetIndexFragmentation (const SCE_SMeshArena *arena)
+{
+    return SCE_MeshArena_HeapFragmentation (&arena->indices);
+}
+SCEuint SCE_MeshArena_GetNumAllocs (const SCE_SMeshArena *arena)
+{
+    return arena->n_allocs;
+}
+SCEuint SCE_MeshArena_GetNumMoves (const SCE_SMeshArena *arena)
+{
+    return arena->n_moves;
+}
+SCEuint SCE_MeshArena_GetNumFailures (const SCE_SMeshArena *arena)
+{
+    return arena->n_failures;
+}
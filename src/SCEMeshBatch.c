@@ -0,0 +1,562 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#include <string.h>
+#include <SCE/utils/SCEUtils.h>
+#include <SCE/core/SCECore.h>
+#include <SCE/renderer/SCERenderer.h>
+#include "SCE/interface/SCEGPU.h"
+#include "SCE/interface/SCEMeshBatch.h"
+
+/**
+ * \file SCEMeshBatch.c
+ * \brief Packs meshes of identical vertex layout into shared buffers and
+ * renders them with a single multi-draw call
+ *
+ * Every draw is recorded into a per-frame command buffer by
+ * SCE_MeshBatch_Draw(), then SCE_MeshBatch_Flush() submits the whole list
+ * with glMultiDrawElementsIndirect() when available. The vertex shader
+ * reads the first three rows of the object matrix of each draw, and
+ * optionally a user vector, from the attributes given to
+ * SCE_MeshBatch_SetAttribIndices() and SCE_MeshBatch_SetUserAttribIndex().
+ * Unlike pseudo instancing (see SCE_PSEUDO_INSTANCING) the camera matrix is
+ * not combined into them: the shader transforms the vertices with these
+ * rows in place of the object matrix uniform, then applies the camera and
+ * projection matrices as usual. The attributes are sourced from a per-draw
+ * data buffer owned by the batch, indexed by the base instance of each draw
+ * command, and the layout of the mesh is restored after the draw. When
+ * indirect rendering or base instances are not supported, the attributes
+ * are set between each draw and glDrawElementsBaseVertex() is used
+ * instead. Without base vertices
+ * either (GL 3.2 or ARB_draw_elements_base_vertex), the indices are rebased
+ * when the meshes are packed and plain glDrawElements() is used.
+ */
+
+static int is_init = SCE_FALSE;
+static int use_indirect = SCE_FALSE;
+static int use_base_vertex = SCE_FALSE;
+
+int SCE_Init_MeshBatch (void)
+{
+    if (is_init)
+        return SCE_OK;
+    use_base_vertex = (GLEW_VERSION_3_2 ||
+                       GLEW_ARB_draw_elements_base_vertex) ?
+        SCE_TRUE : SCE_FALSE;
+#ifdef GL_ARB_multi_draw_indirect
+    /* the per-draw data are fetched through the base instance */
+    use_indirect = (GLEW_ARB_multi_draw_indirect && use_base_vertex &&
+                    (GLEW_VERSION_4_2 || GLEW_ARB_base_instance)) ?
+        SCE_TRUE : SCE_FALSE;
+#else
+    use_indirect = SCE_FALSE;
+#endif
+    is_init = SCE_TRUE;
+    return SCE_OK;
+}
+void SCE_Quit_MeshBatch (void)
+{
+    is_init = SCE_FALSE;
+}
+
+/**
+ * \brief Are base vertices supported by the draw calls
+ *
+ * When they aren't, the indices stored in the shared buffers must be
+ * relative to the beginning of the vertex buffer.
+ * \sa SCE_MeshBatch_RebaseIndices()
+ */
+int SCE_MeshBatch_HasBaseVertex (void)
+{
+    return use_base_vertex;
+}
+
+
+void SCE_MeshBatch_InitEntry (SCE_SMeshBatchEntry *entry)
+{
+    entry->first_vertex = entry->n_vertices = 0;
+    entry->first_index = entry->n_indices = 0;
+}
+
+void SCE_MeshBatch_Init (SCE_SMeshBatch *batch)
+{
+    size_t i;
+    SCE_Mesh_Init (&batch->mesh);
+    batch->max_vertices = batch->max_indices = 0;
+    batch->n_vertices = batch->n_indices = 0;
+    for (i = 0; i < SCE_MESH_NUM_STREAMS; i++)
+        batch->vertex_size[i] = 0;
+    batch->index_size = 0;
+    batch->cmds = NULL;
+    batch->data = NULL;
+    batch->n_cmds = batch->max_cmds = 0;
+    batch->attrib1 = 3;
+    batch->attrib2 = 4;
+    batch->attrib3 = 5;
+    batch->attrib4 = -1;
+    batch->cmd_buffer = batch->data_buffer = 0;
+    batch->n_draw_calls = batch->n_draws = 0;
+}
+void SCE_MeshBatch_Clear (SCE_SMeshBatch *batch)
+{
+    SCE_GPU_DeleteBuffer (batch->cmd_buffer);
+    SCE_GPU_DeleteBuffer (batch->data_buffer);
+    SCE_free (batch->data);
+    SCE_free (batch->cmds);
+    SCE_Mesh_Clear (&batch->mesh);
+}
+SCE_SMeshBatch* SCE_MeshBatch_Create (void)
+{
+    SCE_SMeshBatch *batch = NULL;
+    if (!(batch = SCE_malloc (sizeof *batch)))
+        SCEE_LogSrc ();
+    else
+        SCE_MeshBatch_Init (batch);
+    return batch;
+}
+void SCE_MeshBatch_Delete (SCE_SMeshBatch *batch)
+{
+    if (batch) {
+        SCE_MeshBatch_Clear (batch);
+        SCE_free (batch);
+    }
+}
+
+/**
+ * \brief Defines the vertex attributes receiving the object matrix of
+ * each draw
+ * \param a1 attribute index of the vector for the matrix row 1
+ * \param a2 attribute index of the vector for the matrix row 2
+ * \param a3 attribute index of the vector for the matrix row 3
+ *
+ * The defaults are 3, 4 and 5, like the pseudo instancing attributes, but
+ * the rows are those of the object matrix alone.
+ * \sa SCE_Instance_SetAttribIndices()
+ */
+void SCE_MeshBatch_SetAttribIndices (SCE_SMeshBatch *batch,
+                                     int a1, int a2, int a3)
+{
+    batch->attrib1 = a1; batch->attrib2 = a2; batch->attrib3 = a3;
+}
+/**
+ * \brief Defines the vertex attribute receiving the user vector of each draw
+ * \param a attribute index, -1 to disable (default)
+ * \sa SCE_MeshBatch_DrawData()
+ */
+void SCE_MeshBatch_SetUserAttribIndex (SCE_SMeshBatch *batch, int a)
+{
+    batch->attrib4 = a;
+}
+
+/**
+ * \brief Allocates the shared buffers of a batch
+ * \param batch a batch
+ * \param layout geometry describing the vertex layout of the meshes to pack,
+ * its data are not read
+ * \param max_vertices,max_indices capacity of the shared buffers
+ * \returns SCE_ERROR on error, SCE_OK otherwise
+ * \sa SCE_MeshBatch_AddMesh()
+ */
+int SCE_MeshBatch_Setup (SCE_SMeshBatch *batch, SCE_SGeometry *layout,
+                         SCEuint max_vertices, SCEuint max_indices)
+{
+    size_t i;
+
+    if (SCE_Mesh_SetGeometry (&batch->mesh, layout, SCE_FALSE) < 0)
+        goto fail;
+    SCE_Mesh_AutoBuild (&batch->mesh);
+    SCE_Mesh_SetNumVertices (&batch->mesh, max_vertices);
+    SCE_Mesh_SetNumIndices (&batch->mesh, max_indices);
+    for (i = 0; i < SCE_MESH_NUM_STREAMS; i++) {
+        SCE_RVertexBuffer *vb = SCE_Mesh_GetStream (&batch->mesh, i);
+        batch->vertex_size[i] = 0;
+        if (!batch->mesh.used_streams[i])
+            continue;
+        if (SCE_Mesh_ReallocStream (&batch->mesh, i, NULL) < 0)
+            goto fail;
+        if (max_vertices > 0)
+            batch->vertex_size[i] = SCE_RGetVertexBufferSize (vb) /max_vertices;
+    }
+    if (SCE_Mesh_ReallocIndexBuffer (&batch->mesh, NULL) < 0)
+        goto fail;
+    if (max_indices > 0)
+        batch->index_size = SCE_RGetIndexBufferSize (&batch->mesh.ib) /
+            max_indices;
+
+    batch->max_vertices = max_vertices;
+    batch->max_indices = max_indices;
+    batch->n_vertices = batch->n_indices = 0;
+
+    if (use_indirect && !batch->cmd_buffer)
+        batch->cmd_buffer = SCE_GPU_CreateBuffer ();
+    if (use_indirect && !batch->data_buffer)
+        batch->data_buffer = SCE_GPU_CreateBuffer ();
+
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+/**
+ * \brief Checks whether a mesh can be packed into a batch
+ * \returns SCE_TRUE if \p mesh uses the same streams, vertex sizes, index
+ * type and primitive type than \p batch
+ */
+int SCE_MeshBatch_Compatible (SCE_SMeshBatch *batch, SCE_SMesh *mesh)
+{
+    size_t i;
+    SCEuint n_vertices = SCE_Mesh_GetNumVertices (mesh);
+    SCEuint n_indices = SCE_Mesh_GetNumIndices (mesh);
+
+    if (!mesh->use_ib || mesh->prim != batch->mesh.prim ||
+        mesh->ib.ia.type != batch->mesh.ib.ia.type || !n_vertices ||
+        !n_indices)
+        return SCE_FALSE;
+    if (SCE_RGetIndexBufferSize (&mesh->ib) / n_indices != batch->index_size)
+        return SCE_FALSE;
+    for (i = 0; i < SCE_MESH_NUM_STREAMS; i++) {
+        size_t size;
+        if (mesh->used_streams[i] != batch->mesh.used_streams[i])
+            return SCE_FALSE;
+        if (!mesh->used_streams[i])
+            continue;
+        size = SCE_RGetVertexBufferSize (&mesh->streams[i]) / n_vertices;
+        if (size != batch->vertex_size[i])
+            return SCE_FALSE;
+    }
+    return SCE_TRUE;
+}
+
+/**
+ * \brief Gets the largest index of an index type
+ */
+SCEuint SCE_MeshBatch_MaxIndex (SCEenum type)
+{
+    switch (type) {
+    case SCE_UNSIGNED_INT: return 0xffffffff;
+    case SCE_UNSIGNED_SHORT: return 0xffff;
+    default: return 0xff;
+    }
+}
+/**
+ * \brief Adds \p base to \p n indices, done at packing time when the draw
+ * calls can't take a base vertex
+ *
+ * The addition wraps around, a negative offset can thus be given as its
+ * unsigned counterpart.
+ * \sa SCE_MeshBatch_HasBaseVertex()
+ */
+void SCE_MeshBatch_RebaseIndices (void *indices, SCEenum type,
+                                  SCEuint n, SCEuint base)
+{
+    SCEuint i;
+
+    switch (type) {
+    case SCE_UNSIGNED_INT:
+        for (i = 0; i < n; i++)
+            ((SCEuint*)indices)[i] += base;
+        break;
+    case SCE_UNSIGNED_SHORT:
+        for (i = 0; i < n; i++)
+            ((SCEushort*)indices)[i] += base;
+        break;
+    default:
+        for (i = 0; i < n; i++)
+            ((SCEubyte*)indices)[i] += base;
+    }
+}
+
+/**
+ * \brief Copies the vertices and indices of a built mesh into the shared
+ * buffers of a batch
+ * \param batch a batch set up with SCE_MeshBatch_Setup()
+ * \param mesh a built mesh with a vertex layout identical to the batch's one
+ * \param entry receives the location of \p mesh in \p batch
+ * \returns SCE_ERROR on error (incompatible layout or batch full), SCE_OK
+ * otherwise
+ *
+ * Indices are not rebased, the base vertex of the draw commands does it,
+ * unless base vertices are not supported: the mesh must then fit in the
+ * range of the index type of the batch.
+ * \sa SCE_MeshBatch_Compatible(), SCE_MeshBatch_Draw()
+ */
+int SCE_MeshBatch_AddMesh (SCE_SMeshBatch *batch, SCE_SMesh *mesh,
+                           SCE_SMeshBatchEntry *entry)
+{
+    size_t i, size = 0;
+    void *data = NULL;
+    SCEuint n_vertices = SCE_Mesh_GetNumVertices (mesh);
+    SCEuint n_indices = SCE_Mesh_GetNumIndices (mesh);
+
+    if (!SCE_MeshBatch_Compatible (batch, mesh)) {
+        SCEE_Log (SCE_INVALID_ARG);
+        SCEE_LogMsg ("vertex layout of the mesh doesn't match the batch one");
+        return SCE_ERROR;
+    }
+    if (batch->n_vertices + n_vertices > batch->max_vertices ||
+        batch->n_indices + n_indices > batch->max_indices) {
+        SCEE_Log (SCE_INVALID_OPERATION);
+        SCEE_LogMsg ("batch is full (%u vertices, %u indices)",
+                     batch->max_vertices, batch->max_indices);
+        return SCE_ERROR;
+    }
+    if (!use_base_vertex &&
+        batch->n_vertices + n_vertices - 1 >
+        SCE_MeshBatch_MaxIndex (batch->mesh.ib.ia.type)) {
+        SCEE_Log (SCE_INVALID_OPERATION);
+        SCEE_LogMsg ("batch is full (vertices out of the index type range)");
+        return SCE_ERROR;
+    }
+
+    for (i = 0; i < SCE_MESH_NUM_STREAMS; i++)
+        size = MAX (size, batch->vertex_size[i] * n_vertices);
+    size = MAX (size, batch->index_size * n_indices);
+    if (!(data = SCE_malloc (size)))
+        goto fail;
+
+    for (i = 0; i < SCE_MESH_NUM_STREAMS; i++) {
+        size_t s = batch->vertex_size[i];
+        if (!batch->mesh.used_streams[i])
+            continue;
+        SCE_Mesh_DownloadVertices (mesh, i, data, 0, s * n_vertices);
+        SCE_Mesh_UploadVertices (&batch->mesh, i, data, s * batch->n_vertices,
+                                 s * n_vertices);
+    }
+    SCE_Mesh_DownloadIndices (mesh, data, batch->index_size * n_indices);
+    if (!use_base_vertex)
+        SCE_MeshBatch_RebaseIndices (data, batch->mesh.ib.ia.type, n_indices,
+                                     batch->n_vertices);
+    SCE_Mesh_Unbind ();
+    SCE_RInstantIndexBufferUpdate (&batch->mesh.ib, data,
+                                   batch->index_size * batch->n_indices,
+                                   batch->index_size * n_indices);
+    SCE_free (data);
+
+    entry->first_vertex = batch->n_vertices;
+    entry->n_vertices = n_vertices;
+    entry->first_index = batch->n_indices;
+    entry->n_indices = n_indices;
+    batch->n_vertices += n_vertices;
+    batch->n_indices += n_indices;
+
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+SCE_SMesh* SCE_MeshBatch_GetMesh (SCE_SMeshBatch *batch)
+{
+    return &batch->mesh;
+}
+
+
+/**
+ * \brief Starts recording the draws of a frame
+ * \sa SCE_MeshBatch_Draw(), SCE_MeshBatch_Flush()
+ */
+void SCE_MeshBatch_Begin (SCE_SMeshBatch *batch)
+{
+    batch->n_cmds = 0;
+}
+
+static int SCE_MeshBatch_Grow (SCE_SMeshBatch *batch)
+{
+    SCEuint n = batch->max_cmds ? batch->max_cmds * 2 : 64;
+    void *p = NULL;
+
+    if (!(p = SCE_realloc (batch->cmds, n * sizeof *batch->cmds)))
+        goto fail;
+    batch->cmds = p;
+    if (!(p = SCE_realloc (batch->data, n * SCE_MESHBATCH_DRAW_DATA_SIZE *
+                           sizeof *batch->data)))
+        goto fail;
+    batch->data = p;
+    batch->max_cmds = n;
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+/**
+ * \brief Records a draw of a packed mesh
+ * \param batch a batch
+ * \param entry location of the mesh, as given by SCE_MeshBatch_AddMesh()
+ * \param m object matrix of the draw, without the camera matrix
+ * \returns SCE_ERROR on memory allocation failure, SCE_OK otherwise
+ */
+int SCE_MeshBatch_Draw (SCE_SMeshBatch *batch, const SCE_SMeshBatchEntry *entry,
+                        const SCE_TMatrix4 m)
+{
+    return SCE_MeshBatch_DrawData (batch, entry, m, NULL);
+}
+/**
+ * \brief Records a draw of a packed mesh along with a user vector
+ * \param user four floats read by the attribute given to
+ * SCE_MeshBatch_SetUserAttribIndex(), can be NULL
+ * \sa SCE_MeshBatch_Draw()
+ */
+int SCE_MeshBatch_DrawData (SCE_SMeshBatch *batch,
+                            const SCE_SMeshBatchEntry *entry,
+                            const SCE_TMatrix4 m, const float *user)
+{
+    SCE_SMeshBatchCommand *cmd = NULL;
+    float *data = NULL;
+
+    if (batch->n_cmds >= batch->max_cmds && SCE_MeshBatch_Grow (batch) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    cmd = &batch->cmds[batch->n_cmds];
+    cmd->count = entry->n_indices;
+    cmd->n_instances = 1;
+    cmd->first_index = entry->first_index;
+    cmd->base_vertex = entry->first_vertex;
+    cmd->base_instance = batch->n_cmds;
+    data = &batch->data[batch->n_cmds * SCE_MESHBATCH_DRAW_DATA_SIZE];
+    memcpy (data, m, 12 * sizeof *data);
+    if (user)
+        memcpy (&data[12], user, 4 * sizeof *data);
+    else
+        data[12] = data[13] = data[14] = data[15] = 0.0f;
+    batch->n_cmds++;
+    return SCE_OK;
+}
+/**
+ * \brief Records a draw for each instance of a group
+ * \sa SCE_MeshBatch_Draw()
+ */
+int SCE_MeshBatch_DrawGroup (SCE_SMeshBatch *batch,
+                             const SCE_SMeshBatchEntry *entry,
+                             SCE_SGeometryInstanceGroup *group)
+{
+    SCE_SListIterator *it = NULL;
+    SCE_List_ForEach (it, &group->instances) {
+        SCE_SGeometryInstance *inst = SCE_List_GetData (it);
+        if (SCE_MeshBatch_Draw (batch, entry, SCE_Instance_GetMatrix (inst)) < 0)
+            goto fail;
+    }
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+/* sends the commands and the per-draw data, before the mesh is bound */
+static void SCE_MeshBatch_UploadIndirect (SCE_SMeshBatch *batch)
+{
+    size_t stride = SCE_MESHBATCH_DRAW_DATA_SIZE * sizeof *batch->data;
+    SCE_GPU_SetBufferData (batch->data_buffer, batch->n_cmds * stride,
+                           batch->data);
+    SCE_GPU_SetBufferData (batch->cmd_buffer,
+                           batch->n_cmds * sizeof *batch->cmds, batch->cmds);
+}
+
+static void SCE_MeshBatch_SubmitIndirect (SCE_SMeshBatch *batch)
+{
+    int attribs[4], n = 3;
+    size_t stride = SCE_MESHBATCH_DRAW_DATA_SIZE * sizeof *batch->data;
+
+    attribs[0] = batch->attrib1;
+    attribs[1] = batch->attrib2;
+    attribs[2] = batch->attrib3;
+    attribs[3] = batch->attrib4;
+    if (batch->attrib4 >= 0)
+        n = 4;
+
+    /* per-draw data, fetched through the base instance of each command */
+    SCE_GPU_EnableDrawAttribs (batch->data_buffer, attribs, n, stride);
+    SCE_GPU_MultiDrawIndirect (batch->mesh.prim, batch->mesh.ib.ia.type,
+                               batch->cmd_buffer, batch->n_cmds);
+    SCE_GPU_DisableDrawAttribs (attribs, n);
+    batch->n_draw_calls = 1;
+}
+
+static void SCE_MeshBatch_SubmitLoop (SCE_SMeshBatch *batch)
+{
+    SCEuint i;
+    for (i = 0; i < batch->n_cmds; i++) {
+        SCE_SMeshBatchCommand *cmd = &batch->cmds[i];
+        float *data = &batch->data[i * SCE_MESHBATCH_DRAW_DATA_SIZE];
+        SCE_RVertexAttrib4fv (batch->attrib1, &data[0]);
+        SCE_RVertexAttrib4fv (batch->attrib2, &data[4]);
+        SCE_RVertexAttrib4fv (batch->attrib3, &data[8]);
+        if (batch->attrib4 >= 0)
+            SCE_RVertexAttrib4fv (batch->attrib4, &data[12]);
+        if (use_base_vertex) {
+            glDrawElementsBaseVertex (batch->mesh.prim, cmd->count,
+                                      batch->mesh.ib.ia.type,
+                                      (const GLvoid*)(cmd->first_index *
+                                                      batch->index_size),
+                                      cmd->base_vertex);
+        } else {
+            /* indices rebased by SCE_MeshBatch_AddMesh() */
+            glDrawElements (batch->mesh.prim, cmd->count,
+                            batch->mesh.ib.ia.type,
+                            (const GLvoid*)(cmd->first_index *
+                                            batch->index_size));
+        }
+    }
+    batch->n_draw_calls = batch->n_cmds;
+}
+
+/**
+ * \brief Submits every draw recorded since the last SCE_MeshBatch_Begin()
+ *
+ * The shared buffers are bound once, then the draws are issued with a single
+ * glMultiDrawElementsIndirect() when supported. Resources (shader, textures)
+ * must have been setup by the caller.
+ * \sa SCE_MeshBatch_Begin(), SCE_MeshBatch_GetNumDrawCalls()
+ */
+void SCE_MeshBatch_Flush (SCE_SMeshBatch *batch)
+{
+    batch->n_draws = batch->n_cmds;
+    batch->n_draw_calls = 0;
+    if (!batch->n_cmds)
+        return;
+
+    if (use_indirect)
+        SCE_MeshBatch_UploadIndirect (batch);
+    SCE_Mesh_Use (&batch->mesh);
+    if (use_indirect)
+        SCE_MeshBatch_SubmitIndirect (batch);
+    else
+        SCE_MeshBatch_SubmitLoop (batch);
+    SCE_Mesh_Unuse ();
+    batch->n_cmds = 0;
+}
+
+/**
+ * \brief Gets the number of GL draw calls issued by the last flush
+ */
+SCEuint SCE_MeshBatch_GetNumDrawCalls (const SCE_SMeshBatch *batch)
+{
+    return batch->n_draw_calls;
+}
+/**
+ * \brief Gets the number of draws submitted by the last flush
+ */
+SCEuint SCE_MeshBatch_GetNumDraws (const SCE_SMeshBatch *batch)
+{
+    return batch->n_draws;
+}
@@ -0,0 +1,599 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SCE/utils/SCEUtils.h>
+#include <SCE/core/SCECore.h>
+#include "SCE/interface/SCEMeshOptimizer.h"
+
+/**
+ * \file SCEMeshOptimizer.c
+ * \brief Build-time reordering of indexed triangle lists
+ *
+ * Three passes are available, applied in this order:
+ * - triangles are reordered for the post-transform vertex cache using
+ *   Tom Forsyth's linear-speed vertex cache optimization;
+ * - the resulting list is split into clusters at each cache hard boundary
+ *   (a triangle missing its 3 vertices) and clusters are sorted so that
+ *   those facing outward are drawn first, which reduces overdraw;
+ * - vertices are renumbered in the order of their first use so that vertex
+ *   fetches are sequential, see SCE_MeshOpt_Remap().
+ *
+ * The average cache miss ratio (ACMR: transformed vertices per triangle) is
+ * measured before and after the passes with a FIFO cache of
+ * SCE_MESHOPT_FIFO_SIZE entries.
+ */
+
+/* size of the LRU cache modeled by the vertex cache optimizer */
+#define SCE_MESHOPT_CACHE_SIZE 32
+#define SCE_MESHOPT_MAX_VALENCE 32
+
+static int tables_ready = SCE_FALSE;
+static float cache_scores[SCE_MESHOPT_CACHE_SIZE];
+static float valence_scores[SCE_MESHOPT_MAX_VALENCE];
+
+static void SCE_MeshOpt_MakeTables (void)
+{
+    const float cache_decay = 1.5, last_tri_score = 0.75;
+    const float valence_scale = 2.0, valence_power = 0.5;
+    int i;
+
+    for (i = 0; i < SCE_MESHOPT_CACHE_SIZE; i++) {
+        if (i < 3)
+            cache_scores[i] = last_tri_score;
+        else {
+            float s = 1.0 - (i - 3) * (1.0 / (SCE_MESHOPT_CACHE_SIZE - 3));
+            cache_scores[i] = pow (s, cache_decay);
+        }
+    }
+    valence_scores[0] = 0.0;
+    for (i = 1; i < SCE_MESHOPT_MAX_VALENCE; i++)
+        valence_scores[i] = valence_scale * pow (i, -valence_power);
+    tables_ready = SCE_TRUE;
+}
+
+static float SCE_MeshOpt_VertexScore (int pos, SCEuint valence)
+{
+    float score = 0.0;
+    if (valence == 0)
+        return -1.0;            /* no triangle left */
+    if (pos >= 0)
+        score = cache_scores[pos];
+    if (valence < SCE_MESHOPT_MAX_VALENCE)
+        score += valence_scores[valence];
+    else
+        score += 2.0 * pow (valence, -0.5);
+    return score;
+}
+
+
+void SCE_MeshOpt_Init (SCE_SMeshOptimizer *opt)
+{
+    opt->indices = opt->sorted = opt->remap = NULL;
+    opt->adjacency = opt->offsets = opt->valence = NULL;
+    opt->cache_pos = NULL;
+    opt->vscore = opt->tscore = NULL;
+    opt->emitted = NULL;
+    opt->clusters = NULL;
+    opt->tmp = NULL;
+    opt->max_indices = opt->max_vertices = 0;
+    opt->tmp_size = 0;
+    opt->n_vertices = 0;
+    opt->remapped = SCE_FALSE;
+    SCE_MeshOpt_ResetStats (opt);
+}
+static void SCE_MeshOpt_FreeIndices (SCE_SMeshOptimizer *opt)
+{
+    SCE_free (opt->indices);
+    SCE_free (opt->sorted);
+    SCE_free (opt->adjacency);
+    SCE_free (opt->tscore);
+    SCE_free (opt->emitted);
+    SCE_free (opt->clusters);
+    opt->indices = opt->sorted = opt->adjacency = NULL;
+    opt->tscore = NULL;
+    opt->emitted = NULL;
+    opt->clusters = NULL;
+    opt->max_indices = 0;
+}
+static void SCE_MeshOpt_FreeVertices (SCE_SMeshOptimizer *opt)
+{
+    SCE_free (opt->remap);
+    SCE_free (opt->offsets);
+    SCE_free (opt->valence);
+    SCE_free (opt->cache_pos);
+    SCE_free (opt->vscore);
+    opt->remap = opt->offsets = opt->valence = NULL;
+    opt->cache_pos = NULL;
+    opt->vscore = NULL;
+    opt->max_vertices = 0;
+}
+void SCE_MeshOpt_Clear (SCE_SMeshOptimizer *opt)
+{
+    SCE_MeshOpt_FreeIndices (opt);
+    SCE_MeshOpt_FreeVertices (opt);
+    SCE_free (opt->tmp);
+    opt->tmp = NULL;
+    opt->tmp_size = 0;
+}
+
+static int SCE_MeshOpt_Reserve (SCE_SMeshOptimizer *opt, SCEuint n_indices,
+                                SCEuint n_vertices)
+{
+    if (n_indices > opt->max_indices) {
+        SCEuint n_tris = n_indices / 3 + 1;
+        SCE_MeshOpt_FreeIndices (opt);
+        if (!(opt->indices = SCE_malloc (n_indices * sizeof *opt->indices)) ||
+            !(opt->sorted = SCE_malloc (n_indices * sizeof *opt->sorted)) ||
+            !(opt->adjacency = SCE_malloc (n_indices *
+                                           sizeof *opt->adjacency)) ||
+            !(opt->tscore = SCE_malloc (n_tris * sizeof *opt->tscore)) ||
+            !(opt->emitted = SCE_malloc (n_tris * sizeof *opt->emitted)) ||
+            !(opt->clusters = SCE_malloc (n_tris * sizeof *opt->clusters))) {
+            SCE_MeshOpt_FreeIndices (opt);
+            goto fail;
+        }
+        opt->max_indices = n_indices;
+    }
+    if (n_vertices > opt->max_vertices) {
+        SCE_MeshOpt_FreeVertices (opt);
+        if (!(opt->remap = SCE_malloc (n_vertices * sizeof *opt->remap)) ||
+            !(opt->offsets = SCE_malloc ((n_vertices + 1) *
+                                         sizeof *opt->offsets)) ||
+            !(opt->valence = SCE_malloc (n_vertices * sizeof *opt->valence)) ||
+            !(opt->cache_pos = SCE_malloc (n_vertices *
+                                           sizeof *opt->cache_pos)) ||
+            !(opt->vscore = SCE_malloc (n_vertices * sizeof *opt->vscore))) {
+            SCE_MeshOpt_FreeVertices (opt);
+            goto fail;
+        }
+        opt->max_vertices = n_vertices;
+    }
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+static void SCE_MeshOpt_Load (SCEuint *dst, const void *src, SCEenum type,
+                              SCEuint n)
+{
+    SCEuint i;
+    switch (type) {
+    case SCE_UNSIGNED_BYTE:
+        for (i = 0; i < n; i++) dst[i] = ((const SCEubyte*)src)[i];
+        break;
+    case SCE_UNSIGNED_SHORT:
+        for (i = 0; i < n; i++) dst[i] = ((const SCEushort*)src)[i];
+        break;
+    default:
+        memcpy (dst, src, n * sizeof *dst);
+    }
+}
+static void SCE_MeshOpt_Store (void *dst, const SCEuint *src, SCEenum type,
+                               SCEuint n)
+{
+    SCEuint i;
+    switch (type) {
+    case SCE_UNSIGNED_BYTE:
+        for (i = 0; i < n; i++) ((SCEubyte*)dst)[i] = src[i];
+        break;
+    case SCE_UNSIGNED_SHORT:
+        for (i = 0; i < n; i++) ((SCEushort*)dst)[i] = src[i];
+        break;
+    default:
+        memcpy (dst, src, n * sizeof *src);
+    }
+}
+
+
+/* returns SCE_TRUE if v was not in the FIFO */
+static int SCE_MeshOpt_FIFOAccess (SCEuint *fifo, SCEuint *n, SCEuint *head,
+                                   SCEuint v)
+{
+    SCEuint i;
+    for (i = 0; i < *n; i++) {
+        if (fifo[i] == v)
+            return SCE_FALSE;
+    }
+    if (*n < SCE_MESHOPT_FIFO_SIZE)
+        fifo[(*n)++] = v;
+    else {
+        fifo[*head] = v;
+        *head = (*head + 1) % SCE_MESHOPT_FIFO_SIZE;
+    }
+    return SCE_TRUE;
+}
+
+/**
+ * \brief Computes the average cache miss ratio of a triangle list
+ * \param indices indices of the triangles
+ * \param n_indices number of indices
+ * \returns the number of vertices transformed per triangle, from 0.5 (ideal
+ * regular grid) to 3 (no vertex reused)
+ */
+float SCE_MeshOpt_ComputeACMR (const SCEuint *indices, SCEuint n_indices)
+{
+    SCEuint fifo[SCE_MESHOPT_FIFO_SIZE];
+    SCEuint i, n = 0, head = 0, misses = 0;
+
+    if (n_indices < 3)
+        return 0.0;
+    for (i = 0; i < n_indices; i++)
+        misses += SCE_MeshOpt_FIFOAccess (fifo, &n, &head, indices[i]);
+    return (float)misses / (n_indices / 3);
+}
+
+
+static void SCE_MeshOpt_VertexCache (SCE_SMeshOptimizer *opt,
+                                     SCEuint n_indices, SCEuint n_vertices)
+{
+    SCEuint cache[SCE_MESHOPT_CACHE_SIZE + 3];
+    SCEuint new_cache[SCE_MESHOPT_CACHE_SIZE + 3];
+    SCEuint cache_len = 0, new_len;
+    SCEuint *ind = opt->indices;
+    SCEuint n_tris = n_indices / 3;
+    SCEuint i, j, k, v, t;
+    long best = -1;
+    float best_score;
+
+    if (!tables_ready)
+        SCE_MeshOpt_MakeTables ();
+
+    /* triangles of each vertex */
+    for (v = 0; v < n_vertices; v++) {
+        opt->valence[v] = 0;
+        opt->cache_pos[v] = -1;
+    }
+    for (i = 0; i < n_tris * 3; i++)
+        opt->valence[ind[i]]++;
+    opt->offsets[0] = 0;
+    for (v = 0; v < n_vertices; v++) {
+        opt->offsets[v + 1] = opt->offsets[v] + opt->valence[v];
+        opt->remap[v] = opt->offsets[v];
+    }
+    for (t = 0; t < n_tris; t++) {
+        for (k = 0; k < 3; k++) {
+            v = ind[t * 3 + k];
+            opt->adjacency[opt->remap[v]++] = t;
+        }
+    }
+
+    for (v = 0; v < n_vertices; v++)
+        opt->vscore[v] = SCE_MeshOpt_VertexScore (-1, opt->valence[v]);
+    for (t = 0; t < n_tris; t++) {
+        opt->emitted[t] = SCE_FALSE;
+        opt->tscore[t] = opt->vscore[ind[t * 3]] + opt->vscore[ind[t * 3 + 1]]
+            + opt->vscore[ind[t * 3 + 2]];
+    }
+
+    for (i = 0; i < n_tris; i++) {
+        if (best < 0) {
+            /* no candidate around the cache, take the best one left */
+            best_score = -1.0;
+            for (t = 0; t < n_tris; t++) {
+                if (!opt->emitted[t] && opt->tscore[t] > best_score) {
+                    best_score = opt->tscore[t];
+                    best = t;
+                }
+            }
+        }
+        t = best;
+        opt->emitted[t] = SCE_TRUE;
+        memcpy (&opt->sorted[i * 3], &ind[t * 3], 3 * sizeof *ind);
+
+        /* remove the triangle from its vertices' lists and put its vertices
+           at the front of the cache */
+        new_len = 0;
+        for (k = 0; k < 3; k++) {
+            SCEuint first, last;
+            v = ind[t * 3 + k];
+            first = opt->offsets[v];
+            last = first + opt->valence[v];
+            for (j = first; j < last; j++) {
+                if (opt->adjacency[j] == t) {
+                    opt->adjacency[j] = opt->adjacency[last - 1];
+                    opt->valence[v]--;
+                    break;
+                }
+            }
+            for (j = 0; j < new_len && new_cache[j] != v; j++);
+            if (j == new_len)
+                new_cache[new_len++] = v;
+        }
+        for (j = 0; j < cache_len; j++) {
+            v = cache[j];
+            if (v != ind[t * 3] && v != ind[t * 3 + 1] && v != ind[t * 3 + 2])
+                new_cache[new_len++] = v;
+        }
+
+        /* evict what does not fit anymore */
+        for (j = SCE_MESHOPT_CACHE_SIZE; j < new_len; j++)
+            opt->cache_pos[new_cache[j]] = -1;
+        cache_len = MIN (new_len, SCE_MESHOPT_CACHE_SIZE);
+        for (j = 0; j < cache_len; j++) {
+            cache[j] = new_cache[j];
+            opt->cache_pos[cache[j]] = j;
+        }
+
+        /* update scores of the touched vertices and of their triangles */
+        for (j = 0; j < new_len; j++) {
+            v = new_cache[j];
+            opt->vscore[v] = SCE_MeshOpt_VertexScore (opt->cache_pos[v],
+                                                      opt->valence[v]);
+        }
+        best = -1;
+        best_score = -1.0;
+        for (j = 0; j < new_len; j++) {
+            SCEuint first, last, a;
+            v = new_cache[j];
+            first = opt->offsets[v];
+            last = first + opt->valence[v];
+            for (a = first; a < last; a++) {
+                SCEuint tt = opt->adjacency[a];
+                float s = opt->vscore[ind[tt * 3]] +
+                    opt->vscore[ind[tt * 3 + 1]] + opt->vscore[ind[tt * 3 + 2]];
+                opt->tscore[tt] = s;
+                if (s > best_score) {
+                    best_score = s;
+                    best = tt;
+                }
+            }
+        }
+    }
+
+    memcpy (ind, opt->sorted, n_tris * 3 * sizeof *ind);
+}
+
+
+static int SCE_MeshOpt_CompareClusters (const void *a, const void *b)
+{
+    const SCE_SMeshOptCluster *c1 = a, *c2 = b;
+    if (c1->key > c2->key)
+        return -1;
+    else if (c1->key < c2->key)
+        return 1;
+    return (c1->first < c2->first) ? -1 : 1; /* stable */
+}
+
+#define SCE_MESHOPT_POS(p, stride, v) \
+    ((const float*)((const char*)(p) + (size_t)(v) * (stride)))
+
+static void SCE_MeshOpt_Overdraw (SCE_SMeshOptimizer *opt, SCEuint n_indices,
+                                  const float *pos, size_t stride)
+{
+    SCEuint fifo[SCE_MESHOPT_FIFO_SIZE];
+    SCEuint n = 0, head = 0;
+    SCEuint *ind = opt->indices;
+    SCEuint n_tris = n_indices / 3, n_clusters = 0;
+    SCEuint i, t, k;
+    SCE_TVector3 center = {0.0, 0.0, 0.0};
+
+    if (n_tris == 0)
+        return;
+
+    /* split at hard boundaries of the cache */
+    for (t = 0; t < n_tris; t++) {
+        SCEuint misses = 0;
+        for (k = 0; k < 3; k++)
+            misses += SCE_MeshOpt_FIFOAccess (fifo, &n, &head, ind[t * 3 + k]);
+        if (t == 0 || misses == 3) {
+            opt->clusters[n_clusters].first = t;
+            opt->clusters[n_clusters].n_triangles = 0;
+            n_clusters++;
+        }
+        opt->clusters[n_clusters - 1].n_triangles++;
+    }
+
+    for (i = 0; i < n_indices; i++)
+        SCE_Vector3_Operator1v (center, +=, SCE_MESHOPT_POS (pos, stride,
+                                                            ind[i]));
+    SCE_Vector3_Operator1 (center, /=, n_indices);
+
+    /* clusters facing away from the center are drawn first */
+    for (i = 0; i < n_clusters; i++) {
+        SCE_SMeshOptCluster *c = &opt->clusters[i];
+        SCE_TVector3 centroid = {0.0, 0.0, 0.0}, normal = {0.0, 0.0, 0.0};
+        float len;
+        for (t = c->first; t < c->first + c->n_triangles; t++) {
+            const float *p0, *p1, *p2;
+            SCE_TVector3 e1, e2, nor;
+            p0 = SCE_MESHOPT_POS (pos, stride, ind[t * 3]);
+            p1 = SCE_MESHOPT_POS (pos, stride, ind[t * 3 + 1]);
+            p2 = SCE_MESHOPT_POS (pos, stride, ind[t * 3 + 2]);
+            SCE_Vector3_Operator2v (e1, =, p1, -, p0);
+            SCE_Vector3_Operator2v (e2, =, p2, -, p0);
+            SCE_Vector3_Cross (nor, e1, e2); /* area weighted */
+            SCE_Vector3_Operator1v (normal, +=, nor);
+            SCE_Vector3_Operator1v (centroid, +=, p0);
+            SCE_Vector3_Operator1v (centroid, +=, p1);
+            SCE_Vector3_Operator1v (centroid, +=, p2);
+        }
+        SCE_Vector3_Operator1 (centroid, /=, 3.0 * c->n_triangles);
+        SCE_Vector3_Operator1v (centroid, -=, center);
+        len = SCE_Vector3_Length (normal);
+        c->key = len > 0.0 ? SCE_Vector3_Dot (centroid, normal) / len : 0.0;
+    }
+
+    qsort (opt->clusters, n_clusters, sizeof *opt->clusters,
+           SCE_MeshOpt_CompareClusters);
+
+    n = 0;
+    for (i = 0; i < n_clusters; i++) {
+        SCE_SMeshOptCluster *c = &opt->clusters[i];
+        memcpy (&opt->sorted[n], &ind[c->first * 3],
+                c->n_triangles * 3 * sizeof *ind);
+        n += c->n_triangles * 3;
+    }
+    memcpy (ind, opt->sorted, n * sizeof *ind);
+}
+
+#undef SCE_MESHOPT_POS
+
+
+static void SCE_MeshOpt_VertexFetch (SCE_SMeshOptimizer *opt,
+                                     SCEuint n_indices, SCEuint n_vertices)
+{
+    SCEuint i, v, next = 0;
+    const SCEuint unused = ~0U;
+
+    for (v = 0; v < n_vertices; v++)
+        opt->remap[v] = unused;
+    for (i = 0; i < n_indices; i++) {
+        v = opt->indices[i];
+        if (opt->remap[v] == unused)
+            opt->remap[v] = next++;
+        opt->indices[i] = opt->remap[v];
+    }
+    /* unreferenced vertices go at the end */
+    for (v = 0; v < n_vertices; v++) {
+        if (opt->remap[v] == unused)
+            opt->remap[v] = next++;
+    }
+}
+
+
+/**
+ * \brief Optimizes an indexed triangle list
+ * \param opt a mesh optimizer
+ * \param flags passes to apply, see SCE_MESHOPT_VERTEX_CACHE,
+ * SCE_MESHOPT_OVERDRAW and SCE_MESHOPT_VERTEX_FETCH
+ * \param indices indices of the triangles, modified in place
+ * \param type data type of \p indices
+ * \param n_indices number of indices (multiple of 3)
+ * \param pos positions (3 floats), only needed by SCE_MESHOPT_OVERDRAW, can be
+ * NULL
+ * \param stride distance in bytes between two positions
+ * \param n_vertices number of vertices
+ * \returns SCE_ERROR on error, SCE_OK otherwise
+ *
+ * When SCE_MESHOPT_VERTEX_FETCH is requested, the indices reference the
+ * vertices in their new order, so every vertex array of the mesh must be
+ * reordered with SCE_MeshOpt_Remap().
+ * \sa SCE_MeshOpt_GetACMR()
+ */
+int SCE_MeshOpt_Optimize (SCE_SMeshOptimizer *opt, SCEbitfield flags,
+                          void *indices, SCEenum type, SCEuint n_indices,
+                          const float *pos, size_t stride, SCEuint n_vertices)
+{
+    n_indices -= n_indices % 3;
+    opt->n_vertices = n_vertices;
+    opt->remapped = SCE_FALSE;
+    if (n_indices == 0 || n_vertices == 0)
+        return SCE_OK;
+
+    if (SCE_MeshOpt_Reserve (opt, n_indices, n_vertices) < 0)
+        goto fail;
+    SCE_MeshOpt_Load (opt->indices, indices, type, n_indices);
+
+    opt->acmr_before = SCE_MeshOpt_ComputeACMR (opt->indices, n_indices);
+    if (flags & SCE_MESHOPT_VERTEX_CACHE)
+        SCE_MeshOpt_VertexCache (opt, n_indices, n_vertices);
+    /* needs the original vertex numbers to fetch the positions */
+    if ((flags & SCE_MESHOPT_OVERDRAW) && pos)
+        SCE_MeshOpt_Overdraw (opt, n_indices, pos,
+                              stride ? stride : 3 * sizeof *pos);
+    if (flags & SCE_MESHOPT_VERTEX_FETCH) {
+        SCE_MeshOpt_VertexFetch (opt, n_indices, n_vertices);
+        opt->remapped = SCE_TRUE;
+    }
+    opt->acmr_after = SCE_MeshOpt_ComputeACMR (opt->indices, n_indices);
+
+    opt->sum_before += opt->acmr_before;
+    opt->sum_after += opt->acmr_after;
+    opt->n_meshes++;
+
+    SCE_MeshOpt_Store (indices, opt->indices, type, n_indices);
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+/**
+ * \brief Reorders a vertex array the same way the vertices of the last mesh
+ * given to SCE_MeshOpt_Optimize() have been
+ * \param opt a mesh optimizer
+ * \param data vertex array
+ * \param size size in bytes of one vertex in \p data
+ * \param stride distance in bytes between two vertices, 0 means \p size
+ * \returns SCE_ERROR on error, SCE_OK otherwise
+ */
+int SCE_MeshOpt_Remap (SCE_SMeshOptimizer *opt, void *data, size_t size,
+                       size_t stride)
+{
+    SCEuint v;
+    size_t total;
+    char *dst = data;
+    const char *src = NULL;
+
+    if (!opt->remapped)
+        return SCE_OK;
+    if (!stride)
+        stride = size;
+    total = stride * opt->n_vertices;
+    if (total > opt->tmp_size) {
+        SCE_free (opt->tmp);
+        if (!(opt->tmp = SCE_malloc (total))) {
+            opt->tmp_size = 0;
+            SCEE_LogSrc ();
+            return SCE_ERROR;
+        }
+        opt->tmp_size = total;
+    }
+    memcpy (opt->tmp, data, total);
+    src = opt->tmp;
+    for (v = 0; v < opt->n_vertices; v++)
+        memcpy (&dst[opt->remap[v] * stride], &src[v * stride], size);
+    return SCE_OK;
+}
+
+
+/**
+ * \brief Gets the ACMR of the last optimized mesh
+ * \param opt a mesh optimizer
+ * \param before,after ACMR before and after the optimization, can be NULL
+ */
+void SCE_MeshOpt_GetACMR (const SCE_SMeshOptimizer *opt, float *before,
+                          float *after)
+{
+    if (before) *before = opt->acmr_before;
+    if (after) *after = opt->acmr_after;
+}
+/**
+ * \brief Gets the average ACMR of every mesh optimized since the last call to
+ * SCE_MeshOpt_ResetStats()
+ */
+void SCE_MeshOpt_GetAverageACMR (const SCE_SMeshOptimizer *opt, float *before,
+                                 float *after)
+{
+    double n = opt->n_meshes ? opt->n_meshes : 1;
+    if (before) *before = opt->sum_before / n;
+    if (after) *after = opt->sum_after / n;
+}
+void SCE_MeshOpt_ResetStats (SCE_SMeshOptimizer *opt)
+{
+    opt->acmr_before = opt->acmr_after = 0.0;
+    opt->sum_before = opt->sum_after = 0.0;
+    opt->n_meshes = 0;
+}
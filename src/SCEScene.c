@@ -1151,19 +1151,46 @@ void SCE_Scene_ClearBuffers (SCE_SScene *scene)
 }
 
 
+static void SCE_Scene_FlushBatch (SCE_SSceneEntity **pending)
+{
+    if (*pending) {
+        SCE_MeshBatch_Flush ((*pending)->batch);
+        SCE_SceneEntity_UnuseResources (*pending);
+        *pending = NULL;
+    }
+}
+
 static void SCE_Scene_RenderEntities (SCE_SScene *scene, SCE_SList *entities)
 {
-    SCE_SSceneEntity *entity = NULL;
+    SCE_SSceneEntity *entity = NULL, *pending = NULL;
     SCE_SListIterator *it;
     SCE_List_ForEach (it, entities) {
         entity = SCE_List_GetData (it);
         if (SCE_SceneEntity_HasInstance (entity) &&
             SCE_SceneEntity_MatchState (entity, scene->state->state)) {
-            SCE_SceneEntity_UseResources (entity);
-            SCE_SceneEntity_Render (entity);
-            SCE_SceneEntity_UnuseResources (entity);
+            if (!entity->batch) {
+                SCE_Scene_FlushBatch (&pending);
+                SCE_SceneEntity_UseResources (entity);
+                SCE_SceneEntity_Render (entity);
+                SCE_SceneEntity_UnuseResources (entity);
+            } else {
+                /* batched entities are sorted by resources (see
+                   SCE_Scene_SetupBatching()), keep recording draws as long
+                   as nothing would change */
+                if (pending && (pending->batch != entity->batch ||
+                                !SCE_SceneEntity_HasSameResources (pending,
+                                                                   entity)))
+                    SCE_Scene_FlushBatch (&pending);
+                if (!pending) {
+                    SCE_SceneEntity_UseResources (entity);
+                    SCE_MeshBatch_Begin (entity->batch);
+                    pending = entity;
+                }
+                SCE_SceneEntity_Render (entity);
+            }
         }
     }
+    SCE_Scene_FlushBatch (&pending);
     SCE_Texture_Flush ();
     SCE_Material_Use (NULL);
     SCE_Shader_Use (NULL);
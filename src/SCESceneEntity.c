@@ -147,6 +147,8 @@ void SCE_SceneEntity_Init (SCE_SSceneEntity *entity)
     entity->shader = NULL;
     entity->material = NULL;
     SCE_SceneEntity_InitProperties (&entity->props);
+    entity->batch = NULL;
+    SCE_MeshBatch_InitEntry (&entity->batch_entry);
 
     entity->group = NULL;
     entity->isinfrustumfunc = SCE_SceneEntity_IsBSInFrustum;
@@ -560,6 +562,39 @@ SCE_SMesh* SCE_SceneEntity_GetMesh (SCE_SSceneEntity *entity)
     return entity->mesh;
 }
 
+/**
+ * \brief Packs the mesh of an entity into a batch
+ * \param entity an entity, its mesh must be set and built
+ * \param batch a batch or NULL to render the entity with its own mesh
+ * \returns SCE_ERROR on error, SCE_OK otherwise
+ *
+ * Entities sharing the same batch and the same resources are rendered by
+ * SCE_Scene_Render() with a single draw call. The shader of the entity must
+ * then read the object matrix of each instance from the per-draw attributes
+ * of the batch (see SCE_MeshBatch_SetAttribIndices()) instead of the object
+ * matrix uniform; these rows don't include the camera matrix, unlike the
+ * pseudo instancing ones.
+ * \sa SCE_MeshBatch_AddMesh(), SCE_SceneEntity_HasSameResources()
+ */
+int SCE_SceneEntity_SetBatch (SCE_SSceneEntity *entity, SCE_SMeshBatch *batch)
+{
+    entity->batch = NULL;
+    SCE_MeshBatch_InitEntry (&entity->batch_entry);
+    if (batch) {
+        if (SCE_MeshBatch_AddMesh (batch, entity->mesh,
+                                   &entity->batch_entry) < 0) {
+            SCEE_LogSrc ();
+            return SCE_ERROR;
+        }
+        entity->batch = batch;
+    }
+    return SCE_OK;
+}
+SCE_SMeshBatch* SCE_SceneEntity_GetBatch (SCE_SSceneEntity *entity)
+{
+    return entity->batch;
+}
+
 
 /**
  * \brief Adds a texture to an entity
@@ -891,6 +926,37 @@ void SCE_SceneEntity_UseResources (SCE_SSceneEntity *entity)
         SCE_Texture_Use (SCE_SceneResource_GetResource (SCE_List_GetData (it)));
     SCE_Texture_EndLot ();
 }
+/**
+ * \brief Checks whether two entities use the same resources and properties
+ * \returns SCE_TRUE if calling SCE_SceneEntity_UseResources() for \p b after
+ * \p a would not change any state
+ */
+int SCE_SceneEntity_HasSameResources (SCE_SSceneEntity *a, SCE_SSceneEntity *b)
+{
+    SCE_SListIterator *it = NULL, *it2 = NULL;
+    SCE_SSceneEntityProperties *p = &a->props, *q = &b->props;
+
+    if (a->shader != b->shader || a->material != b->material)
+        return SCE_FALSE;
+    if (p->cullface != q->cullface || p->cullmode != q->cullmode ||
+        p->depthtest != q->depthtest || p->depthmode != q->depthmode ||
+        p->alphatest != q->alphatest || p->depthscale != q->depthscale)
+        return SCE_FALSE;
+    if (p->alphatest && (p->alphafunc != q->alphafunc ||
+                         p->alpharef != q->alpharef))
+        return SCE_FALSE;
+    if (p->depthscale && (p->depthrange[0] != q->depthrange[0] ||
+                          p->depthrange[1] != q->depthrange[1]))
+        return SCE_FALSE;
+
+    it2 = SCE_List_GetFirst (b->textures);
+    SCE_List_ForEach (it, a->textures) {
+        if (!it2 || SCE_List_GetData (it) != SCE_List_GetData (it2))
+            return SCE_FALSE;
+        it2 = SCE_List_GetNext (it2);
+    }
+    return it2 == NULL;
+}
 void SCE_SceneEntity_UnuseResources (SCE_SSceneEntity *entity)
 {
     /* reset shitty states */
@@ -928,10 +994,19 @@ void SCE_SceneEntity_Unlock (void)
 
 /**
  * \brief Render all the instances of the given entity
+ *
+ * If the entity is packed into a batch, its instances are only recorded into
+ * the batch and SCE_MeshBatch_Flush() has to be called to render them.
+ * \sa SCE_SceneEntity_SetBatch()
  */
 void SCE_SceneEntity_Render (SCE_SSceneEntity *entity)
 {
-    SCE_Instance_RenderGroup (entity->igroup);
+    if (entity->batch) {
+        /* just record the draws, the batch is flushed by the caller */
+        SCE_MeshBatch_DrawGroup (entity->batch, &entity->batch_entry,
+                                 entity->igroup);
+    } else
+        SCE_Instance_RenderGroup (entity->igroup);
 }
 
 /** @} */
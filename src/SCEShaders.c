@@ -17,7 +17,7 @@
  -----------------------------------------------------------------------------*/
  
 /* created: 06/03/2007
-   updated: 10/04/2012 */
+   updated: 19/10/2026 */
 
 #include <ctype.h>
 #include <SCE/utils/SCEUtils.h>
@@ -741,6 +741,57 @@ int SCE_Shader_Globalf (SCE_SShader *shader, const char *define, float value)
     return SCE_Shader_Global (shader, define, buf);
 }
 
+static const char *quantization_helpers =
+    "uniform vec3 "SCE_SHADER_UNIFORM_POSITION_SCALE";"
+    "uniform vec3 "SCE_SHADER_UNIFORM_POSITION_OFFSET";"
+
+    /* q: normalized 16 bits position */
+    "vec3 sce_decode_position (vec4 q)"
+    "{"
+    "  return q.xyz * "SCE_SHADER_UNIFORM_POSITION_SCALE" +"
+    "         "SCE_SHADER_UNIFORM_POSITION_OFFSET";"
+    "}"
+
+    /* e: normalized 2x16 bits octahedral vector */
+    "vec3 sce_decode_octahedral (vec2 e)"
+    "{"
+    "  vec3 n = vec3 (e.xy, 1.0 - abs (e.x) - abs (e.y));"
+    "  float t = max (-n.z, 0.0);"
+    "  n.x += n.x >= 0.0 ? -t : t;"
+    "  n.y += n.y >= 0.0 ? -t : t;"
+    "  return normalize (n);"
+    "}"
+
+    /* p: normalized 10-10-10-2 vector, w holds the handedness */
+    "vec3 sce_decode_packed (vec4 p)"
+    "{"
+    "  return normalize (p.xyz);"
+    "}"
+    "\n";
+
+/**
+ * \brief Adds the functions decoding quantized vertex data to a shader
+ * \param shader a shader
+ * \param type shader type the functions are added to
+ *
+ * Adds sce_decode_position(), sce_decode_octahedral() and sce_decode_packed()
+ * along with the uniforms SCE_SHADER_UNIFORM_POSITION_SCALE and
+ * SCE_SHADER_UNIFORM_POSITION_OFFSET, which should be bound to
+ * SCE_Mesh_GetPositionScale() and SCE_Mesh_GetPositionOffset(). Half float
+ * texture coordinates need no decoding.
+ * \sa SCE_Mesh_SetQuantization(), SCE_Shader_AddSource()
+ */
+int SCE_Shader_AddQuantizationHelpers (SCE_SShader *shader,
+                                       SCE_RShaderType type)
+{
+    if (SCE_Shader_AddSource (shader, type, quantization_helpers,
+                              SCE_FALSE) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    return SCE_OK;
+}
+
 
 int SCE_Shader_InputPrimitive (SCE_SShader *shader, SCE_EPrimitiveType prim,
                                int adj)
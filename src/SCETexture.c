@@ -17,8 +17,9 @@
  -----------------------------------------------------------------------------*/
  
 /* created: 11/03/2007
-   updated: 08/04/2012 */
+   updated: 19/10/2026 */
 
+#include <string.h>
 #include <SCE/utils/SCEUtils.h>
 #include <SCE/core/SCECore.h>
 #include <SCE/renderer/SCERenderer.h>
@@ -56,6 +57,9 @@ static SCE_SListIterator *mark = NULL;
 
 static SCE_STexture *unitused[SCE_MAX_TEXTURE_UNITS];
 
+/* whether the pixel buffers of the streams are fenced (GL 3.2) */
+static int use_sync = SCE_FALSE;
+
 static void SCE_Texture_PopTexture (void *tex)
 {
     unitused[((SCE_STexture*)tex)->unit] = NULL;
@@ -72,6 +76,7 @@ int SCE_Init_Texture (void)
     SCE_List_SetFreeFunc (&texused, SCE_Texture_PopTexture);
     for (i = 0; i < SCE_MAX_TEXTURE_UNITS; i++)
         unitused[i] = NULL;
+    use_sync = SCE_GPU_HasFences ();
     resource_type = SCE_Resource_RegisterType (
         SCE_FALSE, SCE_Texture_LoadResource, NULL);
     if (resource_type < 0)
@@ -398,6 +403,174 @@ void SCE_Texture_Update (SCE_STexture *tex)
 }
 
 
+void SCE_Texture_InitStream (SCE_STextureStream *stream)
+{
+    int i;
+    for (i = 0; i < SCE_TEXTURE_STREAM_BUFFERS; i++) {
+        stream->buffers[i] = 0;
+        stream->sizes[i] = 0;
+        stream->fences[i] = NULL;
+    }
+    stream->current = 0;
+    stream->n_bytes = 0;
+}
+void SCE_Texture_ClearStream (SCE_STextureStream *stream)
+{
+    int i;
+    for (i = 0; i < SCE_TEXTURE_STREAM_BUFFERS; i++) {
+        SCE_GPU_DeleteBuffer (stream->buffers[i]);
+        SCE_GPU_DeleteFence (stream->fences[i]);
+    }
+    SCE_Texture_InitStream (stream);
+}
+/**
+ * \brief Gets the number of bytes uploaded through a stream so far
+ */
+size_t SCE_Texture_GetStreamedBytes (const SCE_STextureStream *stream)
+{
+    return stream->n_bytes;
+}
+
+/* copies a box of a volume into a tightly packed buffer */
+static void SCE_Texture_PackBox (const SCEubyte *src, int tw, int th,
+                                 const int *p1, const int *p2, size_t texel,
+                                 SCEubyte *dst)
+{
+    int y, z;
+    size_t row = (p2[0] - p1[0]) * texel;
+
+    for (z = p1[2]; z < p2[2]; z++) {
+        for (y = p1[1]; y < p2[1]; y++) {
+            size_t offset = ((size_t)z * th + y) * tw + p1[0];
+            memcpy (dst, &src[offset * texel], row);
+            dst += row;
+        }
+    }
+}
+
+/* whether the last transfer out of a buffer of the ring may still be
+   running */
+static int SCE_Texture_IsStreamBusy (SCE_STextureStream *stream, int i)
+{
+    if (!use_sync)
+        return SCE_TRUE;
+    if (!stream->fences[i])
+        return SCE_FALSE;
+    if (!SCE_GPU_IsFenceReached (stream->fences[i]))
+        return SCE_TRUE;
+    SCE_GPU_DeleteFence (stream->fences[i]);
+    stream->fences[i] = NULL;
+    return SCE_FALSE;
+}
+
+/* streams a packed box through the next pixel buffer of the ring, returns
+   SCE_FALSE if the buffer could not be mapped. a buffer is reused as is
+   once the GPU is done with it, its storage is only orphaned when it grows or
+   when the ring wrapped around faster than the transfers */
+static int SCE_Texture_StreamBox (SCE_STextureStream *stream,
+                                  const SCEubyte *src, int tw, int th,
+                                  const int *p1, const int *p2, size_t texel,
+                                  SCEenum fmt, SCEenum type)
+{
+    int i = stream->current;
+    SCEuint *buffer = &stream->buffers[i];
+    size_t *capacity = &stream->sizes[i];
+    size_t size;
+    SCEubyte *dst = NULL;
+    int orphan;
+
+    size = (size_t)(p2[0] - p1[0]) * (p2[1] - p1[1]) * (p2[2] - p1[2]) * texel;
+
+    if (!*buffer)
+        *buffer = SCE_GPU_CreateBuffer ();
+    /* otherwise the fence has been reached, nothing reads the buffer */
+    orphan = (size > *capacity || SCE_Texture_IsStreamBusy (stream, i));
+    if (orphan)
+        *capacity = MAX (*capacity, size);
+    if (!(dst = SCE_GPU_MapPixelBuffer (*buffer, *capacity, size, orphan)))
+        return SCE_FALSE;
+    SCE_Texture_PackBox (src, tw, th, p1, p2, texel, dst);
+    SCE_GPU_UnmapPixelBuffer ();
+
+    SCE_GPU_TexSubImage3D (p1, p2, fmt, type, NULL);
+    SCE_GPU_UsePixelBuffer (0);
+    if (use_sync) {
+        SCE_GPU_DeleteFence (stream->fences[i]);
+        stream->fences[i] = SCE_GPU_CreateFence ();
+    }
+
+    stream->current = (stream->current + 1) % SCE_TEXTURE_STREAM_BUFFERS;
+    stream->n_bytes += size;
+    return SCE_TRUE;
+}
+
+/**
+ * \brief Updates a box of a 3D texture
+ * \param tex a 3D texture
+ * \param stream ring of pixel buffers to stream the data through, can be
+ * NULL to upload straight from client memory
+ * \param box area to update, in texels (the second point is excluded)
+ * \param data texels of the whole texture, laid out like its data
+ * \param texel size of one texel in \p data, in bytes
+ * \returns SCE_ERROR on error, SCE_OK otherwise
+ *
+ * Unlike SCE_Texture_Update(), only the texels inside \p box are sent to
+ * the GPU. The format and type of \p data are those of the first data of
+ * \p tex. Other kinds of textures are updated entirely.
+ * \sa SCE_Texture_Update(), SCE_Texture_InitStream()
+ */
+int SCE_Texture_UpdateBox (SCE_STexture *tex, SCE_STextureStream *stream,
+                           const SCE_SIntRect3 *box, const void *data,
+                           size_t texel)
+{
+    SCE_STexData *tc = NULL;
+    int p1[3], p2[3];
+    int i, tw, th, td, align;
+    SCEenum fmt, type;
+    unsigned int unit = tex->unit;
+
+    if (SCE_Texture_GetType (tex) != SCE_TEX_3D) {
+        SCE_Texture_Update (tex);
+        return SCE_OK;
+    }
+    if (!(tc = SCE_RGetTextureTexData (tex->tex, 0, 0))) {
+        SCEE_Log (SCE_INVALID_ARG);
+        SCEE_LogMsg ("the texture has no data to update");
+        return SCE_ERROR;
+    }
+    tw = SCE_Texture_GetWidth (tex);
+    th = SCE_Texture_GetHeight (tex);
+    td = SCE_Texture_GetDepth (tex);
+
+    SCE_Rectangle3_GetPointsv (box, p1, p2);
+    p1[0] = MAX (p1[0], 0); p2[0] = MIN (p2[0], tw);
+    p1[1] = MAX (p1[1], 0); p2[1] = MIN (p2[1], th);
+    p1[2] = MAX (p1[2], 0); p2[2] = MIN (p2[2], td);
+    for (i = 0; i < 3; i++) {
+        if (p2[i] <= p1[i])
+            return SCE_OK;      /* empty box */
+    }
+
+    fmt = SCE_TexData_GetDataFormat (tc);
+    type = SCE_TexData_GetDataType (tc);
+
+    SCE_RUseTexture (tex->tex, unit);
+    align = SCE_GPU_SetUnpackAlignment (1);
+    if (!stream || !SCE_Texture_StreamBox (stream, data, tw, th, p1, p2,
+                                           texel, fmt, type)) {
+        /* let GL pick the box out of the whole volume */
+        SCE_GPU_SetUnpackLayout (tw, th, p1);
+        SCE_GPU_TexSubImage3D (p1, p2, fmt, type, data);
+        SCE_GPU_SetUnpackLayout (0, 0, NULL);
+    }
+    SCE_GPU_SetUnpackAlignment (align);
+    /* give the unit back to the texture SCE_Texture_Use() bound there */
+    SCE_RUseTexture (unitused[unit] ? unitused[unit]->tex : NULL, unit);
+
+    return SCE_OK;
+}
+
+
 /**
  * \brief Constructs a default texture data structure for renderable texture
  * \param tex a texture
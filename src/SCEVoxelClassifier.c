@@ -0,0 +1,314 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#include <SCE/utils/SCEUtils.h>
+#include <SCE/core/SCECore.h>
+#include "SCE/interface/SCEVoxelClassifier.h"
+
+/**
+ * \file SCEVoxelClassifier.c
+ * \brief Marching cubes cell classification
+ *
+ * Every voxel of the box is compared to the iso value once, one plane at a
+ * time, the cube indices are then computed a whole row of cells at a time
+ * from the inside bits of two consecutive planes, and the cells crossing
+ * the surface are appended to the worklist without branching. The inner
+ * loops only do byte comparisons, shifts and ors over contiguous arrays so
+ * that compilers vectorize them. SCE_VClassifier_HasSurface() goes through
+ * the same steps but stops at the first row of cells crossing the surface,
+ * without filling the worklist.
+ *
+ * Cube indices follow the corner numbering of Paul Bourke's tables, a bit
+ * being set when the corner is below the iso value. Grids are toroidal:
+ * their wrapping is applied to the coordinates of the box.
+ */
+
+void SCE_VClassifier_Init (SCE_SVoxelClassifier *cl)
+{
+    cl->iso = 128;
+    cl->dims[0] = cl->dims[1] = cl->dims[2] = 0;
+    cl->n_cells = 0;
+    cl->cells = NULL;
+    cl->cases = NULL;
+    cl->planes = NULL;
+    cl->row = NULL;
+}
+void SCE_VClassifier_Clear (SCE_SVoxelClassifier *cl)
+{
+    SCE_free (cl->cells);
+    SCE_free (cl->cases);
+    SCE_free (cl->planes);
+    SCE_free (cl->row);
+}
+SCE_SVoxelClassifier* SCE_VClassifier_Create (void)
+{
+    SCE_SVoxelClassifier *cl = NULL;
+    if (!(cl = SCE_malloc (sizeof *cl)))
+        SCEE_LogSrc ();
+    else
+        SCE_VClassifier_Init (cl);
+    return cl;
+}
+void SCE_VClassifier_Delete (SCE_SVoxelClassifier *cl)
+{
+    if (cl) {
+        SCE_VClassifier_Clear (cl);
+        SCE_free (cl);
+    }
+}
+
+/**
+ * \brief Sets the maximum dimensions of the boxes to classify, in cells
+ *
+ * Must be called before SCE_VClassifier_Build().
+ */
+void SCE_VClassifier_SetDimensions (SCE_SVoxelClassifier *cl, int w, int h,
+                                    int d)
+{
+    cl->dims[0] = w;
+    cl->dims[1] = h;
+    cl->dims[2] = d;
+}
+/**
+ * \brief Sets the iso value of the surface, default is 128
+ */
+void SCE_VClassifier_SetIsoValue (SCE_SVoxelClassifier *cl, SCEubyte iso)
+{
+    cl->iso = iso;
+}
+
+/**
+ * \brief Allocates the worklist and the scratch memory of a classifier
+ * \returns SCE_ERROR on error, SCE_OK otherwise
+ */
+int SCE_VClassifier_Build (SCE_SVoxelClassifier *cl)
+{
+    size_t n;
+
+    SCE_VClassifier_Clear (cl);
+    n = (size_t)cl->dims[0] * cl->dims[1] * cl->dims[2];
+    if (!(cl->cells = SCE_malloc (n * sizeof *cl->cells)))
+        goto fail;
+    if (!(cl->cases = SCE_malloc (n)))
+        goto fail;
+    n = (size_t)(cl->dims[0] + 1) * (cl->dims[1] + 1);
+    if (!(cl->planes = SCE_malloc (2 * n)))
+        goto fail;
+    if (!(cl->row = SCE_malloc (cl->dims[0])))
+        goto fail;
+    cl->n_cells = 0;
+
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+
+/* inside bits of n voxels of a row of w voxels, starting at x */
+static void SCE_VClassifier_Row (const SCEubyte *row, int w, int x, int n,
+                                 SCEubyte iso, SCEubyte *bits)
+{
+    int i, len;
+
+    while (n > 0) {
+        len = MIN (n, w - x);
+        for (i = 0; i < len; i++)
+            bits[i] = row[x + i] < iso;
+        bits = &bits[len];
+        n -= len;
+        x = 0;
+    }
+}
+
+/* inside bits of the voxels of the plane z of the box */
+static void SCE_VClassifier_Plane (const SCE_SVoxelClassifier *cl,
+                                   const SCEubyte *data, const int *dims,
+                                   const int *origin, const int *n, int z,
+                                   SCEubyte *plane)
+{
+    int y, rx, ry, rz;
+    size_t offset;
+
+    rx = SCE_Math_Ring (origin[0], dims[0]);
+    rz = SCE_Math_Ring (origin[2] + z, dims[2]);
+    for (y = 0; y <= n[1]; y++) {
+        ry = SCE_Math_Ring (origin[1] + y, dims[1]);
+        offset = ((size_t)rz * dims[1] + ry) * dims[0];
+        SCE_VClassifier_Row (&data[offset], dims[0], rx, n[0] + 1, cl->iso,
+                             &plane[y * (n[0] + 1)]);
+    }
+}
+
+/* cube indices of a row of n cells, from the inside bits of the rows
+   (y, z), (y + 1, z), (y, z + 1) and (y + 1, z + 1) */
+static void SCE_VClassifier_Cases (const SCEubyte *a0, const SCEubyte *a1,
+                                   const SCEubyte *b0, const SCEubyte *b1,
+                                   int n, SCEubyte *cases)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        cases[i] = a0[i] | (a0[i + 1] << 1) | (a1[i + 1] << 2) | (a1[i] << 3) |
+            (b0[i] << 4) | (b0[i + 1] << 5) | (b1[i + 1] << 6) | (b1[i] << 7);
+    }
+}
+
+/* appends the cells of a row crossing the surface to the worklist */
+static SCEuint SCE_VClassifier_Compact (SCE_SVoxelClassifier *cl,
+                                        SCEuint offset, int n, SCEuint k)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        cl->cells[k] = offset + i;
+        cl->cases[k] = cl->row[i];
+        /* kept unless the index is 0 or 255 */
+        k += (SCEubyte)(cl->row[i] + 1) > 1;
+    }
+    return k;
+}
+
+/* does a row of n cells cross the surface */
+static int SCE_VClassifier_Crosses (const SCEubyte *row, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if ((SCEubyte)(row[i] + 1) > 1)
+            return SCE_TRUE;
+    }
+    return SCE_FALSE;
+}
+
+/* classifies the cells of \p box, stops at the first row crossing the
+   surface when \p any is true and then returns 1 */
+static SCEuint SCE_VClassifier_Run (SCE_SVoxelClassifier *cl,
+                                    const SCE_SGrid *grid,
+                                    const SCE_SIntRect3 *box, int any)
+{
+    int p1[3], p2[3], n[3], dims[3];
+    int i, y, z, pw;
+    SCEuint k = 0;
+    const SCEubyte *data = NULL;
+    SCEubyte *a = NULL, *b = NULL, *tmp = NULL;
+
+    cl->n_cells = 0;
+    SCE_Rectangle3_GetPointsv (box, p1, p2);
+    for (i = 0; i < 3; i++) {
+        n[i] = MIN (p2[i] - p1[i], cl->dims[i]);
+        if (n[i] <= 0)
+            return 0;
+    }
+
+    dims[0] = SCE_Grid_GetWidth (grid);
+    dims[1] = SCE_Grid_GetHeight (grid);
+    dims[2] = SCE_Grid_GetDepth (grid);
+    /* TODO: direct access to structure attributes */
+    p1[0] += grid->wrap_x;
+    p1[1] += grid->wrap_y;
+    p1[2] += grid->wrap_z;
+    data = SCE_Grid_GetRaw ((SCE_SGrid*)grid);
+
+    pw = n[0] + 1;
+    a = cl->planes;
+    b = &cl->planes[pw * (n[1] + 1)];
+    SCE_VClassifier_Plane (cl, data, dims, p1, n, 0, a);
+    for (z = 0; z < n[2]; z++) {
+        SCE_VClassifier_Plane (cl, data, dims, p1, n, z + 1, b);
+        for (y = 0; y < n[1]; y++) {
+            SCE_VClassifier_Cases (&a[y * pw], &a[(y + 1) * pw],
+                                   &b[y * pw], &b[(y + 1) * pw], n[0],
+                                   cl->row);
+            if (any) {
+                if (SCE_VClassifier_Crosses (cl->row, n[0]))
+                    return 1;
+                continue;
+            }
+            k = SCE_VClassifier_Compact (cl, (z * n[1] + y) * n[0], n[0], k);
+        }
+        tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    cl->n_cells = k;
+    return k;
+}
+
+/**
+ * \brief Classifies the cells of a box of a density grid
+ * \param cl a classifier
+ * \param grid density grid, one byte per voxel
+ * \param box half-open box of cells, in coordinates of \p grid (its
+ * wrapping is applied), clamped to the dimensions of \p cl
+ *
+ * Each cell reads the voxels of its 8 corners, the last ones along each
+ * axis thus read one voxel past the box.
+ * \returns the number of cells crossing the surface
+ * \sa SCE_VClassifier_GetCells(), SCE_VClassifier_GetCases(),
+ * SCE_VClassifier_HasSurface()
+ */
+SCEuint SCE_VClassifier_Classify (SCE_SVoxelClassifier *cl,
+                                  const SCE_SGrid *grid,
+                                  const SCE_SIntRect3 *box)
+{
+    return SCE_VClassifier_Run (cl, grid, box, SCE_FALSE);
+}
+/**
+ * \brief Checks whether any cell of a box of a density grid crosses the
+ * surface
+ *
+ * Same as SCE_VClassifier_Classify() but returns as soon as a crossing
+ * cell is found, the worklist is left empty.
+ * \returns SCE_TRUE if the surface goes through \p box, SCE_FALSE otherwise
+ */
+int SCE_VClassifier_HasSurface (SCE_SVoxelClassifier *cl,
+                                const SCE_SGrid *grid,
+                                const SCE_SIntRect3 *box)
+{
+    return SCE_VClassifier_Run (cl, grid, box, SCE_TRUE) ? SCE_TRUE : SCE_FALSE;
+}
+
+/**
+ * \brief Gets the size of the worklist of the last classification
+ */
+SCEuint SCE_VClassifier_GetNumCells (const SCE_SVoxelClassifier *cl)
+{
+    return cl->n_cells;
+}
+/**
+ * \brief Gets the worklist of the last classification
+ *
+ * Cells are given by their offset in the box, x varying first.
+ * \sa SCE_VClassifier_GetCases()
+ */
+const SCEuint* SCE_VClassifier_GetCells (const SCE_SVoxelClassifier *cl)
+{
+    return cl->cells;
+}
+/**
+ * \brief Gets the cube indices of the cells of the worklist
+ */
+const SCEubyte* SCE_VClassifier_GetCases (const SCE_SVoxelClassifier *cl)
+{
+    return cl->cases;
+}
@@ -0,0 +1,697 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#include <stdio.h>
+#include <string.h>
+#include <SCE/utils/SCEUtils.h>
+#include <SCE/core/SCECore.h>
+#include <SCE/renderer/SCERenderer.h>
+#include "SCE/interface/SCEVoxelMeshCache.h"
+
+/**
+ * \file SCEVoxelMeshCache.c
+ * \brief Cache of the final geometry of octree nodes
+ *
+ * The octree terrain stores the geometry of every region it decimates, and
+ * looks it up when a node enters the view again so that it is uploaded as
+ * is, without going through the pipeline. Entries are kept in memory up to
+ * a budget, the least recently used ones are then either dropped or
+ * written into a spill directory, from which they are read back on demand.
+ * The spill directory has its own budget, the oldest spilled entries are
+ * dropped when it is exceeded.
+ *
+ * Modifications of the world are reported through
+ * SCE_VMeshCache_Invalidate(), which drops the entries reading the modified
+ * voxels and bumps the data version of the cache. Geometry generated from
+ * an older version is refused by SCE_VMeshCache_Store() when its node reads
+ * an area invalidated since then, since the voxels it was built from may
+ * have changed in the meantime. Only the last SCE_VMESHCACHE_HISTORY
+ * invalidations are remembered, geometry older than that is refused.
+ *
+ * A refused prefetch leaves an entry without geometry behind, which keeps
+ * the node from being prefetched again while its area is being edited. It
+ * is not removed by the invalidations, only by the first lookup of the node
+ * (reported as a miss) or when the node is stored.
+ */
+
+static void SCE_VMeshCache_InitEntry (SCE_SVMeshCacheEntry *e)
+{
+    e->level = 0;
+    e->x = e->y = e->z = 0;
+    e->vertices = NULL;
+    e->indices = NULL;
+    e->n_vertices = e->n_indices = 0;
+    e->size = 0;
+    e->spilled = SCE_FALSE;
+    e->prefetched = SCE_FALSE;
+    e->discarded = SCE_FALSE;
+    SCE_List_InitIt (&e->it);
+    SCE_List_SetData (&e->it, e);
+    SCE_List_InitIt (&e->it2);
+    SCE_List_SetData (&e->it2, e);
+}
+
+void SCE_VMeshCache_Init (SCE_SVoxelMeshCache *cache)
+{
+    int i;
+
+    cache->max_bytes = 0;
+    cache->bytes = 0;
+    cache->spilled_bytes = 0;
+    cache->max_spilled_bytes = SCE_VMESHCACHE_MAX_SPILLED_BYTES;
+    cache->stride = 0;
+    cache->w = cache->h = cache->d = 0;
+    cache->border = 0;
+    cache->version = 0;
+    for (i = 0; i < SCE_VMESHCACHE_HISTORY; i++) {
+        cache->history[i].flush = SCE_TRUE;
+        cache->history[i].level = 0;
+    }
+    cache->spill = NULL;
+    SCE_List_Init (&cache->lru);
+    SCE_List_Init (&cache->spilled);
+    for (i = 0; i < SCE_VMESHCACHE_NUM_BUCKETS; i++)
+        SCE_List_Init (&cache->buckets[i]);
+    cache->n_hits = cache->n_misses = 0;
+    cache->n_spill_hits = 0;
+    cache->n_prefetch_hits = 0;
+}
+void SCE_VMeshCache_Clear (SCE_SVoxelMeshCache *cache)
+{
+    SCE_VMeshCache_Flush (cache);
+    SCE_free (cache->spill);
+}
+SCE_SVoxelMeshCache* SCE_VMeshCache_Create (void)
+{
+    SCE_SVoxelMeshCache *cache = NULL;
+    if (!(cache = SCE_malloc (sizeof *cache)))
+        SCEE_LogSrc ();
+    else
+        SCE_VMeshCache_Init (cache);
+    return cache;
+}
+void SCE_VMeshCache_Delete (SCE_SVoxelMeshCache *cache)
+{
+    if (cache) {
+        SCE_VMeshCache_Clear (cache);
+        SCE_free (cache);
+    }
+}
+
+/**
+ * \brief Sets the memory budget of a cache
+ * \param cache a cache
+ * \param bytes maximum size of the geometry kept in memory, 0 disables the
+ * cache (default)
+ *
+ * Entries exceeding the budget are spilled on disk if a spill directory
+ * has been given, see SCE_VMeshCache_SetSpillDirectory().
+ */
+void SCE_VMeshCache_SetMaxBytes (SCE_SVoxelMeshCache *cache, size_t bytes)
+{
+    cache->max_bytes = bytes;
+    if (!bytes)
+        SCE_VMeshCache_Flush (cache);
+}
+size_t SCE_VMeshCache_GetMaxBytes (const SCE_SVoxelMeshCache *cache)
+{
+    return cache->max_bytes;
+}
+/**
+ * \brief Sets the size of a vertex, flushes the cache
+ */
+void SCE_VMeshCache_SetStride (SCE_SVoxelMeshCache *cache, size_t stride)
+{
+    if (stride != cache->stride)
+        SCE_VMeshCache_Flush (cache);
+    cache->stride = stride;
+}
+/**
+ * \brief Sets the dimensions of a node
+ * \param cache a cache
+ * \param w,h,d dimensions of a node, in voxels of its level
+ * \param border number of voxels read around a node to generate its
+ * geometry
+ * \sa SCE_VMeshCache_Invalidate()
+ */
+void SCE_VMeshCache_SetNodeSize (SCE_SVoxelMeshCache *cache, long w, long h,
+                                 long d, long border)
+{
+    cache->w = w;
+    cache->h = h;
+    cache->d = d;
+    cache->border = border;
+}
+/**
+ * \brief Sets the directory where entries exceeding the memory budget
+ * are written
+ * \param cache a cache
+ * \param dir an existing directory, NULL to disable spilling
+ * \sa SCE_VMeshCache_SetMaxSpilledBytes()
+ */
+int SCE_VMeshCache_SetSpillDirectory (SCE_SVoxelMeshCache *cache,
+                                      const char *dir)
+{
+    char *spill = NULL;
+
+    if (dir) {
+        if (!(spill = SCE_malloc (strlen (dir) + 1))) {
+            SCEE_LogSrc ();
+            return SCE_ERROR;
+        }
+        strcpy (spill, dir);
+    }
+    /* spilled entries are lost */
+    SCE_VMeshCache_Flush (cache);
+    SCE_free (cache->spill);
+    cache->spill = spill;
+    return SCE_OK;
+}
+
+/**
+ * \brief Gets the data version of a cache
+ *
+ * Record the version before reading the voxels of a node, and give it back
+ * to SCE_VMeshCache_Store() along with the geometry generated from them.
+ */
+SCEuint SCE_VMeshCache_GetVersion (const SCE_SVoxelMeshCache *cache)
+{
+    return cache->version;
+}
+
+
+/* area of the voxels read to generate the geometry of a node */
+static void SCE_VMeshCache_GetNodeBox (const SCE_SVoxelMeshCache *cache,
+                                       long x, long y, long z,
+                                       SCE_SLongRect3 *box)
+{
+    long b = cache->border;
+    SCE_Rectangle3_SetFromOriginl (box, x - b, y - b, z - b,
+                                   cache->w + 2 * b, cache->h + 2 * b,
+                                   cache->d + 2 * b);
+}
+/* records an invalidation and bumps the version */
+static void SCE_VMeshCache_PushHistory (SCE_SVoxelMeshCache *cache,
+                                        int flush, SCEuint level,
+                                        const SCE_SLongRect3 *rect)
+{
+    SCE_SVMeshCacheInvalidation *inv = NULL;
+    inv = &cache->history[cache->version % SCE_VMESHCACHE_HISTORY];
+    inv->flush = flush;
+    inv->level = level;
+    if (rect)
+        inv->rect = *rect;
+    cache->version++;
+}
+/* was the area read by a node modified since \p version */
+static int SCE_VMeshCache_IsOutdated (const SCE_SVoxelMeshCache *cache,
+                                      SCEuint version, SCEuint level,
+                                      long x, long y, long z)
+{
+    const SCE_SVMeshCacheInvalidation *inv = NULL;
+    SCE_SLongRect3 box;
+    SCEuint v;
+
+    /* the version wraps around, compare distances */
+    if (cache->version - version > SCE_VMESHCACHE_HISTORY)
+        return SCE_TRUE;
+    SCE_VMeshCache_GetNodeBox (cache, x, y, z, &box);
+    for (v = version; v != cache->version; v++) {
+        inv = &cache->history[v % SCE_VMESHCACHE_HISTORY];
+        if (inv->flush)
+            return SCE_TRUE;
+        if (inv->level == level && SCE_Rectangle3_Intersectsl (&box,
+                                                               &inv->rect))
+            return SCE_TRUE;
+    }
+    return SCE_FALSE;
+}
+
+
+static SCE_SList* SCE_VMeshCache_GetBucket (SCE_SVoxelMeshCache *cache,
+                                            SCEuint level, long x, long y,
+                                            long z)
+{
+    unsigned long h;
+    h = (unsigned long)x * 73856093UL ^ (unsigned long)y * 19349663UL ^
+        (unsigned long)z * 83492791UL ^ (unsigned long)level * 2654435761UL;
+    return &cache->buckets[h % SCE_VMESHCACHE_NUM_BUCKETS];
+}
+
+static SCE_SVMeshCacheEntry*
+SCE_VMeshCache_Find (SCE_SVoxelMeshCache *cache, SCEuint level, long x,
+                     long y, long z)
+{
+    SCE_SListIterator *it = NULL;
+    SCE_SVMeshCacheEntry *e = NULL;
+    SCE_SList *bucket = SCE_VMeshCache_GetBucket (cache, level, x, y, z);
+
+    SCE_List_ForEach (it, bucket) {
+        e = SCE_List_GetData (it);
+        if (e->level == level && e->x == x && e->y == y && e->z == z)
+            return e;
+    }
+    return NULL;
+}
+
+/* name of the spill file of an entry, to be freed */
+static char* SCE_VMeshCache_MakePath (const SCE_SVoxelMeshCache *cache,
+                                      const SCE_SVMeshCacheEntry *e)
+{
+    char *path = NULL;
+
+    /* enough for the separators and 4 numbers of 64 bits */
+    if (!(path = SCE_malloc (strlen (cache->spill) + 96))) {
+        SCEE_LogSrc ();
+        return NULL;
+    }
+    sprintf (path, "%s/%u_%ld_%ld_%ld.vmc", cache->spill, e->level,
+             e->x, e->y, e->z);
+    return path;
+}
+
+static void SCE_VMeshCache_FreeEntry (SCE_SVoxelMeshCache *cache,
+                                      SCE_SVMeshCacheEntry *e)
+{
+    char *path = NULL;
+
+    SCE_List_Remove (&e->it);
+    SCE_List_Remove (&e->it2);
+    if (e->spilled) {
+        cache->spilled_bytes -= e->size;
+        if ((path = SCE_VMeshCache_MakePath (cache, e)))
+            remove (path);
+        SCE_free (path);
+    } else
+        cache->bytes -= e->size;
+    /* vertices are stored right after the indices */
+    SCE_free (e->indices);
+    SCE_free (e);
+}
+
+/* writes the geometry of an entry in the spill directory and frees it,
+   the oldest spilled entries are dropped to stay within the disk budget */
+static int SCE_VMeshCache_Spill (SCE_SVoxelMeshCache *cache,
+                                 SCE_SVMeshCacheEntry *e)
+{
+    FILE *fp = NULL;
+    char *path = NULL;
+    size_t n;
+    int error;
+
+    if (e->size > cache->max_spilled_bytes)
+        return SCE_ERROR;
+    while (cache->spilled_bytes + e->size > cache->max_spilled_bytes) {
+        SCE_SVMeshCacheEntry *old = NULL;
+        old = SCE_List_GetData (SCE_List_GetFirst (&cache->spilled));
+        SCE_VMeshCache_FreeEntry (cache, old);
+    }
+
+    if (!(path = SCE_VMeshCache_MakePath (cache, e)))
+        return SCE_ERROR;
+    if (!(fp = fopen (path, "wb"))) {
+        SCE_free (path);
+        return SCE_ERROR;
+    }
+    n = fwrite (e->indices, 1, e->size, fp);
+    error = fclose (fp) != 0 || n != e->size;
+    /* don't leave a truncated file behind */
+    if (error)
+        remove (path);
+    SCE_free (path);
+    if (error)
+        return SCE_ERROR;
+
+    SCE_free (e->indices);
+    e->indices = NULL;
+    e->vertices = NULL;
+    e->spilled = SCE_TRUE;
+    cache->bytes -= e->size;
+    cache->spilled_bytes += e->size;
+    SCE_List_Remove (&e->it);
+    SCE_List_Appendl (&cache->spilled, &e->it);
+    return SCE_OK;
+}
+
+/**
+ * \brief Sets the disk budget of a cache
+ * \param cache a cache
+ * \param bytes maximum size of the entries written in the spill directory,
+ * SCE_VMESHCACHE_MAX_SPILLED_BYTES by default
+ *
+ * The oldest spilled entries are dropped to make room for new ones.
+ * \sa SCE_VMeshCache_SetSpillDirectory()
+ */
+void SCE_VMeshCache_SetMaxSpilledBytes (SCE_SVoxelMeshCache *cache,
+                                        size_t bytes)
+{
+    SCE_SVMeshCacheEntry *e = NULL;
+
+    cache->max_spilled_bytes = bytes;
+    while (cache->spilled_bytes > bytes) {
+        e = SCE_List_GetData (SCE_List_GetFirst (&cache->spilled));
+        SCE_VMeshCache_FreeEntry (cache, e);
+    }
+}
+
+/* reads back the geometry of a spilled entry */
+static int SCE_VMeshCache_Load (SCE_SVoxelMeshCache *cache,
+                                SCE_SVMeshCacheEntry *e)
+{
+    FILE *fp = NULL;
+    char *path = NULL;
+    SCEubyte *data = NULL;
+    size_t n = 0;
+
+    if (!(path = SCE_VMeshCache_MakePath (cache, e)))
+        return SCE_ERROR;
+    if ((data = SCE_malloc (e->size)) && (fp = fopen (path, "rb"))) {
+        n = fread (data, 1, e->size, fp);
+        fclose (fp);
+    }
+    if (n != e->size) {
+        SCE_free (data);
+        SCE_free (path);
+        return SCE_ERROR;
+    }
+    remove (path);
+    SCE_free (path);
+
+    e->indices = (SCEuint*)data;
+    e->vertices = data ? &data[e->n_indices * sizeof *e->indices] : NULL;
+    e->spilled = SCE_FALSE;
+    cache->spilled_bytes -= e->size;
+    cache->bytes += e->size;
+    SCE_List_Remove (&e->it);
+    SCE_List_Appendl (&cache->lru, &e->it);
+    return SCE_OK;
+}
+
+/* makes room for \p size bytes by evicting the least recently used
+   entries, except \p keep */
+static void SCE_VMeshCache_Reserve (SCE_SVoxelMeshCache *cache, size_t size,
+                                    SCE_SVMeshCacheEntry *keep)
+{
+    SCE_SVMeshCacheEntry *e = NULL;
+
+    while (cache->bytes + size > cache->max_bytes &&
+           SCE_List_HasElements (&cache->lru)) {
+        e = SCE_List_GetData (SCE_List_GetFirst (&cache->lru));
+        if (e == keep) {
+            /* the most recently used entry, nothing else to evict */
+            if (SCE_List_GetLast (&cache->lru) == &e->it)
+                break;
+            SCE_List_Remove (&e->it);
+            SCE_List_Appendl (&cache->lru, &e->it);
+            continue;
+        }
+        /* a failed spill only loses the entry */
+        if (!cache->spill || e->discarded ||
+            SCE_VMeshCache_Spill (cache, e) < 0)
+            SCE_VMeshCache_FreeEntry (cache, e);
+    }
+}
+
+/**
+ * \brief Removes every entry of a cache
+ */
+void SCE_VMeshCache_Flush (SCE_SVoxelMeshCache *cache)
+{
+    SCE_SListIterator *it = NULL, *pro = NULL;
+
+    SCE_List_ForEachProtected (pro, it, &cache->lru)
+        SCE_VMeshCache_FreeEntry (cache, SCE_List_GetData (it));
+    SCE_List_ForEachProtected (pro, it, &cache->spilled)
+        SCE_VMeshCache_FreeEntry (cache, SCE_List_GetData (it));
+    SCE_VMeshCache_PushHistory (cache, SCE_TRUE, 0, NULL);
+}
+
+static void SCE_VMeshCache_InvalidateList (SCE_SVoxelMeshCache *cache,
+                                           SCE_SList *list, SCEuint level,
+                                           const SCE_SLongRect3 *rect)
+{
+    SCE_SListIterator *it = NULL, *pro = NULL;
+    SCE_SVMeshCacheEntry *e = NULL;
+    SCE_SLongRect3 box;
+
+    SCE_List_ForEachProtected (pro, it, list) {
+        e = SCE_List_GetData (it);
+        if (e->level != level || e->discarded)
+            continue;
+        SCE_VMeshCache_GetNodeBox (cache, e->x, e->y, e->z, &box);
+        if (SCE_Rectangle3_Intersectsl (&box, rect))
+            SCE_VMeshCache_FreeEntry (cache, e);
+    }
+}
+/**
+ * \brief Signals a modification of the voxels of a level
+ * \param cache a cache
+ * \param level modified level
+ * \param rect modified area, in voxels of \p level
+ *
+ * Removes the entries whose node reads voxels of \p rect and bumps the data
+ * version of the cache. The area is remembered to refuse the geometry of
+ * the nodes reading it generated before this call.
+ * \sa SCE_VMeshCache_SetNodeSize(), SCE_VMeshCache_GetVersion()
+ */
+void SCE_VMeshCache_Invalidate (SCE_SVoxelMeshCache *cache, SCEuint level,
+                                const SCE_SLongRect3 *rect)
+{
+    SCE_VMeshCache_InvalidateList (cache, &cache->lru, level, rect);
+    SCE_VMeshCache_InvalidateList (cache, &cache->spilled, level, rect);
+    SCE_VMeshCache_PushHistory (cache, SCE_FALSE, level, rect);
+}
+
+static int SCE_VMeshCache_Put (SCE_SVoxelMeshCache *cache, SCEuint version,
+                               SCEuint level, long x, long y, long z,
+                               const void *vertices, SCEuint n_vertices,
+                               const SCEuint *indices, SCEuint n_indices,
+                               int prefetched)
+{
+    SCE_SVMeshCacheEntry *e = NULL;
+    SCEubyte *data = NULL;
+    size_t isize, vsize;
+    int discarded = SCE_FALSE;
+
+    if (!cache->max_bytes)
+        return SCE_OK;
+    if (version != cache->version &&
+        SCE_VMeshCache_IsOutdated (cache, version, level, x, y, z)) {
+        /* remember the refused prefetches, not to prefetch them again */
+        if (!prefetched || SCE_VMeshCache_Find (cache, level, x, y, z))
+            return SCE_OK;
+        discarded = SCE_TRUE;
+        n_vertices = n_indices = 0;
+    }
+
+    if ((e = SCE_VMeshCache_Find (cache, level, x, y, z)))
+        SCE_VMeshCache_FreeEntry (cache, e);
+
+    isize = n_indices * sizeof *indices;
+    vsize = n_vertices * cache->stride;
+    if (isize + vsize > cache->max_bytes)
+        return SCE_OK;
+    SCE_VMeshCache_Reserve (cache, isize + vsize, NULL);
+
+    if (!(e = SCE_malloc (sizeof *e)))
+        goto fail;
+    SCE_VMeshCache_InitEntry (e);
+    /* empty nodes are recorded as well, without any data */
+    if (isize + vsize) {
+        if (!(data = SCE_malloc (isize + vsize)))
+            goto fail;
+        memcpy (data, indices, isize);
+        memcpy (&data[isize], vertices, vsize);
+    }
+
+    e->level = level;
+    e->x = x;
+    e->y = y;
+    e->z = z;
+    e->indices = (SCEuint*)data;
+    e->vertices = data ? &data[isize] : NULL;
+    e->n_vertices = n_vertices;
+    e->n_indices = n_indices;
+    e->size = isize + vsize;
+    e->prefetched = prefetched;
+    e->discarded = discarded;
+    cache->bytes += e->size;
+    SCE_List_Appendl (&cache->lru, &e->it);
+    SCE_List_Appendl (SCE_VMeshCache_GetBucket (cache, level, x, y, z),
+                      &e->it2);
+    return SCE_OK;
+fail:
+    SCE_free (e);
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+/**
+ * \brief Stores the geometry of a node
+ * \param cache a cache
+ * \param version data version of the voxels the geometry was generated
+ * from, see SCE_VMeshCache_GetVersion()
+ * \param level level of the node
+ * \param x,y,z origin of the node
+ * \param vertices interleaved vertices, see SCE_VMeshCache_SetStride()
+ * \param n_vertices number of vertices
+ * \param indices 32 bits indices
+ * \param n_indices number of indices
+ *
+ * Does nothing when the cache is disabled or when the voxels read by the
+ * node have been invalidated since \p version.
+ * Any previous geometry of the node is replaced. A node without surface is
+ * stored with no vertices, so that it is known to be empty.
+ */
+int SCE_VMeshCache_Store (SCE_SVoxelMeshCache *cache, SCEuint version,
+                          SCEuint level, long x, long y, long z,
+                          const void *vertices, SCEuint n_vertices,
+                          const SCEuint *indices, SCEuint n_indices)
+{
+    if (SCE_VMeshCache_Put (cache, version, level, x, y, z, vertices,
+                            n_vertices, indices, n_indices, SCE_FALSE) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    return SCE_OK;
+}
+/**
+ * \brief Same as SCE_VMeshCache_Store() for the geometry of a node
+ * generated ahead of need
+ *
+ * The first lookup of the entry is reported by
+ * SCE_VMeshCache_GetNumPrefetchHits().
+ */
+int SCE_VMeshCache_Prefetch (SCE_SVoxelMeshCache *cache, SCEuint version,
+                             SCEuint level, long x, long y, long z,
+                             const void *vertices, SCEuint n_vertices,
+                             const SCEuint *indices, SCEuint n_indices)
+{
+    if (SCE_VMeshCache_Put (cache, version, level, x, y, z, vertices,
+                            n_vertices, indices, n_indices, SCE_TRUE) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    return SCE_OK;
+}
+/**
+ * \brief Checks whether the geometry of a node is in the cache, in memory
+ * or on disk, without touching the statistics nor the order of the entries
+ *
+ * Also true for a node whose prefetch has been refused, so that it is not
+ * prefetched again.
+ */
+int SCE_VMeshCache_Contains (SCE_SVoxelMeshCache *cache, SCEuint level,
+                             long x, long y, long z)
+{
+    return cache->max_bytes && SCE_VMeshCache_Find (cache, level, x, y, z);
+}
+
+/**
+ * \brief Looks up the geometry of a node
+ * \param cache a cache
+ * \param level level of the node
+ * \param x,y,z origin of the node
+ * \returns the entry of the node with its geometry in memory, or NULL
+ *
+ * The returned entry becomes the most recently used one, it remains valid
+ * until the next call to a function modifying the cache.
+ */
+SCE_SVMeshCacheEntry* SCE_VMeshCache_Get (SCE_SVoxelMeshCache *cache,
+                                          SCEuint level, long x, long y,
+                                          long z)
+{
+    SCE_SVMeshCacheEntry *e = NULL;
+
+    if (!cache->max_bytes)
+        return NULL;
+    if (!(e = SCE_VMeshCache_Find (cache, level, x, y, z))) {
+        cache->n_misses++;
+        return NULL;
+    }
+    if (e->discarded) {
+        SCE_VMeshCache_FreeEntry (cache, e);
+        cache->n_misses++;
+        return NULL;
+    }
+
+    if (e->spilled) {
+        if (SCE_VMeshCache_Load (cache, e) < 0) {
+            /* file removed or unreadable */
+            SCE_VMeshCache_FreeEntry (cache, e);
+            cache->n_misses++;
+            return NULL;
+        }
+        cache->n_spill_hits++;
+        SCE_VMeshCache_Reserve (cache, 0, e);
+    } else {
+        SCE_List_Remove (&e->it);
+        SCE_List_Appendl (&cache->lru, &e->it);
+    }
+    if (e->prefetched) {
+        e->prefetched = SCE_FALSE;
+        cache->n_prefetch_hits++;
+    }
+    cache->n_hits++;
+    return e;
+}
+
+/**
+ * \brief Gets the statistics of a cache
+ * \param cache a cache
+ * \param hits number of successful lookups
+ * \param misses number of failed lookups
+ * \param bytes memory used by the entries
+ * \param spilled size of the entries spilled on disk
+ *
+ * Any of the pointers can be NULL.
+ * \sa SCE_VMeshCache_GetHitRate(), SCE_VMeshCache_ResetStats()
+ */
+void SCE_VMeshCache_GetStats (const SCE_SVoxelMeshCache *cache, SCEuint *hits,
+                              SCEuint *misses, size_t *bytes, size_t *spilled)
+{
+    if (hits) *hits = cache->n_hits;
+    if (misses) *misses = cache->n_misses;
+    if (bytes) *bytes = cache->bytes;
+    if (spilled) *spilled = cache->spilled_bytes;
+}
+/**
+ * \brief Gets the ratio of successful lookups, between 0 and 1
+ */
+float SCE_VMeshCache_GetHitRate (const SCE_SVoxelMeshCache *cache)
+{
+    SCEuint n = cache->n_hits + cache->n_misses;
+    return n ? (float)cache->n_hits / n : 0.0;
+}
+/**
+ * \brief Gets the number of entries stored by SCE_VMeshCache_Prefetch()
+ * that have been looked up since
+ */
+SCEuint SCE_VMeshCache_GetNumPrefetchHits (const SCE_SVoxelMeshCache *cache)
+{
+    return cache->n_prefetch_hits;
+}
+void SCE_VMeshCache_ResetStats (SCE_SVoxelMeshCache *cache)
+{
+    cache->n_hits = cache->n_misses = 0;
+    cache->n_spill_hits = 0;
+    cache->n_prefetch_hits = 0;
+}
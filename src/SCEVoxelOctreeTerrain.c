@@ -17,8 +17,10 @@
  -----------------------------------------------------------------------------*/
 
 /* created: 16/03/2013
-   updated: 23/03/2013 */
+   updated: 19/10/2026 */
 
+#include <string.h>
+#include <pthread.h>
 #include <SCE/core/SCECore.h>
 #include <SCE/renderer/SCERenderer.h>
 
@@ -27,15 +29,32 @@
 
 #include "SCE/interface/SCEVoxelOctreeTerrain.h"
 
+/* number of blocks moved by each defragmentation step of the mesh arena */
+#define SCE_VOTERRAIN_DEFRAGMENT_MOVES 2
+/* number of blocks moved to make room when the mesh arena is full */
+#define SCE_VOTERRAIN_FULL_DEFRAGMENT_MOVES 32
+/* number of updates skipping the worlds while the worker thread reads them,
+   before waiting for it */
+#define SCE_VOTERRAIN_MAX_WORLD_SKIPS 4
+
 
 static void SCE_VOTerrain_InitRegion (SCE_SVOTerrainRegion *region)
 {
     region->status = SCE_VOTERRAIN_REGION_POOL; /* even though it's not true. */
-    SCE_Mesh_Init (&region->mesh);
-    SCE_Matrix4_Identity (region->matrix);
+    region->mesh = NULL;
+    SCE_MeshArena_InitAlloc (&region->alloc);
     region->draw = SCE_FALSE;
     region->node = NULL;
+    SCE_Vector3_Set (region->pos, 0.0, 0.0, 0.0);
+    region->size = 0.0;
+    region->cull_frame = 0;
+    region->cull = SCE_COLLIDE_OUT;
     region->level = NULL;
+    region->version = 0;
+    region->stage = 0;
+    region->urgent = region->refine = SCE_FALSE;
+    region->edit_time = 0.0;
+    region->prefetch = SCE_FALSE;
     SCE_List_InitIt (&region->it);
     SCE_List_SetData (&region->it, region);
     SCE_List_InitIt (&region->it2);
@@ -47,7 +66,6 @@ static void SCE_VOTerrain_InitRegion (SCE_SVOTerrainRegion *region)
 }
 static void SCE_VOTerrain_ClearRegion (SCE_SVOTerrainRegion *region)
 {
-    SCE_Mesh_Clear (&region->mesh);
     /* TODO: avoid node callback from being called...? */
     if (region->node)
         SCE_VOctree_SetNodeData (region->node, NULL);
@@ -56,27 +74,22 @@ static void SCE_VOTerrain_ClearRegion (SCE_SVOTerrainRegion *region)
     SCE_List_Remove (&region->it3);
     SCE_List_Remove (&region->it4);
 }
-static SCE_SVOTerrainRegion* SCE_VOTerrain_CreateRegion (void)
-{
-    SCE_SVOTerrainRegion *region = NULL;
-    if (!(region = SCE_malloc (sizeof *region)))
-        SCEE_LogSrc ();
-    else {
-        SCE_VOTerrain_InitRegion (region);
-    }
-    return region;
-}
-static void SCE_VOTerrain_DeleteRegion (SCE_SVOTerrainRegion *region)
+/* regions are freed along with their slab */
+static void SCE_VOTerrain_FreeRegion (void *r)
 {
-    if (region) {
-        SCE_VOTerrain_ClearRegion (region);
-        SCE_free (region);
-    }
+    SCE_VOTerrain_ClearRegion (r);
 }
 
-static void SCE_VOTerrain_FreeRegion (void *r)
+static void SCE_VOTerrain_DeleteSlab (SCE_SVOTerrainSlab *slab)
 {
-    SCE_VOTerrain_DeleteRegion (r);
+    SCEuint i;
+
+    if (slab->meshes) {
+        for (i = 0; i < SCE_VOTERRAIN_SLAB_SIZE; i++)
+            SCE_Mesh_Clear (&slab->meshes[i]);
+        SCE_free (slab->meshes);
+    }
+    SCE_free (slab);
 }
 static void SCE_VOTerrain_InitLevel (SCE_SVOTerrainLevel *tl)
 {
@@ -88,6 +101,14 @@ static void SCE_VOTerrain_InitLevel (SCE_SVOTerrainLevel *tl)
     SCE_List_Init (&tl->ready);
     SCE_List_Init (&tl->to_render);
     SCE_List_Init (&tl->hidden);
+    SCE_List_Init (&tl->prefetched);
+    SCE_List_SetFreeFunc (&tl->prefetched, SCE_VOTerrain_FreeRegion);
+    tl->updates.rects = tl->edits.rects = NULL;
+    tl->updates.n = tl->updates.max = 0;
+    tl->edits.n = tl->edits.max = 0;
+    tl->edit_time = 0.0;
+    tl->decimation = 0.7;
+    tl->max_vertices = 0;
 }
 static void SCE_VOTerrain_ClearLevel (SCE_SVOTerrainLevel *tl)
 {
@@ -95,6 +116,9 @@ static void SCE_VOTerrain_ClearLevel (SCE_SVOTerrainLevel *tl)
     SCE_List_Clear (&tl->ready);
     SCE_List_Clear (&tl->to_render);
     SCE_List_Clear (&tl->hidden);
+    SCE_List_Clear (&tl->prefetched);
+    SCE_free (tl->updates.rects);
+    SCE_free (tl->edits.rects);
 }
 
 
@@ -131,6 +155,8 @@ static void SCE_VOTerrain_InitPipeline (SCE_SVOTerrainPipeline *pipe)
         SCE_List_Init (&pipe->stages[i]);
 
     SCE_QEMD_Init (&pipe->qmesh);
+    pipe->optimize = 0;
+    SCE_MeshOpt_Init (&pipe->opt);
     pipe->vertices = NULL;
     pipe->normals = NULL;
     pipe->materials = NULL;
@@ -141,6 +167,36 @@ static void SCE_VOTerrain_InitPipeline (SCE_SVOTerrainPipeline *pipe)
 
     pipe->vstride = pipe->nstride = pipe->mstride = 0;
     pipe->stride = 0;
+    pipe->decode = NULL;
+    pipe->encode = NULL;
+
+    SCE_Texture_InitStream (&pipe->stream);
+    pipe->async = SCE_FALSE;
+    pipe->running = SCE_FALSE;
+    pipe->quit = SCE_FALSE;
+    pthread_mutex_init (&pipe->mutex, NULL);
+    pthread_cond_init (&pipe->cond, NULL);
+    for (i = 0; i < SCE_VOTERRAIN_NUM_FETCHES; i++) {
+        SCE_SVOTerrainFetch *f = &pipe->fetches[i];
+        f->state = SCE_VOTERRAIN_FETCH_FREE;
+        f->cancel = f->error = SCE_FALSE;
+        f->region = NULL;
+        f->level = 0;
+        f->x = f->y = f->z = 0;
+        f->density = f->material = NULL;
+    }
+    pipe->n_async = pipe->n_sync = 0;
+
+    pipe->batch = 1;
+    for (i = 0; i < SCE_VOTERRAIN_MAX_BATCH; i++) {
+        SCE_SVOTerrainSlot *slot = &pipe->slots[i];
+        slot->tc = slot->tc_mat = NULL;
+        slot->tex = slot->material = NULL;
+        SCE_Mesh_Init (&slot->mesh);
+        SCE_VRender_InitMesh (&slot->vmesh);
+        SCE_VRender_SetMesh (&slot->vmesh, &slot->mesh);
+        slot->region = slot->mregion = NULL;
+    }
 }
 static void SCE_VOTerrain_ClearPipeline (SCE_SVOTerrainPipeline *pipe)
 {
@@ -159,12 +215,98 @@ static void SCE_VOTerrain_ClearPipeline (SCE_SVOTerrainPipeline *pipe)
         SCE_List_Clear (&pipe->stages[i]);
 
     SCE_QEMD_Clear (&pipe->qmesh);
+    SCE_MeshOpt_Clear (&pipe->opt);
     SCE_free (pipe->vertices);
     SCE_free (pipe->normals);
     SCE_free (pipe->materials);
     SCE_free (pipe->indices);
     SCE_free (pipe->anchors);
     SCE_free (pipe->interleaved);
+
+    SCE_Texture_ClearStream (&pipe->stream);
+    for (i = 0; i < SCE_VOTERRAIN_NUM_FETCHES; i++) {
+        SCE_free (pipe->fetches[i].density);
+        SCE_free (pipe->fetches[i].material);
+    }
+    pthread_cond_destroy (&pipe->cond);
+    pthread_mutex_destroy (&pipe->mutex);
+
+    for (i = 0; i < SCE_VOTERRAIN_MAX_BATCH; i++) {
+        SCE_Texture_Delete (pipe->slots[i].tex);
+        SCE_Texture_Delete (pipe->slots[i].material);
+        SCE_Mesh_Clear (&pipe->slots[i].mesh);
+    }
+}
+
+/* fetches the voxels of the queued regions, ahead of Stage1 */
+static void* SCE_VOTerrain_Worker (void *data)
+{
+    SCE_SVoxelOctreeTerrain *vt = data;
+    SCE_SVOTerrainPipeline *pipe = &vt->pipe;
+    SCE_SVOTerrainFetch *f = NULL;
+    SCE_SLongRect3 rect;
+    int i, error;
+
+    pthread_mutex_lock (&pipe->mutex);
+    while (!pipe->quit) {
+        f = NULL;
+        for (i = 0; i < SCE_VOTERRAIN_NUM_FETCHES && !f; i++) {
+            if (pipe->fetches[i].state == SCE_VOTERRAIN_FETCH_QUEUED)
+                f = &pipe->fetches[i];
+        }
+        if (!f) {
+            pthread_cond_wait (&pipe->cond, &pipe->mutex);
+            continue;
+        }
+        f->state = SCE_VOTERRAIN_FETCH_BUSY;
+        SCE_Rectangle3_SetFromOriginl (&rect, f->x - 2, f->y - 2, f->z - 2,
+                                       vt->w + 4, vt->h + 4, vt->d + 4);
+        pthread_mutex_unlock (&pipe->mutex);
+
+        /* the slot is ours as long as it is busy */
+        pthread_mutex_lock (&vt->world_mutex);
+        error = SCE_VWorld_GetRegion (vt->vw, f->level, &rect,
+                                      f->density) < 0;
+        if (!error && pipe->use_materials)
+            error = SCE_VWorld_GetRegion (vt->mw, f->level, &rect,
+                                          f->material) < 0;
+        pthread_mutex_unlock (&vt->world_mutex);
+
+        pthread_mutex_lock (&pipe->mutex);
+        f->error = error;
+        f->state = f->cancel ? SCE_VOTERRAIN_FETCH_FREE :
+            SCE_VOTERRAIN_FETCH_READY;
+        f->cancel = SCE_FALSE;
+    }
+    pthread_mutex_unlock (&pipe->mutex);
+
+    return NULL;
+}
+static int SCE_VOTerrain_StartWorker (SCE_SVoxelOctreeTerrain *vt)
+{
+    SCE_SVOTerrainPipeline *pipe = &vt->pipe;
+
+    pipe->quit = SCE_FALSE;
+    if (pthread_create (&pipe->thread, NULL, SCE_VOTerrain_Worker, vt) != 0) {
+        SCEE_Log (SCE_INVALID_OPERATION);
+        SCEE_LogMsg ("failed to create the voxel fetching thread");
+        return SCE_ERROR;
+    }
+    pipe->running = SCE_TRUE;
+    return SCE_OK;
+}
+static void SCE_VOTerrain_StopWorker (SCE_SVoxelOctreeTerrain *vt)
+{
+    SCE_SVOTerrainPipeline *pipe = &vt->pipe;
+
+    if (!pipe->running)
+        return;
+    pthread_mutex_lock (&pipe->mutex);
+    pipe->quit = SCE_TRUE;
+    pthread_cond_signal (&pipe->cond);
+    pthread_mutex_unlock (&pipe->mutex);
+    pthread_join (pipe->thread, NULL);
+    pipe->running = SCE_FALSE;
 }
 
 
@@ -174,6 +316,8 @@ void SCE_VOTerrain_Init (SCE_SVoxelOctreeTerrain *vt)
 
     vt->vw = NULL;
     vt->mw = NULL;
+    pthread_mutex_init (&vt->world_mutex, NULL);
+    vt->world_skips = 0;
     vt->n_levels = 0;
     vt->w = vt->h = vt->d = 0;
     vt->n_regions = 0;
@@ -184,10 +328,14 @@ void SCE_VOTerrain_Init (SCE_SVoxelOctreeTerrain *vt)
     vt->comp_pos = vt->comp_nor = SCE_FALSE;
     SCE_Geometry_Init (&vt->region_geom);
     SCE_VOTerrain_InitPipeline (&vt->pipe);
+    vt->built = SCE_FALSE;
 
+    vt->slabs = NULL;
+    vt->n_slabs = 0;
     SCE_List_Init (&vt->pool);
     SCE_List_SetFreeFunc (&vt->pool, SCE_VOTerrain_FreeRegion);
     SCE_List_Init (&vt->to_render);
+    vt->cull_frame = 0;
 
     for (i = 0; i < SCE_VOTERRAIN_MAX_LEVELS; i++) {
         SCE_VOTerrain_InitLevel (&vt->levels[i]);
@@ -196,16 +344,44 @@ void SCE_VOTerrain_Init (SCE_SVoxelOctreeTerrain *vt)
     vt->shader = NULL;
     vt->diffuse = NULL;
     vt->normal = NULL;
+    vt->arena = NULL;
+    vt->arena_vertices = vt->arena_indices = 0;
+    vt->budget = NULL;
+    vt->max_cycles = 8;
+    vt->n_cycles = 0;
+    vt->n_restarts = 0;
+    vt->fast_edits = SCE_FALSE;
+    vt->n_refines = 0;
+    vt->n_edits = 0;
+    vt->edit_latency = vt->max_edit_latency = 0.0;
+    vt->velocity[0] = vt->velocity[1] = vt->velocity[2] = 0.0;
+    vt->prefetch_time = 1.0;
+    vt->screen_error = 0.0;
+    vt->projection = 1.0;
+    vt->max_prefetches = 32;
+    vt->n_prefetching = 0;
+    SCE_List_Init (&vt->prefetch_queue);
+    vt->n_prefetches = vt->n_prefetch_used = 0;
+    SCE_VMeshCache_Init (&vt->cache);
 }
 void SCE_VOTerrain_Clear (SCE_SVoxelOctreeTerrain *vt)
 {
-    int i;
+    SCEuint i;
+    SCE_VOTerrain_StopWorker (vt);
     SCE_Geometry_Clear (&vt->region_geom);
     SCE_VOTerrain_ClearPipeline (&vt->pipe);
     SCE_List_Clear (&vt->pool);
     SCE_List_Clear (&vt->to_render);
+    SCE_List_Clear (&vt->prefetch_queue);
     for (i = 0; i < SCE_VOTERRAIN_MAX_LEVELS; i++)
         SCE_VOTerrain_ClearLevel (&vt->levels[i]);
+    SCE_MeshArena_Delete (vt->arena);
+    SCE_VMeshCache_Clear (&vt->cache);
+    /* no list references the regions anymore */
+    for (i = 0; i < vt->n_slabs; i++)
+        SCE_VOTerrain_DeleteSlab (vt->slabs[i]);
+    SCE_free (vt->slabs);
+    pthread_mutex_destroy (&vt->world_mutex);
 }
 
 SCE_SVoxelOctreeTerrain* SCE_VOTerrain_Create (void)
@@ -240,8 +416,8 @@ void SCE_VOTerrain_SetVoxelWorld (SCE_SVoxelOctreeTerrain *vt,
     vt->w = SCE_VWorld_GetWidth (vw);
     vt->h = SCE_VWorld_GetHeight (vw);
     vt->d = SCE_VWorld_GetDepth (vw);
-    /* TODO: depending on the size of the cells, they might contain more than
-       256**2 vertices, which is the maximum supported by SCEindices */
+    /* NOTE: region meshes pick their index type from their number of
+       vertices, the pipeline works with 32 bits indices */
 }
 void SCE_VOTerrain_SetMaterialWorld (SCE_SVoxelOctreeTerrain *vt,
                                      SCE_SVoxelWorld *mw)
@@ -265,9 +441,44 @@ SCEuint SCE_VOTerrain_GetNumRegions (const SCE_SVoxelOctreeTerrain *vt)
 {
     return vt->n_regions;
 }
+/* world bounds of the geometry of a region, see MakeRegionMatrix() */
+static void SCE_VOTerrain_PlaceRegion (const SCE_SVoxelOctreeTerrain *vt,
+                                       SCE_SVOTerrainRegion *region)
+{
+    long x, y, z;
+    float scale;
+
+    /* voxel scale, level space */
+    scale = vt->scale * (1 << region->level->level);
+    /* translate */
+    SCE_VOctree_GetNodeOriginv (region->node, &x, &y, &z);
+    SCE_Vector3_Set (region->pos, scale * (x - 1), scale * (y - 1),
+                     scale * (z - 1));
+    /* voxel unit */
+    region->size = scale * (vt->w + 4);
+}
+/* places again the regions of a level, which bounds depend on the unit */
+static void SCE_VOTerrain_PlaceRegions (const SCE_SVoxelOctreeTerrain *vt,
+                                        SCE_SList *list)
+{
+    SCE_SListIterator *it = NULL;
+    SCE_List_ForEach (it, list)
+        SCE_VOTerrain_PlaceRegion (vt, SCE_List_GetData (it));
+}
+/**
+ * \brief Sets the size of a voxel of the finest level, in world units
+ *
+ * The regions already generated are moved accordingly.
+ */
 void SCE_VOTerrain_SetUnit (SCE_SVoxelOctreeTerrain *vt, float unit)
 {
+    SCEuint i;
+
     vt->scale = unit;
+    for (i = 0; i < vt->n_levels; i++) {
+        SCE_VOTerrain_PlaceRegions (vt, &vt->levels[i].regions);
+        SCE_VOTerrain_PlaceRegions (vt, &vt->levels[i].prefetched);
+    }
 }
 void SCE_VOTerrain_SetShader (SCE_SVoxelOctreeTerrain *vt, SCE_SShader *shader)
 {
@@ -288,6 +499,322 @@ void SCE_VOTerrain_UseMaterials (SCE_SVoxelOctreeTerrain *vt, int use)
     vt->pipe.use_materials = use;
     SCE_VRender_UseMaterials (&vt->pipe.temp, use);
 }
+/**
+ * \brief Sets the optimization passes applied to the decimated meshes
+ * \sa SCE_MeshOpt_Optimize(), SCE_VOTerrain_GetACMR()
+ */
+void SCE_VOTerrain_SetMeshOptimization (SCE_SVoxelOctreeTerrain *vt,
+                                        SCEbitfield flags)
+{
+    vt->pipe.optimize = flags;
+}
+/**
+ * \brief Gets the average ACMR of the decimated meshes
+ * \param vt a voxel octree terrain
+ * \param before,after ACMR before and after optimization, can be NULL
+ */
+void SCE_VOTerrain_GetACMR (const SCE_SVoxelOctreeTerrain *vt, float *before,
+                            float *after)
+{
+    SCE_MeshOpt_GetAverageACMR (&vt->pipe.opt, before, after);
+}
+
+/* upper bound of the automatic decimation */
+#define SCE_VOTERRAIN_MAX_DECIMATION 0.95
+
+/**
+ * \brief Sets the part of the vertices of each region of a level removed
+ * by the decimation
+ * \param vt a voxel octree terrain
+ * \param level a level
+ * \param ratio between 0 (no decimation) and 1, default is 0.7
+ *
+ * The mesh cache is flushed when the ratio changes, since it holds
+ * decimated geometry. \p level must be a level of the voxel world, see
+ * SCE_VOTerrain_SetVoxelWorld().
+ * \sa SCE_VOTerrain_SetMaxRegionVertices(), SCE_VOTerrain_SetScreenError()
+ */
+void SCE_VOTerrain_SetDecimation (SCE_SVoxelOctreeTerrain *vt, SCEuint level,
+                                  float ratio)
+{
+    if (level >= vt->n_levels) {
+        SCEE_Log (SCE_INVALID_ARG);
+        SCEE_LogMsg ("the terrain has no level %u", level);
+        return;
+    }
+    ratio = MAX (0.0, MIN (ratio, 1.0));
+    if (vt->levels[level].decimation != ratio) {
+        vt->levels[level].decimation = ratio;
+        SCE_VMeshCache_Flush (&vt->cache);
+    }
+}
+/**
+ * \brief Sets the number of vertices of a decimated region of a level
+ * \param vt a voxel octree terrain
+ * \param level a level
+ * \param n maximum number of vertices, 0 for no limit (default)
+ *
+ * Regions with more vertices after the decimation ratio has been applied
+ * are decimated further, anchored vertices excepted.
+ * \sa SCE_VOTerrain_SetDecimation()
+ */
+void SCE_VOTerrain_SetMaxRegionVertices (SCE_SVoxelOctreeTerrain *vt,
+                                         SCEuint level, SCEuint n)
+{
+    if (level >= vt->n_levels) {
+        SCEE_Log (SCE_INVALID_ARG);
+        SCEE_LogMsg ("the terrain has no level %u", level);
+        return;
+    }
+    if (vt->levels[level].max_vertices != n) {
+        vt->levels[level].max_vertices = n;
+        SCE_VMeshCache_Flush (&vt->cache);
+    }
+}
+/**
+ * \brief Decimates each level from the size of its voxels on the screen
+ * \param vt a voxel octree terrain
+ * \param error tolerated error in pixels, 0 to use the ratio given to
+ * SCE_VOTerrain_SetDecimation() instead (default)
+ * \param projection pixels covered by one unit at a distance of one unit,
+ * usually the viewport height / (2 tan (fovy / 2))
+ * \sa SCE_VOTerrain_GetDecimation(), SCE_VTerrain_SetScreenError()
+ */
+void SCE_VOTerrain_SetScreenError (SCE_SVoxelOctreeTerrain *vt, float error,
+                                   float projection)
+{
+    if (vt->screen_error != error || vt->projection != projection) {
+        vt->screen_error = error;
+        vt->projection = projection;
+        SCE_VMeshCache_Flush (&vt->cache);
+    }
+}
+/**
+ * \brief Gets the part of the vertices removed from the regions of a level
+ * \sa SCE_VOTerrain_SetDecimation(), SCE_VOTerrain_SetScreenError()
+ */
+float SCE_VOTerrain_GetDecimation (const SCE_SVoxelOctreeTerrain *vt,
+                                   SCEuint level)
+{
+    float extent, d, size, keep;
+
+    if (level >= vt->n_levels) {
+        SCEE_Log (SCE_INVALID_ARG);
+        SCEE_LogMsg ("the terrain has no level %u", level);
+        return 0.0;
+    }
+    if (vt->screen_error <= 0.0)
+        return vt->levels[level].decimation;
+
+    /* middle of the shell left by the finer level, in voxels of level 0 */
+    extent = (float)vt->n_regions * vt->w * (1 << level);
+    d = (level ? 0.375 : 0.25) * extent;
+    /* size of a voxel of the level on the screen */
+    size = (1 << level) * vt->projection / MAX (d, 1.0);
+    keep = size / vt->screen_error;
+    keep *= keep;
+    return MAX (0.0, MIN (1.0 - keep, SCE_VOTERRAIN_MAX_DECIMATION));
+}
+/* number of vertex collapses of a region of \p tl */
+static SCEuint SCE_VOTerrain_GetCollapses (const SCE_SVoxelOctreeTerrain *vt,
+                                           const SCE_SVOTerrainLevel *tl,
+                                           SCEuint n_vertices,
+                                           SCEuint n_anchors)
+{
+    SCEuint n, removable;
+
+    removable = n_vertices > n_anchors ? n_vertices - n_anchors : 0;
+    n = removable * SCE_VOTerrain_GetDecimation (vt, tl->level);
+    if (tl->max_vertices && n_vertices - n > tl->max_vertices)
+        n = MIN (removable, n_vertices - tl->max_vertices);
+    return n;
+}
+
+/**
+ * \brief Stores the geometry of all the regions into a single mesh arena
+ * \param vt a voxel octree terrain
+ * \param max_vertices,max_indices size of the arena, 0 disables it (default)
+ *
+ * When enabled, decimated regions are sub-allocated into the shared buffers
+ * of the arena instead of reallocating their own buffers, and all the
+ * regions are drawn with a single multi-draw call: the shader must then read
+ * the object matrix from the per-draw attributes of the arena's batch (see
+ * SCE_MeshBatch_SetAttribIndices()). Must be called before
+ * SCE_VOTerrain_Build().
+ * \sa SCE_VOTerrain_GetMeshArena(), SCE_SMeshArena
+ */
+void SCE_VOTerrain_SetArenaSize (SCE_SVoxelOctreeTerrain *vt,
+                                 SCEuint max_vertices, SCEuint max_indices)
+{
+    vt->arena_vertices = max_vertices;
+    vt->arena_indices = max_indices;
+}
+/**
+ * \brief Gets the mesh arena of a terrain, mostly for its statistics
+ * \returns the arena or NULL if the terrain doesn't use any
+ * \sa SCE_VOTerrain_SetArenaSize(), SCE_MeshArena_GetVertexFragmentation()
+ */
+SCE_SMeshArena* SCE_VOTerrain_GetMeshArena (SCE_SVoxelOctreeTerrain *vt)
+{
+    return vt->arena;
+}
+
+/**
+ * \brief Limits the time spent generating regions by a frame budget
+ * \param vt a voxel octree terrain
+ * \param budget a frame budget, possibly shared with other modules, NULL
+ * disables it (default)
+ *
+ * Without a budget, SCE_VOTerrain_Update() runs the pipeline once, moving
+ * one region through each stage. With a budget it runs the pipeline again
+ * as long as the budget has time left, up to the maximum given to
+ * SCE_VOTerrain_SetMaxCycles(). The time spent by the whole update is
+ * charged to the budget.
+ * \sa SCE_FrameBudget_Begin(), SCE_VTerrain_SetFrameBudget()
+ */
+void SCE_VOTerrain_SetFrameBudget (SCE_SVoxelOctreeTerrain *vt,
+                                   SCE_SFrameBudget *budget)
+{
+    vt->budget = budget;
+}
+/**
+ * \brief Sets the maximum number of pipeline cycles per frame when a frame
+ * budget is used, 8 by default
+ * \sa SCE_VOTerrain_SetFrameBudget()
+ */
+void SCE_VOTerrain_SetMaxCycles (SCE_SVoxelOctreeTerrain *vt, SCEuint n)
+{
+    vt->max_cycles = MAX (n, 1);
+}
+/**
+ * \brief Fetches the voxels of the regions to generate on a worker thread
+ * \param vt a voxel octree terrain
+ * \param async SCE_TRUE to enable, SCE_FALSE by default
+ *
+ * The voxels of the next regions of the pipeline are fetched from the voxel
+ * worlds ahead of time, the first stage of the pipeline only uploads them
+ * and never waits for the worker thread. Any modification of the worlds
+ * must then be done between SCE_VOTerrain_LockWorld() and
+ * SCE_VOTerrain_UnlockWorld().
+ * \returns SCE_ERROR if \p vt has already been built, the worker thread and
+ * its buffers being set up by SCE_VOTerrain_Build(), SCE_OK otherwise
+ * \sa SCE_VOTerrain_GetFetchStats()
+ */
+int SCE_VOTerrain_SetAsyncFetch (SCE_SVoxelOctreeTerrain *vt, int async)
+{
+    if (vt->built) {
+        SCEE_Log (SCE_INVALID_OPERATION);
+        SCEE_LogMsg ("asynchronous fetching must be set before building "
+                     "the terrain");
+        return SCE_ERROR;
+    }
+    vt->pipe.async = async;
+    return SCE_OK;
+}
+
+/* the worlds are only shared with the worker thread of asynchronous
+   fetching, the lock is not taken otherwise */
+static void SCE_VOTerrain_Lock (SCE_SVoxelOctreeTerrain *vt)
+{
+    if (vt->pipe.async)
+        pthread_mutex_lock (&vt->world_mutex);
+}
+static void SCE_VOTerrain_Unlock (SCE_SVoxelOctreeTerrain *vt)
+{
+    if (vt->pipe.async)
+        pthread_mutex_unlock (&vt->world_mutex);
+}
+/**
+ * \brief Prevents the worker thread from reading the voxel worlds
+ *
+ * Does nothing unless asynchronous fetching is enabled. The lock is not
+ * recursive: SCE_VOTerrain_SetPosition() and SCE_VOTerrain_Update() must
+ * not be called before SCE_VOTerrain_UnlockWorld(), the first one would
+ * deadlock and the second one would end up waiting for the lock forever.
+ * \sa SCE_VOTerrain_UnlockWorld(), SCE_VOTerrain_SetAsyncFetch()
+ */
+void SCE_VOTerrain_LockWorld (SCE_SVoxelOctreeTerrain *vt)
+{
+    SCE_VOTerrain_Lock (vt);
+}
+/**
+ * \brief Lets the worker thread read the voxel worlds again
+ * \sa SCE_VOTerrain_LockWorld()
+ */
+void SCE_VOTerrain_UnlockWorld (SCE_SVoxelOctreeTerrain *vt)
+{
+    SCE_VOTerrain_Unlock (vt);
+}
+/**
+ * \brief Gets the number of regions whose voxels were fetched
+ * \param vt a voxel octree terrain
+ * \param async number of regions fetched ahead by the worker thread
+ * \param sync number of regions fetched by the pipeline itself
+ * \sa SCE_VOTerrain_SetAsyncFetch()
+ */
+void SCE_VOTerrain_GetFetchStats (const SCE_SVoxelOctreeTerrain *vt,
+                                  SCEuint *async, SCEuint *sync)
+{
+    if (async)
+        *async = vt->pipe.n_async;
+    if (sync)
+        *sync = vt->pipe.n_sync;
+}
+/**
+ * \brief Sets the number of regions polygonized by each pipeline cycle
+ * \param vt a voxel octree terrain
+ * \param n number of regions, 1 by default, at most SCE_VOTERRAIN_MAX_BATCH
+ *
+ * With more than one region, every region of a cycle gets its own volume
+ * textures and all of them are given to SCE_VRender_HardwareBatch() at once.
+ * Must be called before SCE_VOTerrain_Build().
+ * \sa SCE_VRender_HardwareBatch()
+ */
+void SCE_VOTerrain_SetBatchSize (SCE_SVoxelOctreeTerrain *vt, SCEuint n)
+{
+    vt->pipe.batch = MAX (1, MIN (n, SCE_VOTERRAIN_MAX_BATCH));
+}
+/**
+ * \brief Keeps the final geometry of the regions in memory
+ * \param vt a voxel octree terrain
+ * \param bytes memory budget of the cache, 0 disables it (default)
+ *
+ * The geometry of every decimated region is kept in a LRU cache, keyed by
+ * octree node. When a node comes back into view its geometry is uploaded
+ * right away instead of going through the pipeline again. Modifications
+ * of the voxel world reported to SCE_VOTerrain_Update() invalidate the
+ * matching entries.
+ * \sa SCE_VOTerrain_SetMeshCacheSpill(), SCE_VOTerrain_GetMeshCache()
+ */
+void SCE_VOTerrain_SetMeshCacheSize (SCE_SVoxelOctreeTerrain *vt,
+                                     size_t bytes)
+{
+    SCE_VMeshCache_SetMaxBytes (&vt->cache, bytes);
+}
+/**
+ * \brief Writes the regions evicted from the mesh cache into a directory
+ * \param vt a voxel octree terrain
+ * \param dir an existing directory, NULL disables spilling (default)
+ * \sa SCE_VOTerrain_SetMeshCacheSize(), SCE_VMeshCache_SetSpillDirectory()
+ */
+int SCE_VOTerrain_SetMeshCacheSpill (SCE_SVoxelOctreeTerrain *vt,
+                                     const char *dir)
+{
+    if (SCE_VMeshCache_SetSpillDirectory (&vt->cache, dir) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    return SCE_OK;
+}
+/**
+ * \brief Gets the mesh cache of a terrain, mostly for its statistics
+ * \sa SCE_VOTerrain_SetMeshCacheSize(), SCE_VMeshCache_GetHitRate(),
+ * SCE_VMeshCache_GetStats()
+ */
+SCE_SVoxelMeshCache* SCE_VOTerrain_GetMeshCache (SCE_SVoxelOctreeTerrain *vt)
+{
+    return &vt->cache;
+}
 
 SCEuint SCE_VOTerrain_GetWidth (const SCE_SVoxelOctreeTerrain *vt)
 {
@@ -303,6 +830,42 @@ SCEuint SCE_VOTerrain_GetDepth (const SCE_SVoxelOctreeTerrain *vt)
 }
 
 
+static int SCE_VOTerrain_BuildSlot (SCE_SVOTerrainPipeline *pipe,
+                                    SCE_SVOTerrainSlot *slot)
+{
+    if (!(slot->tc = SCE_TexData_Create ()))
+        goto fail;
+    if (!(slot->tex = SCE_Texture_Create (SCE_TEX_3D, 0, 0, 0)))
+        goto fail;
+    if (!(slot->tc_mat = SCE_TexData_Create ()))
+        goto fail;
+    if (!(slot->material = SCE_Texture_Create (SCE_TEX_3D, 0, 0, 0)))
+        goto fail;
+    SCE_Grid_ToTexture (&pipe->grid, slot->tc, SCE_PXF_LUMINANCE,
+                        SCE_UNSIGNED_BYTE);
+    SCE_Texture_AddTexData (slot->tex, SCE_TEX_3D, slot->tc);
+    SCE_Grid_ToTexture (&pipe->grid2, slot->tc_mat, SCE_PXF_LUMINANCE,
+                        SCE_UNSIGNED_BYTE);
+    SCE_Texture_AddTexData (slot->material, SCE_TEX_3D, slot->tc_mat);
+
+    SCE_Texture_SetUnit (slot->tex, 0);
+    SCE_Texture_SetUnit (slot->material, 1);
+    SCE_Texture_Build (slot->tex, SCE_FALSE);
+    SCE_Texture_Build (slot->material, SCE_FALSE);
+    SCE_Texture_Pixelize (slot->material, SCE_TRUE);
+    SCE_Texture_SetFilter (slot->material, SCE_TEX_NEAREST);
+
+    if (SCE_Mesh_SetGeometry (&slot->mesh,
+                              SCE_VRender_GetFinalGeometry (&pipe->temp),
+                              SCE_FALSE) < 0)
+        goto fail;
+    SCE_Mesh_AutoBuild (&slot->mesh);
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
 static int SCE_VOTerrain_BuildPipeline (SCE_SVoxelOctreeTerrain *vt,
                                         SCE_SVOTerrainPipeline *pipe)
 {
@@ -317,6 +880,7 @@ static int SCE_VOTerrain_BuildPipeline (SCE_SVoxelOctreeTerrain *vt,
     SCE_VRender_SetDimensions (&pipe->temp, w+2, h+2, d+2);
     SCE_VRender_SetVolumeDimensions (&pipe->temp, w + 4, h + 4, d + 4);
     SCE_VRender_SetCompressedScale (&pipe->temp, 1.0);
+    SCE_VRender_SetBatchSize (&pipe->temp, pipe->batch);
     if (SCE_VRender_Build (&pipe->temp) < 0)
         goto fail;
 
@@ -389,6 +953,14 @@ static int SCE_VOTerrain_BuildPipeline (SCE_SVoxelOctreeTerrain *vt,
     SCE_Mesh_AutoBuild (&pipe->mesh);
     SCE_Mesh_AutoBuild (&pipe->mesh2);
 
+    if (pipe->batch > 1) {
+        SCEuint i;
+        for (i = 0; i < pipe->batch; i++) {
+            if (SCE_VOTerrain_BuildSlot (pipe, &pipe->slots[i]) < 0)
+                goto fail;
+        }
+    }
+
     n = SCE_Grid_GetNumPoints (&pipe->grid);
     dim = w;
 
@@ -413,19 +985,38 @@ static int SCE_VOTerrain_BuildPipeline (SCE_SVoxelOctreeTerrain *vt,
     pipe->nstride = vt->comp_nor ? 4 : 3 * sizeof (SCEvertices);
     pipe->mstride = pipe->use_materials ? 1 : 0;
     pipe->stride = pipe->vstride + pipe->nstride + pipe->mstride;
+    /* TODO: compressed formats have no encoder, comp_pos and comp_nor
+       cannot be set anyway */
+    pipe->decode = pipe->use_materials ? SCE_VOTerrain_DecodeMat :
+        SCE_VOTerrain_Decode;
+    pipe->encode = pipe->use_materials ? SCE_VOTerrain_EncodeMat :
+        SCE_VOTerrain_Encode;
 
     SCE_QEMD_SetMaxVertices (&pipe->qmesh, n * 3);
     SCE_QEMD_SetMaxIndices (&pipe->qmesh, n * 15);
     if (SCE_QEMD_Build (&pipe->qmesh) < 0)
         goto fail;
 
+    if (pipe->async) {
+        size_t i;
+        size = SCE_Grid_GetSize (&pipe->grid);
+        for (i = 0; i < SCE_VOTERRAIN_NUM_FETCHES; i++) {
+            SCE_SVOTerrainFetch *f = &pipe->fetches[i];
+            if (!(f->density = SCE_malloc (size)))
+                goto fail;
+            if (pipe->use_materials && !(f->material = SCE_malloc (size)))
+                goto fail;
+        }
+    }
+
     return SCE_OK;
 fail:
     SCEE_LogSrc ();
     return SCE_ERROR;
 }
 
-static int SCE_VOTerrain_MakeRegionGeometry (SCE_SGeometry *geom, int mat)
+static int SCE_VOTerrain_MakeRegionGeometry (SCE_SGeometry *geom, int mat,
+                                             SCEenum itype)
 {
     SCE_SGeometryArray ar1, ar2, ar3;
 
@@ -445,7 +1036,7 @@ static int SCE_VOTerrain_MakeRegionGeometry (SCE_SGeometry *geom, int mat)
     if (!SCE_Geometry_AddArrayRecDup (geom, &ar1, SCE_FALSE))
         goto fail;
     SCE_Geometry_InitArray (&ar1);
-    SCE_Geometry_SetArrayIndices (&ar1, SCE_INDICES_TYPE, NULL, SCE_FALSE);
+    SCE_Geometry_SetArrayIndices (&ar1, itype, NULL, SCE_FALSE);
     if (!SCE_Geometry_SetIndexArrayDup (geom, &ar1, SCE_FALSE))
         goto fail;
     SCE_Geometry_SetPrimitiveType (geom, SCE_TRIANGLES);
@@ -458,12 +1049,32 @@ fail:
 
 int SCE_VOTerrain_Build (SCE_SVoxelOctreeTerrain *vt)
 {
+    SCEuint n;
+
     if (SCE_VOTerrain_BuildPipeline (vt, &vt->pipe) < 0)
         goto fail;
+    /* Fetch() reads 2 voxels around the nodes */
+    SCE_VMeshCache_SetStride (&vt->cache, vt->pipe.stride);
+    SCE_VMeshCache_SetNodeSize (&vt->cache, vt->w, vt->h, vt->d, 2);
 
+    /* the index type of the arena, enough for the largest region */
+    n = SCE_Grid_GetNumPoints (&vt->pipe.grid) * 3;
     if (SCE_VOTerrain_MakeRegionGeometry (&vt->region_geom,
-                                          vt->pipe.use_materials) < 0)
+                                          vt->pipe.use_materials,
+                                          SCE_Mesh_SelectIndexType (n)) < 0)
+        goto fail;
+
+    if (vt->arena_vertices > 0 && vt->arena_indices > 0) {
+        if (!(vt->arena = SCE_MeshArena_Create ()))
+            goto fail;
+        if (SCE_MeshArena_Setup (vt->arena, &vt->region_geom,
+                                 vt->arena_vertices, vt->arena_indices) < 0)
+            goto fail;
+    }
+
+    if (vt->pipe.async && SCE_VOTerrain_StartWorker (vt) < 0)
         goto fail;
+    vt->built = SCE_TRUE;
 
     return SCE_OK;
 fail:
@@ -472,45 +1083,192 @@ fail:
 }
 
 
+/* flags a region shown without decimation, keeping count of them so that
+   SCE_VOTerrain_Refine() only runs when there is something to refine */
+static void SCE_VOTerrain_SetRefine (SCE_SVoxelOctreeTerrain *vt,
+                                     SCE_SVOTerrainRegion *region, int refine)
+{
+    refine = refine ? SCE_TRUE : SCE_FALSE;
+    if (refine == region->refine)
+        return;
+    region->refine = refine;
+    if (refine)
+        vt->n_refines++;
+    else
+        vt->n_refines--;
+}
+
 static void SCE_VOTerrain_SetToPool (SCE_SVoxelOctreeTerrain *vt,
                                      SCE_SVOTerrainRegion *region)
 {
-    SCE_Mesh_SetNumVertices (&region->mesh, 0);
-    SCE_Mesh_SetNumIndices (&region->mesh, 0);
-    SCE_Mesh_ReallocStream (&region->mesh, SCE_MESH_STREAM_G,
-                            vt->pipe.vertex_pool);
-    SCE_Mesh_ReallocIndexBuffer (&region->mesh, vt->pipe.index_pool);
+    if (vt->arena)
+        SCE_MeshArena_Free (vt->arena, &region->alloc);
+    else {
+        SCE_Mesh_SetNumVertices (region->mesh, 0);
+        SCE_Mesh_SetNumIndices (region->mesh, 0);
+        SCE_Mesh_ReallocStream (region->mesh, SCE_MESH_STREAM_G,
+                                vt->pipe.vertex_pool);
+        SCE_Mesh_ReallocIndexBuffer (region->mesh, vt->pipe.index_pool);
+    }
     SCE_List_Remove (&region->it3);
     SCE_List_Appendl (&vt->pool, &region->it3);
 }
+/* allocates a slab of regions and puts them into the pool */
+static int SCE_VOTerrain_AddSlab (SCE_SVoxelOctreeTerrain *vt)
+{
+    SCE_SVOTerrainSlab *slab = NULL, **slabs = NULL;
+    SCEuint i;
+
+    if (!(slabs = SCE_realloc (vt->slabs, (vt->n_slabs + 1) * sizeof *slabs)))
+        goto fail;
+    vt->slabs = slabs;
+    if (!(slab = SCE_malloc (sizeof *slab)))
+        goto fail;
+    slab->meshes = NULL;
+    vt->slabs[vt->n_slabs++] = slab;
+    for (i = 0; i < SCE_VOTERRAIN_SLAB_SIZE; i++)
+        SCE_VOTerrain_InitRegion (&slab->regions[i]);
+
+    /* otherwise the geometry lives in the arena */
+    if (!vt->arena) {
+        if (!(slab->meshes = SCE_malloc (SCE_VOTERRAIN_SLAB_SIZE *
+                                         sizeof *slab->meshes)))
+            goto fail;
+        for (i = 0; i < SCE_VOTERRAIN_SLAB_SIZE; i++)
+            SCE_Mesh_Init (&slab->meshes[i]);
+        for (i = 0; i < SCE_VOTERRAIN_SLAB_SIZE; i++) {
+            if (SCE_Mesh_SetGeometry (&slab->meshes[i], &vt->region_geom,
+                                      SCE_FALSE) < 0)
+                goto fail;
+            /* TODO: maybe not autobuild, maybe.. specify some buffer options
+               (like "dont allocate them since the pool will do it") */
+            SCE_Mesh_AutoBuild (&slab->meshes[i]);
+            slab->regions[i].mesh = &slab->meshes[i];
+        }
+    }
+
+    for (i = 0; i < SCE_VOTERRAIN_SLAB_SIZE; i++)
+        SCE_List_Appendl (&vt->pool, &slab->regions[i].it3);
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
 static SCE_SVOTerrainRegion*
 SCE_VOTerrain_GetFromPool (SCE_SVoxelOctreeTerrain *vt)
 {
-    if (SCE_List_HasElements (&vt->pool)) {
-        void *data;
-        SCE_SListIterator *it = SCE_List_GetFirst (&vt->pool);
-        data = SCE_List_GetData (it);
-        SCE_List_Removel (it);
-        return data;
-    } else {
-        /* allocate a new region... or a bunch of regions? whatev. */
-        SCE_SVOTerrainRegion *region = NULL;
-        SCE_SGeometry geom;
+    void *data;
+    SCE_SListIterator *it = NULL;
 
-        if (!(region = SCE_VOTerrain_CreateRegion ()))
-            goto fail;
+    if (!SCE_List_HasElements (&vt->pool) && SCE_VOTerrain_AddSlab (vt) < 0) {
+        SCEE_LogSrc ();
+        return NULL;
+    }
+    it = SCE_List_GetFirst (&vt->pool);
+    data = SCE_List_GetData (it);
+    SCE_List_Removel (it);
+    return data;
+}
 
-        if (SCE_Mesh_SetGeometry (&region->mesh,&vt->region_geom,SCE_FALSE) < 0)
+static int SCE_VOTerrain_ReallocMesh (SCE_SMesh *mesh, SCE_RBufferPool *v,
+                                      SCE_RBufferPool *i)
+{
+    if (v) {
+        if (SCE_Mesh_ReallocStream (mesh, SCE_MESH_STREAM_G, v) < 0)
+            goto fail;
+    }
+    if (i) {
+        if (SCE_Mesh_ReallocIndexBuffer (mesh, i) < 0)
+            goto fail;
+    }
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+/* resizes the range of a region in the arena, compacting the arena once
+   when it is full. returns SCE_FALSE if it is still full, the region then
+   keeps its current geometry */
+static int SCE_VOTerrain_ReallocRange (SCE_SVoxelOctreeTerrain *vt,
+                                       SCE_SVOTerrainRegion *region,
+                                       SCEuint n_vertices, SCEuint n_indices)
+{
+    if (SCE_MeshArena_Realloc (vt->arena, &region->alloc, n_vertices,
+                               n_indices) == SCE_OK)
+        return SCE_TRUE;
+    /* a full arena is not an error, the region will try again */
+    SCEE_Clear ();
+    if (SCE_MeshArena_Defragment (vt->arena,
+                                  SCE_VOTERRAIN_FULL_DEFRAGMENT_MOVES) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    if (SCE_MeshArena_Realloc (vt->arena, &region->alloc, n_vertices,
+                               n_indices) == SCE_OK)
+        return SCE_TRUE;
+    SCEE_Clear ();
+    return SCE_FALSE;
+}
+/* uploads the final geometry of a region, returns SCE_FALSE if the mesh
+   arena is full */
+static int SCE_VOTerrain_UploadRegion (SCE_SVoxelOctreeTerrain *vt,
+                                       SCE_SVOTerrainRegion *region,
+                                       const SCEubyte *vertices,
+                                       SCEuint n_vertices,
+                                       const SCEuint *indices,
+                                       SCEuint n_indices)
+{
+    SCE_SVOTerrainPipeline *pipe = &vt->pipe;
+    int r;
+
+    if (vt->arena) {
+        /* no buffer reallocation, only a range of the arena */
+        if ((r = SCE_VOTerrain_ReallocRange (vt, region, n_vertices,
+                                             n_indices)) != SCE_TRUE)
+            return r;
+        SCE_MeshArena_UploadVertices (vt->arena, &region->alloc,
+                                      SCE_MESH_STREAM_G, vertices);
+        if (SCE_MeshArena_UploadIndices (vt->arena, &region->alloc,
+                                         indices, SCE_UNSIGNED_INT) < 0)
+            goto fail;
+    } else {
+        SCE_Mesh_SetNumVertices (region->mesh, n_vertices);
+        SCE_Mesh_SetNumIndices (region->mesh, n_indices);
+        SCE_Mesh_AutoIndexType (region->mesh);
+        if (SCE_VOTerrain_ReallocMesh (region->mesh, pipe->vertex_pool,
+                                       pipe->index_pool) < 0)
             goto fail;
-        /* TODO: maybe not autobuild, maybe.. specify some buffer options
-           (like "dont allocate them since the pool will do it") */
-        SCE_Mesh_AutoBuild (&region->mesh);
 
-        return region;
+        SCE_Mesh_UploadVertices (region->mesh, SCE_MESH_STREAM_G,
+                                 (const SCEvertices*)vertices, 0,
+                                 pipe->stride * n_vertices);
+        if (SCE_Mesh_UploadIndicesFrom (region->mesh, indices,
+                                        SCE_UNSIGNED_INT, n_indices) < 0)
+            goto fail;
     }
+    return SCE_TRUE;
 fail:
     SCEE_LogSrc ();
-    return NULL;
+    return SCE_ERROR;
+}
+
+/* drops the voxels of \p region fetched ahead, if any */
+static void SCE_VOTerrain_CancelFetch (SCE_SVOTerrainPipeline *pipe,
+                                       const SCE_SVOTerrainRegion *region)
+{
+    int i;
+
+    pthread_mutex_lock (&pipe->mutex);
+    for (i = 0; i < SCE_VOTERRAIN_NUM_FETCHES; i++) {
+        SCE_SVOTerrainFetch *f = &pipe->fetches[i];
+        if (f->state == SCE_VOTERRAIN_FETCH_FREE || f->region != region)
+            continue;
+        if (f->state == SCE_VOTERRAIN_FETCH_BUSY)
+            f->cancel = SCE_TRUE;
+        else
+            f->state = SCE_VOTERRAIN_FETCH_FREE;
+    }
+    pthread_mutex_unlock (&pipe->mutex);
 }
 
 static void SCE_VOTerrain_Region (SCE_SVoxelOctreeTerrain *vt,
@@ -531,13 +1289,32 @@ static void SCE_VOTerrain_Region (SCE_SVoxelOctreeTerrain *vt,
         SCE_List_Remove (&region->it3);
         SCE_List_Remove (&region->it4);
         SCE_VOTerrain_SetToPool (vt, region);
+        region->urgent = SCE_FALSE;
+        SCE_VOTerrain_SetRefine (vt, region, SCE_FALSE);
+        if (region->prefetch) {
+            region->prefetch = SCE_FALSE;
+            vt->n_prefetching--;
+        }
         break;
 
     case SCE_VOTERRAIN_REGION_PIPELINE:
-        /* TODO: we do want to remove it from the pipeline and put it back
-           actually, because the pipeline could be working on outdated data */
-        if (!SCE_List_IsAttached (&region->it))
+        /* no need to wait for the pipeline to be idle anymore */
+        if (region->prefetch)
+            SCE_List_Remove (&region->it4);
+        /* past the first stage the voxels have been read already, they
+           may be outdated: start over */
+        if (SCE_List_IsAttached (&region->it) && region->stage > 0) {
+            SCE_List_Remove (&region->it);
+            vt->n_restarts++;
+        }
+        if (!SCE_List_IsAttached (&region->it)) {
+            region->version = SCE_VMeshCache_GetVersion (&vt->cache);
+            region->stage = 0;
             SCE_List_Appendl (&vt->pipe.stages[0], &region->it);
+        }
+        /* so are the voxels fetched ahead */
+        if (vt->pipe.async)
+            SCE_VOTerrain_CancelFetch (&vt->pipe, region);
         break;
 
     case SCE_VOTERRAIN_REGION_READY:
@@ -584,6 +1361,7 @@ SCE_VOTerrain_AddNewRegion (SCE_SVoxelOctreeTerrain *vt, SCEuint level,
     }
     region->level = &vt->levels[level];
     region->node = node;
+    SCE_VOTerrain_PlaceRegion (vt, region);
     SCE_VOctree_SetNodeData (node, region);
     /* TODO: freefunc */
     /* actually we dont really need any, since we keep every
@@ -594,15 +1372,55 @@ SCE_VOTerrain_AddNewRegion (SCE_SVoxelOctreeTerrain *vt, SCEuint level,
     return SCE_OK;
 }
 
-/* same as UpdateNodes() but fetches from a rectangle first */
-static int
-SCE_VOTerrain_UpdateMatchingNodes (SCE_SVoxelOctreeTerrain *vt, SCEuint level,
-                                   SCE_SLongRect3 *rect)
+/* uploads the cached geometry of a new region, returns whether there was
+   any */
+static int SCE_VOTerrain_FromCache (SCE_SVoxelOctreeTerrain *vt,
+                                    SCE_SVOTerrainRegion *region)
 {
-    SCE_SList list;
-    SCE_SLongRect3 r1, r2;
-    SCE_SListIterator *it = NULL;
-    SCE_SVoxelOctreeNode *node = NULL;
+    SCE_SVMeshCacheEntry *e = NULL;
+    long x, y, z;
+    int r;
+
+    SCE_VOctree_GetNodeOriginv (region->node, &x, &y, &z);
+    if (!(e = SCE_VMeshCache_Get (&vt->cache, region->level->level, x, y, z)))
+        return SCE_FALSE;
+    /* no surface, see SCE_VOTerrain_EmptyRegion() */
+    if (!e->n_vertices)
+        return SCE_TRUE;
+    /* full arena: go through the pipeline, it will try again */
+    if ((r = SCE_VOTerrain_UploadRegion (vt, region, e->vertices,
+                                         e->n_vertices, e->indices,
+                                         e->n_indices)) != SCE_TRUE) {
+        if (r < 0)
+            SCEE_LogSrc ();
+        return r;
+    }
+    SCE_VOTerrain_Region (vt, region, SCE_VOTERRAIN_REGION_READY);
+    return SCE_TRUE;
+}
+
+/* moves a queued region to the head of the pipeline */
+static void SCE_VOTerrain_MakeUrgent (SCE_SVoxelOctreeTerrain *vt,
+                                      SCE_SVOTerrainRegion *region)
+{
+    if (!region->urgent) {
+        region->urgent = SCE_TRUE;
+        region->edit_time = region->level->edit_time;
+    }
+    SCE_List_Remove (&region->it);
+    SCE_List_Prependl (&vt->pipe.stages[0], &region->it);
+}
+
+/* same as UpdateNodes() but fetches from a rectangle first, \p urgent
+   regions are queued ahead of the others */
+static int
+SCE_VOTerrain_UpdateMatchingNodes (SCE_SVoxelOctreeTerrain *vt, SCEuint level,
+                                   SCE_SLongRect3 *rect, int urgent)
+{
+    SCE_SList list;
+    SCE_SLongRect3 r1, r2;
+    SCE_SListIterator *it = NULL;
+    SCE_SVoxelOctreeNode *node = NULL;
     SCE_SVOTerrainRegion *region = NULL;
     SCE_EVoxelOctreeStatus status;
 
@@ -630,6 +1448,8 @@ SCE_VOTerrain_UpdateMatchingNodes (SCE_SVoxelOctreeTerrain *vt, SCEuint level,
         }
         /* queue for update */
         SCE_VOTerrain_Region (vt, region, SCE_VOTERRAIN_REGION_PIPELINE);
+        if (urgent)
+            SCE_VOTerrain_MakeUrgent (vt, region);
     }
 
     SCE_List_Flush (&list);
@@ -649,6 +1469,7 @@ static int SCE_VOTerrain_UpdateLevel(SCE_SVoxelOctreeTerrain *vt, SCEuint level,
     SCE_SVOTerrainRegion *region = NULL;
     SCE_EVoxelOctreeStatus status;
     SCE_SVOTerrainLevel *tl = &vt->levels[level];
+    int cached;
 
     /* flush, but dont append them to vt->pool yet */
     SCE_List_Init (&tmp);
@@ -666,6 +1487,15 @@ static int SCE_VOTerrain_UpdateLevel(SCE_SVoxelOctreeTerrain *vt, SCEuint level,
             SCE_List_Removel (it); /* keep only null region nodes */
             SCE_List_Removel (&region->it3);
             SCE_List_Appendl (&tl->regions, &region->it3);
+            /* prefetched and not done yet: it is needed now */
+            if (region->prefetch) {
+                if (SCE_List_IsAttached (&region->it4))
+                    SCE_VOTerrain_Region (vt, region,
+                                          SCE_VOTERRAIN_REGION_PIPELINE);
+                region->prefetch = SCE_FALSE;
+                vt->n_prefetching--;
+                vt->n_prefetch_used++;
+            }
         }
     }
     /* those remaining can be marked as expired and added to the global pool */
@@ -686,8 +1516,11 @@ static int SCE_VOTerrain_UpdateLevel(SCE_SVoxelOctreeTerrain *vt, SCEuint level,
             goto fail;
         region = SCE_VOctree_GetNodeData (node);
 
-        /* queue for update */
-        SCE_VOTerrain_Region (vt, region, SCE_VOTERRAIN_REGION_PIPELINE);
+        /* reuse its last geometry, or queue for update */
+        if ((cached = SCE_VOTerrain_FromCache (vt, region)) < 0)
+            goto fail;
+        if (!cached)
+            SCE_VOTerrain_Region (vt, region, SCE_VOTERRAIN_REGION_PIPELINE);
     }
 
     SCE_List_Flush (&list);
@@ -767,20 +1600,91 @@ static int SCE_VOTerrain_SetLevelPosition (SCE_SVoxelOctreeTerrain *vt,
     return SCE_OK;
 }
 
+/* queues the regions of the nodes of the rectangle \p level will have around
+   \p x, \p y, \p z that are neither in the pipeline nor in the mesh cache,
+   their geometry goes into the cache */
+static int SCE_VOTerrain_PrefetchLevel (SCE_SVoxelOctreeTerrain *vt,
+                                        SCEuint level, long x, long y, long z)
+{
+    SCE_SLongRect3 rect, current;
+    SCE_SList list;
+    SCE_SListIterator *it = NULL;
+    SCE_SVoxelOctreeNode *node = NULL;
+    SCE_SVOTerrainRegion *region = NULL;
+    SCE_EVoxelOctreeStatus status;
+    long ox, oy, oz;
+
+    SCE_VOTerrain_GetRectangle (vt, x, y, z, level, &rect);
+    SCE_VOTerrain_GetCurrentRectangle (vt, level, &current);
+    if (rect.p1[0] == current.p1[0] && rect.p1[1] == current.p1[1] &&
+        rect.p1[2] == current.p1[2])
+        return SCE_OK;
+
+    SCE_List_Init (&list);
+    SCE_VWorld_FetchNodes (vt->vw, level, &rect, &list);
+
+    SCE_List_ForEach (it, &list) {
+        if (vt->n_prefetching >= vt->max_prefetches)
+            break;
+        node = SCE_List_GetData (it);
+        status = SCE_VOctree_GetNodeStatus (node);
+        if (status == SCE_VOCTREE_NODE_EMPTY ||
+            status == SCE_VOCTREE_NODE_FULL || SCE_VOctree_GetNodeData (node))
+            continue;
+        SCE_VOctree_GetNodeOriginv (node, &ox, &oy, &oz);
+        if (SCE_VMeshCache_Contains (&vt->cache, level, ox, oy, oz))
+            continue;
+
+        if (SCE_VOTerrain_AddNewRegion (vt, level, node) < 0)
+            goto fail;
+        region = SCE_VOctree_GetNodeData (node);
+        SCE_List_Removel (&region->it3);
+        SCE_List_Appendl (&vt->levels[level].prefetched, &region->it3);
+        region->prefetch = SCE_TRUE;
+        SCE_List_Appendl (&vt->prefetch_queue, &region->it4);
+        vt->n_prefetching++;
+        vt->n_prefetches++;
+    }
+
+    SCE_List_Flush (&list);
+    return SCE_OK;
+fail:
+    SCE_List_Flush (&list);
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
 int SCE_VOTerrain_SetPosition (SCE_SVoxelOctreeTerrain *vt, long x, long y,
                                long z)
 {
     int i;
-
+    long px, py, pz;
+    int prefetch;
+
+    /* predicted position of the viewer */
+    px = x + vt->velocity[0] * vt->prefetch_time;
+    py = y + vt->velocity[1] * vt->prefetch_time;
+    pz = z + vt->velocity[2] * vt->prefetch_time;
+    /* prefetched geometry is only kept in the mesh cache */
+    prefetch = SCE_VMeshCache_GetMaxBytes (&vt->cache) &&
+        (px != x || py != y || pz != z);
+
+    SCE_VOTerrain_Lock (vt);
     for (i = 0; i < vt->n_levels; i++) {
-        if (SCE_VOTerrain_SetLevelPosition (vt, i, x, y, z) < 0) {
+        if (SCE_VOTerrain_SetLevelPosition (vt, i, x, y, z) < 0 ||
+            (prefetch && SCE_VOTerrain_PrefetchLevel (vt, i, px, py, pz) < 0)) {
+            SCE_VOTerrain_Unlock (vt);
             SCEE_LogSrc ();
             return SCE_ERROR;
         }
         x /= 2;
         y /= 2;
         z /= 2;
+        px /= 2;
+        py /= 2;
+        pz /= 2;
     }
+    SCE_VOTerrain_Unlock (vt);
 
     return SCE_OK;
 }
@@ -837,92 +1741,228 @@ size_t SCE_VOTerrain_GetUsedVRAM (const SCE_SVoxelOctreeTerrain *vt)
     for (i = 0; i < vt->n_levels; i++) {
         SCE_List_ForEach (it, &vt->levels[i].regions) {
             region = SCE_List_GetData (it);
-            size += SCE_Mesh_GetUsedVRAM (&region->mesh);
+            if (region->mesh)
+                size += SCE_Mesh_GetUsedVRAM (region->mesh);
         }
     }
+    if (vt->arena)
+        size += SCE_Mesh_GetUsedVRAM (&vt->arena->batch.mesh);
 
     return size;
 }
+/**
+ * \brief Gets the number of regions allocated, used or not
+ * \sa SCE_VOTerrain_GetRegionSize()
+ */
+SCEuint
+SCE_VOTerrain_GetNumAllocatedRegions (const SCE_SVoxelOctreeTerrain *vt)
+{
+    return vt->n_slabs * SCE_VOTERRAIN_SLAB_SIZE;
+}
+/**
+ * \brief Gets the memory used by a region, in bytes, not counting its
+ * geometry
+ *
+ * Regions are allocated by slabs of SCE_VOTERRAIN_SLAB_SIZE. Without an
+ * arena each of them owns a mesh, allocated along with the slab.
+ * \sa SCE_VOTerrain_GetNumAllocatedRegions(), SCE_VOTerrain_SetArenaSize()
+ */
+size_t SCE_VOTerrain_GetRegionSize (const SCE_SVoxelOctreeTerrain *vt)
+{
+    size_t size = sizeof (SCE_SVOTerrainSlab) / SCE_VOTERRAIN_SLAB_SIZE;
+    if (!vt->arena)
+        size += sizeof (SCE_SMesh);
+    return size;
+}
 
 
-static void SCE_VOTerrain_MakeRegionMatrix (SCE_SVoxelOctreeTerrain *vt,
-                                            SCEuint level,
-                                            SCE_SVOTerrainRegion *region)
+static void SCE_VOTerrain_MakeRegionMatrix (SCE_SVOTerrainRegion *region,
+                                            SCE_TMatrix4 m)
 {
-    long x, y, z;
-    float w, w2;
-    float x_, y_, z_;
-    float scale;
+    SCE_Matrix4_Translatev (m, region->pos);
+    SCE_Matrix4_MulScale (m, region->size, region->size, region->size);
+}
 
-    w = vt->w + 4;
+/* returns SCE_COLLIDE_OUT, SCE_COLLIDE_IN or SCE_COLLIDE_PARTIALLY */
+static int SCE_VOTerrain_CullRegion (const SCE_SFrustum *f,
+                                     SCE_SVOTerrainRegion *region,
+                                     SCE_SBoundingBox *box, SCE_SBox *b)
+{
+    SCE_Box_Set (b, region->pos, region->size, region->size, region->size);
+    SCE_BoundingBox_SetFrom (box, b);
+    /* TODO: fix SCE_Frustum_Bounblblbl() 1st param const */
+    return SCE_Frustum_BoundingBoxIn (f, box);
+}
+/* gives the visibility of the node of \p region to the regions of its
+   children, which are then not tested */
+static void SCE_VOTerrain_InheritCull (SCE_SVoxelOctreeTerrain *vt,
+                                       SCE_SVOTerrainRegion *region, int cull)
+{
+    SCE_SVoxelOctreeNode **children = NULL;
+    SCE_SVOTerrainRegion *child = NULL;
+    int j;
 
-    /* voxel scale */
-    SCE_Matrix4_Scale (region->matrix, vt->scale, vt->scale, vt->scale);
-    /* level space */
-    scale = 1 << level;
-    SCE_Matrix4_MulScale (region->matrix, scale, scale, scale);
-    /* translate */
-    SCE_VOctree_GetNodeOriginv (region->node, &x, &y, &z);
-    SCE_Matrix4_MulTranslate (region->matrix, x - 1, y - 1, z - 1);
-    /* voxel unit */
-    SCE_Matrix4_MulScale (region->matrix, w, w, w);
+    if (SCE_VOctree_GetNodeStatus (region->node) != SCE_VOCTREE_NODE_NODE)
+        return;
+    children = SCE_VOctree_GetNodeChildren (region->node);
+    for (j = 0; j < 8; j++) {
+        if ((child = SCE_VOctree_GetNodeData (children[j]))) {
+            child->cull_frame = vt->cull_frame;
+            child->cull = cull;
+        }
+    }
 }
 
 
 void SCE_VOTerrain_CullRegions (SCE_SVoxelOctreeTerrain *vt,
                                 const SCE_SFrustum *f)
 {
-    int i;
+    int i, j, cull;
+    SCE_SList *lists[2];
     SCE_SListIterator *it = NULL;
     SCE_SVOTerrainRegion *region = NULL;
     SCE_SBoundingBox box;
     SCE_SBox b;
-    SCE_TVector3 pos;
 
     if (!f)
         return;
 
-    /* construct bounding box */
     SCE_Box_Init (&b);
-    SCE_Vector3_Set (pos, 0.0, 0.0, 0.0);
-    SCE_Box_Set (&b, pos, 1.0, 1.0, 1.0);
     SCE_BoundingBox_Init (&box);
-    SCE_BoundingBox_SetFrom (&box, &b);
 
     SCE_List_Flush (&vt->to_render);
-
-    for (i = 0; i < vt->n_levels; i++) {
-        SCE_List_ForEach (it, &vt->levels[i].to_render) {
-            region = SCE_List_GetData (it);
-            SCE_VOTerrain_MakeRegionMatrix (vt, i, region);
-            SCE_BoundingBox_Push (&box, region->matrix, &b);
-            /* TODO: fix SCE_Frustum_Bounblblbl() 1st param const */
-            if (SCE_Frustum_BoundingBoxInBool (f, &box)) {
-                SCE_List_Remove (&region->it4);
-                SCE_List_Appendl (&vt->to_render, &region->it4);
+    vt->cull_frame++;
+
+    /* from the coarsest level: the hidden regions are the nodes above the
+       regions of the finer level, when such a node is entirely outside or
+       inside the frustum so are its children */
+    for (i = vt->n_levels - 1; i >= 0; i--) {
+        lists[0] = &vt->levels[i].hidden;
+        lists[1] = &vt->levels[i].to_render;
+        for (j = 0; j < 2; j++) {
+            SCE_List_ForEach (it, lists[j]) {
+                region = SCE_List_GetData (it);
+                if (region->cull_frame == vt->cull_frame)
+                    cull = region->cull;
+                else
+                    cull = SCE_VOTerrain_CullRegion (f, region, &box, &b);
+
+                if (j == 0) {
+                    if (cull != SCE_COLLIDE_PARTIALLY)
+                        SCE_VOTerrain_InheritCull (vt, region, cull);
+                } else if (cull != SCE_COLLIDE_OUT) {
+                    /* finest levels first, front to back */
+                    SCE_List_Remove (&region->it4);
+                    SCE_List_Prependl (&vt->to_render, &region->it4);
+                }
             }
-            SCE_BoundingBox_Pop (&box, &b);
         }
     }
 }
 
 
-static int SCE_VOTerrain_UpdateGeometry (SCE_SVoxelOctreeTerrain *vt)
+static long SCE_VOTerrain_GetVolume (const SCE_SLongRect3 *r)
+{
+    return (r->p2[0] - r->p1[0]) * (r->p2[1] - r->p1[1]) *
+        (r->p2[2] - r->p1[2]);
+}
+/* adds a rectangle to a set, merging it with the rectangles it overlaps or
+   extends without covering much more voxels than they do */
+static int SCE_VOTerrain_AddRect (SCE_SVOTerrainRects *set,
+                                  const SCE_SLongRect3 *rect)
+{
+    SCE_SLongRect3 r = *rect, u, *rects = NULL;
+    SCEuint i = 0, j;
+
+    /* a merged rectangle may now reach others, look again from the start */
+    while (i < set->n) {
+        for (j = 0; j < 3; j++) {
+            u.p1[j] = MIN (r.p1[j], set->rects[i].p1[j]);
+            u.p2[j] = MAX (r.p2[j], set->rects[i].p2[j]);
+        }
+        if (SCE_VOTerrain_GetVolume (&u) <= SCE_VOTerrain_GetVolume (&r) +
+            SCE_VOTerrain_GetVolume (&set->rects[i])) {
+            r = u;
+            set->rects[i] = set->rects[--set->n];
+            i = 0;
+        } else
+            i++;
+    }
+
+    if (set->n == set->max) {
+        j = MAX (8, set->max * 2);
+        if (!(rects = SCE_realloc (set->rects, j * sizeof *rects))) {
+            SCEE_LogSrc ();
+            return SCE_ERROR;
+        }
+        set->rects = rects;
+        set->max = j;
+    }
+    set->rects[set->n++] = r;
+    return SCE_OK;
+}
+static int SCE_VOTerrain_GatherUpdates (SCE_SVoxelOctreeTerrain *vt,
+                                        SCE_SVoxelWorld *vw)
 {
     int level;
     SCE_SLongRect3 rect;
 
-    while ((level = SCE_VWorld_GetNextUpdatedRegion (vt->vw, &rect)) >= 0) {
-        if (SCE_VOTerrain_UpdateMatchingNodes (vt, level, &rect) < 0) {
+    while ((level = SCE_VWorld_GetNextUpdatedRegion (vw, &rect)) >= 0) {
+        if ((SCEuint)level >= vt->n_levels)
+            continue;
+        if (SCE_VOTerrain_AddRect (&vt->levels[level].updates, &rect) < 0) {
             SCEE_LogSrc ();
             return SCE_ERROR;
         }
     }
-    /* TODO: do the same for vt->mw, but cafeful: it will call
-       SCE_VOTerrain_Region(, SCE_VOTERRAIN_REGION_PIPELINE) twice if both
-       vw and mw have the same region updated (which happens quite often) */
+    return SCE_OK;
+}
+
+static int SCE_VOTerrain_UpdateGeometry (SCE_SVoxelOctreeTerrain *vt)
+{
+    SCEuint i, j;
+    SCE_SVOTerrainLevel *tl = NULL;
+
+    /* density and material edits often touch the same areas: merge them
+       so that each region is queued once */
+    if (SCE_VOTerrain_GatherUpdates (vt, vt->vw) < 0)
+        goto fail;
+    if (vt->mw && vt->pipe.use_materials &&
+        SCE_VOTerrain_GatherUpdates (vt, vt->mw) < 0)
+        goto fail;
+
+    /* the cached geometry of these nodes is outdated, invalidate everything
+       before queueing so that the queued regions get the latest version */
+    for (i = 0; i < vt->n_levels; i++) {
+        tl = &vt->levels[i];
+        for (j = 0; j < tl->updates.n; j++)
+            SCE_VMeshCache_Invalidate (&vt->cache, i, &tl->updates.rects[j]);
+        for (j = 0; j < tl->edits.n; j++)
+            SCE_VMeshCache_Invalidate (&vt->cache, i, &tl->edits.rects[j]);
+    }
+    /* queue the matching regions, those already in the pipeline are
+       restarted and those queued already are left as is; edited regions
+       first, they go to the head of the queue */
+    for (i = 0; i < vt->n_levels; i++) {
+        tl = &vt->levels[i];
+        for (j = 0; j < tl->edits.n; j++) {
+            if (SCE_VOTerrain_UpdateMatchingNodes (vt, i, &tl->edits.rects[j],
+                                                   SCE_TRUE) < 0)
+                goto fail;
+        }
+        for (j = 0; j < tl->updates.n; j++) {
+            if (SCE_VOTerrain_UpdateMatchingNodes (vt, i,
+                                                   &tl->updates.rects[j],
+                                                   SCE_FALSE) < 0)
+                goto fail;
+        }
+        tl->edits.n = tl->updates.n = 0;
+    }
 
     return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
 }
 
 
@@ -998,43 +2038,202 @@ static void SCE_VOTerrain_UpdateRegions (SCE_SVoxelOctreeTerrain *vt)
 }
 
 
-/* upload texture */
-static int SCE_VOTerrain_Stage1 (SCE_SVoxelOctreeTerrain *vt,
-                                 SCE_SVOTerrainPipeline *pipe)
+/* fetches the voxels of a region from the worlds */
+static int SCE_VOTerrain_Fetch (SCE_SVoxelOctreeTerrain *vt,
+                                SCE_SVOTerrainRegion *region,
+                                SCEubyte *density, SCEubyte *material)
 {
-    SCE_SVOTerrainRegion *region;
     SCE_SLongRect3 rect;
     long x, y, z;
+    int ret = SCE_OK;
 
-    (void)vt;
-    if (!SCE_List_HasElements (&pipe->stages[0]))
-        return SCE_OK;
-
-    region = SCE_List_GetData (SCE_List_GetFirst (&pipe->stages[0]));
-    SCE_List_Removel (&region->it);
-
-    /* retrieve data */
     SCE_VOctree_GetNodeOriginv (region->node, &x, &y, &z);
     SCE_Rectangle3_SetFromOriginl (&rect, x - 2, y - 2, z - 2,
                                    vt->w + 4, vt->h + 4, vt->d + 4);
     /* TODO: only fill when querying a region outside the world */
     /* SCE_Grid_FillupZeros (&pipe->grid); */
+    SCE_VOTerrain_Lock (vt);
     if (SCE_VWorld_GetRegion (vt->vw, region->level->level, &rect,
-                              SCE_Grid_GetRaw (&pipe->grid)) < 0)
+                              density) < 0)
+        ret = SCE_ERROR;
+    else if (vt->pipe.use_materials &&
+             SCE_VWorld_GetRegion (vt->mw, region->level->level, &rect,
+                                   material) < 0)
+        ret = SCE_ERROR;
+    SCE_VOTerrain_Unlock (vt);
+
+    if (ret < 0)
+        SCEE_LogSrc ();
+    return ret;
+}
+
+/* uploads the voxels of a region into the given textures */
+static int SCE_VOTerrain_Upload (SCE_SVOTerrainPipeline *pipe,
+                                 SCE_STexture *tex, SCE_STexture *mat,
+                                 const SCEubyte *density,
+                                 const SCEubyte *material)
+{
+    SCE_SIntRect3 box;
+    int p1[3] = {0, 0, 0}, p2[3];
+
+    p2[0] = SCE_Grid_GetWidth (&pipe->grid);
+    p2[1] = SCE_Grid_GetHeight (&pipe->grid);
+    p2[2] = SCE_Grid_GetDepth (&pipe->grid);
+    SCE_Rectangle3_Setv (&box, p1, p2);
+
+    if (SCE_Texture_UpdateBox (tex, &pipe->stream, &box, density, 1) < 0)
         goto fail;
-    if (pipe->use_materials) {
-        if (SCE_VWorld_GetRegion (vt->mw, region->level->level, &rect,
+    if (pipe->use_materials &&
+        SCE_Texture_UpdateBox (mat, &pipe->stream, &box, material, 1) < 0)
+        goto fail;
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+static SCE_SVOTerrainFetch*
+SCE_VOTerrain_FindFetch (SCE_SVOTerrainPipeline *pipe,
+                         SCE_SVOTerrainRegion *region, long x, long y, long z)
+{
+    int i;
+
+    for (i = 0; i < SCE_VOTERRAIN_NUM_FETCHES; i++) {
+        SCE_SVOTerrainFetch *f = &pipe->fetches[i];
+        if (f->state != SCE_VOTERRAIN_FETCH_FREE && !f->cancel &&
+            f->region == region && f->level == region->level->level &&
+            f->x == x && f->y == y && f->z == z)
+            return f;
+    }
+    return NULL;
+}
+/* keeps the fetch slots busy with the first regions of the queue and
+   returns the first fetch ready for upload, if any; pipe->mutex must be
+   locked */
+static SCE_SVOTerrainFetch*
+SCE_VOTerrain_ScheduleFetches (SCE_SVOTerrainPipeline *pipe)
+{
+    SCE_SListIterator *it = NULL;
+    SCE_SVOTerrainFetch *f = NULL, *ready = NULL;
+    int claimed[SCE_VOTERRAIN_NUM_FETCHES];
+    int i, n = 0;
+    long x, y, z;
+
+    for (i = 0; i < SCE_VOTERRAIN_NUM_FETCHES; i++)
+        claimed[i] = SCE_FALSE;
+
+    /* the fetches of the regions at the head of the queue are kept */
+    SCE_List_ForEach (it, &pipe->stages[0]) {
+        SCE_SVOTerrainRegion *region = SCE_List_GetData (it);
+        if (n++ == SCE_VOTERRAIN_NUM_FETCHES)
+            break;
+        SCE_VOctree_GetNodeOriginv (region->node, &x, &y, &z);
+        if ((f = SCE_VOTerrain_FindFetch (pipe, region, x, y, z))) {
+            claimed[f - pipe->fetches] = SCE_TRUE;
+            if (!ready && f->state == SCE_VOTERRAIN_FETCH_READY)
+                ready = f;
+        }
+    }
+    /* others are outdated */
+    for (i = 0; i < SCE_VOTERRAIN_NUM_FETCHES; i++) {
+        f = &pipe->fetches[i];
+        if (claimed[i])
+            continue;
+        if (f->state == SCE_VOTERRAIN_FETCH_BUSY)
+            f->cancel = SCE_TRUE;
+        else
+            f->state = SCE_VOTERRAIN_FETCH_FREE;
+    }
+    /* queue the regions that have no fetch yet */
+    n = 0;
+    SCE_List_ForEach (it, &pipe->stages[0]) {
+        SCE_SVOTerrainRegion *region = SCE_List_GetData (it);
+        if (n++ == SCE_VOTERRAIN_NUM_FETCHES)
+            break;
+        SCE_VOctree_GetNodeOriginv (region->node, &x, &y, &z);
+        if (SCE_VOTerrain_FindFetch (pipe, region, x, y, z))
+            continue;
+        for (i = 0; i < SCE_VOTERRAIN_NUM_FETCHES; i++) {
+            f = &pipe->fetches[i];
+            if (f->state == SCE_VOTERRAIN_FETCH_FREE) {
+                f->state = SCE_VOTERRAIN_FETCH_QUEUED;
+                f->cancel = f->error = SCE_FALSE;
+                f->region = region;
+                f->level = region->level->level;
+                f->x = x; f->y = y; f->z = z;
+                break;
+            }
+        }
+    }
+    return ready;
+}
+
+/* upload texture, into the textures of \p slot if not NULL */
+static int SCE_VOTerrain_Stage1 (SCE_SVoxelOctreeTerrain *vt,
+                                 SCE_SVOTerrainPipeline *pipe,
+                                 SCE_SVOTerrainSlot *slot)
+{
+    SCE_SVOTerrainRegion *region = NULL;
+    SCE_SVOTerrainFetch *f = NULL;
+    SCE_STexture *tex = pipe->tex, *mat = pipe->material;
+    int ret;
+
+    if (!SCE_List_HasElements (&pipe->stages[0]))
+        return SCE_OK;
+    if (slot) {
+        tex = slot->tex;
+        mat = slot->material;
+    }
+
+    if (!pipe->async) {
+        region = SCE_List_GetData (SCE_List_GetFirst (&pipe->stages[0]));
+        SCE_List_Removel (&region->it);
+        if (SCE_VOTerrain_Fetch (vt, region, SCE_Grid_GetRaw (&pipe->grid),
+                                 SCE_Grid_GetRaw (&pipe->grid2)) < 0)
+            goto fail;
+        if (SCE_VOTerrain_Upload (pipe, tex, mat,
+                                  SCE_Grid_GetRaw (&pipe->grid),
                                   SCE_Grid_GetRaw (&pipe->grid2)) < 0)
             goto fail;
+        pipe->n_sync++;
+    } else {
+        pthread_mutex_lock (&pipe->mutex);
+        f = SCE_VOTerrain_ScheduleFetches (pipe);
+        pthread_cond_signal (&pipe->cond);
+        pthread_mutex_unlock (&pipe->mutex);
+        /* dont wait for the worker thread */
+        if (!f)
+            return SCE_OK;
+
+        /* the worker thread leaves ready fetches alone */
+        region = f->region;
+        SCE_List_Removel (&region->it);
+        if (f->error) {
+            /* fetch again to get the error reported */
+            ret = SCE_VOTerrain_Fetch (vt, region,
+                                       SCE_Grid_GetRaw (&pipe->grid),
+                                       SCE_Grid_GetRaw (&pipe->grid2));
+            if (ret == SCE_OK)
+                ret = SCE_VOTerrain_Upload (pipe, tex, mat,
+                                            SCE_Grid_GetRaw (&pipe->grid),
+                                            SCE_Grid_GetRaw (&pipe->grid2));
+            pipe->n_sync++;
+        } else {
+            ret = SCE_VOTerrain_Upload (pipe, tex, mat, f->density,
+                                        f->material);
+            pipe->n_async++;
+        }
+        pthread_mutex_lock (&pipe->mutex);
+        f->state = SCE_VOTERRAIN_FETCH_FREE;
+        pthread_mutex_unlock (&pipe->mutex);
+        if (ret < 0)
+            goto fail;
     }
 
-    /* upload */
-    glPixelStorei (GL_UNPACK_ALIGNMENT, 2);
-    SCE_Texture_Update (pipe->tex);
-    if (pipe->use_materials)
-        SCE_Texture_Update (pipe->material);
-    glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
     SCE_List_Appendl (&pipe->stages[1], &region->it); /* onto the next stage */
+    region->stage = 1;
+    if (slot)
+        slot->region = region;
 
     return SCE_OK;
 fail:
@@ -1042,6 +2241,44 @@ fail:
     return SCE_ERROR;
 }
 
+/* accounts for the latency of an edited region whose new geometry is in
+   place */
+static void SCE_VOTerrain_EditDone (SCE_SVoxelOctreeTerrain *vt,
+                                    SCE_SVOTerrainRegion *region)
+{
+    double latency;
+
+    if (!region->urgent)
+        return;
+    region->urgent = SCE_FALSE;
+    latency = SCE_FrameBudget_GetTime () - region->edit_time;
+    vt->n_edits++;
+    vt->edit_latency += latency;
+    vt->max_edit_latency = MAX (vt->max_edit_latency, latency);
+}
+
+/* a region without surface is left without geometry, a prefetched one is
+   recorded empty in the mesh cache so that it is not prefetched again */
+static int SCE_VOTerrain_EmptyRegion (SCE_SVoxelOctreeTerrain *vt,
+                                      SCE_SVOTerrainRegion *region)
+{
+    long x, y, z;
+
+    if (!region->prefetch) {
+        SCE_VOTerrain_EditDone (vt, region);
+        return SCE_OK;
+    }
+    SCE_VOctree_GetNodeOriginv (region->node, &x, &y, &z);
+    if (SCE_VMeshCache_Prefetch (&vt->cache, region->version,
+                                 region->level->level, x, y, z,
+                                 NULL, 0, NULL, 0) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    SCE_VOTerrain_Region (vt, region, SCE_VOTERRAIN_REGION_POOL);
+    return SCE_OK;
+}
+
 /* generate geometry using the GPU (preferably) */
 static int SCE_VOTerrain_Stage2 (SCE_SVoxelOctreeTerrain *vt,
                                  SCE_SVOTerrainPipeline *pipe)
@@ -1058,8 +2295,11 @@ static int SCE_VOTerrain_Stage2 (SCE_SVoxelOctreeTerrain *vt,
                               &pipe->vmesh, 1, 1, 1) < 0)
         goto fail;
 
-    if (!SCE_VRender_IsEmpty (&pipe->vmesh))
+    if (!SCE_VRender_IsEmpty (&pipe->vmesh)) {
         SCE_List_Appendl (&pipe->stages[2], &region->it);
+        region->stage = 2;
+    } else if (SCE_VOTerrain_EmptyRegion (vt, region) < 0)
+        goto fail;
 
     return SCE_OK;
 fail:
@@ -1067,82 +2307,158 @@ fail:
     return SCE_ERROR;
 }
 
-static int SCE_VOTerrain_ReallocMesh (SCE_SMesh *mesh, SCE_RBufferPool *v,
-                                      SCE_RBufferPool *i)
+static SCE_SVOTerrainSlot*
+SCE_VOTerrain_FindSlot (SCE_SVOTerrainPipeline *pipe,
+                        const SCE_SVOTerrainRegion *region, int meshed)
 {
-    if (v) {
-        if (SCE_Mesh_ReallocStream (mesh, SCE_MESH_STREAM_G, v) < 0)
-            goto fail;
+    SCEuint i;
+
+    for (i = 0; i < pipe->batch; i++) {
+        SCE_SVOTerrainSlot *slot = &pipe->slots[i];
+        if ((meshed ? slot->mregion : slot->region) == region)
+            return slot;
     }
-    if (i) {
-        if (SCE_Mesh_ReallocIndexBuffer (mesh, i) < 0)
+    return NULL;
+}
+
+/* generate the geometry of all the uploaded regions at once */
+static int SCE_VOTerrain_Stage2Batch (SCE_SVoxelOctreeTerrain *vt,
+                                      SCE_SVOTerrainPipeline *pipe)
+{
+    SCE_SVOTerrainRegion *regions[SCE_VOTERRAIN_MAX_BATCH];
+    SCE_SVOTerrainSlot *slots[SCE_VOTERRAIN_MAX_BATCH];
+    SCE_STexture *volumes[SCE_VOTERRAIN_MAX_BATCH];
+    SCE_STexture *materials[SCE_VOTERRAIN_MAX_BATCH];
+    SCE_SVoxelMesh *vms[SCE_VOTERRAIN_MAX_BATCH];
+    SCEuint i, n = 0;
+
+    while (SCE_List_HasElements (&pipe->stages[1])) {
+        SCE_SVOTerrainRegion *region;
+        SCE_SVOTerrainSlot *slot;
+
+        region = SCE_List_GetData (SCE_List_GetFirst (&pipe->stages[1]));
+        SCE_List_Removel (&region->it);
+        if (!(slot = SCE_VOTerrain_FindSlot (pipe, region, SCE_FALSE))) {
+            /* no voxels, should not happen: queue it again */
+            SCE_List_Appendl (&pipe->stages[0], &region->it);
+            region->stage = 0;
+            continue;
+        }
+        regions[n] = region;
+        slots[n] = slot;
+        volumes[n] = slot->tex;
+        materials[n] = slot->material;
+        vms[n] = &slot->vmesh;
+        n++;
+    }
+    /* slots whose region left the pipeline are free as well, even when
+       nothing is left to generate */
+    for (i = 0; i < pipe->batch; i++)
+        pipe->slots[i].region = pipe->slots[i].mregion = NULL;
+    if (!n)
+        return SCE_OK;
+
+    if (SCE_VRender_HardwareBatch (&pipe->temp, volumes, materials, vms,
+                                   n, 1, 1, 1) < 0)
+        goto fail;
+
+    for (i = 0; i < n; i++) {
+        if (!SCE_VRender_IsEmpty (vms[i])) {
+            slots[i]->mregion = regions[i];
+            SCE_List_Appendl (&pipe->stages[2], &regions[i]->it);
+            regions[i]->stage = 2;
+        } else if (SCE_VOTerrain_EmptyRegion (vt, regions[i]) < 0)
             goto fail;
     }
+
     return SCE_OK;
 fail:
     SCEE_LogSrc ();
     return SCE_ERROR;
 }
 
-static void SCE_VOTerrain_Decode (SCE_SVOTerrainPipeline *pipe)
+/* vertex decoders and encoders, one per vertex format so that the loops
+   have constant strides and no branch. the GPU outputs 7 floats per vertex:
+   position, material and normal; decimated vertices are stored as position,
+   normal and, with materials, one byte of material */
+#define SCE_VOTERRAIN_GET_MATERIAL(mat, in) ((mat) = (SCEubyte)((in) * 255.0f))
+#define SCE_VOTERRAIN_NO_MATERIAL(mat, in)
+
+#define SCE_VOTERRAIN_DEFINE_DECODER(name, material)                    \
+    static void name (const SCEvertices *in, size_t n, SCEvertices *pos, \
+                      SCEvertices *nor, SCEubyte *mat)                  \
+    {                                                                   \
+        size_t i;                                                       \
+        (void)mat;                                                      \
+        for (i = 0; i < n; i++) {                                       \
+            pos[i * 3]     = in[i * 7];                                 \
+            pos[i * 3 + 1] = in[i * 7 + 1];                             \
+            pos[i * 3 + 2] = in[i * 7 + 2];                             \
+            material (mat[i], in[i * 7 + 3]);                           \
+            nor[i * 3]     = in[i * 7 + 4];                             \
+            nor[i * 3 + 1] = in[i * 7 + 5];                             \
+            nor[i * 3 + 2] = in[i * 7 + 6];                             \
+        }                                                               \
+    }
+
+SCE_VOTERRAIN_DEFINE_DECODER (SCE_VOTerrain_Decode, SCE_VOTERRAIN_NO_MATERIAL)
+SCE_VOTERRAIN_DEFINE_DECODER (SCE_VOTerrain_DecodeMat,
+                              SCE_VOTERRAIN_GET_MATERIAL)
+
+/* the size of the copies being constant, compilers turn them into plain
+   (unaligned) moves */
+#define SCE_VOTERRAIN_PUT_MATERIAL(out, mat) ((out)[0] = (mat))
+#define SCE_VOTERRAIN_NO_PUT_MATERIAL(out, mat)
+
+#define SCE_VOTERRAIN_DEFINE_ENCODER(name, material, mstride)           \
+    static void name (const SCEvertices *pos, const SCEvertices *nor,   \
+                      const SCEubyte *mat, size_t n, SCEubyte *out)     \
+    {                                                                   \
+        size_t i;                                                       \
+        const size_t size = 3 * sizeof (SCEvertices);                   \
+        (void)mat;                                                      \
+        for (i = 0; i < n; i++) {                                       \
+            memcpy (out, &pos[i * 3], size);                            \
+            memcpy (&out[size], &nor[i * 3], size);                     \
+            material (&out[2 * size], mat[i]);                          \
+            out = &out[2 * size + (mstride)];                           \
+        }                                                               \
+    }
+
+SCE_VOTERRAIN_DEFINE_ENCODER (SCE_VOTerrain_Encode,
+                              SCE_VOTERRAIN_NO_PUT_MATERIAL, 0)
+SCE_VOTERRAIN_DEFINE_ENCODER (SCE_VOTerrain_EncodeMat,
+                              SCE_VOTERRAIN_PUT_MATERIAL, 1)
+
+/* converts 32 bits indices to SCEindices in place, for the decimation */
+static SCEindices* SCE_VOTerrain_NarrowIndices (SCEuint *indices, size_t n)
 {
     size_t i;
-    SCEindices *ind1 = NULL;
-    SCEuint *ind2 = NULL;
-    float material;
-    SCEvertices *interleaved = pipe->interleaved;
-
-    /* vertices */
-    /* TODO: this stride is defined upon the geometry as defined by the
-       vrender module */
-    for (i = 0; i < pipe->n_vertices; i++) {
-        memcpy (&pipe->vertices[i * 3], &interleaved[i * 7],
-                3 * sizeof (SCEvertices));
-        if (pipe->use_materials) {
-            material = interleaved[i * 7 + 3];
-            pipe->materials[i] = (SCEubyte)(material * 255.0);
-        }
-        memcpy (&pipe->normals[i * 3], &interleaved[i * 7 + 4],
-                3 * sizeof (SCEvertices));
-    }
+    SCEindices *ind = (SCEindices*)indices;
 
-    /* indices */
-    ind1 = pipe->indices;
-    ind2 = (SCEuint*)pipe->indices;
-    for (i = 0; i < pipe->n_indices; i++)
-        ind1[i] = ind2[i];
+    for (i = 0; i < n; i++)
+        ind[i] = indices[i];
+    return ind;
 }
-
-static void SCE_VOTerrain_Encode (SCE_SVOTerrainPipeline *pipe)
+/* converts back the output of the decimation to 32 bits in place */
+static void SCE_VOTerrain_WidenIndices (SCEuint *indices, size_t n)
 {
-    long i;
+    const SCEindices *ind = (const SCEindices*)indices;
 
-    /* TODO: dont use memcpy if the data type of interleaved changes */
-    for (i = 0; i < pipe->n_vertices; i++) {
-        memcpy (&pipe->interleaved[i * pipe->stride],
-                &pipe->vertices[i * 3],
-                3 * sizeof *pipe->vertices);
-        memcpy (&pipe->interleaved[i * pipe->stride + pipe->vstride],
-                &pipe->normals[i * 3],
-                3 * sizeof *pipe->vertices);
-        if (pipe->use_materials) {
-            memcpy (&pipe->interleaved[i * pipe->stride + pipe->vstride +
-                                       pipe->nstride],
-                    &pipe->materials[i], sizeof *pipe->materials);
-        }
-    }
+    while (n--)
+        indices[n] = ind[n];
 }
 
 static SCEuint
 SCE_VOTerrain_Anchors (SCEvertices *vertices, SCEubyte *materials,
-                       size_t n_vertices, SCEindices *indices,
+                       size_t n_vertices, SCEuint *indices,
                        size_t n_indices, float inf, float sup,
                        SCEubyte *out)
 {
     SCEuint i, n = 0;
     SCEvertices *v;
     SCEubyte a;
-    SCEindices i0, i1, i2;
+    SCEuint i0, i1, i2;
 
     for (i = 0; i < n_vertices; i++)
         out[i] = 0;
@@ -1181,30 +2497,33 @@ SCE_VOTerrain_Anchors (SCEvertices *vertices, SCEubyte *materials,
     return n;
 }
 
-/* decimate the geometry */
-static int SCE_VOTerrain_Stage3 (SCE_SVoxelOctreeTerrain *vt,
-                                 SCE_SVOTerrainPipeline *pipe)
+/* decimate the geometry generated into \p mesh for \p region */
+static int SCE_VOTerrain_Decimate (SCE_SVoxelOctreeTerrain *vt,
+                                   SCE_SVOTerrainPipeline *pipe,
+                                   SCE_SVOTerrainRegion *region,
+                                   SCE_SMesh *mesh)
 {
-    SCE_SVOTerrainRegion *region;
     SCEuint n_collapses, n_anchors;
-    size_t size, stride;
+    SCEindices *indices = NULL;
+    long x, y, z;
     float inf, sup;
-
-    if (!SCE_List_HasElements (&pipe->stages[2]))
-        return SCE_OK;
-
-    region = SCE_List_GetData (SCE_List_GetFirst (&pipe->stages[2]));
-    SCE_List_Removel (&region->it);
+    int r;
 
     /* download geometry */
-    pipe->n_vertices = SCE_Mesh_GetNumVertices (&pipe->mesh);
-    pipe->n_indices = SCE_Mesh_GetNumIndices (&pipe->mesh);
-    SCE_Mesh_DownloadAllVertices (&pipe->mesh, SCE_MESH_STREAM_G,
+    pipe->n_vertices = SCE_Mesh_GetNumVertices (mesh);
+    pipe->n_indices = SCE_Mesh_GetNumIndices (mesh);
+    SCE_Mesh_DownloadAllVertices (mesh, SCE_MESH_STREAM_G,
                                   (SCEvertices*)pipe->interleaved);
-    SCE_Mesh_DownloadAllIndices (&pipe->mesh, pipe->indices);
+    /* the GPU outputs 32 bits indices */
+    SCE_Mesh_DownloadAllIndices (mesh, (SCEindices*)pipe->indices);
 
     /* decode (might include decompression) */
-    SCE_VOTerrain_Decode (pipe);
+    pipe->decode ((SCEvertices*)pipe->interleaved, pipe->n_vertices,
+                  pipe->vertices, pipe->normals, pipe->materials);
+
+    /* with fast edits, edited regions are shown right away and decimated
+       later on, see SCE_VOTerrain_Refine() */
+    SCE_VOTerrain_SetRefine (vt, region, vt->fast_edits && region->urgent);
 
 #if 1
     /* decimate */
@@ -1215,43 +2534,126 @@ static int SCE_VOTerrain_Stage3 (SCE_SVoxelOctreeTerrain *vt,
     inf = 0.00001;
     sup = (vt->w - 4.0) / (vt->w - 1.0);
 #endif
-    n_anchors = SCE_VOTerrain_Anchors (pipe->vertices, pipe->materials,
-                                       pipe->n_vertices, pipe->indices,
-                                       pipe->n_indices, inf, sup,pipe->anchors);
-    SCE_QEMD_Set (&pipe->qmesh, pipe->vertices, pipe->normals, pipe->materials,
-                  pipe->anchors, pipe->indices, pipe->n_vertices,
-                  pipe->n_indices);
-    /* aiming at ~75% vertex reduction */
-    n_collapses = (pipe->n_vertices - n_anchors) * 0.70;
-    SCE_QEMD_Process (&pipe->qmesh, n_collapses);
-    SCE_QEMD_Get (&pipe->qmesh, pipe->vertices, pipe->normals, pipe->materials,
-                  pipe->indices, &pipe->n_vertices, &pipe->n_indices);
+    /* the decimation works with SCEindices, larger meshes are kept as is */
+    if (!region->refine && pipe->n_vertices &&
+        pipe->n_vertices - 1 <= (SCEindices)~0) {
+        n_anchors = SCE_VOTerrain_Anchors (pipe->vertices, pipe->materials,
+                                           pipe->n_vertices, pipe->indices,
+                                           pipe->n_indices, inf, sup,
+                                           pipe->anchors);
+        indices = SCE_VOTerrain_NarrowIndices (pipe->indices, pipe->n_indices);
+        SCE_QEMD_Set (&pipe->qmesh, pipe->vertices, pipe->normals,
+                      pipe->materials, pipe->anchors, indices,
+                      pipe->n_vertices, pipe->n_indices);
+        n_collapses = SCE_VOTerrain_GetCollapses (vt, region->level,
+                                                  pipe->n_vertices, n_anchors);
+        SCE_QEMD_Process (&pipe->qmesh, n_collapses);
+        SCE_QEMD_Get (&pipe->qmesh, pipe->vertices, pipe->normals,
+                      pipe->materials, indices, &pipe->n_vertices,
+                      &pipe->n_indices);
+        SCE_VOTerrain_WidenIndices (pipe->indices, pipe->n_indices);
+    }
 #endif
 
+    if (pipe->optimize && !region->refine) {
+        if (SCE_MeshOpt_Optimize (&pipe->opt, pipe->optimize, pipe->indices,
+                                  SCE_UNSIGNED_INT, pipe->n_indices,
+                                  pipe->vertices, 0, pipe->n_vertices) < 0)
+            goto fail;
+        if (SCE_MeshOpt_Remap (&pipe->opt, pipe->vertices,
+                               3 * sizeof *pipe->vertices, 0) < 0 ||
+            SCE_MeshOpt_Remap (&pipe->opt, pipe->normals,
+                               3 * sizeof *pipe->normals, 0) < 0)
+            goto fail;
+        if (pipe->use_materials &&
+            SCE_MeshOpt_Remap (&pipe->opt, pipe->materials,
+                               sizeof *pipe->materials, 0) < 0)
+            goto fail;
+    }
+
     /* encode (might include compression) */
-    SCE_VOTerrain_Encode (pipe);
+    pipe->encode (pipe->vertices, pipe->normals, pipe->materials,
+                  pipe->n_vertices, pipe->interleaved);
 
-    /* upload geometry */
-    SCE_Mesh_SetNumVertices (&region->mesh, pipe->n_vertices);
-    SCE_Mesh_SetNumIndices (&region->mesh, pipe->n_indices);
-    if (SCE_VOTerrain_ReallocMesh (&region->mesh, pipe->vertex_pool,
-                                   pipe->index_pool) < 0)
+    /* keep it for the next time the node comes into view */
+    SCE_VOctree_GetNodeOriginv (region->node, &x, &y, &z);
+    if (region->prefetch) {
+        /* not in view yet, the node is looked up in the cache when it is */
+        if (SCE_VMeshCache_Prefetch (&vt->cache, region->version,
+                                     region->level->level, x, y, z,
+                                     pipe->interleaved, pipe->n_vertices,
+                                     pipe->indices, pipe->n_indices) < 0)
+            goto fail;
+        SCE_VOTerrain_Region (vt, region, SCE_VOTERRAIN_REGION_POOL);
+        return SCE_OK;
+    }
+    if (!region->refine &&
+        SCE_VMeshCache_Store (&vt->cache, region->version,
+                              region->level->level, x, y, z,
+                              pipe->interleaved, pipe->n_vertices,
+                              pipe->indices, pipe->n_indices) < 0)
         goto fail;
 
-    stride = pipe->stride;
-    size = stride * pipe->n_vertices;
-    SCE_Mesh_UploadVertices (&region->mesh, SCE_MESH_STREAM_G,
-                             (SCEvertices*)pipe->interleaved, 0, size);
-    size = pipe->n_indices * sizeof *pipe->indices;
-    SCE_Mesh_UploadIndices (&region->mesh, pipe->indices, size);
+    if ((r = SCE_VOTerrain_UploadRegion (vt, region, pipe->interleaved,
+                                         pipe->n_vertices, pipe->indices,
+                                         pipe->n_indices)) < 0)
+        goto fail;
+    if (!r) {
+        /* the arena is full, keep the current geometry and mesh the region
+           again later on */
+        SCE_VOTerrain_Region (vt, region, SCE_VOTERRAIN_REGION_PIPELINE);
+        return SCE_OK;
+    }
 
     SCE_VOTerrain_Region (vt, region, SCE_VOTERRAIN_REGION_READY);
+    SCE_VOTerrain_EditDone (vt, region);
+
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+static int SCE_VOTerrain_Stage3 (SCE_SVoxelOctreeTerrain *vt,
+                                 SCE_SVOTerrainPipeline *pipe)
+{
+    SCE_SVOTerrainRegion *region;
+
+    if (!SCE_List_HasElements (&pipe->stages[2]))
+        return SCE_OK;
+
+    region = SCE_List_GetData (SCE_List_GetFirst (&pipe->stages[2]));
+    SCE_List_Removel (&region->it);
+
+    if (SCE_VOTerrain_Decimate (vt, pipe, region, &pipe->mesh) < 0)
+        goto fail;
 
     return SCE_OK;
 fail:
     SCEE_LogSrc ();
     return SCE_ERROR;
 }
+/* decimate the geometry of all the regions generated by Stage2Batch() */
+static int SCE_VOTerrain_Stage3Batch (SCE_SVoxelOctreeTerrain *vt,
+                                      SCE_SVOTerrainPipeline *pipe)
+{
+    SCE_SVOTerrainRegion *region;
+    SCE_SVOTerrainSlot *slot;
+
+    while (SCE_List_HasElements (&pipe->stages[2])) {
+        region = SCE_List_GetData (SCE_List_GetFirst (&pipe->stages[2]));
+        SCE_List_Removel (&region->it);
+        if (!(slot = SCE_VOTerrain_FindSlot (pipe, region, SCE_TRUE)))
+            continue;
+        slot->mregion = NULL;
+        if (SCE_VOTerrain_Decimate (vt, pipe, region, &slot->mesh) < 0)
+            goto fail;
+    }
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
 
 static void SCE_VOTerrain_SwitchPipelineTextures (SCE_SVOTerrainPipeline *pipe)
 {
@@ -1274,9 +2676,23 @@ static void SCE_VOTerrain_SwitchPipelineTextures (SCE_SVOTerrainPipeline *pipe)
 static int SCE_VOTerrain_UpdatePipeline (SCE_SVoxelOctreeTerrain *vt,
                                          SCE_SVOTerrainPipeline *pipe)
 {
+    SCEuint i;
+
+    if (pipe->batch > 1) {
+        /* each stage handles up to pipe->batch regions */
+        if (SCE_VOTerrain_Stage2Batch (vt, pipe) < 0) goto fail;
+        for (i = 0; i < pipe->batch; i++) {
+            if (SCE_VOTerrain_Stage1 (vt, pipe, &pipe->slots[i]) < 0)
+                goto fail;
+            if (!pipe->slots[i].region)
+                break;          /* nothing left to upload */
+        }
+        if (SCE_VOTerrain_Stage3Batch (vt, pipe) < 0) goto fail;
+        return SCE_OK;
+    }
     if (SCE_VOTerrain_Stage2 (vt, pipe) < 0) goto fail;
     SCE_VOTerrain_SwitchPipelineTextures (pipe);
-    if (SCE_VOTerrain_Stage1 (vt, pipe) < 0) goto fail;
+    if (SCE_VOTerrain_Stage1 (vt, pipe, NULL) < 0) goto fail;
     if (SCE_VOTerrain_Stage3 (vt, pipe) < 0) goto fail;
     return SCE_OK;
 fail:
@@ -1284,25 +2700,268 @@ fail:
     return SCE_ERROR;
 }
 
+static int SCE_VOTerrain_PipelineBusy (const SCE_SVOTerrainPipeline *pipe)
+{
+    int i;
+    for (i = 0; i < SCE_VOTERRAIN_NUM_PIPELINE_STAGES; i++) {
+        if (SCE_List_HasElements (&pipe->stages[i]))
+            return SCE_TRUE;
+    }
+    return SCE_FALSE;
+}
+/* whether another pipeline cycle fits in this frame */
+static int SCE_VOTerrain_HasTime (const SCE_SVoxelOctreeTerrain *vt)
+{
+    return vt->budget && vt->n_cycles < vt->max_cycles &&
+        SCE_FrameBudget_HasTime (vt->budget) &&
+        SCE_VOTerrain_PipelineBusy (&vt->pipe);
+}
+
+/* locks the worlds unless the worker thread is using them, which is only
+   tolerated a few times in a row */
+static int SCE_VOTerrain_TryLockWorld (SCE_SVoxelOctreeTerrain *vt)
+{
+    if (!vt->pipe.async)
+        return SCE_TRUE;
+    if (pthread_mutex_trylock (&vt->world_mutex) != 0) {
+        if (++vt->world_skips < SCE_VOTERRAIN_MAX_WORLD_SKIPS)
+            return SCE_FALSE;
+        pthread_mutex_lock (&vt->world_mutex);
+    }
+    vt->world_skips = 0;
+    return SCE_TRUE;
+}
+
+/* hands the prefetched regions to the pipeline when it has nothing else to
+   do */
+static void SCE_VOTerrain_FeedPrefetches (SCE_SVoxelOctreeTerrain *vt)
+{
+    SCEuint i;
+    SCE_SVOTerrainRegion *region = NULL;
+
+    if (SCE_List_HasElements (&vt->pipe.stages[0]))
+        return;
+    for (i = 0; i < MAX (vt->pipe.batch, 1); i++) {
+        if (!SCE_List_HasElements (&vt->prefetch_queue))
+            break;
+        region = SCE_List_GetData (SCE_List_GetFirst (&vt->prefetch_queue));
+        SCE_VOTerrain_Region (vt, region, SCE_VOTERRAIN_REGION_PIPELINE);
+    }
+}
+
+/* queues for decimation the regions shown without being decimated, once
+   they are rendered so that they keep being displayed meanwhile */
+static void SCE_VOTerrain_Refine (SCE_SVoxelOctreeTerrain *vt)
+{
+    SCE_SListIterator *it = NULL, *pro = NULL;
+    SCE_SVOTerrainRegion *region = NULL;
+
+    SCE_List_ForEachProtected (pro, it, &vt->to_render) {
+        region = SCE_List_GetData (it);
+        if (region->refine && region->status == SCE_VOTERRAIN_REGION_RENDER) {
+            SCE_VOTerrain_SetRefine (vt, region, SCE_FALSE);
+            SCE_VOTerrain_Region (vt, region, SCE_VOTERRAIN_REGION_PIPELINE);
+        }
+    }
+}
+
 int SCE_VOTerrain_Update (SCE_SVoxelOctreeTerrain *vt)
 {
-    /* queue regions that need to be updated */
-    if (SCE_VOTerrain_UpdateGeometry (vt) < 0) goto fail;
-    /* generate queued regions */
-    if (SCE_VOTerrain_UpdatePipeline (vt, &vt->pipe) < 0) goto fail;
+    int ret;
+
+    if (vt->budget)
+        SCE_FrameBudget_StartSlice (vt->budget);
+    /* the worlds are not touched while the worker thread reads them, the
+       work below is done again next frame anyway */
+    if (SCE_VOTerrain_TryLockWorld (vt)) {
+        /* queue regions that need to be updated */
+        ret = SCE_VOTerrain_UpdateGeometry (vt);
+        SCE_VOTerrain_FeedPrefetches (vt);
+        SCE_VOTerrain_Unlock (vt);
+        if (ret < 0) goto fail;
+    }
+    /* generate queued regions, at least one cycle so that the pipeline never
+       stalls, even when another module ate the whole budget */
+    vt->n_cycles = 0;
+    do {
+        if (SCE_VOTerrain_UpdatePipeline (vt, &vt->pipe) < 0) goto fail;
+        vt->n_cycles++;
+    } while (SCE_VOTerrain_HasTime (vt));
+    /* compact the arena a little bit */
+    if (vt->arena &&
+        SCE_MeshArena_Defragment (vt->arena, SCE_VOTERRAIN_DEFRAGMENT_MOVES) < 0)
+        goto fail;
     /* see which regions can be rendered (compute hidden regions under higher,
        LOD, etc.) */
-    SCE_VOTerrain_UpdateRegions (vt);
+    if (SCE_VOTerrain_TryLockWorld (vt)) {
+        SCE_VOTerrain_UpdateRegions (vt);
+        /* fast edits may have been disabled since */
+        if (vt->n_refines)
+            SCE_VOTerrain_Refine (vt);
+        SCE_VOTerrain_Unlock (vt);
+    }
+    if (vt->budget)
+        SCE_FrameBudget_StopSlice (vt->budget);
     return SCE_OK;
 fail:
+    if (vt->budget)
+        SCE_FrameBudget_StopSlice (vt->budget);
     SCEE_LogSrc ();
     return SCE_ERROR;
 }
 
+/**
+ * \brief Gets the number of pipeline cycles run by the last update
+ * \sa SCE_VOTerrain_SetFrameBudget()
+ */
+SCEuint SCE_VOTerrain_GetNumCycles (const SCE_SVoxelOctreeTerrain *vt)
+{
+    return vt->n_cycles;
+}
+/**
+ * \brief Gets the number of regions sent back to the first stage of the
+ * pipeline because their voxels changed while they were processed
+ */
+SCEuint SCE_VOTerrain_GetNumRestarts (const SCE_SVoxelOctreeTerrain *vt)
+{
+    return vt->n_restarts;
+}
+
+/**
+ * \brief Signals an edit of the worlds
+ * \param vt a voxel octree terrain
+ * \param level edited level
+ * \param rect edited area, in voxels of \p level
+ *
+ * Call this right after modifying the voxel worlds on behalf of the user
+ * (digging, building...). The next SCE_VOTerrain_Update() queues the
+ * regions of \p rect at the head of the pipeline, ahead of the regions
+ * streamed in as the viewer moves. The delay between this call and the
+ * upload of the new geometry is reported by SCE_VOTerrain_GetEditLatency().
+ * \sa SCE_VOTerrain_SetFastEdits()
+ */
+int SCE_VOTerrain_Edit (SCE_SVoxelOctreeTerrain *vt, SCEuint level,
+                        const SCE_SLongRect3 *rect)
+{
+    SCE_SVOTerrainLevel *tl = NULL;
+
+    if (level >= vt->n_levels) {
+        SCEE_Log (SCE_INVALID_ARG);
+        SCEE_LogMsg ("the terrain has no level %u", level);
+        return SCE_ERROR;
+    }
+    tl = &vt->levels[level];
+    if (!tl->edits.n)
+        tl->edit_time = SCE_FrameBudget_GetTime ();
+    if (SCE_VOTerrain_AddRect (&tl->edits, rect) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    return SCE_OK;
+}
+/**
+ * \brief Shows edited regions before decimating them
+ * \param vt a voxel octree terrain
+ * \param fast SCE_TRUE to upload the geometry of edited regions as soon as
+ * it is generated, SCE_FALSE to decimate it first (default)
+ *
+ * The regions shown without decimation are queued again once rendered, at
+ * the tail of the pipeline, to get their decimated geometry.
+ * \sa SCE_VOTerrain_Edit()
+ */
+void SCE_VOTerrain_SetFastEdits (SCE_SVoxelOctreeTerrain *vt, int fast)
+{
+    vt->fast_edits = fast;
+}
+/**
+ * \brief Gets the number of edited regions whose new geometry has been
+ * uploaded so far
+ * \sa SCE_VOTerrain_Edit(), SCE_VOTerrain_GetEditLatency()
+ */
+SCEuint SCE_VOTerrain_GetNumEdits (const SCE_SVoxelOctreeTerrain *vt)
+{
+    return vt->n_edits;
+}
+/**
+ * \brief Gets the average and maximum time between an edit and the upload
+ * of the new geometry of the edited regions, in milliseconds
+ * \param vt a voxel octree terrain
+ * \param avg average latency, can be NULL
+ * \param max maximum latency, can be NULL
+ * \sa SCE_VOTerrain_Edit(), SCE_VOTerrain_GetNumEdits()
+ */
+void SCE_VOTerrain_GetEditLatency (const SCE_SVoxelOctreeTerrain *vt,
+                                   float *avg, float *max)
+{
+    if (avg)
+        *avg = vt->n_edits ? vt->edit_latency / vt->n_edits : 0.0;
+    if (max)
+        *max = vt->max_edit_latency;
+}
+
+/**
+ * \brief Sets the velocity of the viewer, used to prefetch regions
+ * \param vt a voxel octree terrain
+ * \param x,y,z velocity, in voxels of the level 0 per second
+ *
+ * SCE_VOTerrain_SetPosition() queues the regions the levels will need
+ * around the position the viewer is predicted to reach, see
+ * SCE_VOTerrain_SetPrefetchTime(). They are meshed when the pipeline has
+ * nothing else to do and their geometry is stored into the mesh cache,
+ * prefetching is thus disabled along with the cache. To follow a path,
+ * give the displacement towards the next waypoint divided by the prefetch
+ * time.
+ * \sa SCE_VOTerrain_GetPrefetchStats(), SCE_VOTerrain_SetMeshCacheSize()
+ */
+void SCE_VOTerrain_SetVelocity (SCE_SVoxelOctreeTerrain *vt, float x, float y,
+                                float z)
+{
+    vt->velocity[0] = x;
+    vt->velocity[1] = y;
+    vt->velocity[2] = z;
+}
+/**
+ * \brief Sets how far ahead regions are prefetched, in seconds, 1 by
+ * default, 0 disables prefetching
+ * \sa SCE_VOTerrain_SetVelocity()
+ */
+void SCE_VOTerrain_SetPrefetchTime (SCE_SVoxelOctreeTerrain *vt, float t)
+{
+    vt->prefetch_time = t;
+}
+/**
+ * \brief Sets the maximum number of prefetched regions not meshed yet, 32
+ * by default
+ * \sa SCE_VOTerrain_SetVelocity()
+ */
+void SCE_VOTerrain_SetMaxPrefetches (SCE_SVoxelOctreeTerrain *vt, SCEuint n)
+{
+    vt->max_prefetches = n;
+}
+/**
+ * \brief Gets the number of regions prefetched so far and how many of them
+ * ended up used
+ * \param vt a voxel octree terrain
+ * \param issued number of prefetched regions, can be NULL
+ * \param used number of them needed by a level, either while still in the
+ * pipeline or later on from the mesh cache, can be NULL
+ * \sa SCE_VOTerrain_SetVelocity()
+ */
+void SCE_VOTerrain_GetPrefetchStats (const SCE_SVoxelOctreeTerrain *vt,
+                                     SCEuint *issued, SCEuint *used)
+{
+    if (issued)
+        *issued = vt->n_prefetches;
+    if (used)
+        *used = vt->n_prefetch_used +
+            SCE_VMeshCache_GetNumPrefetchHits (&vt->cache);
+}
+
 void SCE_VOTerrain_Render (SCE_SVoxelOctreeTerrain *vt)
 {
     SCE_SListIterator *it = NULL;
     SCE_SVOTerrainRegion *region = NULL;
+    SCE_TMatrix4 m;
 
     /* TODO: apparently in "shadow mode" shaders are locked, but maybe
        with this kind of terrain we dont need special shadow shaders */
@@ -1314,15 +2973,27 @@ void SCE_VOTerrain_Render (SCE_SVoxelOctreeTerrain *vt)
         SCE_Texture_Use (vt->normal);
     SCE_Texture_EndLot ();
 
-    SCE_List_ForEach (it, &vt->to_render) {
-        region = SCE_List_GetData (it);
+    if (vt->arena) {
+        SCE_SMeshBatch *batch = SCE_MeshArena_GetBatch (vt->arena);
+        SCE_MeshBatch_Begin (batch);
+        SCE_List_ForEach (it, &vt->to_render) {
+            region = SCE_List_GetData (it);
+            SCE_VOTerrain_MakeRegionMatrix (region, m);
+            SCE_MeshBatch_Draw (batch, SCE_MeshArena_GetEntry (&region->alloc),
+                                m);
+        }
+        SCE_MeshBatch_Flush (batch);
+    } else {
+        SCE_List_ForEach (it, &vt->to_render) {
+            region = SCE_List_GetData (it);
 
-        SCE_VOTerrain_MakeRegionMatrix (vt, region->level->level, region);
+            SCE_VOTerrain_MakeRegionMatrix (region, m);
 
-        SCE_RLoadMatrix (SCE_MAT_OBJECT, region->matrix);
-        SCE_Mesh_Use (&region->mesh);
-        SCE_Mesh_Render ();
-        SCE_Mesh_Unuse ();
+            SCE_RLoadMatrix (SCE_MAT_OBJECT, m);
+            SCE_Mesh_Use (region->mesh);
+            SCE_Mesh_Render ();
+            SCE_Mesh_Unuse ();
+        }
     }
 
     SCE_Texture_Flush ();
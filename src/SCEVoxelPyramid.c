@@ -0,0 +1,432 @@
+/*------------------------------------------------------------------------------
+    SCEngine - A 3D real time rendering engine written in the C language
+    Copyright (C) 2006-2013  Antony Martin <martin(dot)antony(at)yahoo(dot)fr>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -----------------------------------------------------------------------------*/
+
+/* created: 19/10/2026
+   updated: 19/10/2026 */
+
+#include <string.h>
+#include <SCE/utils/SCEUtils.h>
+#include "SCE/interface/SCEVoxelPyramid.h"
+
+/**
+ * \file SCEVoxelPyramid.c
+ * \brief Min/max density pyramid for empty space skipping
+ *
+ * The pyramid is maintained alongside a voxel grid: the owner calls
+ * SCE_VPyramid_Update() with the box of raw voxels it has just modified
+ * and queries SCE_VPyramid_HasCrossing() before meshing a box of cells.
+ * Grids are toroidal, the last cell along an axis reads the first voxel,
+ * so the finest blocks touching the end of the grid also depend on the
+ * voxels at index 0.
+ */
+
+void SCE_VPyramid_Init (SCE_SVoxelPyramid *pyr)
+{
+    SCEuint i;
+    pyr->dims[0] = pyr->dims[1] = pyr->dims[2] = 0;
+    pyr->block = SCE_VPYRAMID_DEFAULT_BLOCK;
+    pyr->iso = 128;
+    pyr->n_levels = 0;
+    for (i = 0; i < SCE_VPYRAMID_MAX_LEVELS; i++) {
+        pyr->size[i][0] = pyr->size[i][1] = pyr->size[i][2] = 0;
+        pyr->min[i] = pyr->max[i] = NULL;
+    }
+}
+void SCE_VPyramid_Clear (SCE_SVoxelPyramid *pyr)
+{
+    SCEuint i;
+    for (i = 0; i < SCE_VPYRAMID_MAX_LEVELS; i++) {
+        SCE_free (pyr->min[i]);
+        SCE_free (pyr->max[i]);
+    }
+}
+SCE_SVoxelPyramid* SCE_VPyramid_Create (void)
+{
+    SCE_SVoxelPyramid *pyr = NULL;
+    if (!(pyr = SCE_malloc (sizeof *pyr)))
+        SCEE_LogSrc ();
+    else
+        SCE_VPyramid_Init (pyr);
+    return pyr;
+}
+void SCE_VPyramid_Delete (SCE_SVoxelPyramid *pyr)
+{
+    if (pyr) {
+        SCE_VPyramid_Clear (pyr);
+        SCE_free (pyr);
+    }
+}
+
+/**
+ * \brief Sets the dimensions of the voxel grid
+ *
+ * Must be called before SCE_VPyramid_Build().
+ */
+void SCE_VPyramid_SetDimensions (SCE_SVoxelPyramid *pyr, int w, int h, int d)
+{
+    pyr->dims[0] = w;
+    pyr->dims[1] = h;
+    pyr->dims[2] = d;
+}
+/**
+ * \brief Sets the width of the finest blocks, in cells
+ *
+ * Must be called before SCE_VPyramid_Build(). Default is
+ * SCE_VPYRAMID_DEFAULT_BLOCK.
+ */
+void SCE_VPyramid_SetBlockSize (SCE_SVoxelPyramid *pyr, int block)
+{
+    pyr->block = MAX (block, 1);
+}
+/**
+ * \brief Sets the iso value of the surface, default is 128
+ *
+ * A block contains the surface when some of its voxels are below \p iso
+ * while others are not.
+ */
+void SCE_VPyramid_SetIsoValue (SCE_SVoxelPyramid *pyr, SCEubyte iso)
+{
+    pyr->iso = iso;
+}
+SCEuint SCE_VPyramid_GetNumLevels (const SCE_SVoxelPyramid *pyr)
+{
+    return pyr->n_levels;
+}
+
+/**
+ * \brief Allocates the levels of a pyramid
+ * \param pyr a pyramid
+ *
+ * The blocks are initialized as crossing the surface, call
+ * SCE_VPyramid_UpdateAll() to compute them.
+ * \returns SCE_ERROR on error, SCE_OK otherwise
+ */
+int SCE_VPyramid_Build (SCE_SVoxelPyramid *pyr)
+{
+    SCEuint i, j;
+    size_t n;
+
+    SCE_VPyramid_Clear (pyr);
+    for (i = 0; i < 3; i++)
+        pyr->size[0][i] = MAX ((pyr->dims[i] + pyr->block - 1) / pyr->block,
+                               1);
+
+    for (i = 0; i < SCE_VPYRAMID_MAX_LEVELS; i++) {
+        if (i > 0) {
+            if (pyr->size[i - 1][0] == 1 && pyr->size[i - 1][1] == 1 &&
+                pyr->size[i - 1][2] == 1)
+                break;
+            for (j = 0; j < 3; j++)
+                pyr->size[i][j] = (pyr->size[i - 1][j] + 1) / 2;
+        }
+        n = pyr->size[i][0] * pyr->size[i][1] * pyr->size[i][2];
+        if (!(pyr->min[i] = SCE_malloc (n)))
+            goto fail;
+        if (!(pyr->max[i] = SCE_malloc (n)))
+            goto fail;
+        memset (pyr->min[i], 0, n);
+        memset (pyr->max[i], 255, n);
+    }
+    pyr->n_levels = i;
+
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+
+#define SCE_VPYRAMID_INDEX(pyr, l, x, y, z)                             \
+    (((z) * (pyr)->size[l][1] + (y)) * (pyr)->size[l][0] + (x))
+
+static int SCE_VPyramid_Crossing (const SCE_SVoxelPyramid *pyr,
+                                  SCEubyte min, SCEubyte max)
+{
+    return min < pyr->iso && max >= pyr->iso;
+}
+
+static void SCE_VPyramid_ComputeBlock (SCE_SVoxelPyramid *pyr,
+                                       const SCEubyte *data,
+                                       int bx, int by, int bz)
+{
+    int x, y, z, x1, y1, z1, x2, y2, z2;
+    int w = pyr->dims[0], h = pyr->dims[1], d = pyr->dims[2];
+    size_t i, offset;
+    SCEubyte min = 255, max = 0, v;
+
+    x1 = bx * pyr->block; x2 = MIN (x1 + pyr->block, w);
+    y1 = by * pyr->block; y2 = MIN (y1 + pyr->block, h);
+    z1 = bz * pyr->block; z2 = MIN (z1 + pyr->block, d);
+
+    /* the end of the block is included: its last cells read the first
+       voxels of the next block, or of the grid when it is the last one */
+    for (z = z1; z <= z2; z++) {
+        for (y = y1; y <= y2; y++) {
+            offset = ((size_t)(z % d) * h + y % h) * w;
+            for (x = x1; x < x2; x++) {
+                v = data[offset + x];
+                min = MIN (min, v);
+                max = MAX (max, v);
+            }
+            v = data[offset + x2 % w];
+            min = MIN (min, v);
+            max = MAX (max, v);
+        }
+    }
+
+    i = SCE_VPYRAMID_INDEX (pyr, 0, bx, by, bz);
+    pyr->min[0][i] = min;
+    pyr->max[0][i] = max;
+}
+
+static void SCE_VPyramid_ComputeParent (SCE_SVoxelPyramid *pyr, SCEuint l,
+                                        int px, int py, int pz)
+{
+    int x, y, z;
+    size_t i;
+    SCEubyte min = 255, max = 0;
+
+    for (z = 2 * pz; z < MIN (2 * pz + 2, pyr->size[l - 1][2]); z++) {
+        for (y = 2 * py; y < MIN (2 * py + 2, pyr->size[l - 1][1]); y++) {
+            for (x = 2 * px; x < MIN (2 * px + 2, pyr->size[l - 1][0]); x++) {
+                i = SCE_VPYRAMID_INDEX (pyr, l - 1, x, y, z);
+                min = MIN (min, pyr->min[l - 1][i]);
+                max = MAX (max, pyr->max[l - 1][i]);
+            }
+        }
+    }
+
+    i = SCE_VPYRAMID_INDEX (pyr, l, px, py, pz);
+    pyr->min[l][i] = min;
+    pyr->max[l][i] = max;
+}
+
+/* computes blocks [b1, b2] of the finest level and their ancestors */
+static void SCE_VPyramid_UpdateBlocks (SCE_SVoxelPyramid *pyr,
+                                       const SCEubyte *data,
+                                       int b1[3], int b2[3])
+{
+    int x, y, z, i;
+    SCEuint l;
+
+    for (z = b1[2]; z <= b2[2]; z++) {
+        for (y = b1[1]; y <= b2[1]; y++) {
+            for (x = b1[0]; x <= b2[0]; x++)
+                SCE_VPyramid_ComputeBlock (pyr, data, x, y, z);
+        }
+    }
+
+    for (l = 1; l < pyr->n_levels; l++) {
+        for (i = 0; i < 3; i++) {
+            b1[i] /= 2;
+            b2[i] /= 2;
+        }
+        for (z = b1[2]; z <= b2[2]; z++) {
+            for (y = b1[1]; y <= b2[1]; y++) {
+                for (x = b1[0]; x <= b2[0]; x++)
+                    SCE_VPyramid_ComputeParent (pyr, l, x, y, z);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Updates the blocks depending on modified voxels
+ * \param pyr a pyramid
+ * \param data voxels of the grid
+ * \param box modified voxels, half-open box in raw grid coordinates
+ * \sa SCE_VPyramid_UpdateAll()
+ */
+void SCE_VPyramid_Update (SCE_SVoxelPyramid *pyr, const SCEubyte *data,
+                          const SCE_SIntRect3 *box)
+{
+    int p1[3], p2[3];
+    int first[3][2], last[3][2], n[3];
+    int b1[3], b2[3];
+    int i, x, y, z;
+
+    if (!pyr->n_levels)
+        return;
+
+    SCE_Rectangle3_GetPointsv (box, p1, p2);
+    for (i = 0; i < 3; i++) {
+        p1[i] = MAX (p1[i], 0);
+        p2[i] = MIN (p2[i], pyr->dims[i]);
+        if (p2[i] <= p1[i])
+            return;
+        /* the block before the first voxel reads it too */
+        first[i][0] = MAX (p1[i] - 1, 0) / pyr->block;
+        last[i][0] = MIN ((p2[i] - 1) / pyr->block, pyr->size[0][i] - 1);
+        n[i] = 1;
+        /* voxels at index 0 are read by the last block */
+        if (p1[i] == 0 && last[i][0] < pyr->size[0][i] - 1) {
+            first[i][1] = last[i][1] = pyr->size[0][i] - 1;
+            n[i] = 2;
+        }
+    }
+
+    for (z = 0; z < n[2]; z++) {
+        for (y = 0; y < n[1]; y++) {
+            for (x = 0; x < n[0]; x++) {
+                b1[0] = first[0][x]; b2[0] = last[0][x];
+                b1[1] = first[1][y]; b2[1] = last[1][y];
+                b1[2] = first[2][z]; b2[2] = last[2][z];
+                SCE_VPyramid_UpdateBlocks (pyr, data, b1, b2);
+            }
+        }
+    }
+}
+/**
+ * \brief Computes all the blocks of a pyramid
+ * \param pyr a pyramid
+ * \param data voxels of the grid
+ */
+void SCE_VPyramid_UpdateAll (SCE_SVoxelPyramid *pyr, const SCEubyte *data)
+{
+    int b1[3], b2[3];
+    int i;
+
+    if (!pyr->n_levels)
+        return;
+
+    for (i = 0; i < 3; i++) {
+        b1[i] = 0;
+        b2[i] = pyr->size[0][i] - 1;
+    }
+    SCE_VPyramid_UpdateBlocks (pyr, data, b1, b2);
+}
+
+
+static int SCE_VPyramid_Visit (const SCE_SVoxelPyramid *pyr, SCEuint l,
+                               int bx, int by, int bz,
+                               const int *c1, const int *c2)
+{
+    int x, y, z, span;
+    int x1, x2, y1, y2, z1, z2;
+    size_t i;
+
+    i = SCE_VPYRAMID_INDEX (pyr, l, bx, by, bz);
+    if (!SCE_VPyramid_Crossing (pyr, pyr->min[l][i], pyr->max[l][i]))
+        return SCE_FALSE;
+    if (l == 0)
+        return SCE_TRUE;
+
+    /* children intersecting the cells */
+    span = pyr->block << (l - 1);
+    x1 = MAX (2 * bx, c1[0] / span);
+    x2 = MIN (2 * bx + 1, (c2[0] - 1) / span);
+    x2 = MIN (x2, pyr->size[l - 1][0] - 1);
+    y1 = MAX (2 * by, c1[1] / span);
+    y2 = MIN (2 * by + 1, (c2[1] - 1) / span);
+    y2 = MIN (y2, pyr->size[l - 1][1] - 1);
+    z1 = MAX (2 * bz, c1[2] / span);
+    z2 = MIN (2 * bz + 1, (c2[2] - 1) / span);
+    z2 = MIN (z2, pyr->size[l - 1][2] - 1);
+
+    for (z = z1; z <= z2; z++) {
+        for (y = y1; y <= y2; y++) {
+            for (x = x1; x <= x2; x++) {
+                if (SCE_VPyramid_Visit (pyr, l - 1, x, y, z, c1, c2))
+                    return SCE_TRUE;
+            }
+        }
+    }
+    return SCE_FALSE;
+}
+
+static int SCE_VPyramid_HasCrossingRaw (const SCE_SVoxelPyramid *pyr,
+                                        const int *c1, const int *c2)
+{
+    int x, y, z, span, top;
+    int b1[3], b2[3], i;
+
+    top = pyr->n_levels - 1;
+    span = pyr->block << top;
+    for (i = 0; i < 3; i++) {
+        b1[i] = c1[i] / span;
+        b2[i] = MIN ((c2[i] - 1) / span, pyr->size[top][i] - 1);
+    }
+
+    for (z = b1[2]; z <= b2[2]; z++) {
+        for (y = b1[1]; y <= b2[1]; y++) {
+            for (x = b1[0]; x <= b2[0]; x++) {
+                if (SCE_VPyramid_Visit (pyr, top, x, y, z, c1, c2))
+                    return SCE_TRUE;
+            }
+        }
+    }
+    return SCE_FALSE;
+}
+
+/**
+ * \brief Tells whether a box of cells may contain the surface
+ * \param pyr a pyramid
+ * \param cells half-open box of cells, in logical coordinates
+ * \param wrap wrapping offset of the grid along each axis (logical
+ * coordinate 0 maps to raw coordinate \p wrap), can be NULL
+ *
+ * The answer is conservative: false is only returned when every block
+ * touched by \p cells lies entirely on one side of the surface.
+ * \returns SCE_FALSE if no cell of \p cells can produce a triangle
+ */
+int SCE_VPyramid_HasCrossing (const SCE_SVoxelPyramid *pyr,
+                              const SCE_SIntRect3 *cells, const int *wrap)
+{
+    int p1[3], p2[3];
+    int r1[3][2], r2[3][2], n[3];
+    int c1[3], c2[3];
+    int i, x, y, z, len, start;
+
+    if (!pyr->n_levels)
+        return SCE_TRUE;
+
+    /* split the box into raw ranges */
+    SCE_Rectangle3_GetPointsv (cells, p1, p2);
+    for (i = 0; i < 3; i++) {
+        len = p2[i] - p1[i];
+        if (len <= 0)
+            return SCE_FALSE;
+        n[i] = 1;
+        if (len >= pyr->dims[i]) {
+            r1[i][0] = 0;
+            r2[i][0] = pyr->dims[i];
+            continue;
+        }
+        start = SCE_Math_Ring (p1[i] + (wrap ? wrap[i] : 0), pyr->dims[i]);
+        r1[i][0] = start;
+        r2[i][0] = MIN (start + len, pyr->dims[i]);
+        if (start + len > pyr->dims[i]) {
+            r1[i][1] = 0;
+            r2[i][1] = start + len - pyr->dims[i];
+            n[i] = 2;
+        }
+    }
+
+    for (z = 0; z < n[2]; z++) {
+        for (y = 0; y < n[1]; y++) {
+            for (x = 0; x < n[0]; x++) {
+                c1[0] = r1[0][x]; c2[0] = r2[0][x];
+                c1[1] = r1[1][y]; c2[1] = r2[1][y];
+                c1[2] = r1[2][z]; c2[2] = r2[2][z];
+                if (SCE_VPyramid_HasCrossingRaw (pyr, c1, c2))
+                    return SCE_TRUE;
+            }
+        }
+    }
+    return SCE_FALSE;
+}
@@ -17,7 +17,7 @@
  -----------------------------------------------------------------------------*/
 
 /* created: 14/02/2012
-   updated: 21/03/2013 */
+   updated: 19/10/2026 */
 
 #include <SCE/utils/SCEUtils.h>
 #include <SCE/core/SCECore.h>
@@ -440,9 +440,12 @@ void SCE_VRender_Init (SCE_SVoxelTemplate *vt)
     vt->width = vt->height = vt->depth = 0;
 
     SCE_MC_Init (&vt->mc_gen);
+    SCE_VClassifier_Init (&vt->classifier);
     vt->vertices = NULL;
     vt->normals = NULL;
     vt->indices = NULL;
+    vt->optimize = 0;
+    SCE_MeshOpt_Init (&vt->opt);
 
     SCE_Geometry_Init (&vt->grid_geom);
     SCE_Mesh_Init (&vt->grid_mesh);
@@ -460,6 +463,23 @@ void SCE_VRender_Init (SCE_SVoxelTemplate *vt)
     vt->indices_shader = NULL;
     vt->splat = NULL;
     vt->mc_table = NULL;
+
+    vt->batch = 1;
+    vt->slots = NULL;
+}
+static void SCE_VRender_ClearSlots (SCE_SVoxelTemplate *vt)
+{
+    SCEuint i;
+
+    if (!vt->slots)
+        return;
+    for (i = 0; i < vt->batch; i++) {
+        SCE_Mesh_Clear (&vt->slots[i].non_empty);
+        SCE_Mesh_Clear (&vt->slots[i].list_verts);
+        SCE_Texture_Delete (vt->slots[i].splat);
+    }
+    SCE_free (vt->slots);
+    vt->slots = NULL;
 }
 void SCE_VRender_Clear (SCE_SVoxelTemplate *vt)
 {
@@ -469,9 +489,11 @@ void SCE_VRender_Clear (SCE_SVoxelTemplate *vt)
     SCE_Mesh_Clear (&vt->list_verts);
 
     SCE_MC_Clear (&vt->mc_gen);
+    SCE_VClassifier_Clear (&vt->classifier);
     SCE_free (vt->vertices);
     SCE_free (vt->normals);
     SCE_free (vt->indices);
+    SCE_MeshOpt_Clear (&vt->opt);
 
     SCE_Shader_Delete (vt->non_empty_shader);
     SCE_Shader_Delete (vt->list_verts_shader);
@@ -480,6 +502,7 @@ void SCE_VRender_Clear (SCE_SVoxelTemplate *vt)
     SCE_Shader_Delete (vt->splat_shader);
     SCE_Shader_Delete (vt->indices_shader);
     SCE_Texture_Delete (vt->splat);
+    SCE_VRender_ClearSlots (vt);
 }
 SCE_SVoxelTemplate* SCE_VRender_Create (void)
 {
@@ -600,6 +623,44 @@ void SCE_VRender_SetIndexBufferPool (SCE_SVoxelTemplate *vt,
 {
     vt->index_pool = pool;
 }
+/**
+ * \brief Sets the optimization passes applied to the meshes generated by
+ * SCE_VRender_Software()
+ * \sa SCE_MeshOpt_Optimize(), SCE_VRender_GetOptimizer()
+ */
+void SCE_VRender_SetOptimization (SCE_SVoxelTemplate *vt, SCEbitfield flags)
+{
+    vt->optimize = flags;
+}
+/**
+ * \brief Gets the mesh optimizer of a template, mostly for its statistics
+ * \sa SCE_MeshOpt_GetAverageACMR()
+ */
+SCE_SMeshOptimizer* SCE_VRender_GetOptimizer (SCE_SVoxelTemplate *vt)
+{
+    return &vt->opt;
+}
+/**
+ * \brief Sets the maximum number of volumes SCE_VRender_HardwareBatch() can
+ * polygonize at once, must be called before SCE_VRender_Build()
+ * \param vt a voxel template
+ * \param n number of volumes, 1 by default
+ *
+ * Each volume of a batch gets its own intermediate meshes and 3D map of
+ * indices, so that every pass of the generation is done for the whole batch
+ * before the next pass begins. This function has no effect once \p vt is
+ * built.
+ * \sa SCE_VRender_HardwareBatch()
+ */
+void SCE_VRender_SetBatchSize (SCE_SVoxelTemplate *vt, SCEuint n)
+{
+    if (!vt->slots)
+        vt->batch = MAX (n, 1);
+}
+SCEuint SCE_VRender_GetBatchSize (const SCE_SVoxelTemplate *vt)
+{
+    return vt->batch;
+}
 
 static const char *non_empty_vs =
     "#define OW (1.0/W)\n"
@@ -1814,6 +1875,45 @@ static const char *mc_indices_gs =
     "}";
 
 
+/* creates a 3D map of indices, the render target of the splat pass */
+static SCE_STexture*
+SCE_VRender_CreateSplat (SCE_SVoxelTemplate *vt, int width, int height,
+                         int depth, unsigned int n_vertices)
+{
+    SCE_STexture *splat = NULL;
+    SCE_STexData tc;
+
+    if (!(splat = SCE_Texture_Create (SCE_TEX_3D, 0, 0, 0))) goto fail;
+    SCE_TexData_Init (&tc);
+    if (vt->algo == SCE_VRENDER_MARCHING_TETRAHEDRA)
+        SCE_TexData_SetDimensions (&tc, width * 8, height, depth);
+    else
+        SCE_TexData_SetDimensions (&tc, width * 4, height, depth);
+    if (n_vertices < 256 * 256) {
+        SCE_TexData_SetDataType (&tc, SCE_UNSIGNED_SHORT);
+        SCE_TexData_SetPixelFormat (&tc, SCE_PXF_R16UI);
+    } else {
+        SCE_TexData_SetDataType (&tc, SCE_UNSIGNED_INT);
+        SCE_TexData_SetPixelFormat (&tc, SCE_PXF_R32UI);
+    }
+    SCE_TexData_SetType (&tc, SCE_IMAGE_3D);
+    SCE_TexData_SetDataFormat (&tc, SCE_IMAGE_RED);
+    SCE_Texture_AddTexDataDup (splat, 0, &tc);
+    /* index values must not be modified by magnification filter */
+    SCE_Texture_Pixelize (splat, SCE_TRUE);
+    SCE_Texture_SetFilter (splat, SCE_TEX_NEAREST);
+    SCE_Texture_Build (splat, SCE_FALSE);
+    if (SCE_Texture_SetupFramebuffer (splat, SCE_RENDER_COLOR,
+                                      0, SCE_FALSE, SCE_FALSE) < 0)
+        goto fail;
+
+    return splat;
+fail:
+    SCE_Texture_Delete (splat);
+    SCEE_LogSrc ();
+    return NULL;
+}
+
 static int SCE_VRender_BuildHW (SCE_SVoxelTemplate *vt)
 {
     SCE_SGrid grid;
@@ -2006,28 +2106,8 @@ static int SCE_VRender_BuildHW (SCE_SVoxelTemplate *vt)
     if (SCE_Shader_Build (vt->indices_shader) < 0) goto fail;
 
     /* constructing indices 3D map */
-    if (!(vt->splat = SCE_Texture_Create (SCE_TEX_3D, 0, 0, 0))) goto fail;
-    SCE_TexData_Init (&tc);
-    if (vt->algo == SCE_VRENDER_MARCHING_TETRAHEDRA)
-        SCE_TexData_SetDimensions (&tc, width * 8, height, depth);
-    else
-        SCE_TexData_SetDimensions (&tc, width * 4, height, depth);
-    if (n_vertices < 256 * 256) {
-        SCE_TexData_SetDataType (&tc, SCE_UNSIGNED_SHORT);
-        SCE_TexData_SetPixelFormat (&tc, SCE_PXF_R16UI);
-    } else {
-        SCE_TexData_SetDataType (&tc, SCE_UNSIGNED_INT);
-        SCE_TexData_SetPixelFormat (&tc, SCE_PXF_R32UI);
-    }
-    SCE_TexData_SetType (&tc, SCE_IMAGE_3D);
-    SCE_TexData_SetDataFormat (&tc, SCE_IMAGE_RED);
-    SCE_Texture_AddTexDataDup (vt->splat, 0, &tc);
-    /* index values must not be modified by magnification filter */
-    SCE_Texture_Pixelize (vt->splat, SCE_TRUE);
-    SCE_Texture_SetFilter (vt->splat, SCE_TEX_NEAREST);
-    SCE_Texture_Build (vt->splat, SCE_FALSE);
-    if (SCE_Texture_SetupFramebuffer (vt->splat, SCE_RENDER_COLOR,
-                                      0, SCE_FALSE, SCE_FALSE) < 0)
+    if (!(vt->splat = SCE_VRender_CreateSplat (vt, width, height, depth,
+                                               n_vertices)))
         goto fail;
 
     if (vt->algo == SCE_VRENDER_MARCHING_CUBES) {
@@ -2050,6 +2130,32 @@ static int SCE_VRender_BuildHW (SCE_SVoxelTemplate *vt)
         SCE_Texture_SetUnit (vt->mc_table, 1);
     }
 
+    if (vt->batch > 1) {
+        SCEuint i;
+        SCE_VRender_ClearSlots (vt);
+        if (!(vt->slots = SCE_malloc (vt->batch * sizeof *vt->slots)))
+            goto fail;
+        for (i = 0; i < vt->batch; i++) {
+            SCE_Mesh_Init (&vt->slots[i].non_empty);
+            SCE_Mesh_Init (&vt->slots[i].list_verts);
+            vt->slots[i].splat = NULL;
+        }
+        for (i = 0; i < vt->batch; i++) {
+            SCE_SVoxelBatchSlot *slot = &vt->slots[i];
+            if (SCE_Mesh_SetGeometry (&slot->non_empty, &non_empty_geom,
+                                      SCE_FALSE) < 0)
+                goto fail;
+            SCE_Mesh_AutoBuild (&slot->non_empty);
+            if (SCE_Mesh_SetGeometry (&slot->list_verts, &list_verts_geom,
+                                      SCE_FALSE) < 0)
+                goto fail;
+            SCE_Mesh_AutoBuild (&slot->list_verts);
+            if (!(slot->splat = SCE_VRender_CreateSplat (vt, width, height,
+                                                         depth, n_vertices)))
+                goto fail;
+        }
+    }
+
     return SCE_OK;
 fail:
     SCEE_LogSrc ();
@@ -2090,6 +2196,10 @@ static int SCE_VRender_BuildSoftware (SCE_SVoxelTemplate *vt)
     SCE_MC_SetNumCells (&vt->mc_gen, n_points);
     if (SCE_MC_Build (&vt->mc_gen) < 0)
         goto fail;
+    SCE_VClassifier_SetDimensions (&vt->classifier, vt->width, vt->height,
+                                   vt->depth);
+    if (SCE_VClassifier_Build (&vt->classifier) < 0)
+        goto fail;
 
     return SCE_OK;
 fail:
@@ -2123,6 +2233,17 @@ void SCE_VRender_SetMesh (SCE_SVoxelMesh *vm, SCE_SMesh *mesh)
 }
 
 
+/**
+ * \brief Sets the range of the vertex buffer of the mesh to write into
+ * \param vm a voxel mesh
+ * \param r first vertex and number of vertices of the range, NULL to use
+ * the whole buffer (default)
+ *
+ * When both ranges are set, SCE_VRender_Software() writes the generated
+ * geometry at the beginning of the ranges instead of reallocating the
+ * buffers of the mesh, which may thus be shared by many voxel meshes.
+ * \sa SCE_VRender_SetIBRange(), SCE_VRender_FitsRanges()
+ */
 void SCE_VRender_SetVBRange (SCE_SVoxelMesh *vm, const int *r)
 {
     if (r) {
@@ -2132,6 +2253,12 @@ void SCE_VRender_SetVBRange (SCE_SVoxelMesh *vm, const int *r)
         vm->vertex_range[0] = vm->vertex_range[1] = -1;
     }
 }
+/**
+ * \brief Sets the range of the index buffer of the mesh to write into
+ * \param r first index and number of indices of the range, NULL to use
+ * the whole buffer (default)
+ * \sa SCE_VRender_SetVBRange()
+ */
 void SCE_VRender_SetIBRange (SCE_SVoxelMesh *vm, const int *r)
 {
     if (r) {
@@ -2141,7 +2268,99 @@ void SCE_VRender_SetIBRange (SCE_SVoxelMesh *vm, const int *r)
         vm->index_range[0] = vm->index_range[1] = -1;
     }
 }
+static int SCE_VRender_UseRanges (const SCE_SVoxelMesh *vm)
+{
+    return vm->vertex_range[0] >= 0 && vm->index_range[0] >= 0;
+}
+/**
+ * \brief Checks whether the last generated geometry of a voxel mesh fits
+ * into its ranges
+ * \returns SCE_TRUE if no range is set or if the geometry fits
+ * \sa SCE_VRender_SetVBRange(), SCE_VRender_UploadRanges()
+ */
+int SCE_VRender_FitsRanges (const SCE_SVoxelMesh *vm)
+{
+    if (!SCE_VRender_UseRanges (vm))
+        return SCE_TRUE;
+    return vm->n_vertices <= (SCEuint)vm->vertex_range[1] &&
+        vm->n_indices <= (SCEuint)vm->index_range[1];
+}
+/**
+ * \brief Uploads the geometry generated by the last call to
+ * SCE_VRender_Software() into the ranges of a voxel mesh
+ *
+ * Use it when the geometry did not fit into the previous ranges, after having
+ * given larger ones.
+ * \returns SCE_ERROR if the geometry still doesn't fit, SCE_OK otherwise
+ * \sa SCE_VRender_FitsRanges()
+ */
+int SCE_VRender_UploadRanges (SCE_SVoxelTemplate *vt, SCE_SVoxelMesh *vm)
+{
+    size_t vertex_size = 3 * sizeof (SCEvertices);
+    size_t index_size = sizeof (SCEindices);
+
+    if (!SCE_VRender_UseRanges (vm) || !SCE_VRender_FitsRanges (vm)) {
+        SCEE_Log (SCE_INVALID_OPERATION);
+        SCEE_LogMsg ("geometry of %u vertices and %u indices doesn't fit into "
+                     "the ranges of the voxel mesh", vm->n_vertices,
+                     vm->n_indices);
+        return SCE_ERROR;
+    }
+    if (!vm->n_vertices)
+        return SCE_OK;
 
+    SCE_Mesh_UploadVertices (vm->mesh, SCE_MESH_STREAM_G, vt->vertices,
+                             vm->vertex_range[0] * vertex_size,
+                             vm->n_vertices * vertex_size);
+    SCE_Mesh_UploadVertices (vm->mesh, SCE_MESH_STREAM_N, vt->normals,
+                             vm->vertex_range[0] * vertex_size,
+                             vm->n_vertices * vertex_size);
+    SCE_Mesh_Unbind ();
+    SCE_RInstantIndexBufferUpdate (SCE_Mesh_GetIndexBuffer (vm->mesh),
+                                   vt->indices,
+                                   vm->index_range[0] * index_size,
+                                   vm->n_indices * index_size);
+    return SCE_OK;
+}
+
+
+/**
+ * \brief Empties a voxel mesh without generating anything
+ * \param vt a voxel template
+ * \param vm the voxel mesh to empty
+ *
+ * Use it when the voxels of the mesh are known not to cross the surface.
+ * The buffers of the mesh are shrunk when \p vt has buffer pools, a mesh
+ * with ranges keeps them untouched.
+ * \returns SCE_ERROR on error, SCE_OK otherwise
+ * \sa SCE_VRender_IsEmpty()
+ */
+int SCE_VRender_Empty (SCE_SVoxelTemplate *vt, SCE_SVoxelMesh *vm)
+{
+    vm->render = SCE_FALSE;
+    vm->n_vertices = vm->n_indices = 0;
+    if (SCE_VRender_UseRanges (vm))
+        return SCE_OK;
+    SCE_Mesh_SetNumVertices (vm->mesh, 0);
+    SCE_Mesh_SetNumIndices (vm->mesh, 0);
+    if (vt->vertex_pool) {
+        if (SCE_Mesh_ReallocStream (vm->mesh, SCE_MESH_STREAM_G,
+                                    vt->vertex_pool) < 0)
+            goto fail;
+        if (vt->pipeline == SCE_VRENDER_SOFTWARE &&
+            SCE_Mesh_ReallocStream (vm->mesh, SCE_MESH_STREAM_N,
+                                    vt->vertex_pool) < 0)
+            goto fail;
+    }
+    if (vt->index_pool) {
+        if (SCE_Mesh_ReallocIndexBuffer (vm->mesh, vt->index_pool) < 0)
+            goto fail;
+    }
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
 
 /**
  * \brief Generates geometry from a density field using the CPU
@@ -2152,11 +2371,15 @@ void SCE_VRender_SetIBRange (SCE_SVoxelMesh *vm, const int *r)
  * \returns SCE_ERROR on error, SCE_OK otherwise. Note that if you haven't set
  * any buffer pool to \p vt (see SCE_VRender_SetBufferPool()), this function
  * always returns SCE_OK.
+ *
+ * When \p vm has ranges, nothing is reallocated and the geometry is written
+ * into them; check SCE_VRender_FitsRanges() afterwards.
  */
 int SCE_VRender_Software (SCE_SVoxelTemplate *vt, const SCE_SGrid *volume,
                           SCE_SVoxelMesh *vm, int x, int y, int z)
 {
-    SCE_SIntRect3 rect;
+    SCE_SIntRect3 rect, cells;
+    int p1[3], p2[3];
     size_t n_vertices, n_indices;
     size_t vertex_size, index_size;
     SCE_RVertexBuffer *vb;
@@ -2164,34 +2387,53 @@ int SCE_VRender_Software (SCE_SVoxelTemplate *vt, const SCE_SGrid *volume,
 
     SCE_Rectangle3_SetFromOrigin (&rect, x, y, z, vt->width, vt->height,
                                   vt->depth);
-    /* TODO: pos and nor shall be interleaved */
-    n_vertices = SCE_MC_GenerateVertices (&vt->mc_gen, &rect, volume,
-                                          vt->vertices);
-    if (n_vertices != 0) {
-        vm->render = SCE_TRUE;
-    } else {
-        vm->render = SCE_FALSE;
-        SCE_Mesh_SetNumVertices (vm->mesh, 0);
-        SCE_Mesh_SetNumIndices (vm->mesh, 0);
-        if (vt->vertex_pool) {
-            if (SCE_Mesh_ReallocStream (vm->mesh, SCE_MESH_STREAM_G,
-                                        vt->vertex_pool) < 0)
-                goto fail;
-            if (SCE_Mesh_ReallocStream (vm->mesh, SCE_MESH_STREAM_N,
-                                        vt->vertex_pool) < 0)
-                goto fail;
-        }
-        if (vt->index_pool) {
-            if (SCE_Mesh_ReallocIndexBuffer (vm->mesh, vt->index_pool) < 0)
-                goto fail;
-        }
-        return;
+    /* most volumes hold no surface at all: find it out with a cheap
+       classification pass before marching */
+    p1[0] = x; p2[0] = x + vt->width;
+    p1[1] = y; p2[1] = y + vt->height;
+    p1[2] = z; p2[2] = z + vt->depth;
+    SCE_Rectangle3_Setv (&cells, p1, p2);
+    n_vertices = 0;
+    if (SCE_VClassifier_HasSurface (&vt->classifier, volume, &cells)) {
+        /* TODO: pos and nor shall be interleaved */
+        n_vertices = SCE_MC_GenerateVertices (&vt->mc_gen, &rect, volume,
+                                              vt->vertices);
     }
+    if (n_vertices == 0) {
+        if (SCE_VRender_Empty (vt, vm) < 0)
+            goto fail;
+        return SCE_OK;
+    }
+    vm->render = SCE_TRUE;
     n_indices = SCE_MC_GenerateIndices (&vt->mc_gen, vt->indices);
     SCE_MC_GenerateNormals (&vt->mc_gen, volume, vt->normals);
 
+    if (vt->optimize) {
+        if (SCE_MeshOpt_Optimize (&vt->opt, vt->optimize, vt->indices,
+                                  SCE_INDICES_TYPE, n_indices, vt->vertices,
+                                  0, n_vertices) < 0)
+            goto fail;
+        if (SCE_MeshOpt_Remap (&vt->opt, vt->vertices,
+                               3 * sizeof *vt->vertices, 0) < 0)
+            goto fail;
+        if (SCE_MeshOpt_Remap (&vt->opt, vt->normals,
+                               3 * sizeof *vt->normals, 0) < 0)
+            goto fail;
+    }
+
     vertex_size = 3 * sizeof (SCEvertices);
     index_size = sizeof (SCEindices);
+    vm->n_vertices = n_vertices;
+    vm->n_indices = n_indices;
+
+    if (SCE_VRender_UseRanges (vm)) {
+        /* shared buffers: only touch the generated range, if it fits,
+           otherwise the caller will provide larger ranges */
+        if (SCE_VRender_FitsRanges (vm) &&
+            SCE_VRender_UploadRanges (vt, vm) < 0)
+            goto fail;
+        return SCE_OK;
+    }
 
     /* we kinda wanna upload these data asap, because we dont really want
        to keep a copy on CPU memory */
@@ -2214,8 +2456,6 @@ int SCE_VRender_Software (SCE_SVoxelTemplate *vt, const SCE_SGrid *volume,
     SCE_Mesh_UploadVertices (vm->mesh, SCE_MESH_STREAM_N, vt->normals,
                              0, n_vertices * vertex_size);
     SCE_Mesh_UploadIndices (vm->mesh, vt->indices, n_indices * index_size);
-    /* TODO: we want to use BindBufferRange() since only a small part of the
-       buffer will actually be needed. */
 
     return SCE_OK;
 fail:
@@ -2223,6 +2463,22 @@ fail:
     return SCE_ERROR;
 }
 
+/* offset of the texture coordinates of the volume of a mesh */
+static void SCE_VRender_GetWrap (SCE_STexture *volume, const SCE_SVoxelMesh *vm,
+                                 int x, int y, int z, SCE_TVector3 wrap)
+{
+    float w, h, d;
+
+    w = SCE_Texture_GetWidth (volume);
+    h = SCE_Texture_GetHeight (volume);
+    d = SCE_Texture_GetDepth (volume);
+    SCE_Vector3_Copy (wrap, vm->wrap);
+    wrap[0] += (float)x / w;
+    wrap[1] += (float)y / h;
+    wrap[2] += (float)z / d;
+}
+
+/* resets a mesh whose volume has no non-empty cell */
 /**
  * \brief Generates geometry from a density field using the GPU
  * \param vt a voxel template
@@ -2239,16 +2495,9 @@ int SCE_VRender_Hardware (SCE_SVoxelTemplate *vt, SCE_STexture *volume,
                           int x, int y, int z)
 {
     SCE_TVector3 wrap;
-    float w, h, d;
     int i;
 
-    w = SCE_Texture_GetWidth (volume);
-    h = SCE_Texture_GetHeight (volume);
-    d = SCE_Texture_GetDepth (volume);
-    SCE_Vector3_Copy (wrap, vm->wrap);
-    wrap[0] += (float)x / w;
-    wrap[1] += (float)y / h;
-    wrap[2] += (float)z / d;
+    SCE_VRender_GetWrap (volume, vm, x, y, z, wrap);
 
     /* 1st pass: render non empty cells */
     /* TODO: we are assuming that volume's unit is 0 */
@@ -2265,19 +2514,9 @@ int SCE_VRender_Hardware (SCE_SVoxelTemplate *vt, SCE_STexture *volume,
     if (SCE_Mesh_GetNumVertices (&vt->non_empty) != 0) {
         vm->render = SCE_TRUE;
     } else {
-        vm->render = SCE_FALSE;
-        /* ... so I setup those as a precaution :) (wat?) */
-        SCE_Mesh_SetNumVertices (vm->mesh, 0);
-        SCE_Mesh_SetNumIndices (vm->mesh, 0);
-        if (vt->vertex_pool) {
-            if (SCE_Mesh_ReallocStream (vm->mesh, SCE_MESH_STREAM_G,
-                                        vt->vertex_pool) < 0)
-                goto fail;
-        }
-        if (vt->index_pool) {
-            if (SCE_Mesh_ReallocIndexBuffer (vm->mesh, vt->index_pool) < 0)
-                goto fail;
-        }
+        /* ... so the mesh is emptied as a precaution :) (wat?) */
+        if (SCE_VRender_Empty (vt, vm) < 0)
+            goto fail;
         SCE_Shader_Use (NULL);
         SCE_Texture_Use (NULL);
         return SCE_OK;
@@ -2352,6 +2591,9 @@ int SCE_VRender_Hardware (SCE_SVoxelTemplate *vt, SCE_STexture *volume,
     i = SCE_Mesh_GetNumIndices (vm->mesh);
     SCE_Mesh_SetNumIndices (vm->mesh, i * 3);
 
+    vm->n_vertices = SCE_Mesh_GetNumVertices (vm->mesh);
+    vm->n_indices = SCE_Mesh_GetNumIndices (vm->mesh);
+
     sce_max_vertices = MAX (sce_max_vertices, SCE_Mesh_GetNumVertices (vm->mesh));
     sce_max_indices = MAX (sce_max_indices, SCE_Mesh_GetNumIndices (vm->mesh));
 
@@ -2365,6 +2607,183 @@ fail:
 }
 
 
+/**
+ * \brief Generates the geometry of several density fields using the GPU
+ * \param vt a voxel template
+ * \param volumes source voxels of each mesh
+ * \param materials material data of each mesh, can be NULL
+ * \param vms abstract output meshes
+ * \param n number of meshes, at most SCE_VRender_GetBatchSize()
+ * \param x,y,z coordinates of the origin for volume texture fetches
+ * \returns SCE_ERROR on error, SCE_OK otherwise
+ *
+ * Same as SCE_VRender_Hardware() but each pass of the generation is done
+ * for all the volumes before the next one: shaders are bound once per pass
+ * and the amounts of generated primitives are read back once per pass
+ * instead of stalling after every single render.
+ * \sa SCE_VRender_Hardware(), SCE_VRender_SetBatchSize()
+ */
+int SCE_VRender_HardwareBatch (SCE_SVoxelTemplate *vt, SCE_STexture **volumes,
+                               SCE_STexture **materials, SCE_SVoxelMesh **vms,
+                               SCEuint n, int x, int y, int z)
+{
+    SCE_SVoxelBatchSlot *slot = NULL;
+    SCE_SVoxelMesh *vm = NULL;
+    SCE_TVector3 wrap;
+    int use_materials;
+    SCEuint i;
+
+    if (n <= 1) {
+        if (n == 0)
+            return SCE_OK;
+        return SCE_VRender_Hardware (vt, volumes[0],
+                                     materials ? materials[0] : NULL,
+                                     vms[0], x, y, z);
+    }
+    if (!vt->slots || n > vt->batch) {
+        SCEE_Log (SCE_INVALID_ARG);
+        SCEE_LogMsg ("batch of %u volumes, the template supports %u",
+                     n, vt->slots ? vt->batch : 1);
+        return SCE_ERROR;
+    }
+    use_materials = materials && vt->use_materials;
+
+    /* 1st pass: render non empty cells */
+    /* TODO: we are assuming that volume's unit is 0 */
+    SCE_Shader_Use (vt->non_empty_shader);
+    for (i = 0; i < n; i++) {
+        slot = &vt->slots[i];
+        SCE_VRender_GetWrap (volumes[i], vms[i], x, y, z, wrap);
+        SCE_Texture_Use (volumes[i]);
+        SCE_Shader_SetParam3fv (vt->non_empty_offset_loc, 1, wrap);
+        SCE_Mesh_BeginRenderTo (&slot->non_empty);
+        SCE_Mesh_Use (&vt->grid_mesh);
+        SCE_Mesh_Render ();
+        SCE_Mesh_Unuse ();
+        SCE_Mesh_StopRenderTo (&slot->non_empty);
+    }
+    for (i = 0; i < n; i++) {
+        slot = &vt->slots[i];
+        SCE_Mesh_ResolveRenderTo (&slot->non_empty);
+        vms[i]->render = SCE_Mesh_GetNumVertices (&slot->non_empty) != 0;
+        if (!vms[i]->render && SCE_VRender_Empty (vt, vms[i]) < 0)
+            goto fail;
+    }
+
+    /* 2nd pass: render the lists of vertices */
+    SCE_Shader_Use (vt->list_verts_shader);
+    for (i = 0; i < n; i++) {
+        if (!vms[i]->render)
+            continue;
+        slot = &vt->slots[i];
+        SCE_Mesh_BeginRenderTo (&slot->list_verts);
+        SCE_Mesh_Use (&slot->non_empty);
+        SCE_Mesh_Render ();
+        SCE_Mesh_Unuse ();
+        SCE_Mesh_StopRenderTo (&slot->list_verts);
+    }
+    for (i = 0; i < n; i++) {
+        if (vms[i]->render)
+            SCE_Mesh_ResolveRenderTo (&vt->slots[i].list_verts);
+    }
+
+    /* 3rd pass: process vertices to generate final coords & normal */
+    SCE_Shader_Use (vt->final_shader);
+    SCE_Shader_SetParamf (vt->comp_scale_loc, vt->comp_scale);
+    for (i = 0; i < n; i++) {
+        vm = vms[i];
+        if (!vm->render)
+            continue;
+        slot = &vt->slots[i];
+        if (vt->vertex_pool) {
+            SCE_Mesh_SetNumVertices (vm->mesh, SCE_Mesh_GetNumVertices
+                                     (&slot->list_verts));
+            if (SCE_Mesh_ReallocStream (vm->mesh, SCE_MESH_STREAM_G,
+                                        vt->vertex_pool) < 0)
+                goto fail;
+        }
+        SCE_VRender_GetWrap (volumes[i], vm, x, y, z, wrap);
+        SCE_Texture_Use (volumes[i]);
+        /* TODO: we are assuming that material's unit is 1 */
+        if (use_materials && materials[i])
+            SCE_Texture_Use (materials[i]);
+        SCE_Shader_SetParam3fv (vt->final_offset_loc, 1, wrap);
+        SCE_Mesh_SetPrimitiveType (vm->mesh, SCE_POINTS);
+        SCE_Mesh_BeginRenderTo (vm->mesh);
+        SCE_Mesh_Use (&slot->list_verts);
+        SCE_Mesh_Render ();
+        SCE_Mesh_Unuse ();
+        SCE_Mesh_StopRenderTo (vm->mesh);
+    }
+    SCE_Texture_Flush ();
+
+    glPointSize (1.0);  /* TODO: take care of point size */
+    /* 4th pass: generate the 3D maps of indices */
+    SCE_Shader_Use (vt->splat_shader);
+    for (i = 0; i < n; i++) {
+        if (!vms[i]->render)
+            continue;
+        slot = &vt->slots[i];
+        SCE_Texture_RenderTo (slot->splat, 0);
+        SCE_Mesh_Use (&slot->list_verts);
+        SCE_Mesh_Render ();
+        SCE_Mesh_Unuse ();
+    }
+    SCE_Texture_RenderTo (NULL, 0);
+
+    /* 5th pass: generate the index buffers */
+    SCE_Shader_Use (vt->indices_shader);
+    for (i = 0; i < n; i++) {
+        vm = vms[i];
+        if (!vm->render)
+            continue;
+        slot = &vt->slots[i];
+        if (vt->index_pool) {
+            SCE_Mesh_SetNumIndices (vm->mesh, 15 * SCE_Mesh_GetNumVertices
+                                    (&slot->non_empty));
+            if (SCE_Mesh_ReallocIndexBuffer (vm->mesh, vt->index_pool) < 0)
+                goto fail;
+        }
+        SCE_Texture_BeginLot ();
+        SCE_Texture_Use (slot->splat);
+        if (vt->algo == SCE_VRENDER_MARCHING_CUBES)
+            SCE_Texture_Use (vt->mc_table);
+        SCE_Texture_EndLot ();
+        SCE_Mesh_BeginRenderToIndices (vm->mesh);
+        SCE_Mesh_Use (&slot->non_empty);
+        SCE_Mesh_Render ();
+        SCE_Mesh_Unuse ();
+        SCE_Mesh_StopRenderToIndices (vm->mesh);
+    }
+
+    /* read back the final amounts of vertices and indices */
+    for (i = 0; i < n; i++) {
+        vm = vms[i];
+        if (!vm->render)
+            continue;
+        SCE_Mesh_ResolveRenderTo (vm->mesh);
+        SCE_Mesh_SetPrimitiveType (vm->mesh, SCE_TRIANGLES);
+        SCE_Mesh_SetNumIndices (vm->mesh, 3 * SCE_Mesh_GetNumIndices
+                                (vm->mesh));
+        vm->n_vertices = SCE_Mesh_GetNumVertices (vm->mesh);
+        vm->n_indices = SCE_Mesh_GetNumIndices (vm->mesh);
+        sce_max_vertices = MAX (sce_max_vertices, vm->n_vertices);
+        sce_max_indices = MAX (sce_max_indices, vm->n_indices);
+    }
+
+    SCE_Shader_Use (NULL);
+    SCE_Texture_Flush ();
+
+    return SCE_OK;
+fail:
+    SCE_Shader_Use (NULL);
+    SCE_Texture_RenderTo (NULL, 0);
+    SCE_Texture_Flush ();
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+
 unsigned int SCE_VRender_GetMaxV (void)
 {
     return sce_max_vertices;
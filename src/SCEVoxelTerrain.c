@@ -17,7 +17,7 @@
  -----------------------------------------------------------------------------*/
 
 /* created: 30/01/2012
-   updated: 15/03/2013 */
+   updated: 19/10/2026 */
 
 #include <SCE/utils/SCEUtils.h>
 #include <SCE/core/SCECore.h>
@@ -26,14 +26,23 @@
 #include "SCE/interface/SCEVoxelRenderer.h"
 #include "SCE/interface/SCEVoxelTerrain.h"
 
+/* number of arena allocations moved per update */
+#define SCE_VTERRAIN_DEFRAGMENT_MOVES 2
+/* number of allocations moved to make room when the mesh arena is full */
+#define SCE_VTERRAIN_FULL_DEFRAGMENT_MOVES 32
+
 static void SCE_VTerrain_InitRegion (SCE_SVoxelTerrainRegion *tr)
 {
     tr->x = tr->y = tr->z = 0;
     tr->wx = tr->wy = tr->wz = 0;
     SCE_VRender_InitMesh (&tr->vm);
     tr->mesh = NULL;
+    SCE_MeshArena_InitAlloc (&tr->alloc);
     SCE_Matrix4_Identity (tr->matrix);
     tr->draw = SCE_FALSE;
+    tr->visible = SCE_TRUE;
+    tr->hidden = SCE_FALSE;
+    tr->priority = 0.0;
     SCE_List_InitIt (&tr->it);
     SCE_List_SetData (&tr->it, tr);
     SCE_List_InitIt (&tr->it2);
@@ -41,6 +50,8 @@ static void SCE_VTerrain_InitRegion (SCE_SVoxelTerrainRegion *tr)
     SCE_List_InitIt (&tr->it3);
     SCE_List_SetData (&tr->it3, tr);
     tr->need_update = SCE_FALSE;
+    tr->urgent = SCE_FALSE;
+    tr->edit_time = 0.0;
     tr->level_list = NULL;
     tr->level = NULL;
 }
@@ -57,6 +68,7 @@ static void SCE_VTerrain_InitLevel (SCE_SVoxelTerrainLevel *tl)
     tl->level = 0;
     SCE_Grid_Init (&tl->grid);
     SCE_Grid_Init (&tl->grid2);
+    SCE_VPyramid_Init (&tl->pyramid);
     tl->wrap[0] = tl->wrap[1] = tl->wrap[2] = 0;
     tl->tex = NULL;
     tl->mat = NULL;
@@ -67,15 +79,18 @@ static void SCE_VTerrain_InitLevel (SCE_SVoxelTerrainLevel *tl)
     tl->enabled = SCE_TRUE;
     tl->x = tl->y = tl->z = 0;
     tl->map_x = tl->map_y = tl->map_z = 0;
+    tl->decimation = 0.8;
+    tl->max_vertices = 0;
 
     tl->need_update = SCE_FALSE;
-    SCE_Rectangle3_Init (&tl->update_zone);
+    tl->n_dirty = 0;
     SCE_List_Init (&tl->list1);
     SCE_List_Init (&tl->list2);
     tl->updating = &tl->list1;
     tl->queue = &tl->list2;
 
     SCE_List_Init (&tl->to_render);
+    tl->placed_ready = SCE_FALSE;
 
     SCE_List_InitIt (&tl->it);
     SCE_List_SetData (&tl->it, tl);
@@ -86,6 +101,7 @@ static void SCE_VTerrain_ClearLevel (SCE_SVoxelTerrainLevel *tl)
 
     SCE_Grid_Clear (&tl->grid);
     SCE_Grid_Clear (&tl->grid2);
+    SCE_VPyramid_Clear (&tl->pyramid);
     SCE_Texture_Delete (tl->tex);
     SCE_Texture_Delete (tl->mat);
 
@@ -115,6 +131,8 @@ static void SCE_VTerrain_InitShader (SCE_SVoxelTerrainShader *shader)
     shader->topdiffuse_loc = shader->sidediffuse_loc = SCE_SHADER_BAD_INDEX;
     shader->noise_loc = SCE_SHADER_BAD_INDEX;
     shader->material_loc = SCE_SHADER_BAD_INDEX;
+    shader->draw_attribs[0] = shader->draw_attribs[1] = -1;
+    shader->draw_attribs[2] = shader->draw_attribs[3] = -1;
 }
 static void SCE_VTerrain_ClearShader (SCE_SVoxelTerrainShader *shader)
 {
@@ -127,6 +145,8 @@ SCE_VTerrain_InitHybridGenerator (SCE_SVoxelTerrainHybridGenerator *hybrid)
     SCE_List_Init (&hybrid->queue);
     hybrid->dim = 0;
     SCE_Grid_Init (&hybrid->grid);
+    SCE_VClassifier_Init (&hybrid->classifier);
+    hybrid->active = SCE_FALSE;
     SCE_MC_Init (&hybrid->mc_gen);
     hybrid->mc_step = 10000;    /* seems legit. */
     hybrid->query = SCE_FALSE;
@@ -141,18 +161,23 @@ SCE_VTerrain_InitHybridGenerator (SCE_SVoxelTerrainHybridGenerator *hybrid)
     hybrid->x = hybrid->y = hybrid->z = 0;
     hybrid->level = 0;
     SCE_QEMD_Init (&hybrid->qmesh);
+    hybrid->optimize = 0;
+    SCE_MeshOpt_Init (&hybrid->opt);
+    hybrid->gradient = SCE_FALSE;
 }
 static void
 SCE_VTerrain_ClearHybridGenerator (SCE_SVoxelTerrainHybridGenerator *hybrid)
 {
     SCE_List_Clear (&hybrid->queue);
     SCE_Grid_Clear (&hybrid->grid);
+    SCE_VClassifier_Clear (&hybrid->classifier);
     SCE_free (hybrid->vertices);
     SCE_free (hybrid->normals);
     SCE_free (hybrid->indices);
     SCE_free (hybrid->anchors);
     SCE_free (hybrid->interleaved);
     SCE_QEMD_Clear (&hybrid->qmesh);
+    SCE_MeshOpt_Clear (&hybrid->opt);
 }
 
 void SCE_VTerrain_Init (SCE_SVoxelTerrain *vt)
@@ -166,6 +191,10 @@ void SCE_VTerrain_Init (SCE_SVoxelTerrain *vt)
     vt->cut = 0;
     SCE_VTerrain_InitHybridGenerator (&vt->hybrid);
     vt->vertex_pool = vt->index_pool = NULL;
+    vt->arena = NULL;
+    vt->arena_vertices = vt->arena_indices = 0;
+    vt->n_draw_calls = 0;
+    SCE_Texture_InitStream (&vt->stream);
 
     vt->subregion_dim = 0;
     vt->n_subregions = 1;
@@ -175,6 +204,10 @@ void SCE_VTerrain_Init (SCE_SVoxelTerrain *vt)
     }
 
     vt->x = vt->y = vt->z = 0;
+    vt->velocity[0] = vt->velocity[1] = vt->velocity[2] = 0.0;
+    vt->prefetch_time = 1.0;
+    vt->screen_error = 0.0;
+    vt->projection = 1.0;
     vt->width = vt->height = vt->depth = 0;
     vt->unit = 1.0;
     vt->scale = 1.0;
@@ -183,6 +216,13 @@ void SCE_VTerrain_Init (SCE_SVoxelTerrain *vt)
     SCE_List_Init (&vt->to_update);
     vt->update_level = NULL;
     vt->max_updates = 8;
+    vt->n_dropped_updates = 0;
+    vt->n_empty_skips = 0;
+    vt->n_urgent = 0;
+    vt->n_edits = 0;
+    vt->edit_latency = vt->max_edit_latency = 0.0;
+    vt->encode = NULL;
+    vt->budget = NULL;
 
     vt->trans_enabled = SCE_TRUE;
     vt->shadow_mode = SCE_FALSE;
@@ -204,6 +244,8 @@ void SCE_VTerrain_Clear (SCE_SVoxelTerrain *vt)
         SCE_VTerrain_ClearShader (&vt->shaders[i]);
     for (i = 0; i < SCE_MAX_VTERRAIN_LEVELS; i++)
         SCE_VTerrain_ClearLevel (&vt->levels[i]);
+    SCE_MeshArena_Delete (vt->arena);
+    SCE_Texture_ClearStream (&vt->stream);
 }
 SCE_SVoxelTerrain* SCE_VTerrain_Create (void)
 {
@@ -284,23 +326,36 @@ SCE_VTerrain_GetRegion (const SCE_SVoxelTerrainLevel *tl, int x, int y, int z)
     return &tl->regions[offset];
 }
 
+/* the matrices of the regions depend on the dimensions and on the unit,
+   compute them again at the next update */
+static void SCE_VTerrain_Unplace (SCE_SVoxelTerrain *vt)
+{
+    SCEuint i;
+    for (i = 0; i < vt->n_levels; i++)
+        vt->levels[i].placed_ready = SCE_FALSE;
+}
+
 void SCE_VTerrain_SetDimensions (SCE_SVoxelTerrain *vt, int w, int h, int d)
 {
     vt->width = w; vt->height = h; vt->depth = d;
     vt->scale = vt->width * vt->unit;
+    SCE_VTerrain_Unplace (vt);
 }
 void SCE_VTerrain_SetWidth (SCE_SVoxelTerrain *vt, int w)
 {
     vt->width = w;
     vt->scale = vt->width * vt->unit;
+    SCE_VTerrain_Unplace (vt);
 }
 void SCE_VTerrain_SetHeight (SCE_SVoxelTerrain *vt, int h)
 {
     vt->height = h;
+    SCE_VTerrain_Unplace (vt);
 }
 void SCE_VTerrain_SetDepth (SCE_SVoxelTerrain *vt, int d)
 {
     vt->depth = d;
+    SCE_VTerrain_Unplace (vt);
 }
 int SCE_VTerrain_GetWidth (const SCE_SVoxelTerrain *vt)
 {
@@ -326,6 +381,8 @@ size_t SCE_VTerrain_GetUsedVRAM (const SCE_SVoxelTerrain *vt)
         for (j = 0; j < n; j++)
             size += SCE_Mesh_GetUsedVRAM (l->regions[j].mesh);
     }
+    if (vt->arena)
+        size += SCE_Mesh_GetUsedVRAM (&vt->arena->batch.mesh);
 
     return size;
 }
@@ -334,6 +391,7 @@ void SCE_VTerrain_SetUnit (SCE_SVoxelTerrain *vt, float unit)
 {
     vt->unit = unit;
     vt->scale = vt->width * vt->unit;
+    SCE_VTerrain_Unplace (vt);
 }
 
 
@@ -386,6 +444,20 @@ void SCE_VTerrain_SetHybridMCStep (SCE_SVoxelTerrain *vt, SCEuint step)
 {
     vt->hybrid.mc_step = step;
 }
+/**
+ * \brief Computes the normals of the hybrid pipeline from the densities
+ * \param vt a voxel terrain
+ * \param use SCE_TRUE to sample the gradient of the density grid at each
+ * decimated vertex, SCE_FALSE to average the normals of the faces (default)
+ *
+ * The gradient is taken like the shaders do for the seamless LOD, with
+ * central differences of the trilinearly interpolated densities: it doesn't
+ * depend on the triangles left by the decimation.
+ */
+void SCE_VTerrain_UseGradientNormals (SCE_SVoxelTerrain *vt, int use)
+{
+    vt->hybrid.gradient = use;
+}
 void SCE_VTerrain_SetVertexBufferPool (SCE_SVoxelTerrain *vt,
                                        SCE_RBufferPool *pool)
 {
@@ -398,6 +470,178 @@ void SCE_VTerrain_SetIndexBufferPool (SCE_SVoxelTerrain *vt,
     vt->index_pool = pool;
     SCE_VRender_SetIndexBufferPool (&vt->temp, pool);
 }
+/**
+ * \brief Copies the regions meshes into shared buffers of the given capacity
+ * \param max_vertices,max_indices capacity of the arena, 0 to disable it
+ * (default)
+ *
+ * Each level is then drawn with a single multi-draw call, the object matrix
+ * and the origin of each region being read from per-draw attributes: the
+ * shaders are built with SCE_VTERRAIN_MULTIDRAW defined to 1. With the
+ * software pipeline, regions are meshed directly into their range of the
+ * arena, which is only reallocated when a mesh outgrows it. Must be called
+ * before SCE_VTerrain_Build() and SCE_VTerrain_BuildShader().
+ * \sa SCE_VTerrain_GetMeshArena(), SCE_VTerrain_GetNumDrawCalls()
+ */
+void SCE_VTerrain_SetArenaSize (SCE_SVoxelTerrain *vt, SCEuint max_vertices,
+                                SCEuint max_indices)
+{
+    vt->arena_vertices = max_vertices;
+    vt->arena_indices = max_indices;
+}
+/**
+ * \brief Gets the mesh arena of a terrain, mostly for its statistics
+ * \returns the arena or NULL if the terrain doesn't use any
+ * \sa SCE_VTerrain_SetArenaSize()
+ */
+SCE_SMeshArena* SCE_VTerrain_GetMeshArena (SCE_SVoxelTerrain *vt)
+{
+    return vt->arena;
+}
+/**
+ * \brief Sets the optimization passes applied to the generated meshes
+ *
+ * Applies to both the meshes generated by the CPU and those decimated by the
+ * hybrid pipeline.
+ * \sa SCE_MeshOpt_Optimize(), SCE_VRender_SetOptimization()
+ */
+void SCE_VTerrain_SetMeshOptimization (SCE_SVoxelTerrain *vt,
+                                       SCEbitfield flags)
+{
+    vt->hybrid.optimize = flags;
+    SCE_VRender_SetOptimization (&vt->temp, flags);
+}
+/**
+ * \brief Gets the average ACMR of the meshes generated by the CPU since the
+ * beginning
+ * \param vt a voxel terrain
+ * \param before,after ACMR before and after optimization, can be NULL
+ * \sa SCE_VTerrain_GetHybridACMR()
+ */
+void SCE_VTerrain_GetACMR (SCE_SVoxelTerrain *vt, float *before, float *after)
+{
+    SCE_MeshOpt_GetAverageACMR (SCE_VRender_GetOptimizer (&vt->temp),
+                                before, after);
+}
+/**
+ * \brief Gets the average ACMR of the meshes decimated by the hybrid
+ * pipeline since the beginning
+ *
+ * Decimated meshes don't have the topology of the meshes of the CPU, so
+ * their averages are reported apart.
+ * \sa SCE_VTerrain_GetACMR()
+ */
+void SCE_VTerrain_GetHybridACMR (SCE_SVoxelTerrain *vt, float *before,
+                                 float *after)
+{
+    SCE_MeshOpt_GetAverageACMR (&vt->hybrid.opt, before, after);
+}
+
+/* upper bound of the automatic decimation */
+#define SCE_VTERRAIN_MAX_DECIMATION 0.95
+
+/**
+ * \brief Sets the part of the vertices of each region of a level removed
+ * by the hybrid pipeline
+ * \param vt a voxel terrain
+ * \param level a level
+ * \param ratio between 0 (no decimation) and 1, default is 0.8
+ *
+ * Anchored vertices, on the borders of the regions, are never removed.
+ * \p level must be lower than the number of levels, see
+ * SCE_VTerrain_SetNumLevels().
+ * \sa SCE_VTerrain_SetMaxRegionVertices(), SCE_VTerrain_SetScreenError()
+ */
+void SCE_VTerrain_SetDecimation (SCE_SVoxelTerrain *vt, SCEuint level,
+                                 float ratio)
+{
+    if (level >= vt->n_levels) {
+        SCEE_Log (SCE_INVALID_ARG);
+        SCEE_LogMsg ("the terrain has no level %u", level);
+        return;
+    }
+    vt->levels[level].decimation = MAX (0.0, MIN (ratio, 1.0));
+}
+/**
+ * \brief Sets the number of vertices of a decimated region of a level
+ * \param vt a voxel terrain
+ * \param level a level
+ * \param n maximum number of vertices, 0 for no limit (default)
+ *
+ * Regions with more vertices after the decimation ratio has been applied
+ * are decimated further, anchored vertices excepted.
+ * \sa SCE_VTerrain_SetDecimation()
+ */
+void SCE_VTerrain_SetMaxRegionVertices (SCE_SVoxelTerrain *vt, SCEuint level,
+                                        SCEuint n)
+{
+    if (level >= vt->n_levels) {
+        SCEE_Log (SCE_INVALID_ARG);
+        SCEE_LogMsg ("the terrain has no level %u", level);
+        return;
+    }
+    vt->levels[level].max_vertices = n;
+}
+/**
+ * \brief Decimates each level from the size of its voxels on the screen
+ * \param vt a voxel terrain
+ * \param error tolerated error in pixels, 0 to use the ratio given to
+ * SCE_VTerrain_SetDecimation() instead (default)
+ * \param projection pixels covered by one unit at a distance of one unit,
+ * usually the viewport height / (2 tan (fovy / 2))
+ *
+ * The voxels of a level are measured at the middle of the part of the
+ * level not covered by the finer one, the more of them fit in \p error
+ * pixels the more vertices are removed.
+ * \sa SCE_VTerrain_GetDecimation()
+ */
+void SCE_VTerrain_SetScreenError (SCE_SVoxelTerrain *vt, float error,
+                                  float projection)
+{
+    vt->screen_error = error;
+    vt->projection = projection;
+}
+/**
+ * \brief Gets the part of the vertices removed from the regions of a level
+ * \sa SCE_VTerrain_SetDecimation(), SCE_VTerrain_SetScreenError()
+ */
+float SCE_VTerrain_GetDecimation (const SCE_SVoxelTerrain *vt, SCEuint level)
+{
+    const SCE_SVoxelTerrainLevel *tl = NULL;
+    float extent, d, size, keep;
+
+    if (level >= vt->n_levels) {
+        SCEE_Log (SCE_INVALID_ARG);
+        SCEE_LogMsg ("the terrain has no level %u", level);
+        return 0.0;
+    }
+    tl = &vt->levels[level];
+    if (vt->screen_error <= 0.0)
+        return tl->decimation;
+
+    /* middle of the shell left by the finer level, in voxels of level 0 */
+    extent = (float)vt->n_subregions * (vt->subregion_dim - 1) * (1 << level);
+    d = (level ? 0.375 : 0.25) * extent;
+    /* size of a voxel of the level on the screen */
+    size = (1 << level) * vt->projection / MAX (d, 1.0);
+    keep = size / vt->screen_error;
+    keep *= keep;
+    return MAX (0.0, MIN (1.0 - keep, SCE_VTERRAIN_MAX_DECIMATION));
+}
+/* number of vertex collapses of a region of \p tl */
+static SCEuint SCE_VTerrain_GetCollapses (const SCE_SVoxelTerrain *vt,
+                                          const SCE_SVoxelTerrainLevel *tl,
+                                          SCEuint n_vertices, SCEuint n_anchors)
+{
+    SCEuint n, removable;
+
+    removable = n_vertices > n_anchors ? n_vertices - n_anchors : 0;
+    n = removable * SCE_VTerrain_GetDecimation (vt, tl->level);
+    if (tl->max_vertices && n_vertices - n > tl->max_vertices)
+        n = MIN (removable, n_vertices - tl->max_vertices);
+    return n;
+}
+
 void SCE_VTerrain_EnableMaterials (SCE_SVoxelTerrain *vt)
 {
     vt->use_materials = SCE_TRUE;
@@ -464,6 +708,11 @@ static int SCE_VTerrain_BuildLevel (SCE_SVoxelTerrain *vt,
     SCE_Grid_SetDimensions (&tl->grid, vt->width, vt->height, vt->depth);
     if (SCE_Grid_Build (&tl->grid) < 0)
         goto fail;
+    SCE_VPyramid_SetDimensions (&tl->pyramid, vt->width, vt->height,
+                                vt->depth);
+    if (SCE_VPyramid_Build (&tl->pyramid) < 0)
+        goto fail;
+    SCE_VPyramid_UpdateAll (&tl->pyramid, SCE_Grid_GetRaw (&tl->grid));
 
     if (!(tc = SCE_TexData_Create ()))
         goto fail;
@@ -549,8 +798,23 @@ static const char *vs_fun =
     /* sce_tc_origin = lod0.xyz / dimension */
 
     /* in pixels/dimension, origin of the current region relative to regions_origin */
-    "uniform vec3 sce_current_origin;"
     /* current_origin = region_pos * (subregion_dim - 1) / dimension */
+    "\n#if "SCE_VTERRAIN_MULTIDRAW_NAME"\n"
+    /* per-draw data: object matrix rows and current origin */
+    "in vec4 sce_draw_row0;"
+    "in vec4 sce_draw_row1;"
+    "in vec4 sce_draw_row2;"
+    "in vec4 sce_draw_origin;"
+    "\n#define sce_current_origin (sce_draw_origin.xyz)\n"
+    "vec4 sce_vterrain_transform (vec4 p)"
+    "{"
+    "  return vec4 (dot (sce_draw_row0, p), dot (sce_draw_row1, p),"
+    "               dot (sce_draw_row2, p), p.w);"
+    "}"
+    "\n#else\n"
+    "uniform vec3 sce_current_origin;"
+    "\n#define sce_vterrain_transform(p) (sce_objectmatrix * (p))\n"
+    "\n#endif\n"
 
     /* texture wrapping offsets */
     "uniform vec3 sce_wrapping0;"
@@ -704,7 +968,7 @@ static const char *vs_main =
     "  lighting += 0.7 * light (nor, vec3 (1.0, 1.0, 2.0), vec3 (1.0, 0.9, 0.8));"
     "  col = vec4 (lighting, 1.0);"
 
-    "  vec4 p = sce_objectmatrix * vec4 (position, 1.0);"
+    "  vec4 p = sce_vterrain_transform (vec4 (position, 1.0));"
     "  pos = p.xyz;"
 
     "  mat4 final_matrix = sce_projectionmatrix * sce_cameramatrix;"
@@ -761,6 +1025,9 @@ int SCE_VTerrain_BuildShader (SCE_SVoxelTerrain *vt, SCE_SShader *shd)
                             vt->subregion_dim) < 0) goto fail;
     if (SCE_Shader_Globali (shd, "SCE_N_SUBREGIONS",
                             vt->n_subregions) < 0) goto fail;
+    if (SCE_Shader_Globali (shd, SCE_VTERRAIN_MULTIDRAW_NAME,
+                            vt->arena_vertices > 0 &&
+                            vt->arena_indices > 0) < 0) goto fail;
     /* TODO: first, the user should know that this functions forces the shader
        version. second, this version should match vrender's (which is currently
        the case but you know it's kinda hardcoded right now) */
@@ -783,6 +1050,9 @@ static int SCE_VTerrain_BuildHybrid (SCE_SVoxelTerrain *vt)
     SCE_Grid_SetPointSize (&h->grid, 1);
     if (SCE_Grid_Build (&h->grid) < 0)
         goto fail;
+    SCE_VClassifier_SetDimensions (&h->classifier, n, n, n);
+    if (SCE_VClassifier_Build (&h->classifier) < 0)
+        goto fail;
 
     n = SCE_Grid_GetNumPoints (&h->grid);
     SCE_MC_SetNumCells (&h->mc_gen, n);
@@ -814,6 +1084,22 @@ fail:
     return SCE_ERROR;
 }
 
+/* makes the CPU mesher write directly into the arena */
+static void SCE_VTerrain_ShareArena (SCE_SVoxelTerrain *vt)
+{
+    SCEuint i, j, n;
+    SCE_SMesh *mesh = NULL;
+
+    mesh = SCE_MeshBatch_GetMesh (SCE_MeshArena_GetBatch (vt->arena));
+
+    for (i = 0; i < vt->n_levels; i++) {
+        SCE_SVoxelTerrainLevel *tl = &vt->levels[i];
+        n = tl->subregions * tl->subregions * tl->subregions;
+        for (j = 0; j < n; j++)
+            SCE_VRender_SetMesh (&tl->regions[j].vm, mesh);
+    }
+}
+
 int SCE_VTerrain_Build (SCE_SVoxelTerrain *vt)
 {
     size_t i;
@@ -832,6 +1118,7 @@ int SCE_VTerrain_Build (SCE_SVoxelTerrain *vt)
         goto fail;
 
     if (vt->cut) {
+        vt->encode = sce_vterrain_encoders[!!vt->comp_pos][!!vt->comp_nor];
         if (SCE_VTerrain_BuildHybrid (vt) < 0)
             goto fail;
     }
@@ -841,6 +1128,17 @@ int SCE_VTerrain_Build (SCE_SVoxelTerrain *vt)
             goto fail;
     }
 
+    if (vt->arena_vertices > 0 && vt->arena_indices > 0) {
+        SCE_SGeometry *geom = SCE_VRender_GetFinalGeometry (&vt->temp);
+        if (!(vt->arena = SCE_MeshArena_Create ()))
+            goto fail;
+        if (SCE_MeshArena_Setup (vt->arena, geom, vt->arena_vertices,
+                                 vt->arena_indices) < 0)
+            goto fail;
+        if (vt->rpipeline == SCE_VRENDER_SOFTWARE)
+            SCE_VTerrain_ShareArena (vt);
+    }
+
     if (!vt->pipeline) {
         /* user hasn't specified any: use default main code */
         if (!(vt->pipeline = SCE_Shader_Create ())) goto fail;
@@ -902,6 +1200,13 @@ int SCE_VTerrain_Build (SCE_SVoxelTerrain *vt)
         SCE_LOC (noise_loc, "sce_noise_tex");
         SCE_LOC (material_loc, "sce_material_tex");
 #undef SCE_LOC
+#define SCE_LOC(n, name)                                        \
+        shd->draw_attribs[n] = SCE_Shader_GetAttribIndex (shd->shd, name)
+        SCE_LOC (0, "sce_draw_row0");
+        SCE_LOC (1, "sce_draw_row1");
+        SCE_LOC (2, "sce_draw_row2");
+        SCE_LOC (3, "sce_draw_origin");
+#undef SCE_LOC
 
     }
 
@@ -914,6 +1219,34 @@ fail:
 }
 
 
+/**
+ * \brief Sets the velocity of the viewer
+ * \param vt a voxel terrain
+ * \param x,y,z velocity, in voxels of the level 0 per second
+ *
+ * Regions are then updated nearest to the path of the viewer first, and
+ * SCE_VTerrain_GetPrefetchSlices() tells which slices the levels are
+ * about to need. To follow a path, give the displacement towards the next
+ * waypoint divided by the prefetch time.
+ * \sa SCE_VTerrain_SetPrefetchTime()
+ */
+void SCE_VTerrain_SetVelocity (SCE_SVoxelTerrain *vt, float x, float y,
+                               float z)
+{
+    vt->velocity[0] = x;
+    vt->velocity[1] = y;
+    vt->velocity[2] = z;
+}
+/**
+ * \brief Sets how far ahead the position of the viewer is predicted, in
+ * seconds, 1 by default
+ * \sa SCE_VTerrain_SetVelocity()
+ */
+void SCE_VTerrain_SetPrefetchTime (SCE_SVoxelTerrain *vt, float t)
+{
+    vt->prefetch_time = t;
+}
+
 void SCE_VTerrain_SetPosition (SCE_SVoxelTerrain *vt, long x, long y, long z)
 {
     vt->x = x;
@@ -921,8 +1254,9 @@ void SCE_VTerrain_SetPosition (SCE_SVoxelTerrain *vt, long x, long y, long z)
     vt->z = z;
 }
 
-void SCE_VTerrain_GetMissingSlices (const SCE_SVoxelTerrain *vt, SCEuint level,
-                                    long *x, long *y, long *z)
+static void SCE_VTerrain_GetSlicesTo (const SCE_SVoxelTerrain *vt,
+                                      SCEuint level, long px, long py,
+                                      long pz, long *x, long *y, long *z)
 {
     long center[3];
     const SCE_SVoxelTerrainLevel *tl = &vt->levels[level];
@@ -934,9 +1268,35 @@ void SCE_VTerrain_GetMissingSlices (const SCE_SVoxelTerrain *vt, SCEuint level,
     center[2] = (tl->map_z + vt->depth / 2) * herp;
 
     /* compute difference */
-    *x = (vt->x - center[0]) / herp;
-    *y = (vt->y - center[1]) / herp;
-    *z = (vt->z - center[2]) / herp;
+    *x = (px - center[0]) / herp;
+    *y = (py - center[1]) / herp;
+    *z = (pz - center[2]) / herp;
+}
+void SCE_VTerrain_GetMissingSlices (const SCE_SVoxelTerrain *vt, SCEuint level,
+                                    long *x, long *y, long *z)
+{
+    SCE_VTerrain_GetSlicesTo (vt, level, vt->x, vt->y, vt->z, x, y, z);
+}
+/**
+ * \brief Same as SCE_VTerrain_GetMissingSlices() for the predicted position
+ * of the viewer
+ *
+ * The grid of a level only holds the slices around the current position,
+ * the slices beyond those returned by SCE_VTerrain_GetMissingSlices() are
+ * to be loaded or generated ahead of time by the caller, and appended once
+ * they are missing.
+ * \sa SCE_VTerrain_SetVelocity()
+ */
+void SCE_VTerrain_GetPrefetchSlices (const SCE_SVoxelTerrain *vt,
+                                     SCEuint level, long *x, long *y, long *z)
+{
+    long p[3];
+    int i;
+
+    for (i = 0; i < 3; i++)
+        p[i] = vt->velocity[i] * vt->prefetch_time;
+    SCE_VTerrain_GetSlicesTo (vt, level, vt->x + p[0], vt->y + p[1],
+                              vt->z + p[2], x, y, z);
 }
 int SCE_VTerrain_GetMissingRegion (SCE_SVoxelTerrain *vt, SCE_SLongRect3 *r)
 {
@@ -1004,6 +1364,8 @@ void SCE_VTerrain_SetLevel (SCE_SVoxelTerrain *vt, SCEuint level,
     }
 
     SCE_Grid_CopyData (&vt->levels[level].grid, grid);
+    SCE_VPyramid_UpdateAll (&vt->levels[level].pyramid,
+                            SCE_Grid_GetRaw (&vt->levels[level].grid));
     /* TODO: UpdateGrid() */
 }
 
@@ -1023,13 +1385,144 @@ void SCE_VTerrain_ActivateLevel (SCE_SVoxelTerrain *vt, SCEuint level,
 }
 
 
+/* splits a box of level coordinates (both points included) into boxes of
+   texels: the grid is stored with the wrapping wrap, so the box may
+   wrap around the texture on each axis. returns the number of boxes, up
+   to 8 */
+static SCEuint SCE_VTerrain_WrapBox (const SCE_SVoxelTerrain *vt,
+                                     const int *wrap,
+                                     const SCE_SIntRect3 *r,
+                                     SCE_SIntRect3 *boxes)
+{
+    int p1[3], p2[3], q1[3], q2[3];
+    int start[3][2], end[3][2];
+    int dims[3];
+    SCEuint n[3], i, x, y, z, n_boxes = 0;
+
+    dims[0] = vt->width;
+    dims[1] = vt->height;
+    dims[2] = vt->depth;
+    SCE_Rectangle3_GetPointsv (r, p1, p2);
+
+    for (i = 0; i < 3; i++) {
+        int a = MAX (p1[i], 0), b = MIN (p2[i] + 1, dims[i]);
+        int len = b - a, first;
+        if (len <= 0)
+            return 0;
+        first = SCE_Math_Ring (a + wrap[i], dims[i]);
+        n[i] = 1;
+        if (len >= dims[i]) {
+            start[i][0] = 0;
+            end[i][0] = dims[i];
+        } else if (first + len <= dims[i]) {
+            start[i][0] = first;
+            end[i][0] = first + len;
+        } else {
+            start[i][0] = first;
+            end[i][0] = dims[i];
+            start[i][1] = 0;
+            end[i][1] = first + len - dims[i];
+            n[i] = 2;
+        }
+    }
+
+    for (z = 0; z < n[2]; z++) {
+        for (y = 0; y < n[1]; y++) {
+            for (x = 0; x < n[0]; x++) {
+                q1[0] = start[0][x]; q2[0] = end[0][x];
+                q1[1] = start[1][y]; q2[1] = end[1][y];
+                q1[2] = start[2][z]; q2[2] = end[2][z];
+                SCE_Rectangle3_Setv (&boxes[n_boxes++], q1, q2);
+            }
+        }
+    }
+    return n_boxes;
+}
+/* queues boxes of texels for upload at the next texture update */
+static void SCE_VTerrain_AddDirtyBoxes (SCE_SVoxelTerrainLevel *tl,
+                                        const SCE_SIntRect3 *boxes,
+                                        SCEuint n)
+{
+    SCEuint i;
+
+    for (i = 0; i < n; i++) {
+        if (tl->n_dirty == SCE_VTERRAIN_MAX_DIRTY_BOXES) {
+            SCEuint j;
+            /* too many of them, upload their bounding box instead */
+            for (j = 1; j < tl->n_dirty; j++)
+                SCE_Rectangle3_Union (&tl->dirty[0], &tl->dirty[j],
+                                      &tl->dirty[0]);
+            tl->n_dirty = 1;
+        }
+        tl->dirty[tl->n_dirty++] = boxes[i];
+    }
+}
+/* a slice replaced a plane of texels of \p grid orthogonal to \p axis:
+   depending on the direction of the move it is either the first plane of
+   the new wrapping or the last one, both are returned */
+static void SCE_VTerrain_SliceBoxes (const SCE_SVoxelTerrain *vt, int axis,
+                                     int wrap, SCE_SIntRect3 *boxes)
+{
+    int dims[3], p1[3] = {0, 0, 0}, p2[3];
+
+    dims[0] = p2[0] = vt->width;
+    dims[1] = p2[1] = vt->height;
+    dims[2] = p2[2] = vt->depth;
+    p1[axis] = SCE_Math_Ring (wrap, dims[axis]);
+    p2[axis] = p1[axis] + 1;
+    SCE_Rectangle3_Setv (&boxes[0], p1, p2);
+    p1[axis] = SCE_Math_Ring (wrap - 1, dims[axis]);
+    p2[axis] = p1[axis] + 1;
+    SCE_Rectangle3_Setv (&boxes[1], p1, p2);
+}
+static void SCE_VTerrain_AddDirtySlice (const SCE_SVoxelTerrain *vt,
+                                        SCE_SVoxelTerrainLevel *tl,
+                                        int axis, int wrap)
+{
+    SCE_SIntRect3 boxes[2];
+    SCE_VTerrain_SliceBoxes (vt, axis, wrap, boxes);
+    SCE_VTerrain_AddDirtyBoxes (tl, boxes, 2);
+}
+static int SCE_VTerrain_FaceAxis (SCE_EBoxFace f)
+{
+    switch (f) {
+    case SCE_BOX_POSX:
+    case SCE_BOX_NEGX: return 0;
+    case SCE_BOX_POSY:
+    case SCE_BOX_NEGY: return 1;
+    default: return 2;
+    }
+}
+/* uploads the dirty areas of the textures of a level */
+static int SCE_VTerrain_UploadLevel (SCE_SVoxelTerrain *vt,
+                                     SCE_SVoxelTerrainLevel *tl)
+{
+    SCEuint i;
+
+    /* grids have a point size of 1, see SCE_VTerrain_BuildLevel() */
+    for (i = 0; i < tl->n_dirty; i++) {
+        if (SCE_Texture_UpdateBox (tl->tex, &vt->stream, &tl->dirty[i],
+                                   SCE_Grid_GetRaw (&tl->grid), 1) < 0)
+            goto fail;
+        if (tl->mat &&
+            SCE_Texture_UpdateBox (tl->mat, &vt->stream, &tl->dirty[i],
+                                   SCE_Grid_GetRaw (&tl->grid2), 1) < 0)
+            goto fail;
+    }
+    tl->n_dirty = 0;
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
 static void
 SCE_VTerrain_AppendDensitySlice (SCE_SVoxelTerrain *vt, SCEuint level,
                                  SCE_EBoxFace f, const unsigned char *slice)
 {
     SCE_SVoxelTerrainLevel *tl = NULL;
-    int w, h, d, dim;
-    SCE_SIntRect3 r;
+    int w, h, d, dim, axis;
+    SCE_SIntRect3 r, boxes[2];
 
     tl = &vt->levels[level];
     SCE_Grid_UpdateFace (&tl->grid, f, slice);
@@ -1043,30 +1536,11 @@ SCE_VTerrain_AppendDensitySlice (SCE_SVoxelTerrain *vt, SCEuint level,
     h = SCE_Grid_GetHeight (&tl->grid);
     d = SCE_Grid_GetDepth (&tl->grid);
 
-#if 0
-    /* TODO: take grid wrapping into account... it will be crappy */
-    texdata = SCE_RGetTextureTexData (SCE_Texture_GetCTexture (tl->tex), 0, 0);
-    switch (f) {
-    case SCE_BOX_POSX:
-        SCE_TexData_Modified3 (texdata, 0, 0, 0, 1, h, d);
-        break;
-    case SCE_BOX_NEGX:
-        SCE_TexData_Modified3 (texdata, w - 1, 0, 0, 1, h, d);
-        break;
-    case SCE_BOX_POSY:
-        SCE_TexData_Modified3 (texdata, 0, 0, 0, w, 1, d);
-        break;
-    case SCE_BOX_NEGY:
-        SCE_TexData_Modified3 (texdata, 0, h - 1, 0, w, 1, d);
-        break;
-    case SCE_BOX_POSZ:
-        SCE_TexData_Modified3 (texdata, 0, 0, 0, w, h, 1);
-        break;
-    case SCE_BOX_NEGZ:
-        SCE_TexData_Modified3 (texdata, 0, 0, d - 1, w, h, 1);
-        break;
-    }
-#endif
+    axis = SCE_VTerrain_FaceAxis (f);
+    SCE_VTerrain_SliceBoxes (vt, axis, tl->wrap[axis], boxes);
+    SCE_VTerrain_AddDirtyBoxes (tl, boxes, 2);
+    SCE_VPyramid_Update (&tl->pyramid, SCE_Grid_GetRaw (&tl->grid), &boxes[0]);
+    SCE_VPyramid_Update (&tl->pyramid, SCE_Grid_GetRaw (&tl->grid), &boxes[1]);
 
     dim = (vt->subregion_dim - 1) * vt->n_subregions + 1;
 
@@ -1143,9 +1617,16 @@ SCE_VTerrain_AppendMaterialSlice (SCE_SVoxelTerrain *vt, SCEuint level,
                                   SCE_EBoxFace f,const unsigned char *slice)
 {
     SCE_SVoxelTerrainLevel *tl = NULL;
+    int wrap[3];
 
     tl = &vt->levels[level];
     SCE_Grid_UpdateFace (&tl->grid2, f, slice);
+    /* TODO: direct access to structure attributes */
+    wrap[0] = tl->grid2.wrap_x;
+    wrap[1] = tl->grid2.wrap_y;
+    wrap[2] = tl->grid2.wrap_z;
+    SCE_VTerrain_AddDirtySlice (vt, tl, SCE_VTerrain_FaceAxis (f),
+                                wrap[SCE_VTerrain_FaceAxis (f)]);
 }
 
 void SCE_VTerrain_AppendSlice (SCE_SVoxelTerrain *vt, SCEuint level,
@@ -1161,26 +1642,98 @@ void SCE_VTerrain_AppendSlice (SCE_SVoxelTerrain *vt, SCEuint level,
 /* TODO: add a parameter to specify whether data is full or empty */
 void SCE_VTerrain_SetRegion (SCE_SVoxelTerrain *vt, const unsigned char *data)
 {
-    memcpy (SCE_Grid_GetRaw (&vt->hybrid.grid), data,
-            SCE_Grid_GetSize (&vt->hybrid.grid));
-    vt->hybrid.grid_ready = SCE_TRUE;
-    vt->hybrid.query = SCE_FALSE;
+    SCE_SVoxelTerrainHybridGenerator *h = &vt->hybrid;
+    SCE_SIntRect3 r;
+    int dim = 2 * h->dim;
+
+    memcpy (SCE_Grid_GetRaw (&h->grid), data, SCE_Grid_GetSize (&h->grid));
+    /* the cells marched by SCE_VTerrain_UpdateHybrid(), the grid is only
+       read once so the classifier stops at the first crossing cell rather
+       than going through a density pyramid */
+    SCE_Rectangle3_Set (&r, 0, 0, 0, dim, dim, dim);
+    h->active = SCE_VClassifier_HasSurface (&h->classifier, &h->grid, &r);
+    h->grid_ready = SCE_TRUE;
+    h->query = SCE_FALSE;
 }
 
 
-static void
-SCE_VTerrain_CullLevelRegions1 (SCE_SVoxelTerrain *vt, SCEuint level,
-                                SCE_SVoxelTerrainLevel *tl,
-                                const SCE_SFrustum *frustum)
+/* voxels shared by two neighbouring regions */
+#define DERP 1
+
+/* origin and wrapping of the regions of \p tl, and origin of the inner
+   level \p tl2 which hides some of them */
+static void SCE_VTerrain_GetPlacement (const SCE_SVoxelTerrainLevel *tl,
+                                       const SCE_SVoxelTerrainLevel *tl2,
+                                       long *key)
+{
+    key[0] = tl->map_x + tl->x;
+    key[1] = tl->map_y + tl->y;
+    key[2] = tl->map_z + tl->z;
+    key[3] = tl->wrap_x;
+    key[4] = tl->wrap_y;
+    key[5] = tl->wrap_z;
+    key[6] = key[7] = key[8] = 0;
+    if (tl2) {
+        key[6] = tl2->map_x + tl2->x;
+        key[7] = tl2->map_y + tl2->y;
+        key[8] = tl2->map_z + tl2->z;
+    }
+}
+
+/* area of the regions [p1, p2[ in the units of the finer level */
+static void SCE_VTerrain_GetZone (const SCE_SVoxelTerrain *vt,
+                                  const SCE_SVoxelTerrainLevel *tl,
+                                  const int *p1, const int *p2,
+                                  SCE_SIntRect3 *zone)
+{
+    int a[3], b[3];
+    int dim = vt->subregion_dim;
+
+    a[0] = 2 * (tl->map_x + tl->x + p1[0] * (dim - 1));
+    a[1] = 2 * (tl->map_y + tl->y + p1[1] * (dim - 1));
+    a[2] = 2 * (tl->map_z + tl->z + p1[2] * (dim - 1));
+    b[0] = 2 * (tl->map_x + tl->x + (p2[0] - 1) * (dim - 1) + dim);
+    b[1] = 2 * (tl->map_y + tl->y + (p2[1] - 1) * (dim - 1) + dim);
+    b[2] = 2 * (tl->map_z + tl->z + (p2[2] - 1) * (dim - 1) + dim);
+    SCE_Rectangle3_Setv (zone, a, b);
+}
+
+/* area of the finer level \p tl2 */
+static void SCE_VTerrain_GetInnerZone (const SCE_SVoxelTerrain *vt,
+                                       const SCE_SVoxelTerrainLevel *tl2,
+                                       SCE_SIntRect3 *inner)
+{
+    int p1[3], p2[3];
+
+    p1[0] = tl2->map_x + tl2->x + 1;
+    p1[1] = tl2->map_y + tl2->y + 1;
+    p1[2] = tl2->map_z + tl2->z + 1;
+    p2[0] = p1[0] + vt->n_subregions * (vt->subregion_dim - 1);
+    p2[1] = p1[1] + vt->n_subregions * (vt->subregion_dim - 1);
+    p2[2] = p1[2] + vt->n_subregions * (vt->subregion_dim - 1);
+    SCE_Rectangle3_Setv (inner, p1, p2);
+}
+
+/* computes the wrapped coordinates, the matrix and whether each region is
+   hidden by the finer level \p tl2, only when the level has moved */
+static void SCE_VTerrain_PlaceLevelRegions (SCE_SVoxelTerrain *vt,
+                                            SCEuint level,
+                                            SCE_SVoxelTerrainLevel *tl,
+                                            SCE_SVoxelTerrainLevel *tl2)
 {
+    long key[9];
+    int p[3], q[3];
+    SCE_SIntRect3 inner_lod, zone;
     SCE_TVector3 pos, origin;
     float invw, invh, invd;
     float scale;
     int x, y, z;
-    SCE_SBoundingBox box;
-    SCE_SBox b;
 
-    SCE_List_Flush (&tl->to_render);
+    SCE_VTerrain_GetPlacement (tl, tl2, key);
+    if (tl->placed_ready && !memcmp (key, tl->placed, sizeof key))
+        return;
+    memcpy (tl->placed, key, sizeof key);
+    tl->placed_ready = SCE_TRUE;
 
     scale = 1 << level;
     scale *= vt->scale;
@@ -1194,166 +1747,158 @@ SCE_VTerrain_CullLevelRegions1 (SCE_SVoxelTerrain *vt, SCEuint level,
                      (tl->map_y + tl->y) * invh,
                      (tl->map_z + tl->z) * invd);
 
-    /* construct bounding box */
-    SCE_Box_Init (&b);
-    SCE_Vector3_Set (pos, 0.0, 0.0, 0.0);
-    SCE_Box_Set (&b, pos, vt->subregion_dim * invw,
-                 vt->subregion_dim * invh,
-                 vt->subregion_dim * invd);
-    SCE_BoundingBox_Init (&box);
-    SCE_BoundingBox_SetFrom (&box, &b);
+    if (tl2)
+        SCE_VTerrain_GetInnerZone (vt, tl2, &inner_lod);
 
     for (z = 0; z < tl->subregions; z++) {
         for (y = 0; y < tl->subregions; y++) {
             for (x = 0; x < tl->subregions; x++) {
-                unsigned int offset = SCE_VTerrain_Get (tl, x, y, z);
-                SCE_SVoxelTerrainRegion *region = &tl->regions[offset];
+                SCE_SVoxelTerrainRegion *region =
+                    SCE_VTerrain_GetRegion (tl, x, y, z);
 
                 region->wx = x;
                 region->wy = y;
                 region->wz = z;
 
-                if (region->draw) {
-                    int draw;
-#define DERP 1
-                    SCE_Vector3_Set
-                        (pos,
-                         (float)x * (vt->subregion_dim - DERP) * invw,
-                         (float)y * (vt->subregion_dim - DERP) * invh,
-                         (float)z * (vt->subregion_dim - DERP) * invd);
-
-                    SCE_Vector3_Operator1v (pos, +=, origin);
-                    SCE_Matrix4_Identity (region->matrix);
-                    SCE_Matrix4_SetScale (region->matrix, scale, scale, scale);
-                    SCE_Matrix4_MulTranslatev (region->matrix, pos);
-
-                    if (!frustum) {
-                        SCE_List_Appendl (&tl->to_render, &region->it2);
-                    } else {
-                        /* frustum culling */
-                        SCE_BoundingBox_Push (&box, region->matrix, &b);
-                        /* cull test */
-                        draw = SCE_Frustum_BoundingBoxInBool (frustum, &box);
-                        SCE_BoundingBox_Pop (&box, &b);
-
-                        if (draw)
-                            SCE_List_Appendl (&tl->to_render, &region->it2);
-                    }
+                region->hidden = SCE_FALSE;
+                if (tl2) {
+                    p[0] = x; p[1] = y; p[2] = z;
+                    q[0] = x + 1; q[1] = y + 1; q[2] = z + 1;
+                    SCE_VTerrain_GetZone (vt, tl, p, q, &zone);
+                    region->hidden = SCE_Rectangle3_IsInside (&inner_lod,
+                                                              &zone);
                 }
+
+                SCE_Vector3_Set
+                    (pos,
+                     (float)x * (vt->subregion_dim - DERP) * invw,
+                     (float)y * (vt->subregion_dim - DERP) * invh,
+                     (float)z * (vt->subregion_dim - DERP) * invd);
+
+                SCE_Vector3_Operator1v (pos, +=, origin);
+                SCE_Matrix4_Identity (region->matrix);
+                SCE_Matrix4_SetScale (region->matrix, scale, scale, scale);
+                SCE_Matrix4_MulTranslatev (region->matrix, pos);
             }
         }
     }
-
 }
 
-static void
-SCE_VTerrain_CullLevelRegions2 (SCE_SVoxelTerrain *vt, SCEuint level,
-                                SCE_SVoxelTerrainLevel *tl,
-                                SCE_SVoxelTerrainLevel *tl2,
-                                const SCE_SFrustum *frustum)
-{
-    int draw = SCE_TRUE, p1[3], p2[3];
-    SCE_SIntRect3 inner_lod, zone;
-    SCE_TVector3 pos, origin;
-    float invw, invh, invd;
-    float scale;
-    int x, y, z;
-    SCE_SBoundingBox box;
-    SCE_SBox b;
-
-    SCE_List_Flush (&tl->to_render);
-
-    scale = 1 << level;
-    scale *= vt->scale;
-
-    invw = 1.0 / vt->width;
-    invh = 1.0 / vt->height;
-    invd = 1.0 / vt->depth;
-
-    SCE_Vector3_Set (origin,
-                     (tl->map_x + tl->x) * invw,
-                     (tl->map_y + tl->y) * invh,
-                     (tl->map_z + tl->z) * invd);
+/* culls the block of regions [p1, p2[ of a level, \p cull is the
+   visibility of the enclosing block: only partially visible blocks are
+   tested, then split in two along their longest side */
+static void SCE_VTerrain_CullBlock (SCE_SVoxelTerrain *vt, SCEuint level,
+                                    SCE_SVoxelTerrainLevel *tl,
+                                    const SCE_SIntRect3 *inner,
+                                    const SCE_SFrustum *frustum,
+                                    const int *p1, const int *p2, int cull)
+{
+    int i, axis, x, y, z;
+    int q1[3], q2[3];
+    SCE_SIntRect3 zone;
+
+    /* entirely covered by the finer level, visibility is not needed */
+    if (inner) {
+        SCE_VTerrain_GetZone (vt, tl, p1, p2, &zone);
+        if (SCE_Rectangle3_IsInside (inner, &zone))
+            cull = SCE_COLLIDE_IN;
+    }
 
-    /* construct bounding box */
-    SCE_Box_Init (&b);
-    SCE_Vector3_Set (pos, 0.0, 0.0, 0.0);
-    SCE_Box_Set (&b, pos, vt->subregion_dim * invw,
-                 vt->subregion_dim * invh,
-                 vt->subregion_dim * invd);
-    SCE_BoundingBox_Init (&box);
-    SCE_BoundingBox_SetFrom (&box, &b);
+    if (cull == SCE_COLLIDE_PARTIALLY) {
+        SCE_SBoundingBox box;
+        SCE_SBox b;
+        SCE_TVector3 pos, dims;
+        float scale, unit;
+        int dim = vt->subregion_dim;
+
+        scale = 1 << level;
+        scale *= vt->scale;
+        unit = dim - DERP;
+
+        SCE_Vector3_Set (pos,
+                         (tl->map_x + tl->x + p1[0] * unit) / vt->width,
+                         (tl->map_y + tl->y + p1[1] * unit) / vt->height,
+                         (tl->map_z + tl->z + p1[2] * unit) / vt->depth);
+        SCE_Vector3_Set (dims,
+                         ((p2[0] - p1[0] - 1) * unit + dim) / vt->width,
+                         ((p2[1] - p1[1] - 1) * unit + dim) / vt->height,
+                         ((p2[2] - p1[2] - 1) * unit + dim) / vt->depth);
+        SCE_Vector3_Operator1 (pos, *=, scale);
+        SCE_Vector3_Operator1 (dims, *=, scale);
+
+        SCE_Box_Init (&b);
+        SCE_Box_Set (&b, pos, dims[0], dims[1], dims[2]);
+        SCE_BoundingBox_Init (&box);
+        SCE_BoundingBox_SetFrom (&box, &b);
+        /* TODO: fix SCE_Frustum_Bounblblbl() 1st param const */
+        cull = SCE_Frustum_BoundingBoxIn (frustum, &box);
+    }
 
-    for (z = 0; z < tl->subregions; z++) {
-        for (y = 0; y < tl->subregions; y++) {
-            for (x = 0; x < tl->subregions; x++) {
-                unsigned int offset = SCE_VTerrain_Get (tl, x, y, z);
-                SCE_SVoxelTerrainRegion *region = &tl->regions[offset];
+    /* pick the longest side */
+    axis = 0;
+    for (i = 1; i < 3; i++) {
+        if (p2[i] - p1[i] > p2[axis] - p1[axis])
+            axis = i;
+    }
 
-                region->wx = x;
-                region->wy = y;
-                region->wz = z;
+    if (cull == SCE_COLLIDE_PARTIALLY && p2[axis] - p1[axis] > 1) {
+        for (i = 0; i < 3; i++) {
+            q1[i] = p1[i];
+            q2[i] = p2[i];
+        }
+        q1[axis] = q2[axis] = (p1[axis] + p2[axis]) / 2;
+        SCE_VTerrain_CullBlock (vt, level, tl, inner, frustum, p1, q2, cull);
+        SCE_VTerrain_CullBlock (vt, level, tl, inner, frustum, q1, p2, cull);
+        return;
+    }
 
-                /* compute current region area */
-                p1[0] = 2 * (tl->map_x + tl->x + x * (vt->subregion_dim-1));
-                p1[1] = 2 * (tl->map_y + tl->y + y * (vt->subregion_dim-1));
-                p1[2] = 2 * (tl->map_z + tl->z + z * (vt->subregion_dim-1));
-                p2[0] = p1[0] + 2 * vt->subregion_dim;
-                p2[1] = p1[1] + 2 * vt->subregion_dim;
-                p2[2] = p1[2] + 2 * vt->subregion_dim;
-                SCE_Rectangle3_Setv (&zone, p1, p2);
-
-                /* compute inner LOD grid area */
-                p1[0] = tl2->map_x + tl2->x + 1;
-                p1[1] = tl2->map_y + tl2->y + 1;
-                p1[2] = tl2->map_z + tl2->z + 1;
-                p2[0] = p1[0] + vt->n_subregions * (vt->subregion_dim-1);
-                p2[1] = p1[1] + vt->n_subregions * (vt->subregion_dim-1);
-                p2[2] = p1[2] + vt->n_subregions * (vt->subregion_dim-1);
-                SCE_Rectangle3_Setv (&inner_lod, p1, p2);
-
-                draw = !SCE_Rectangle3_IsInside (&inner_lod, &zone);
-
-                if (draw && region->draw) {
-                    SCE_Vector3_Set
-                        (pos,
-                         (float)x * (vt->subregion_dim - DERP) * invw,
-                         (float)y * (vt->subregion_dim - DERP) * invh,
-                         (float)z * (vt->subregion_dim - DERP) * invd);
-
-                    SCE_Vector3_Operator1v (pos, +=, origin);
-                    SCE_Matrix4_Identity (region->matrix);
-                    SCE_Matrix4_SetScale (region->matrix, scale, scale, scale);
-                    SCE_Matrix4_MulTranslatev (region->matrix, pos);
-
-                    if (!frustum) {
-                        SCE_List_Appendl (&tl->to_render, &region->it2);
-                    } else {
-                        /* frustum culling */
-                        SCE_BoundingBox_Push (&box, region->matrix, &b);
-                        /* cull test */
-                        draw = SCE_Frustum_BoundingBoxInBool (frustum, &box);
-                        SCE_BoundingBox_Pop (&box, &b);
-
-                        if (draw)
-                            SCE_List_Appendl (&tl->to_render, &region->it2);
-                    }
-                }
+    for (z = p1[2]; z < p2[2]; z++) {
+        for (y = p1[1]; y < p2[1]; y++) {
+            for (x = p1[0]; x < p2[0]; x++) {
+                SCE_SVoxelTerrainRegion *region =
+                    SCE_VTerrain_GetRegion (tl, x, y, z);
+
+                /* visibility is computed for every region, it orders the
+                   updates of empty ones too */
+                region->visible = region->hidden || cull != SCE_COLLIDE_OUT;
+                if (region->draw && region->visible && !region->hidden)
+                    SCE_List_Appendl (&tl->to_render, &region->it2);
             }
         }
     }
 }
 
+static void
+SCE_VTerrain_CullLevelRegions (SCE_SVoxelTerrain *vt, SCEuint level,
+                               SCE_SVoxelTerrainLevel *tl,
+                               SCE_SVoxelTerrainLevel *tl2,
+                               const SCE_SFrustum *frustum)
+{
+    int p1[3], p2[3];
+    SCE_SIntRect3 inner_lod;
+
+    SCE_List_Flush (&tl->to_render);
+    SCE_VTerrain_PlaceLevelRegions (vt, level, tl, tl2);
+
+    p1[0] = p1[1] = p1[2] = 0;
+    p2[0] = p2[1] = p2[2] = tl->subregions;
+    if (tl2)
+        SCE_VTerrain_GetInnerZone (vt, tl2, &inner_lod);
+    SCE_VTerrain_CullBlock (vt, level, tl, tl2 ? &inner_lod : NULL, frustum,
+                            p1, p2, frustum ? SCE_COLLIDE_PARTIALLY :
+                            SCE_COLLIDE_IN);
+}
+
 
 void SCE_VTerrain_CullRegions (SCE_SVoxelTerrain *vt,
                                const SCE_SFrustum *frustum)
 {
     size_t i;
 
-    SCE_VTerrain_CullLevelRegions1 (vt, 0, &vt->levels[0], frustum);
+    SCE_VTerrain_CullLevelRegions (vt, 0, &vt->levels[0], NULL, frustum);
     for (i = 1; i < vt->n_levels; i++)
-        SCE_VTerrain_CullLevelRegions2 (vt, i, &vt->levels[i],
-                                        &vt->levels[i - 1], frustum);
+        SCE_VTerrain_CullLevelRegions (vt, i, &vt->levels[i],
+                                       &vt->levels[i - 1], frustum);
 }
 
 /* get borders and multiplies every vertex */
@@ -1378,55 +1923,134 @@ static SCEuint SCE_VTerrain_Derp (float coef, SCEvertices *vertices,
     return j;
 }
 
-static void SCE_VTerrain_EncodePos (SCEvertices *v, size_t n, size_t stride,
-                                    SCEubyte *out)
+/* trilinear interpolation of the densities of \p data around \p p, in
+   voxels */
+static float SCE_VTerrain_SampleDensity (const SCEubyte *data, int w, int h,
+                                         int d, const float *p)
 {
-    size_t i;
-    SCEvertices *u;
+    const SCEubyte *c = NULL;
+    size_t sy = w, sz = (size_t)w * h;
+    float f[3], a, b;
+    int q[3], dims[3], i;
 
-    for (i = 0; i < n; i++) {
-        memcpy (out, &v[i * 3], 3 * sizeof *v);
-        u = (SCEvertices*)out;
-        u[3] = 1.0;
-        out = &out[stride];
+    dims[0] = w; dims[1] = h; dims[2] = d;
+    for (i = 0; i < 3; i++) {
+        q[i] = MAX (0, MIN ((int)p[i], dims[i] - 2));
+        f[i] = MAX (0.0f, MIN (p[i] - q[i], 1.0f));
     }
-}
-static void SCE_VTerrain_EncodeNor (SCEvertices *v, size_t n, size_t stride,
-                                    SCEubyte *out)
-{
-    size_t i;
+    c = &data[q[0] + sy * q[1] + sz * q[2]];
+
+#define SCE_VTERRAIN_LERP(u, v, t) ((u) + ((v) - (u)) * (t))
+    a = SCE_VTERRAIN_LERP (SCE_VTERRAIN_LERP (c[0], c[1], f[0]),
+                           SCE_VTERRAIN_LERP (c[sy], c[sy + 1], f[0]), f[1]);
+    c += sz;
+    b = SCE_VTERRAIN_LERP (SCE_VTERRAIN_LERP (c[0], c[1], f[0]),
+                           SCE_VTERRAIN_LERP (c[sy], c[sy + 1], f[0]), f[1]);
+    return SCE_VTERRAIN_LERP (a, b, f[2]);
+#undef SCE_VTERRAIN_LERP
+}
+
+/* normals of the vertices from the gradient of the densities of \p grid,
+   \p coef brings the vertices into voxels */
+static void SCE_VTerrain_GradientNormals (SCE_SGrid *grid, float coef,
+                                          const SCEvertices *vertices,
+                                          SCEuint n_vertices,
+                                          SCEvertices *normals)
+{
+    const SCEubyte *data = SCE_Grid_GetRaw (grid);
+    int w, h, d;
+    SCEuint i;
+    float p[3], len;
+    SCEvertices *n = NULL;
 
-    for (i = 0; i < n; i++) {
-        memcpy (out, &v[i * 3], 3 * sizeof *v);
-        out = &out[stride];
-    }
-}
-static void SCE_VTerrain_EncodeCompressPos (float scale, SCEvertices *v, size_t n,
-                                            size_t stride, SCEubyte *out)
-{
-    size_t i;
+    w = SCE_Grid_GetWidth (grid);
+    h = SCE_Grid_GetHeight (grid);
+    d = SCE_Grid_GetDepth (grid);
 
-    for (i = 0; i < n; i++) {
-        /* TODO: HAHAHA we have to consider endianess of the GPU,
-           quite funny. */
-        out[3] = (SCEubyte)(scale * v[i * 3]     * 256.0);
-        out[2] = (SCEubyte)(scale * v[i * 3 + 1] * 256.0);
-        out[1] = (SCEubyte)(scale * v[i * 3 + 2] * 256.0);
-        out = &out[stride];
+    for (i = 0; i < n_vertices; i++) {
+        n = &normals[i * 3];
+        p[0] = vertices[i * 3] * coef;
+        p[1] = vertices[i * 3 + 1] * coef;
+        p[2] = vertices[i * 3 + 2] * coef;
+
+        p[0] += 1.0; n[0] = SCE_VTerrain_SampleDensity (data, w, h, d, p);
+        p[0] -= 2.0; n[0] -= SCE_VTerrain_SampleDensity (data, w, h, d, p);
+        p[0] += 1.0;
+        p[1] += 1.0; n[1] = SCE_VTerrain_SampleDensity (data, w, h, d, p);
+        p[1] -= 2.0; n[1] -= SCE_VTerrain_SampleDensity (data, w, h, d, p);
+        p[1] += 1.0;
+        p[2] += 1.0; n[2] = SCE_VTerrain_SampleDensity (data, w, h, d, p);
+        p[2] -= 2.0; n[2] -= SCE_VTerrain_SampleDensity (data, w, h, d, p);
+
+        /* the densities increase inside the ground */
+        len = SCE_Vector3_Length (n);
+        if (len > 0.0) {
+            SCE_Vector3_Operator1 (n, *=, -1.0 / len);
+        } else {
+            /* flat densities, any direction will do */
+            SCE_Vector3_Set (n, 0.0, 0.0, 1.0);
+        }
     }
 }
-static void SCE_VTerrain_EncodeCompressNor (SCEvertices *v, size_t n,
-                                            size_t stride, SCEubyte *out)
-{
-    size_t i;
 
-    for (i = 0; i < n; i++) {
-        out[3] = (SCEubyte)((1.0 + v[i * 3])     * 127.0);
-        out[2] = (SCEubyte)((1.0 + v[i * 3 + 1]) * 127.0);
-        out[1] = (SCEubyte)((1.0 + v[i * 3 + 2]) * 127.0);
-        out = &out[stride];
+/* vertex encoders of the hybrid generator, one per vertex format so that
+   the loops have constant strides and no branch: positions are either 4
+   floats (w = 1) or 3 bytes of fixed point, normals either 3 floats or 3
+   bytes. both compressed formats are stored in reverse order, the last
+   byte being the first coordinate */
+#define SCE_VTERRAIN_POS(out, v, scale) do {                            \
+        SCEvertices *p_ = (SCEvertices*)(out);                          \
+        p_[0] = (v)[0]; p_[1] = (v)[1]; p_[2] = (v)[2]; p_[3] = 1.0;    \
+    } while (0)
+/* TODO: HAHAHA we have to consider endianess of the GPU, quite funny. */
+#define SCE_VTERRAIN_COMPRESS_POS(out, v, scale) do {                   \
+        (out)[0] = 0;                                                   \
+        (out)[1] = (SCEubyte)((scale) * (v)[2] * 256.0f);               \
+        (out)[2] = (SCEubyte)((scale) * (v)[1] * 256.0f);               \
+        (out)[3] = (SCEubyte)((scale) * (v)[0] * 256.0f);               \
+    } while (0)
+#define SCE_VTERRAIN_NOR(out, v) do {                                   \
+        SCEvertices *n_ = (SCEvertices*)(out);                          \
+        n_[0] = (v)[0]; n_[1] = (v)[1]; n_[2] = (v)[2];                 \
+    } while (0)
+#define SCE_VTERRAIN_COMPRESS_NOR(out, v) do {                          \
+        (out)[0] = 0;                                                   \
+        (out)[1] = (SCEubyte)((1.0f + (v)[2]) * 127.0f);                \
+        (out)[2] = (SCEubyte)((1.0f + (v)[1]) * 127.0f);                \
+        (out)[3] = (SCEubyte)((1.0f + (v)[0]) * 127.0f);                \
+    } while (0)
+
+#define SCE_VTERRAIN_DEFINE_ENCODER(name, pos, psize, nor, nsize)       \
+    static void name (float scale, const SCEvertices *v,                \
+                      const SCEvertices *n, size_t count, SCEubyte *out) \
+    {                                                                   \
+        size_t i;                                                       \
+        (void)scale;                                                    \
+        for (i = 0; i < count; i++) {                                   \
+            pos (out, &v[i * 3], scale);                                \
+            nor (&out[psize], &n[i * 3]);                               \
+            out = &out[(psize) + (nsize)];                              \
+        }                                                               \
     }
-}
+
+SCE_VTERRAIN_DEFINE_ENCODER (SCE_VTerrain_Encode,
+                             SCE_VTERRAIN_POS, 4 * sizeof (SCEvertices),
+                             SCE_VTERRAIN_NOR, 3 * sizeof (SCEvertices))
+SCE_VTERRAIN_DEFINE_ENCODER (SCE_VTerrain_EncodeCP,
+                             SCE_VTERRAIN_COMPRESS_POS, 4,
+                             SCE_VTERRAIN_NOR, 3 * sizeof (SCEvertices))
+SCE_VTERRAIN_DEFINE_ENCODER (SCE_VTerrain_EncodeCN,
+                             SCE_VTERRAIN_POS, 4 * sizeof (SCEvertices),
+                             SCE_VTERRAIN_COMPRESS_NOR, 4)
+SCE_VTERRAIN_DEFINE_ENCODER (SCE_VTerrain_EncodeCPCN,
+                             SCE_VTERRAIN_COMPRESS_POS, 4,
+                             SCE_VTERRAIN_COMPRESS_NOR, 4)
+
+/* indexed by comp_pos, comp_nor */
+static const SCE_FVTerrainEncodeFunc sce_vterrain_encoders[2][2] = {
+    {SCE_VTerrain_Encode, SCE_VTerrain_EncodeCN},
+    {SCE_VTerrain_EncodeCP, SCE_VTerrain_EncodeCPCN}
+};
 
 static int SCE_VTerrain_ReallocMesh (SCE_SMesh *mesh, SCE_RBufferPool *v,
                                      SCE_RBufferPool *i)
@@ -1445,6 +2069,113 @@ fail:
     return SCE_ERROR;
 }
 
+/* sets the ranges of the voxel mesh of a region to its arena blocks */
+static void SCE_VTerrain_SetRegionRanges (SCE_SVoxelTerrainRegion *tr)
+{
+    int r[2];
+    SCE_SMeshArenaAlloc *alloc = &tr->alloc;
+
+    r[0] = alloc->vblock ? alloc->vblock->offset : 0;
+    r[1] = alloc->vblock ? alloc->vblock->size : 0;
+    SCE_VRender_SetVBRange (&tr->vm, r);
+    r[0] = alloc->iblock ? alloc->iblock->offset : 0;
+    r[1] = alloc->iblock ? alloc->iblock->size : 0;
+    SCE_VRender_SetIBRange (&tr->vm, r);
+}
+
+/* resizes the range of a region in the arena, compacting the arena once
+   when it is full. returns SCE_FALSE if it is still full, the region then
+   keeps its current geometry */
+static int SCE_VTerrain_ReallocRange (SCE_SVoxelTerrain *vt,
+                                      SCE_SVoxelTerrainRegion *tr,
+                                      SCEuint n_vertices, SCEuint n_indices)
+{
+    if (SCE_MeshArena_Realloc (vt->arena, &tr->alloc, n_vertices,
+                               n_indices) == SCE_OK)
+        return SCE_TRUE;
+    /* a full arena is not an error, the region will try again */
+    SCEE_Clear ();
+    if (SCE_MeshArena_Defragment (vt->arena,
+                                  SCE_VTERRAIN_FULL_DEFRAGMENT_MOVES) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    if (SCE_MeshArena_Realloc (vt->arena, &tr->alloc, n_vertices,
+                               n_indices) == SCE_OK)
+        return SCE_TRUE;
+    SCEE_Clear ();
+    return SCE_FALSE;
+}
+
+/* generates the mesh of a region on the CPU, in place in the arena if any:
+   the blocks of the region are reused as long as the mesh fits into them.
+   returns SCE_FALSE if the arena is full, a mesh that does not fit into
+   the blocks of the region is never written to the arena, so that they
+   still hold the previous geometry */
+static int SCE_VTerrain_Software (SCE_SVoxelTerrain *vt,
+                                  SCE_SVoxelTerrainRegion *tr,
+                                  int x, int y, int z)
+{
+    SCE_SMeshArenaAlloc *alloc = &tr->alloc;
+    SCEuint first_vertex, first_index;
+    int fits, r;
+
+    if (vt->arena)
+        SCE_VTerrain_SetRegionRanges (tr);
+    if (SCE_VRender_Software (&vt->temp, &tr->level->grid, &tr->vm,
+                              x, y, z) < 0)
+        goto fail;
+    if (!vt->arena)
+        return SCE_TRUE;
+
+    if (SCE_VRender_IsEmpty (&tr->vm)) {
+        SCE_MeshArena_Free (vt->arena, alloc);
+        return SCE_TRUE;
+    }
+    fits = SCE_VRender_FitsRanges (&tr->vm);
+    first_vertex = alloc->entry.first_vertex;
+    first_index = alloc->entry.first_index;
+    if ((r = SCE_VTerrain_ReallocRange (vt, tr, tr->vm.n_vertices,
+                                        tr->vm.n_indices)) != SCE_TRUE)
+        return r;
+    if (!fits || first_vertex != alloc->entry.first_vertex ||
+        first_index != alloc->entry.first_index) {
+        /* new blocks */
+        SCE_VTerrain_SetRegionRanges (tr);
+        if (SCE_VRender_UploadRanges (&vt->temp, &tr->vm) < 0)
+            goto fail;
+    }
+    return SCE_TRUE;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+/* copies the freshly generated mesh of a region into the arena, returns
+   SCE_FALSE if the arena is full */
+static int SCE_VTerrain_StoreRegion (SCE_SVoxelTerrain *vt,
+                                     SCE_SVoxelTerrainRegion *tr)
+{
+    int r;
+
+    if (!vt->arena)
+        return SCE_TRUE;
+    if (!tr->draw) {
+        SCE_MeshArena_Free (vt->arena, &tr->alloc);
+        return SCE_TRUE;
+    }
+    if ((r = SCE_VTerrain_ReallocRange (vt, tr,
+                                        SCE_Mesh_GetNumVertices (tr->mesh),
+                                        SCE_Mesh_GetNumIndices (tr->mesh)))
+        != SCE_TRUE)
+        return r;
+    if (SCE_MeshArena_CopyMesh (vt->arena, &tr->alloc, tr->mesh) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    return SCE_TRUE;
+}
+
 static int SCE_VTerrain_UpdateHybrid (SCE_SVoxelTerrain *vt)
 {
     SCE_SVoxelTerrainHybridGenerator *h = &vt->hybrid;
@@ -1482,7 +2213,6 @@ static int SCE_VTerrain_UpdateHybrid (SCE_SVoxelTerrain *vt)
         size_t size, stride;
         float factor, sup, inf;
         SCEuint n_collapses;
-        SCEubyte *ptr = NULL;
 
         factor = ((float)vt->subregion_dim) / (float)vt->width;
 
@@ -1493,10 +2223,21 @@ static int SCE_VTerrain_UpdateHybrid (SCE_SVoxelTerrain *vt)
            grid for normal generation? faster, slower? */
         dim = 2 * h->dim /* - 1 */;
         SCE_Rectangle3_Set (&r, 0, 0, 0, dim, dim, dim);
-        h->n_vertices = SCE_MC_GenerateVerticesRange (&h->mc_gen, &r, &h->grid,
-                                                      h->vertices, h->mc_step);
-        if (!SCE_MC_IsGenerationFinished (&h->mc_gen))
-            return SCE_OK;
+        if (!h->active) {
+            /* no surface in there, don't even start marching */
+            h->n_vertices = 0;
+            vt->n_empty_skips++;
+        } else {
+            /* one slice of mc_step cells, more while the budget allows it */
+            do {
+                h->n_vertices =
+                    SCE_MC_GenerateVerticesRange (&h->mc_gen, &r, &h->grid,
+                                                  h->vertices, h->mc_step);
+            } while (!SCE_MC_IsGenerationFinished (&h->mc_gen) &&
+                     vt->budget && SCE_FrameBudget_HasTime (vt->budget));
+            if (!SCE_MC_IsGenerationFinished (&h->mc_gen))
+                return SCE_OK;
+        }
         if (!h->n_vertices) {
             SCE_List_RemoveFirst (&h->queue);
             SCE_Mesh_SetNumVertices (tr->mesh, 0);
@@ -1518,35 +2259,43 @@ static int SCE_VTerrain_UpdateHybrid (SCE_SVoxelTerrain *vt)
         SCE_QEMD_Set (&h->qmesh, h->vertices, NULL, NULL, NULL, h->indices,
                       h->n_vertices, h->n_indices);
         SCE_QEMD_AnchorVertices (&h->qmesh, h->anchors, h->n_anchors);
-        /* aiming at 80% vertex reduction */
-        n_collapses = (h->n_vertices - h->n_anchors) * 0.8;
+        n_collapses = SCE_VTerrain_GetCollapses (vt, l, h->n_vertices,
+                                                 h->n_anchors);
         SCE_QEMD_Process (&h->qmesh, n_collapses);
         SCE_QEMD_Get (&h->qmesh, h->vertices, NULL, NULL, h->indices,
                       &h->n_vertices, &h->n_indices);
 
+        if (h->optimize) {
+            if (SCE_MeshOpt_Optimize (&h->opt, h->optimize, h->indices,
+                                      SCE_INDICES_TYPE, h->n_indices,
+                                      h->vertices, 0, h->n_vertices) < 0)
+                goto fail;
+            if (SCE_MeshOpt_Remap (&h->opt, h->vertices,
+                                   3 * sizeof *h->vertices, 0) < 0)
+                goto fail;
+        }
+
         /* generate normals */
-        SCE_Geometry_ComputeNormals (h->vertices, h->indices, h->n_vertices,
-                                     h->n_indices, h->normals);
+        if (h->gradient) {
+            /* Derp() has scaled the vertices from [0, 1] by factor */
+            SCE_VTerrain_GradientNormals (&h->grid, (dim - 1.0) / factor,
+                                          h->vertices, h->n_vertices,
+                                          h->normals);
+        } else {
+            SCE_Geometry_ComputeNormals (h->vertices, h->indices,
+                                         h->n_vertices, h->n_indices,
+                                         h->normals);
+        }
 
         /* encode (and compress if needed) */
         /* compute stride */
         /* TODO: these numbers depend on those setup by the voxel renderer */
-        stride = size = vt->comp_pos ? 4 : (4 * sizeof (SCEvertices));
-        stride +=       vt->comp_nor ? 4 : (3 * sizeof (SCEvertices));
-        ptr = h->interleaved;
+        stride  = vt->comp_pos ? 4 : (4 * sizeof (SCEvertices));
+        stride += vt->comp_nor ? 4 : (3 * sizeof (SCEvertices));
         /* n_subregions is the same we give VRender_SetCompressedScale() */
         factor = (float)vt->n_subregions;
-        if (vt->comp_pos)
-            SCE_VTerrain_EncodeCompressPos (factor, h->vertices,
-                                            h->n_vertices, stride, ptr);
-        else
-            SCE_VTerrain_EncodePos (h->vertices, h->n_vertices, stride, ptr);
-        ptr = &ptr[size];
-        if (vt->comp_nor)
-            SCE_VTerrain_EncodeCompressNor (h->normals, h->n_vertices, stride,
-                                            ptr);
-        else
-            SCE_VTerrain_EncodeNor (h->normals, h->n_vertices, stride, ptr);
+        vt->encode (factor, h->vertices, h->normals, h->n_vertices,
+                    h->interleaved);
 
         /* TODO: we can only hope that the mesh has been simplified enough to
            fit into the buffers (which size have been allocated for smaller
@@ -1554,28 +2303,44 @@ static int SCE_VTerrain_UpdateHybrid (SCE_SVoxelTerrain *vt)
            the incoming variable length vertex buffer feature */
 
         /* upload geometry */
-        SCE_Mesh_SetNumVertices (tr->mesh, h->n_vertices);
-        SCE_Mesh_SetNumIndices (tr->mesh, h->n_indices);
-        /* indices are now SCE_INDICES_TYPE: pretty ugly, because it forces
-           us to put the type back to SCE_UNSIGNED_INT when generating the
-           mesh with the GPU */
-        /* change it before reallocating the mesh */
-        {
-            SCE_RIndexBuffer *ib = SCE_Mesh_GetIndexBuffer (tr->mesh);
-            /* TODO: direct member access */
-            ib->ia.type = SCE_INDICES_TYPE;
+        if (vt->arena) {
+            /* straight into the arena, the region mesh is not used */
+            int r = SCE_VTerrain_ReallocRange (vt, tr, h->n_vertices,
+                                               h->n_indices);
+            if (r < 0)
+                goto fail;
+            if (!r) {
+                /* the arena is full: keep the current mesh and generate
+                   the region again once the other ones are done */
+                SCE_List_Removel (&tr->it3);
+                SCE_List_Appendl (&h->queue, &tr->it3);
+                h->grid_ready = SCE_FALSE;
+                return SCE_OK;
+            }
+            SCE_MeshArena_UploadVertices (vt->arena, &tr->alloc,
+                                          SCE_MESH_STREAM_G, h->interleaved);
+            if (SCE_MeshArena_UploadIndices (vt->arena, &tr->alloc,
+                                             h->indices, SCE_INDICES_TYPE) < 0)
+                goto fail;
+        } else {
+            SCE_Mesh_SetNumVertices (tr->mesh, h->n_vertices);
+            SCE_Mesh_SetNumIndices (tr->mesh, h->n_indices);
+            /* pick the index width before reallocating the mesh */
+            SCE_Mesh_AutoIndexType (tr->mesh);
+            if (SCE_VTerrain_ReallocMesh (tr->mesh, vt->vertex_pool,
+                                          vt->index_pool) < 0)
+                goto fail;
+            size = stride * h->n_vertices;
+            SCE_Mesh_UploadVertices (tr->mesh, SCE_MESH_STREAM_G,
+                                     h->interleaved, 0, size);
+            if (SCE_Mesh_UploadIndicesFrom (tr->mesh, h->indices,
+                                            SCE_INDICES_TYPE,
+                                            h->n_indices) < 0)
+                goto fail;
         }
-        if (SCE_VTerrain_ReallocMesh (tr->mesh, vt->vertex_pool,
-                                      vt->index_pool) < 0)
-            goto fail;
-        size = stride * h->n_vertices;
-        SCE_Mesh_UploadVertices (tr->mesh, SCE_MESH_STREAM_G, h->interleaved,
-                                 0, size);
-        size = h->n_indices * sizeof *h->indices;
-        SCE_Mesh_UploadIndices (tr->mesh, h->indices, size);
+        tr->draw = (h->n_vertices>0 && h->n_indices>0) ? SCE_TRUE : SCE_FALSE;
 
         /* done */
-        tr->draw = (h->n_vertices>0 && h->n_indices>0) ? SCE_TRUE : SCE_FALSE;
         SCE_List_RemoveFirst (&h->queue);
         h->grid_ready = SCE_FALSE;
     }
@@ -1586,103 +2351,413 @@ fail:
     return SCE_ERROR;
 }
 
-int SCE_VTerrain_Update (SCE_SVoxelTerrain *vt)
+/* squared distance between the center of a region and the viewer, in
+   voxels of the level 0; a moving viewer is assumed half way to its
+   predicted position so that the regions ahead come first */
+static float SCE_VTerrain_RegionDistance (const SCE_SVoxelTerrain *vt,
+                                          const SCE_SVoxelTerrainRegion *tr)
 {
-    size_t i;
-    SCE_SListIterator *it = NULL, *pro = NULL;
-    unsigned int x, y, z;
-    SCE_SVoxelTerrainLevel *fresh = NULL;
-    SCE_SList *list = NULL;
+    const SCE_SVoxelTerrainLevel *tl = tr->level;
+    long half = vt->subregion_dim / 2, scale = 1L << tl->level;
+    long p[3];
+    float d[3];
+
+    p[0] = SCE_Math_Ring (tr->x - tl->wrap_x, tl->subregions);
+    p[1] = SCE_Math_Ring (tr->y - tl->wrap_y, tl->subregions);
+    p[2] = SCE_Math_Ring (tr->z - tl->wrap_z, tl->subregions);
+    p[0] = tl->map_x + tl->x + p[0] * (vt->subregion_dim - 1) + half;
+    p[1] = tl->map_y + tl->y + p[1] * (vt->subregion_dim - 1) + half;
+    p[2] = tl->map_z + tl->z + p[2] * (vt->subregion_dim - 1) + half;
+    d[0] = p[0] * scale - vt->x - 0.5f * vt->velocity[0] * vt->prefetch_time;
+    d[1] = p[1] * scale - vt->y - 0.5f * vt->velocity[1] * vt->prefetch_time;
+    d[2] = p[2] * scale - vt->z - 0.5f * vt->velocity[2] * vt->prefetch_time;
+    return d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+}
+static void SCE_VTerrain_ComputePriorities (const SCE_SVoxelTerrain *vt,
+                                            SCE_SList *list)
+{
+    SCE_SListIterator *it = NULL;
+    SCE_List_ForEach (it, list) {
+        SCE_SVoxelTerrainRegion *tr = SCE_List_GetData (it);
+        tr->priority = SCE_VTerrain_RegionDistance (vt, tr);
+    }
+}
+/* regions hidden by a finer level come last, then those outside of the view
+   frustum, the nearest first in each group, the finest level first on
+   ties */
+static int SCE_VTerrain_RegionTier (const SCE_SVoxelTerrainRegion *tr)
+{
+    if (tr->hidden)
+        return 2;
+    return tr->visible ? 0 : 1;
+}
+static int SCE_VTerrain_IsMoreUrgent (const SCE_SVoxelTerrainRegion *a,
+                                      const SCE_SVoxelTerrainRegion *b)
+{
+    int ta = SCE_VTerrain_RegionTier (a), tb = SCE_VTerrain_RegionTier (b);
+    if (ta != tb)
+        return ta < tb;
+    if (a->priority != b->priority)
+        return a->priority < b->priority;
+    return a->level->level < b->level->level;
+}
+/* priorities change as the viewer moves, so they are recomputed each frame
+   and the queue is only scanned for its most urgent entry: the lists are
+   at most a level large and only max_updates regions are dequeued */
+static SCE_SVoxelTerrainRegion* SCE_VTerrain_MostUrgent (SCE_SList *list)
+{
+    SCE_SListIterator *it = NULL;
+    SCE_SVoxelTerrainRegion *best = NULL;
 
-    fresh = vt->update_level;
-    /* whether there is no level being updated or if the level being updated
-       will be completed at the end of this function */
-    if (!vt->update_level ||
-        SCE_List_GetLength (vt->update_level->updating) <= vt->max_updates) {
-        if (SCE_List_HasElements (&vt->to_update)) {
-            SCE_SList *derp = NULL;
-            it = SCE_List_GetFirst (&vt->to_update);
-            fresh = SCE_List_GetData (it);
-            SCE_List_Removel (it);
-            SCE_Texture_Update (fresh->tex);
-            if (fresh->mat)
-                SCE_Texture_Update (fresh->mat);
-            derp = fresh->updating;
-            fresh->updating = fresh->queue;
-            fresh->queue = derp;
-            fresh->need_update = SCE_FALSE;
+    SCE_List_ForEach (it, list) {
+        SCE_SVoxelTerrainRegion *tr = SCE_List_GetData (it);
+        if (!best || SCE_VTerrain_IsMoreUrgent (tr, best))
+            best = tr;
+    }
+    return best;
+}
+/* picks the level holding the most urgent invalidated region */
+static SCE_SVoxelTerrainLevel* SCE_VTerrain_NextLevel (SCE_SVoxelTerrain *vt)
+{
+    SCE_SListIterator *it = NULL;
+    SCE_SVoxelTerrainLevel *best = NULL;
+    SCE_SVoxelTerrainRegion *best_region = NULL;
+
+    SCE_List_ForEach (it, &vt->to_update) {
+        SCE_SVoxelTerrainLevel *tl = SCE_List_GetData (it);
+        SCE_SVoxelTerrainRegion *tr = NULL;
+
+        SCE_VTerrain_ComputePriorities (vt, tl->queue);
+        tr = SCE_VTerrain_MostUrgent (tl->queue);
+        if (!best || (tr && (!best_region ||
+                             SCE_VTerrain_IsMoreUrgent (tr, best_region)))) {
+            best = tl;
+            best_region = tr;
         }
     }
+    return best;
+}
+/* regions invalidated again since the texture of their level was uploaded
+   will be meshed again after the next upload anyway: send them back to the
+   queue without meshing them now */
+static void SCE_VTerrain_DropStaleRegions (SCE_SVoxelTerrain *vt,
+                                           SCE_SList *list)
+{
+    SCE_SListIterator *it = NULL, *pro = NULL;
 
-    /* dequeue some regions for update */
-    i = 0;
-    if (vt->update_level)
-        list = vt->update_level->updating;
-    if (list) SCE_List_ForEachProtected (pro, it, list) {
+    SCE_List_ForEachProtected (pro, it, list) {
         SCE_SVoxelTerrainRegion *tr = SCE_List_GetData (it);
-        SCE_SVoxelTerrainLevel *l = vt->update_level;
+        if (tr->need_update) {
+            SCE_VTerrain_RemoveRegion (vt, tr);
+            vt->n_dropped_updates++;
+        }
+    }
+}
 
-        x = SCE_Math_Ring (tr->x - l->wrap_x, l->subregions);
-        y = SCE_Math_Ring (tr->y - l->wrap_y, l->subregions);
-        z = SCE_Math_Ring (tr->z - l->wrap_z, l->subregions);
+/* accounts for the latency of an edited region whose new geometry is in
+   place */
+static void SCE_VTerrain_EditDone (SCE_SVoxelTerrain *vt,
+                                   SCE_SVoxelTerrainRegion *tr)
+{
+    double latency;
 
-        x = l->x + x * (vt->subregion_dim - 1);
-        y = l->y + y * (vt->subregion_dim - 1);
-        z = l->z + z * (vt->subregion_dim - 1);
+    if (!tr->urgent)
+        return;
+    tr->urgent = SCE_FALSE;
+    latency = SCE_FrameBudget_GetTime () - tr->edit_time;
+    vt->n_edits++;
+    vt->edit_latency += latency;
+    vt->max_edit_latency = MAX (vt->max_edit_latency, latency);
+}
 
-        switch (vt->rpipeline) {
-        case SCE_VRENDER_SOFTWARE:
-            if (SCE_VRender_Software (&vt->temp, &tr->level->grid, &tr->vm,
-                                      x, y, z) < 0)
-                goto fail;
-            break;
-        case SCE_VRENDER_HARDWARE:
-            x += l->wrap[0];
-            y += l->wrap[1];
-            z += l->wrap[2];
-
-            /* TODO: see UpdateHybrid() */
-            /* update before Hardware(), so that the realloc work
-               properly */
-            {
-                SCE_RIndexBuffer *ib = SCE_Mesh_GetIndexBuffer (tr->mesh);
-                /* TODO: direct member access */
-                ib->ia.type = SCE_UNSIGNED_INT;
-            }
-            if (SCE_VRender_Hardware (&vt->temp, tr->level->tex, NULL,
-                                      &tr->vm, x, y, z) < 0)
-                goto fail;
+/* empties a region whose voxels don't cross the surface, without meshing
+   it; its pending update, if any, is cancelled */
+static int SCE_VTerrain_SkipRegion (SCE_SVoxelTerrain *vt,
+                                    SCE_SVoxelTerrainRegion *tr)
+{
+    tr->need_update = SCE_FALSE;
+    SCE_VTerrain_RemoveRegion (vt, tr);
+    tr->draw = SCE_FALSE;
+    if (vt->arena)
+        SCE_MeshArena_Free (vt->arena, &tr->alloc);
+    if (SCE_VRender_Empty (&vt->temp, &tr->vm) < 0) {
+        SCEE_LogSrc ();
+        return SCE_ERROR;
+    }
+    vt->n_empty_skips++;
+    SCE_VTerrain_EditDone (vt, tr);
+    return SCE_OK;
+}
 
-            break;
-        default:;
-        }
+static int SCE_VTerrain_UpdateRegion (SCE_SVoxelTerrain *vt,
+                                      SCE_SVoxelTerrainRegion *tr)
+{
+    SCE_SVoxelTerrainLevel *l = tr->level;
+    unsigned int x, y, z;
+    int draw = tr->draw, r = SCE_TRUE;
 
-        tr->draw = !SCE_VRender_IsEmpty (&tr->vm);
+    x = SCE_Math_Ring (tr->x - l->wrap_x, l->subregions);
+    y = SCE_Math_Ring (tr->y - l->wrap_y, l->subregions);
+    z = SCE_Math_Ring (tr->z - l->wrap_z, l->subregions);
+
+    x = l->x + x * (vt->subregion_dim - 1);
+    y = l->y + y * (vt->subregion_dim - 1);
+    z = l->z + z * (vt->subregion_dim - 1);
+
+    switch (vt->rpipeline) {
+    case SCE_VRENDER_SOFTWARE:
+        if ((r = SCE_VTerrain_Software (vt, tr, x, y, z)) < 0)
+            goto fail;
+        break;
+    case SCE_VRENDER_HARDWARE:
+        x += l->wrap[0];
+        y += l->wrap[1];
+        z += l->wrap[2];
+
+        /* the GPU outputs 32 bits indices, the hybrid generator may
+           have changed the type: update before Hardware(), so that the
+           realloc works properly */
+        SCE_Mesh_SetIndexType (tr->mesh, SCE_UNSIGNED_INT);
+        if (SCE_VRender_Hardware (&vt->temp, tr->level->tex, NULL,
+                                  &tr->vm, x, y, z) < 0)
+            goto fail;
+
+        break;
+    default:;
+    }
+
+    tr->draw = !SCE_VRender_IsEmpty (&tr->vm);
+    /* CPU meshes are already in place */
+    if (r && vt->rpipeline == SCE_VRENDER_HARDWARE &&
+        (r = SCE_VTerrain_StoreRegion (vt, tr)) < 0)
+        goto fail;
+    if (!r) {
+        /* the arena is full: the previous geometry is still in place, mesh
+           the region again later. it loses its edit priority, otherwise
+           SCE_VTerrain_UpdateEdits() would retry it right away */
+        tr->draw = draw;
+        tr->urgent = SCE_FALSE;
+        tr->need_update = SCE_TRUE;
         SCE_VTerrain_RemoveRegion (vt, tr);
+        return SCE_OK;
+    }
+    SCE_VTerrain_RemoveRegion (vt, tr);
+    SCE_VTerrain_EditDone (vt, tr);
+
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
+
+/* whether more work fits in this frame */
+static int SCE_VTerrain_HasTime (const SCE_SVoxelTerrain *vt)
+{
+    return !vt->budget || SCE_FrameBudget_HasTime (vt->budget);
+}
 
-        i++;
-        if (i >= vt->max_updates)
-            break;
+/**
+ * \brief Sets the maximum number of regions updated per frame, 8 by default
+ * \sa SCE_VTerrain_SetFrameBudget()
+ */
+void SCE_VTerrain_SetMaxUpdates (SCE_SVoxelTerrain *vt, SCEuint n)
+{
+    vt->max_updates = MAX (n, 1);
+}
+/**
+ * \brief Limits the time spent updating regions by a frame budget
+ * \param vt a voxel terrain
+ * \param budget a frame budget, possibly shared with other modules, NULL
+ * disables it (default)
+ *
+ * SCE_VTerrain_Update() then stops updating regions and running marching
+ * cubes steps of the hybrid generator once the budget is exhausted, the
+ * maximum number of updates still applies. One region is always updated per
+ * frame so that the terrain never stalls. The time spent by the whole update
+ * is charged to the budget.
+ * \sa SCE_FrameBudget_Begin(), SCE_VTerrain_SetMaxUpdates(),
+ * SCE_VOTerrain_SetFrameBudget()
+ */
+void SCE_VTerrain_SetFrameBudget (SCE_SVoxelTerrain *vt,
+                                  SCE_SFrameBudget *budget)
+{
+    vt->budget = budget;
+}
+
+/* meshes the edited regions right away, whichever level they belong to
+   and whatever the budget */
+static int SCE_VTerrain_UpdateEdits (SCE_SVoxelTerrain *vt)
+{
+    SCEuint i, j;
+
+    if (!vt->n_urgent)
+        return SCE_OK;
+
+    for (i = 0; i < vt->n_levels; i++) {
+        SCE_SVoxelTerrainLevel *tl = &vt->levels[i];
+        SCE_SList *lists[2];
+        int uploaded = SCE_FALSE;
+
+        lists[0] = tl->updating;
+        lists[1] = tl->queue;
+        for (j = 0; j < 2; j++) {
+            SCE_SListIterator *it = NULL, *pro = NULL;
+            SCE_List_ForEachProtected (pro, it, lists[j]) {
+                SCE_SVoxelTerrainRegion *tr = SCE_List_GetData (it);
+                if (!tr->urgent)
+                    continue;
+                /* the regions still queued are meshed from the new texture
+                   as well, which does no harm */
+                if (!uploaded) {
+                    if (SCE_VTerrain_UploadLevel (vt, tl) < 0)
+                        goto fail;
+                    uploaded = SCE_TRUE;
+                }
+                tr->need_update = SCE_FALSE;
+                if (SCE_VTerrain_UpdateRegion (vt, tr) < 0)
+                    goto fail;
+            }
+        }
     }
+    vt->n_urgent = 0;
+    return SCE_OK;
+fail:
+    SCEE_LogSrc ();
+    return SCE_ERROR;
+}
 
-    if (vt->update_level && !SCE_List_HasElements (list)) {
-        SCE_List_Remove (&vt->update_level->it);
-        if (SCE_List_HasElements (vt->update_level->queue))
-            SCE_List_Appendl (&vt->to_update, &vt->update_level->it);
+int SCE_VTerrain_Update (SCE_SVoxelTerrain *vt)
+{
+    size_t i = 0;
+    SCE_SList *list = NULL;
+
+    if (vt->budget)
+        SCE_FrameBudget_StartSlice (vt->budget);
+
+    if (SCE_VTerrain_UpdateEdits (vt) < 0)
+        goto fail;
+
+    /* dequeue the most urgent regions for update */
+    if (vt->update_level) {
+        list = vt->update_level->updating;
+        SCE_VTerrain_DropStaleRegions (vt, list);
+        SCE_VTerrain_ComputePriorities (vt, list);
+        for (i = 0; i < vt->max_updates; i++) {
+            SCE_SVoxelTerrainRegion *tr = NULL;
+            if (i > 0 && !SCE_VTerrain_HasTime (vt))
+                break;
+            if (!(tr = SCE_VTerrain_MostUrgent (list)))
+                break;
+            if (SCE_VTerrain_UpdateRegion (vt, tr) < 0)
+                goto fail;
+        }
+        /* the level is complete */
+        if (!SCE_List_HasElements (list)) {
+            SCE_List_Remove (&vt->update_level->it);
+            if (SCE_List_HasElements (vt->update_level->queue))
+                SCE_List_Appendl (&vt->to_update, &vt->update_level->it);
+            vt->update_level = NULL;
+        }
+    }
+
+    /* upload the texture of the next level, its regions are updated from
+       the next frame on; done only when a level is complete so that no
+       region is left behind, whatever the budget allowed */
+    if (!vt->update_level && SCE_List_HasElements (&vt->to_update) &&
+        (!i || SCE_VTerrain_HasTime (vt))) {
+        SCE_SList *derp = NULL;
+        SCE_SVoxelTerrainLevel *fresh = SCE_VTerrain_NextLevel (vt);
+        SCE_List_Removel (&fresh->it);
+        if (SCE_VTerrain_UploadLevel (vt, fresh) < 0)
+            goto fail;
+        derp = fresh->updating;
+        fresh->updating = fresh->queue;
+        fresh->queue = derp;
+        fresh->need_update = SCE_FALSE;
+        vt->update_level = fresh;
     }
-    vt->update_level = fresh;
 
     if (vt->cut) {
         if (SCE_VTerrain_UpdateHybrid (vt) < 0)
             goto fail;
     }
+    /* compact the arena a little bit */
+    if (vt->arena &&
+        SCE_MeshArena_Defragment (vt->arena, SCE_VTERRAIN_DEFRAGMENT_MOVES) < 0)
+        goto fail;
 
+    if (vt->budget)
+        SCE_FrameBudget_StopSlice (vt->budget);
     return SCE_OK;
 fail:
+    if (vt->budget)
+        SCE_FrameBudget_StopSlice (vt->budget);
     SCEE_LogSrc ();
     return SCE_ERROR;
 }
 
+/**
+ * \brief Gets the number of region updates dropped so far because the
+ * region was invalidated again before being processed
+ *
+ * Regions are updated by order of urgency: visible regions first, nearest
+ * first, regions covered by a finer level last.
+ * \sa SCE_VTerrain_Update(), SCE_VTerrain_CullRegions()
+ */
+SCEuint SCE_VTerrain_GetNumDroppedUpdates (const SCE_SVoxelTerrain *vt)
+{
+    return vt->n_dropped_updates;
+}
+/**
+ * \brief Gets the number of region meshings skipped so far because the
+ * voxels of the region don't cross the surface
+ *
+ * Each level keeps a min/max pyramid of its densities, updated along with
+ * the grid by SCE_VTerrain_AppendSlice() and SCE_VTerrain_UpdateSubGrid();
+ * regions found empty by SCE_VTerrain_UpdateSubGrid() are emptied right
+ * away instead of being queued. The hybrid generator does the same for the
+ * regions it receives through SCE_VTerrain_SetRegion().
+ */
+SCEuint SCE_VTerrain_GetNumEmptySkips (const SCE_SVoxelTerrain *vt)
+{
+    return vt->n_empty_skips;
+}
+/**
+ * \brief Gets the number of bytes of level textures uploaded so far
+ *
+ * Only the areas of the textures modified by SCE_VTerrain_UpdateSubGrid()
+ * and SCE_VTerrain_AppendSlice() are uploaded, through a ring of pixel
+ * buffers.
+ */
+size_t SCE_VTerrain_GetUploadedBytes (const SCE_SVoxelTerrain *vt)
+{
+    return SCE_Texture_GetStreamedBytes (&vt->stream);
+}
+/**
+ * \brief Gets the number of edited regions meshed so far
+ * \sa SCE_VTerrain_EditSubGrid(), SCE_VTerrain_GetEditLatency()
+ */
+SCEuint SCE_VTerrain_GetNumEdits (const SCE_SVoxelTerrain *vt)
+{
+    return vt->n_edits;
+}
+/**
+ * \brief Gets the average and maximum time between an edit and the meshing
+ * of the edited regions, in milliseconds
+ * \param vt a voxel terrain
+ * \param avg average latency, can be NULL
+ * \param max maximum latency, can be NULL
+ * \sa SCE_VTerrain_EditSubGrid(), SCE_VTerrain_GetNumEdits()
+ */
+void SCE_VTerrain_GetEditLatency (const SCE_SVoxelTerrain *vt, float *avg,
+                                  float *max)
+{
+    if (avg)
+        *avg = vt->n_edits ? vt->edit_latency / vt->n_edits : 0.0;
+    if (max)
+        *max = vt->max_edit_latency;
+}
+
 
 void SCE_VTerrain_UpdateGrid (SCE_SVoxelTerrain *vt, SCEuint level, int mat,
                               int draw)
@@ -1694,36 +2769,54 @@ void SCE_VTerrain_UpdateGrid (SCE_SVoxelTerrain *vt, SCEuint level, int mat,
     SCE_VTerrain_UpdateSubGrid (vt, level, &r, mat, draw);
 }
 
-void SCE_VTerrain_UpdateSubGrid (SCE_SVoxelTerrain *vt, SCEuint level,
-                                 SCE_SIntRect3 *rect, int mat, int draw)
+static void
+SCE_VTerrain_InvalidateSubGrid (SCE_SVoxelTerrain *vt, SCEuint level,
+                                SCE_SIntRect3 *rect, int mat, int draw,
+                                int urgent)
 {
     SCEuint x, y, z;
     SCEuint sx, sy, sz;
     SCEuint w, h, d;
-    int p1[3], p2[3];
+    int p1[3], p2[3], c1[3], c2[3];
     int l;
-    SCE_SIntRect3 r, grid_area;
+    SCE_SIntRect3 r, grid_area, cells;
+    SCE_SIntRect3 boxes[8];
+    SCEuint n_boxes, i;
     SCE_SVoxelTerrainLevel *tl = &vt->levels[level];
+    double now = 0.0;
 
+    if (urgent)
+        now = SCE_FrameBudget_GetTime ();
     if (mat) {
-        /* TODO: use rect and stuff blbl */
-        SCE_Texture_Update (tl->mat);
+        /* materials are only sampled, upload them right away. their grid
+           wraps on its own */
+        int wrap[3];
+        wrap[0] = tl->grid2.wrap_x;
+        wrap[1] = tl->grid2.wrap_y;
+        wrap[2] = tl->grid2.wrap_z;
+        n_boxes = SCE_VTerrain_WrapBox (vt, wrap, rect, boxes);
+        for (i = 0; i < n_boxes && tl->mat; i++) {
+            if (SCE_Texture_UpdateBox (tl->mat, &vt->stream, &boxes[i],
+                                       SCE_Grid_GetRaw (&tl->grid2), 1) < 0) {
+                SCEE_LogSrc ();
+                return;
+            }
+        }
         return;
     }
+    n_boxes = SCE_VTerrain_WrapBox (vt, tl->wrap, rect, boxes);
 
     /* get the intersection between the area to update and the grid area */
     SCE_Rectangle3_Set (&grid_area, 0, 0, 0, vt->width, vt->height, vt->depth);
     if (!SCE_Rectangle3_Intersection (&grid_area, rect, &r))
         return;                 /* does not intersect */
 
-    /* update 3D rectangle of updated area for 3D texture update */
-    if (!vt->levels[level].need_update) {
-        vt->levels[level].need_update = SCE_TRUE;
-        vt->levels[level].update_zone = r;
-    } else {
-        SCE_Rectangle3_Union (&vt->levels[level].update_zone,
-                              &r, &vt->levels[level].update_zone);
-    }
+    /* texels to upload at the next texture update */
+    SCE_VTerrain_AddDirtyBoxes (tl, boxes, n_boxes);
+    tl->need_update = SCE_TRUE;
+    for (i = 0; i < n_boxes; i++)
+        SCE_VPyramid_Update (&tl->pyramid, SCE_Grid_GetRaw (&tl->grid),
+                             &boxes[i]);
 
     SCE_Rectangle3_Move (&r, -tl->x, -tl->y, -tl->z);
     SCE_Rectangle3_GetPointsv (&r, p1, p2);
@@ -1747,13 +2840,60 @@ void SCE_VTerrain_UpdateSubGrid (SCE_SVoxelTerrain *vt, SCEuint level,
             for (x = sx; x <= w; x++) {
                 SCE_SVoxelTerrainRegion *region = NULL;
                 region = SCE_VTerrain_GetRegion (tl, x, y, z);
+                /* cells of the region */
+                c1[0] = tl->x + (int)x * l; c2[0] = c1[0] + l;
+                c1[1] = tl->y + (int)y * l; c2[1] = c1[1] + l;
+                c1[2] = tl->z + (int)z * l; c2[2] = c1[2] + l;
+                SCE_Rectangle3_Setv (&cells, c1, c2);
+                /* the hybrid generator might be waiting for its data */
+                if (!SCE_List_IsAttached (&region->it3) &&
+                    !SCE_VPyramid_HasCrossing (&tl->pyramid, &cells,
+                                               tl->wrap)) {
+                    if (SCE_VTerrain_SkipRegion (vt, region) < 0) {
+                        SCEE_LogSrc ();
+                        return;
+                    }
+                    continue;
+                }
                 SCE_VTerrain_AddRegion (vt, region);
                 region->draw = draw;
+                /* regions handed to the hybrid generator aren't queued */
+                if (urgent && !region->urgent &&
+                    SCE_List_IsAttached (&region->it)) {
+                    region->urgent = SCE_TRUE;
+                    region->edit_time = now;
+                    vt->n_urgent++;
+                }
             }
         }
     }
 }
 
+void SCE_VTerrain_UpdateSubGrid (SCE_SVoxelTerrain *vt, SCEuint level,
+                                 SCE_SIntRect3 *rect, int mat, int draw)
+{
+    SCE_VTerrain_InvalidateSubGrid (vt, level, rect, mat, draw, SCE_FALSE);
+}
+/**
+ * \brief Same as SCE_VTerrain_UpdateSubGrid() for an edit of the densities
+ * \param vt a voxel terrain
+ * \param level edited level
+ * \param rect edited area
+ *
+ * Call this right after modifying the density grid on behalf of the user
+ * (digging, building...). The regions of \p rect are meshed by the next
+ * SCE_VTerrain_Update(), ahead of the other regions and regardless of the
+ * frame budget. Regions of the hybrid levels get a GPU generated mesh at
+ * once, refined by the hybrid generator afterwards.
+ * \sa SCE_VTerrain_GetEditLatency()
+ */
+void SCE_VTerrain_EditSubGrid (SCE_SVoxelTerrain *vt, SCEuint level,
+                               SCE_SIntRect3 *rect)
+{
+    SCE_VTerrain_InvalidateSubGrid (vt, level, rect, SCE_FALSE, SCE_TRUE,
+                                    SCE_TRUE);
+}
+
 
 /**
  * \brief Activate/deactivate shadow rendering mode
@@ -1771,7 +2911,8 @@ void SCE_VTerrain_ActivatePointShadowMode (SCE_SVoxelTerrain *vt, int point)
     vt->point_shadow = point;
 }
 
-static void
+/* returns the number of draw calls issued */
+static SCEuint
 SCE_VTerrain_RenderLevel (const SCE_SVoxelTerrain *vt, SCEuint level,
                           const SCE_SVoxelTerrainLevel *tl,
                           const SCE_SVoxelTerrainLevel *tl3,
@@ -1783,6 +2924,7 @@ SCE_VTerrain_RenderLevel (const SCE_SVoxelTerrain *vt, SCEuint level,
     float invw, invh, invd;
     float scale;
     SCE_TVector3 v, invv;
+    SCEuint n = 0;
 
     scale = 1 << level;
     scale *= vt->scale;
@@ -1813,6 +2955,32 @@ SCE_VTerrain_RenderLevel (const SCE_SVoxelTerrain *vt, SCEuint level,
     SCE_Vector3_Set (v, tl->x * invw, tl->y * invh, tl->z * invd);
     SCE_Shader_SetParam3fv (shd->tcorigin_loc, 1, v);
 
+    if (vt->arena) {
+        /* the whole level in one multi-draw, the origin of each region
+           being given as per-draw data */
+        SCE_SMeshBatch *batch = SCE_MeshArena_GetBatch (vt->arena);
+        float data[4];
+
+        SCE_MeshBatch_SetAttribIndices (batch, shd->draw_attribs[0],
+                                        shd->draw_attribs[1],
+                                        shd->draw_attribs[2]);
+        SCE_MeshBatch_SetUserAttribIndex (batch, shd->draw_attribs[3]);
+        SCE_MeshBatch_Begin (batch);
+        SCE_List_ForEach (it, &tl->to_render) {
+            SCE_SVoxelTerrainRegion *region = SCE_List_GetData (it);
+
+            data[0] = (float)region->wx * (vt->subregion_dim - DERP) * invw;
+            data[1] = (float)region->wy * (vt->subregion_dim - DERP) * invh;
+            data[2] = (float)region->wz * (vt->subregion_dim - DERP) * invd;
+            data[3] = 0.0;
+            SCE_MeshBatch_DrawData (batch,
+                                    SCE_MeshArena_GetEntry (&region->alloc),
+                                    region->matrix, data);
+        }
+        SCE_MeshBatch_Flush (batch);
+        return SCE_MeshBatch_GetNumDrawCalls (batch);
+    }
+
     SCE_List_ForEach (it, &tl->to_render) {
         SCE_SVoxelTerrainRegion *region = SCE_List_GetData (it);
 
@@ -1828,7 +2996,9 @@ SCE_VTerrain_RenderLevel (const SCE_SVoxelTerrain *vt, SCEuint level,
         SCE_Mesh_Use (region->mesh);
         SCE_Mesh_Render ();
         SCE_Mesh_Unuse ();
+        n++;
     }
+    return n;
 }
 
 void SCE_VTerrain_Render (SCE_SVoxelTerrain *vt)
@@ -1837,6 +3007,7 @@ void SCE_VTerrain_Render (SCE_SVoxelTerrain *vt)
     SCE_SVoxelTerrainShader *lodshd = NULL, *defshd = NULL;
     SCE_SVoxelTerrainLevel *tl = NULL, *tl3 = NULL;
 
+    vt->n_draw_calls = 0;
     SCE_Texture_SetUnit (vt->top_diffuse, 2);
     SCE_Texture_SetUnit (vt->side_diffuse, 3);
     SCE_Texture_SetUnit (vt->noise, 4);
@@ -1881,7 +3052,8 @@ void SCE_VTerrain_Render (SCE_SVoxelTerrain *vt)
                 SCE_Shader_SetParam (lodshd->lowtex_loc, 1);
             }
 
-            SCE_VTerrain_RenderLevel (vt, i, tl, tl3, lodshd);
+            vt->n_draw_calls += SCE_VTerrain_RenderLevel (vt, i, tl, tl3,
+                                                          lodshd);
 
             SCE_Texture_BeginLot ();
         }
@@ -1894,7 +3066,8 @@ void SCE_VTerrain_Render (SCE_SVoxelTerrain *vt)
 
         SCE_Shader_Use (defshd->shd);
 
-        SCE_VTerrain_RenderLevel (vt, vt->n_levels - 1, tl, NULL, defshd);
+        vt->n_draw_calls += SCE_VTerrain_RenderLevel (vt, vt->n_levels - 1,
+                                                      tl, NULL, defshd);
 
         SCE_Shader_Use (NULL);
         SCE_Texture_Flush ();
@@ -1947,7 +3120,8 @@ void SCE_VTerrain_Render (SCE_SVoxelTerrain *vt)
                 SCE_Shader_SetParam (lodshd->lowtex_loc, 1);
             }
 
-            SCE_VTerrain_RenderLevel (vt, i, tl, tl3, lodshd);
+            vt->n_draw_calls += SCE_VTerrain_RenderLevel (vt, i, tl, tl3,
+                                                          lodshd);
 
             SCE_Texture_BeginLot ();
         }
@@ -1977,10 +3151,22 @@ void SCE_VTerrain_Render (SCE_SVoxelTerrain *vt)
         SCE_Shader_SetParam (defshd->material_loc, 5);
 
         SCE_RSetStencilFunc (SCE_LEQUAL, vt->n_levels, ~0U);
-        SCE_VTerrain_RenderLevel (vt, vt->n_levels - 1, tl, NULL, defshd);
+        vt->n_draw_calls += SCE_VTerrain_RenderLevel (vt, vt->n_levels - 1,
+                                                      tl, NULL, defshd);
 
         SCE_Shader_Use (NULL);
         SCE_Texture_Flush ();
         SCE_RDisableStencilTest ();
     }
 }
+
+/**
+ * \brief Gets the number of draw calls issued by the last render
+ *
+ * Equals the number of rendered levels when the terrain uses an arena.
+ * \sa SCE_VTerrain_SetArenaSize()
+ */
+SCEuint SCE_VTerrain_GetNumDrawCalls (const SCE_SVoxelTerrain *vt)
+{
+    return vt->n_draw_calls;
+}